@@ -0,0 +1,315 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "analyzer.h"
+
+#include <string.h>
+
+#define TS_PACKET 188
+#define TS_SYNC   0x47
+#define MAX_PID   8192
+#define NULL_PID  0x1FFF
+
+#define PCR_HZ    27000000
+#define PCR_WRAP  ( ( G_GUINT64_CONSTANT ( 1 ) << 33 ) * 300 )
+
+typedef struct _AnalyzerPid AnalyzerPid;
+
+struct _AnalyzerPid
+{
+	guint64 packets;
+	guint64 cc_errors;
+	guint64 tei;
+	guint64 scrambled;
+
+	guint64 window;
+	guint64 bitrate;
+	int cc;
+
+	guint64 pcr;
+	guint64 pcr_pos;
+	guint64 pcr_count;
+	double  pcr_ticks;
+
+	uint pcr_interval, pcr_interval_max;
+	uint pcr_jitter,   pcr_jitter_max;
+};
+
+struct _Analyzer
+{
+	AnalyzerPid *pids[MAX_PID];
+
+	uint8_t carry[TS_PACKET];
+	uint carry_len;
+
+	guint64 packets;
+	guint64 sync_loss;
+
+	guint64 window;
+	guint64 bitrate;
+	gint64  window_time;
+
+	GMutex mutex;
+};
+
+/* PCR: ticks per packet of the mux ( average ), the jitter is the difference of the PCR from the expected value */
+static void analyzer_pcr ( const uint8_t *packet, AnalyzerPid *ap, Analyzer *analyzer )
+{
+	guint64 base = ( (guint64)packet[6] << 25 ) | ( (guint64)packet[7] << 17 ) | ( (guint64)packet[8] << 9 ) | ( (guint64)packet[9] << 1 ) | ( packet[10] >> 7 );
+	guint64 ext  = ( (guint64)( packet[10] & 0x01 ) << 8 ) | packet[11];
+
+	guint64 pcr = base * 300 + ext;
+
+	ap->pcr_count++;
+
+	if ( ap->pcr_pos )
+	{
+		guint64 delta = ( pcr + PCR_WRAP - ap->pcr ) % PCR_WRAP;
+		guint64 n_packets = analyzer->packets - ap->pcr_pos;
+
+		if ( delta > 0 && delta < PCR_HZ && n_packets > 0 )
+		{
+			double ticks = (double)delta / (double)n_packets;
+
+			if ( ap->pcr_ticks > 0 )
+			{
+				double jitter = (double)delta - ap->pcr_ticks * (double)n_packets;
+
+				ap->pcr_jitter = (uint)( ( ( jitter < 0 ) ? -jitter : jitter ) * 1000 / ( PCR_HZ / 1000000 ) );
+				if ( ap->pcr_jitter > ap->pcr_jitter_max ) ap->pcr_jitter_max = ap->pcr_jitter;
+			}
+
+			ap->pcr_ticks = ( ap->pcr_ticks > 0 ) ? ( ap->pcr_ticks * 15 + ticks ) / 16 : ticks;
+
+			ap->pcr_interval = (uint)( delta / ( PCR_HZ / 1000000 ) );
+			if ( ap->pcr_interval > ap->pcr_interval_max ) ap->pcr_interval_max = ap->pcr_interval;
+		}
+	}
+
+	ap->pcr = pcr;
+	ap->pcr_pos = analyzer->packets;
+}
+
+static void analyzer_packet ( const uint8_t *packet, Analyzer *analyzer )
+{
+	uint16_t pid = (uint16_t)( ( ( packet[1] & 0x1F ) << 8 ) | packet[2] );
+
+	AnalyzerPid *ap = analyzer->pids[pid];
+
+	if ( !ap )
+	{
+		ap = analyzer->pids[pid] = g_new0 ( AnalyzerPid, 1 );
+		ap->cc = -1;
+	}
+
+	analyzer->packets++;
+	ap->packets++;
+
+	if ( packet[1] & 0x80 ) { ap->tei++; return; }
+
+	if ( packet[3] & 0xC0 ) ap->scrambled++;
+
+	uint8_t afc = ( packet[3] >> 4 ) & 0x03;
+	int cc = packet[3] & 0x0F;
+
+	gboolean af = ( afc & 0x02 ) && packet[4] > 0;
+	gboolean discontinuity = af && ( packet[5] & 0x80 );
+
+	if ( pid != NULL_PID && ap->cc != -1 && !discontinuity )
+	{
+		int expect = ( afc & 0x01 ) ? ( ap->cc + 1 ) & 0x0F : ap->cc;
+
+		if ( cc != expect && !( ( afc & 0x01 ) && cc == ap->cc ) ) ap->cc_errors++;
+	}
+
+	ap->cc = cc;
+
+	if ( af && packet[4] >= 7 && ( packet[5] & 0x10 ) )
+	{
+		if ( discontinuity ) ap->pcr_pos = 0;
+
+		analyzer_pcr ( packet, ap, analyzer );
+	}
+}
+
+/* Mutex held: bitrates of the last second */
+static void analyzer_window ( Analyzer *analyzer )
+{
+	gint64 now = g_get_monotonic_time ();
+
+	if ( analyzer->window_time == 0 ) analyzer->window_time = now;
+
+	gint64 dt = now - analyzer->window_time;
+
+	if ( dt < G_USEC_PER_SEC ) return;
+
+	uint i = 0; for ( i = 0; i < MAX_PID; i++ )
+	{
+		AnalyzerPid *ap = analyzer->pids[i];
+
+		if ( !ap ) continue;
+
+		ap->bitrate = ( ap->packets - ap->window ) * TS_PACKET * 8 * G_USEC_PER_SEC / (guint64)dt;
+		ap->window  = ap->packets;
+	}
+
+	analyzer->bitrate = ( analyzer->packets - analyzer->window ) * TS_PACKET * 8 * G_USEC_PER_SEC / (guint64)dt;
+	analyzer->window  = analyzer->packets;
+	analyzer->window_time = now;
+}
+
+/* Mutex held. Next sync byte: memchr ( vectorized in libc ), confirmed by the sync byte of the next packet */
+static const uint8_t * analyzer_sync ( const uint8_t *data, gsize len, Analyzer *analyzer )
+{
+	const uint8_t *end = data + len;
+
+	analyzer->sync_loss++;
+
+	while ( data < end )
+	{
+		const uint8_t *sync = memchr ( data, TS_SYNC, (size_t)( end - data ) );
+
+		if ( !sync ) return end;
+
+		if ( sync + TS_PACKET >= end || sync[TS_PACKET] == TS_SYNC ) return sync;
+
+		data = sync + 1;
+	}
+
+	return end;
+}
+
+GstPadProbeReturn analyzer_probe ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, Analyzer *analyzer )
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	GstMapInfo map;
+	if ( !gst_buffer_map ( buffer, &map, GST_MAP_READ ) ) return GST_PAD_PROBE_OK;
+
+	const uint8_t *data = map.data, *end = map.data + map.size;
+
+	g_mutex_lock ( &analyzer->mutex );
+
+		if ( analyzer->carry_len )
+		{
+			uint part = (uint)MIN ( (gsize)( TS_PACKET - analyzer->carry_len ), map.size );
+
+			memcpy ( analyzer->carry + analyzer->carry_len, data, part );
+
+			analyzer->carry_len += part;
+			data += part;
+
+			if ( analyzer->carry_len == TS_PACKET )
+			{
+				if ( analyzer->carry[0] == TS_SYNC ) analyzer_packet ( analyzer->carry, analyzer );
+
+				analyzer->carry_len = 0;
+			}
+		}
+
+		while ( end - data >= TS_PACKET )
+		{
+			if ( data[0] != TS_SYNC ) { data = analyzer_sync ( data, (gsize)( end - data ), analyzer ); continue; }
+
+			analyzer_packet ( data, analyzer );
+
+			data += TS_PACKET;
+		}
+
+		if ( data < end && data[0] == TS_SYNC )
+		{
+			analyzer->carry_len = (uint)( end - data );
+			memcpy ( analyzer->carry, data, analyzer->carry_len );
+		}
+
+		analyzer_window ( analyzer );
+
+	g_mutex_unlock ( &analyzer->mutex );
+
+	gst_buffer_unmap ( buffer, &map );
+
+	return GST_PAD_PROBE_OK;
+}
+
+char * analyzer_get_report ( gboolean csv, Analyzer *analyzer )
+{
+	GString *gstring = g_string_new ( NULL );
+
+	g_mutex_lock ( &analyzer->mutex );
+
+		if ( csv )
+			g_string_append ( gstring, "pid,kbit/s,packets,cc-errors,tei,scrambled,pcr,pcr-interval-max-ms,pcr-jitter-max-us\n" );
+		else
+			g_string_append_printf ( gstring, "Mux  %.2f Mbit/s   Packets  %" G_GUINT64_FORMAT "   Sync loss  %" G_GUINT64_FORMAT "\n\n"
+				"   Pid    Mbit/s     CC err   TEI   Scrambled   PCR ms ( max )   Jitter us ( max )\n",
+				(double)analyzer->bitrate / 1000000, analyzer->packets, analyzer->sync_loss );
+
+		uint i = 0; for ( i = 0; i < MAX_PID; i++ )
+		{
+			AnalyzerPid *ap = analyzer->pids[i];
+
+			if ( !ap ) continue;
+
+			if ( csv )
+			{
+				g_string_append_printf ( gstring, "%u,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT
+					",%" G_GUINT64_FORMAT ",%.1f,%.1f\n", i, ap->bitrate / 1000, ap->packets, ap->cc_errors, ap->tei, ap->scrambled,
+					ap->pcr_count, (double)ap->pcr_interval_max / 1000, (double)ap->pcr_jitter_max / 1000 );
+
+				continue;
+			}
+
+			g_string_append_printf ( gstring, "0x%04x  %8.3f  %9" G_GUINT64_FORMAT "  %4" G_GUINT64_FORMAT "  %10" G_GUINT64_FORMAT,
+				i, (double)ap->bitrate / 1000000, ap->cc_errors, ap->tei, ap->scrambled );
+
+			if ( ap->pcr_count )
+				g_string_append_printf ( gstring, "   %5.1f ( %5.1f )   %7.1f ( %7.1f )", (double)ap->pcr_interval / 1000, (double)ap->pcr_interval_max / 1000,
+					(double)ap->pcr_jitter / 1000, (double)ap->pcr_jitter_max / 1000 );
+
+			g_string_append_c ( gstring, '\n' );
+		}
+
+	g_mutex_unlock ( &analyzer->mutex );
+
+	return g_string_free ( gstring, FALSE );
+}
+
+void analyzer_reset ( Analyzer *analyzer )
+{
+	g_mutex_lock ( &analyzer->mutex );
+
+		uint i = 0; for ( i = 0; i < MAX_PID; i++ ) { free ( analyzer->pids[i] ); analyzer->pids[i] = NULL; }
+
+		analyzer->carry_len = 0;
+		analyzer->packets   = 0;
+		analyzer->sync_loss = 0;
+		analyzer->window    = 0;
+		analyzer->bitrate   = 0;
+		analyzer->window_time = 0;
+
+	g_mutex_unlock ( &analyzer->mutex );
+}
+
+Analyzer * analyzer_new ( void )
+{
+	Analyzer *analyzer = g_new0 ( Analyzer, 1 );
+
+	g_mutex_init ( &analyzer->mutex );
+
+	return analyzer;
+}
+
+void analyzer_free ( Analyzer *analyzer )
+{
+	analyzer_reset ( analyzer );
+
+	g_mutex_clear ( &analyzer->mutex );
+
+	free ( analyzer );
+}
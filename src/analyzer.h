@@ -0,0 +1,31 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+/* TS analyzer: buffer probe after dvbsrc. Per pid: bitrate, continuity counter errors, transport error indicator,
+ * scrambled packets, PCR interval and jitter ( PCR against the packet position at the average mux rate ) */
+
+typedef struct _Analyzer Analyzer;
+
+Analyzer * analyzer_new ( void );
+
+void analyzer_free ( Analyzer * );
+
+/* New stream: all counters are cleared */
+void analyzer_reset ( Analyzer * );
+
+/* Buffer probe: any buffer size ( dvbsrc, filesrc ) */
+GstPadProbeReturn analyzer_probe ( GstPad *, GstPadProbeInfo *, Analyzer * );
+
+/* Returns a newly-allocated string holding the report: text table or CSV ( one line per pid ). Free with free() */
+char * analyzer_get_report ( gboolean csv, Analyzer * );
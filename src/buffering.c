@@ -0,0 +1,219 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "buffering.h"
+
+typedef struct _BufferingSet BufferingSet;
+
+struct _BufferingSet
+{
+	const char *name;
+
+	guint64 time;         // max-size-time
+	uint bytes;           // max-size-bytes, 0 - by time only
+	int leaky;            // 2 - downstream ( the oldest buffers are dropped )
+	int demux_latency;    // ms, -1 - tsdemux default
+};
+
+static const BufferingSet buffering_set_n[] =
+{
+	[BUFFERING_LIVE]   = { "live",    1 * GST_SECOND, 0,                2,  300 },
+	[BUFFERING_ROBUST] = { "robust",  4 * GST_SECOND, 0,                0, 1000 },
+	[BUFFERING_RECORD] = { "record", 10 * GST_SECOND, 64 * 1024 * 1024, 0,   -1 }
+};
+
+/* The record branches share the pipeline of the live view */
+static const char *buffering_types[] = { "video", "audio", "rec" };
+
+typedef struct _BufferingMeter BufferingMeter;
+
+struct _BufferingMeter
+{
+	const char *type;
+	GstSegment segment;
+	int age;              // ms, smoothed; G_MININT - no buffer yet
+};
+
+BufferingProfile buffering_profile_get ( const char *name, BufferingProfile def )
+{
+	if ( !name ) return def;
+
+	uint i = 0; for ( i = 0; i < G_N_ELEMENTS ( buffering_set_n ); i++ )
+		if ( g_str_equal ( name, buffering_set_n[i].name ) ) return (BufferingProfile)i;
+
+	return def;
+}
+
+const char * buffering_profile_name ( BufferingProfile profile )
+{
+	return buffering_set_n[profile].name;
+}
+
+GstElement * buffering_queue_new ( BufferingProfile profile, const char *type )
+{
+	GstElement *queue = gst_element_factory_make ( "queue", NULL );
+
+	if ( !queue ) { g_critical ( "%s:: element (factory make) - queue not created. \n", __func__ ); return NULL; }
+
+	const BufferingSet *set = &buffering_set_n[profile];
+
+	g_object_set ( queue, "max-size-buffers", 0, "max-size-bytes", set->bytes, "max-size-time", set->time, "leaky", set->leaky, NULL );
+
+	g_object_set_data ( G_OBJECT ( queue ), "buffering-type", (gpointer)type );
+	g_object_set_data ( G_OBJECT ( queue ), "buffering-profile", GINT_TO_POINTER ( profile + 1 ) );
+
+	return queue;
+}
+
+void buffering_demux_set ( GstElement *demux, BufferingProfile profile )
+{
+	int latency = buffering_set_n[profile].demux_latency;
+
+	if ( latency != -1 && g_object_class_find_property ( G_OBJECT_GET_CLASS ( demux ), "latency" ) )
+		g_object_set ( demux, "latency", latency, NULL );
+}
+
+/* Streaming thread: the running time of a buffer is its capture time ( dvbsrc timestamps, live tsdemux ); age = clock - running time */
+static GstPadProbeReturn buffering_meter_probe ( GstPad *pad, GstPadProbeInfo *info, BufferingMeter *meter )
+{
+	if ( info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM )
+	{
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT ( info );
+
+		if ( GST_EVENT_TYPE ( event ) == GST_EVENT_SEGMENT ) gst_event_copy_segment ( event, &meter->segment );
+
+		return GST_PAD_PROBE_OK;
+	}
+
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	if ( !GST_BUFFER_PTS_IS_VALID ( buffer ) || meter->segment.format != GST_FORMAT_TIME ) return GST_PAD_PROBE_OK;
+
+	guint64 running = gst_segment_to_running_time ( &meter->segment, GST_FORMAT_TIME, GST_BUFFER_PTS ( buffer ) );
+
+	GstElement *element = GST_ELEMENT ( GST_PAD_PARENT ( pad ) );
+	GstClock *clock = gst_element_get_clock ( element );
+
+	if ( !clock || running == GST_CLOCK_TIME_NONE ) { if ( clock ) gst_object_unref ( clock ); return GST_PAD_PROBE_OK; }
+
+	gint64 now = (gint64)( gst_clock_get_time ( clock ) - gst_element_get_base_time ( element ) );
+
+	gst_object_unref ( clock );
+
+	int age = (int)( ( now - (gint64)running ) / GST_MSECOND );
+	int old = g_atomic_int_get ( &meter->age );
+
+	g_atomic_int_set ( &meter->age, ( old == G_MININT ) ? age : ( old * 7 + age ) / 8 );
+
+	return GST_PAD_PROBE_OK;
+}
+
+void buffering_meter_add ( GstElement *element, const char *type )
+{
+	BufferingMeter *meter = g_new0 ( BufferingMeter, 1 );
+
+	meter->type = type;
+	meter->age  = G_MININT;
+	gst_segment_init ( &meter->segment, GST_FORMAT_UNDEFINED );
+
+	/* The pad goes with the element */
+	g_object_set_data_full ( G_OBJECT ( element ), "buffering-meter", meter, free );
+
+	GstPad *pad = gst_element_get_static_pad ( element, "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)buffering_meter_probe, meter, NULL );
+	gst_object_unref ( pad );
+}
+
+static int buffering_type_index ( const char *type )
+{
+	uint i = 0; for ( i = 0; i < G_N_ELEMENTS ( buffering_types ); i++ )
+		if ( g_str_equal ( type, buffering_types[i] ) ) return (int)i;
+
+	return -1;
+}
+
+/* Fill of the queue in %: the larger of time and bytes */
+static int buffering_queue_fill ( GstElement *queue )
+{
+	guint64 level_time = 0, max_time = 0;
+	uint level_bytes = 0, max_bytes = 0;
+
+	g_object_get ( queue, "current-level-time", &level_time, "max-size-time", &max_time, "current-level-bytes", &level_bytes, "max-size-bytes", &max_bytes, NULL );
+
+	int fill_time  = ( max_time  ) ? (int)( level_time  * 100 / max_time  ) : 0;
+	int fill_bytes = ( max_bytes ) ? (int)( (guint64)level_bytes * 100 / max_bytes ) : 0;
+
+	return MAX ( fill_time, fill_bytes );
+}
+
+static GstClockTime buffering_pipeline_latency ( GstElement *pipeline )
+{
+	GstClockTime min = 0;
+	gboolean live = FALSE;
+
+	GstQuery *query = gst_query_new_latency ();
+
+	if ( gst_element_query ( pipeline, query ) ) gst_query_parse_latency ( query, &live, &min, NULL );
+
+	gst_query_unref ( query );
+
+	return ( live ) ? min : 0;
+}
+
+/* A buffer is rendered at its running time + the pipeline latency, a late one on arrival: end-to-end = MAX ( age, latency ) */
+char * buffering_get_info ( GstElement *pipeline )
+{
+	int fill[ G_N_ELEMENTS ( buffering_types ) ] = { -1, -1, -1 };
+	int age [ G_N_ELEMENTS ( buffering_types ) ] = { G_MININT, G_MININT, G_MININT };
+
+	int profile = 0;
+
+	GstIterator *it = gst_bin_iterate_recurse ( GST_BIN ( pipeline ) );
+	GValue item = { 0, };
+
+	while ( gst_iterator_next ( it, &item ) == GST_ITERATOR_OK )
+	{
+		GObject *element = g_value_get_object (&item);
+
+		const char *type = g_object_get_data ( element, "buffering-type" );
+		const BufferingMeter *meter = g_object_get_data ( element, "buffering-meter" );
+
+		int i = ( type ) ? buffering_type_index ( type ) : -1;
+
+		if ( i != -1 )
+		{
+			fill[i] = MAX ( fill[i], buffering_queue_fill ( GST_ELEMENT ( element ) ) );
+
+			if ( !profile && i < 2 ) profile = GPOINTER_TO_INT ( g_object_get_data ( element, "buffering-profile" ) );
+		}
+
+		i = ( meter ) ? buffering_type_index ( meter->type ) : -1;
+
+		if ( i != -1 ) age[i] = g_atomic_int_get ( &meter->age );
+
+		g_value_reset (&item);
+	}
+
+	g_value_unset ( &item );
+	gst_iterator_free ( it );
+
+	int latency = (int)( buffering_pipeline_latency ( pipeline ) / GST_MSECOND );
+
+	GString *gstring = g_string_new ( NULL );
+
+	g_string_append_printf ( gstring, "%s  |  latency %d ms", ( profile ) ? buffering_set_n[profile - 1].name : "-", latency );
+
+	uint i = 0; for ( i = 0; i < G_N_ELEMENTS ( buffering_types ); i++ )
+		if ( age[i] != G_MININT ) g_string_append_printf ( gstring, "  |  %s end-to-end %d ms", buffering_types[i], MAX ( age[i], latency ) );
+
+	for ( i = 0; i < G_N_ELEMENTS ( buffering_types ); i++ )
+		if ( fill[i] != -1 ) g_string_append_printf ( gstring, "  |  %s queue %d %%", buffering_types[i], fill[i] );
+
+	return g_string_free ( gstring, FALSE );
+}
@@ -0,0 +1,43 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+/* Buffering profiles of the queues in front of the decoders ( live view ) and in the record branches:
+ *   live:   small leaky queues sized by time, low tsdemux latency - stale data is dropped instead of adding delay
+ *   robust: larger queues without loss, more tsdemux latency - for weak signal ( PCR / PTS jitter, short dropouts )
+ *   record: large queues without loss - a slow disk must not stall the tee */
+
+typedef enum
+{
+	BUFFERING_LIVE,
+	BUFFERING_ROBUST,
+	BUFFERING_RECORD
+} BufferingProfile;
+
+/* name: "live", "robust", "record"; unknown or NULL - def */
+BufferingProfile buffering_profile_get ( const char *name, BufferingProfile def );
+
+const char * buffering_profile_name ( BufferingProfile );
+
+/* queue of the profile; type: "audio", "video" ( live view ), "rec" ( for the fill report ) */
+GstElement * buffering_queue_new ( BufferingProfile, const char *type );
+
+/* tsdemux: the latency of the profile ( if the property exists; record - unchanged ) */
+void buffering_demux_set ( GstElement *demux, BufferingProfile );
+
+/* element: the first one after the decoder ( volume, videobalance ); the age of the buffers there is measured.
+ * type: "audio", "video" */
+void buffering_meter_add ( GstElement *element, const char *type );
+
+/* Main loop. Returns a newly-allocated string: profile, end-to-end latency, queue fill. Free with free() */
+char * buffering_get_info ( GstElement *pipeline );
@@ -0,0 +1,280 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "channel-db.h"
+
+#define CACHE_VERSION 2
+#define CACHE_TYPE "(uxxa(ssa(ss)))"
+
+struct _ChannelDb
+{
+	GHashTable *records;   // data → Channel ( owned )
+
+	GPtrArray *list;
+	GHashTable *names;
+	GHashTable *sids;
+	GHashTable *triplets;
+	GHashTable *lcns;
+};
+
+static uint channel_db_triplet_hash ( const Channel *channel )
+{
+	return ( (uint)channel->onid << 16 ^ (uint)channel->tsid << 8 ) ^ channel->sid;
+}
+
+static gboolean channel_db_triplet_equal ( const Channel *channel_a, const Channel *channel_b )
+{
+	return ( channel_a->onid == channel_b->onid && channel_a->tsid == channel_b->tsid && channel_a->sid == channel_b->sid ) ? TRUE : FALSE;
+}
+
+Channel * channel_db_get ( const char *data, ChannelDb *db )
+{
+	if ( !data ) return NULL;
+
+	Channel *channel = g_hash_table_lookup ( db->records, data );
+
+	if ( channel ) return channel;
+
+	channel = channel_new ( data );
+
+	if ( channel ) g_hash_table_insert ( db->records, channel->data, channel );
+
+	return channel;
+}
+
+void channel_db_clear ( ChannelDb *db )
+{
+	uint i = 0; for ( i = 0; i < db->list->len; i++ ) ( (Channel *)g_ptr_array_index ( db->list, i ) )->index = -1;
+
+	g_ptr_array_set_size ( db->list, 0 );
+
+	g_hash_table_remove_all ( db->names );
+	g_hash_table_remove_all ( db->sids );
+	g_hash_table_remove_all ( db->triplets );
+	g_hash_table_remove_all ( db->lcns );
+}
+
+/* The first channel of the list wins */
+void channel_db_append ( Channel *channel, ChannelDb *db )
+{
+	channel->index = (int)db->list->len;
+
+	g_ptr_array_add ( db->list, channel );
+
+	if ( !g_hash_table_contains ( db->names, channel->name ) ) g_hash_table_insert ( db->names, channel->name, channel );
+
+	if ( channel->sid && !g_hash_table_contains ( db->sids, GUINT_TO_POINTER ( channel->sid ) ) )
+		g_hash_table_insert ( db->sids, GUINT_TO_POINTER ( channel->sid ), channel );
+
+	if ( channel->tsid && !g_hash_table_contains ( db->triplets, channel ) ) g_hash_table_add ( db->triplets, channel );
+
+	if ( channel->lcn && !g_hash_table_contains ( db->lcns, GUINT_TO_POINTER ( channel->lcn ) ) )
+		g_hash_table_insert ( db->lcns, GUINT_TO_POINTER ( channel->lcn ), channel );
+}
+
+uint channel_db_count ( ChannelDb *db )
+{
+	return db->list->len;
+}
+
+Channel * channel_db_nth ( uint index, ChannelDb *db )
+{
+	return ( index < db->list->len ) ? g_ptr_array_index ( db->list, index ) : NULL;
+}
+
+Channel * channel_db_find_name ( const char *name, ChannelDb *db )
+{
+	Channel *channel = g_hash_table_lookup ( db->names, name );
+
+	if ( channel ) return channel;
+
+	uint i = 0; for ( i = 0; i < db->list->len; i++ )
+	{
+		channel = g_ptr_array_index ( db->list, i );
+
+		if ( g_str_has_prefix ( channel->name, name ) ) return channel;
+	}
+
+	return NULL;
+}
+
+Channel * channel_db_find_sid ( uint16_t sid, ChannelDb *db )
+{
+	return g_hash_table_lookup ( db->sids, GUINT_TO_POINTER ( sid ) );
+}
+
+Channel * channel_db_find_triplet ( uint16_t onid, uint16_t tsid, uint16_t sid, ChannelDb *db )
+{
+	Channel key = { .onid = onid, .tsid = tsid, .sid = sid };
+
+	return g_hash_table_lookup ( db->triplets, &key );
+}
+
+Channel * channel_db_find_lcn ( uint16_t lcn, ChannelDb *db )
+{
+	return g_hash_table_lookup ( db->lcns, GUINT_TO_POINTER ( lcn ) );
+}
+
+Channel * channel_db_step ( const Channel *channel, int step, ChannelDb *db )
+{
+	int len = (int)db->list->len;
+
+	if ( len == 0 ) return NULL;
+
+	if ( !channel || channel->index < 0 || channel->index >= len || g_ptr_array_index ( db->list, channel->index ) != channel )
+		return g_ptr_array_index ( db->list, 0 );
+
+	int index = ( ( channel->index + step ) % len + len ) % len;
+
+	return g_ptr_array_index ( db->list, index );
+}
+
+/* mtime in us: a conf rewritten within the same second must not match the stamp of the older cache */
+static gboolean channel_db_conf_stat ( const char *conf, gint64 *mtime, gint64 *size )
+{
+	GFile *file = g_file_new_for_path ( conf );
+	GFileInfo *info = g_file_query_info ( file, G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL );
+
+	g_object_unref ( file );
+
+	if ( !info ) return FALSE;
+
+	*mtime = (gint64)g_file_info_get_attribute_uint64 ( info, G_FILE_ATTRIBUTE_TIME_MODIFIED ) * G_USEC_PER_SEC
+	       + (gint64)g_file_info_get_attribute_uint32 ( info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC );
+	*size  = g_file_info_get_size ( info );
+
+	g_object_unref ( info );
+
+	return TRUE;
+}
+
+gboolean channel_db_load ( const char *cache, const char *conf, ChannelDb *db )
+{
+	gint64 mtime = 0, size = 0;
+
+	if ( !channel_db_conf_stat ( conf, &mtime, &size ) ) return FALSE;
+
+	GMappedFile *mfile = g_mapped_file_new ( cache, FALSE, NULL );
+
+	if ( !mfile ) return FALSE;
+
+	GBytes *bytes = g_mapped_file_get_bytes ( mfile );
+	GVariant *variant = g_variant_new_from_bytes ( G_VARIANT_TYPE ( CACHE_TYPE ), bytes, FALSE );
+
+	g_bytes_unref ( bytes );
+	g_mapped_file_unref ( mfile );
+
+	uint version = 0;
+	gint64 cache_mtime = 0, cache_size = 0;
+	GVariantIter *iter_ch = NULL;
+
+	g_variant_get ( variant, CACHE_TYPE, &version, &cache_mtime, &cache_size, &iter_ch );
+
+	gboolean ret = ( version == CACHE_VERSION && cache_mtime == mtime && cache_size == size ) ? TRUE : FALSE;
+
+	if ( ret )
+	{
+		channel_db_clear ( db );
+
+		const char *data = NULL, *name = NULL;
+		GVariantIter *iter_f = NULL;
+
+		while ( g_variant_iter_loop ( iter_ch, "(&s&sa(ss))", &data, &name, &iter_f ) )
+		{
+			Channel *channel = g_hash_table_lookup ( db->records, data );
+
+			if ( !channel )
+			{
+				channel = channel_new_empty ( data, name );
+
+				const char *key = NULL, *value = NULL;
+				while ( g_variant_iter_loop ( iter_f, "(&s&s)", &key, &value ) ) channel_add_field ( key, value, channel );
+
+				g_hash_table_insert ( db->records, channel->data, channel );
+			}
+
+			channel_db_append ( channel, db );
+		}
+	}
+
+	g_variant_iter_free ( iter_ch );
+	g_variant_unref ( variant );
+
+	return ret;
+}
+
+void channel_db_save ( const char *cache, const char *conf, ChannelDb *db )
+{
+	gint64 mtime = 0, size = 0;
+
+	if ( !channel_db_conf_stat ( conf, &mtime, &size ) ) return;
+
+	GVariantBuilder builder;
+	g_variant_builder_init ( &builder, G_VARIANT_TYPE ( "a(ssa(ss))" ) );
+
+	uint i = 0; for ( i = 0; i < db->list->len; i++ )
+	{
+		const Channel *channel = g_ptr_array_index ( db->list, i );
+
+		g_variant_builder_open ( &builder, G_VARIANT_TYPE ( "(ssa(ss))" ) );
+		g_variant_builder_add ( &builder, "s", channel->data );
+		g_variant_builder_add ( &builder, "s", channel->name );
+
+		g_variant_builder_open ( &builder, G_VARIANT_TYPE ( "a(ss)" ) );
+
+		uint j = 0; for ( j = 0; j < channel->fields->len; j++ )
+		{
+			const ChannelField *field = &g_array_index ( channel->fields, ChannelField, j );
+
+			g_variant_builder_add ( &builder, "(ss)", field->key, field->str );
+		}
+
+		g_variant_builder_close ( &builder );
+		g_variant_builder_close ( &builder );
+	}
+
+	GVariant *variant = g_variant_ref_sink ( g_variant_new ( "(uxxa(ssa(ss)))", CACHE_VERSION, mtime, size, &builder ) );
+
+	GError *error = NULL;
+
+	if ( !g_file_set_contents ( cache, g_variant_get_data ( variant ), (gssize)g_variant_get_size ( variant ), &error ) )
+	{
+		g_warning ( "%s: %s ", __func__, error->message );
+		g_error_free ( error );
+	}
+
+	g_variant_unref ( variant );
+}
+
+ChannelDb * channel_db_new ( void )
+{
+	ChannelDb *db = g_new0 ( ChannelDb, 1 );
+
+	db->records  = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, (GDestroyNotify)channel_free );
+	db->list     = g_ptr_array_new ();
+	db->names    = g_hash_table_new ( g_str_hash, g_str_equal );
+	db->sids     = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	db->triplets = g_hash_table_new ( (GHashFunc)channel_db_triplet_hash, (GEqualFunc)channel_db_triplet_equal );
+	db->lcns     = g_hash_table_new ( g_direct_hash, g_direct_equal );
+
+	return db;
+}
+
+void channel_db_free ( ChannelDb *db )
+{
+	g_hash_table_unref ( db->names );
+	g_hash_table_unref ( db->sids );
+	g_hash_table_unref ( db->triplets );
+	g_hash_table_unref ( db->lcns );
+	g_ptr_array_unref ( db->list );
+
+	g_hash_table_unref ( db->records );
+
+	free ( db );
+}
@@ -0,0 +1,52 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include "channel.h"
+
+/* Channel database beside the tree view: the parsed records ( by data ) and the channel list in the order of the tree view,
+ * indexed by name, sid, onid / tsid / sid and LCN.
+ * Binary cache ( GVariant ): the list with the fields of every record, valid while gtv-channel.conf is unchanged ( mtime, size ) */
+
+typedef struct _ChannelDb ChannelDb;
+
+ChannelDb * channel_db_new ( void );
+
+void channel_db_free ( ChannelDb * );
+
+/* The record of the data: looked up or parsed ( not added to the list ). NULL - no channel */
+Channel * channel_db_get ( const char *data, ChannelDb * );
+
+/* The list and its indexes are emptied, the records stay */
+void channel_db_clear ( ChannelDb * );
+
+/* End of the list */
+void channel_db_append ( Channel *, ChannelDb * );
+
+uint channel_db_count ( ChannelDb * );
+
+Channel * channel_db_nth ( uint index, ChannelDb * );
+
+/* The first one of the list; name: exact, otherwise the first name with this prefix */
+Channel * channel_db_find_name ( const char *name, ChannelDb * );
+
+Channel * channel_db_find_sid ( uint16_t sid, ChannelDb * );
+
+Channel * channel_db_find_triplet ( uint16_t onid, uint16_t tsid, uint16_t sid, ChannelDb * );
+
+Channel * channel_db_find_lcn ( uint16_t lcn, ChannelDb * );
+
+/* Next ( step 1 ) / previous ( step -1 ) of the list, wraps; channel not listed - the first one */
+Channel * channel_db_step ( const Channel *, int step, ChannelDb * );
+
+/* The list from the cache, if it was saved with this conf file. Returns FALSE - the conf is to be parsed */
+gboolean channel_db_load ( const char *cache, const char *conf, ChannelDb * );
+
+void channel_db_save ( const char *cache, const char *conf, ChannelDb * );
@@ -0,0 +1,211 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "channel.h"
+#include "scan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The class of dvbsrc, loaded once; NULL without the plugin ( DVB_TS_FILE ) */
+static GObjectClass * channel_dvbsrc_class ( void )
+{
+	static GObjectClass *klass = NULL;
+	static gboolean loaded = FALSE;
+
+	if ( loaded ) return klass;
+
+	loaded = TRUE;
+
+	GstElementFactory *factory = gst_element_factory_find ( "dvbsrc" );
+
+	if ( !factory ) return NULL;
+
+	GstPluginFeature *feature = gst_plugin_feature_load ( GST_PLUGIN_FEATURE ( factory ) );
+
+	if ( feature )
+	{
+		GType type = gst_element_factory_get_element_type ( GST_ELEMENT_FACTORY ( feature ) );
+
+		if ( type ) klass = G_OBJECT_CLASS ( g_type_class_ref ( type ) );
+
+		gst_object_unref ( feature );
+	}
+
+	gst_object_unref ( factory );
+
+	return klass;
+}
+
+static gboolean channel_value_set ( GValue *value, GParamSpec *pspec, long num, const char *str )
+{
+	g_value_init ( value, pspec->value_type );
+
+	switch ( G_TYPE_FUNDAMENTAL ( pspec->value_type ) )
+	{
+		case G_TYPE_INT:     g_value_set_int     ( value, (int)num     ); break;
+		case G_TYPE_UINT:    g_value_set_uint    ( value, (uint)num    ); break;
+		case G_TYPE_LONG:    g_value_set_long    ( value, num          ); break;
+		case G_TYPE_ULONG:   g_value_set_ulong   ( value, (ulong)num   ); break;
+		case G_TYPE_INT64:   g_value_set_int64   ( value, num          ); break;
+		case G_TYPE_UINT64:  g_value_set_uint64  ( value, (guint64)num ); break;
+		case G_TYPE_BOOLEAN: g_value_set_boolean ( value, ( num ) ? TRUE : FALSE ); break;
+		case G_TYPE_ENUM:    g_value_set_enum    ( value, (int)num     ); break;
+		case G_TYPE_FLAGS:   g_value_set_flags   ( value, (uint)num    ); break;
+		case G_TYPE_STRING:  g_value_set_string  ( value, str          ); break;
+
+		default:
+			g_value_unset ( value );
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* The property is resolved and its value converted once: polarity → "V" / "H", symbol-rate in kBd */
+static void channel_field_prop ( ChannelField *field, GObjectClass *klass )
+{
+	if ( !klass ) return;
+
+	GParamSpec *pspec = g_object_class_find_property ( klass, field->key );
+
+	if ( !pspec || !( pspec->flags & G_PARAM_WRITABLE ) ) return;
+
+	long num = field->num;
+	const char *str = field->str;
+
+	if ( g_str_equal ( field->key, "polarity" ) ) str = ( str[0] == 'v' || str[0] == 'V' || str[0] == '0' ) ? "V" : "H";
+
+	if ( g_str_equal ( field->key, "symbol-rate" ) && num > 100000 ) num = num / 1000;
+
+	if ( !channel_value_set ( &field->value, pspec, num, str ) ) return;
+
+	field->pspec = pspec;
+	field->type  = CHANNEL_FIELD_PROP;
+}
+
+static enum ChannelFieldType channel_field ( const char *key, const char *str, Channel *channel )
+{
+	ChannelField field = { .key = g_intern_string ( key ), .str = g_strdup ( str ), .num = atol ( str ), .type = CHANNEL_FIELD_UNKNOWN };
+
+	if ( g_str_equal ( key, "program-number" ) ) { field.type = CHANNEL_FIELD_SERVICE; channel->sid  = (uint16_t)field.num; }
+	if ( g_str_equal ( key, "video-pid"      ) ) { field.type = CHANNEL_FIELD_SERVICE; channel->vpid = (uint16_t)field.num; }
+	if ( g_str_equal ( key, "audio-pid"      ) ) { field.type = CHANNEL_FIELD_SERVICE; channel->apid = (uint16_t)field.num; }
+	if ( g_str_equal ( key, "lcn"            ) ) { field.type = CHANNEL_FIELD_SERVICE; channel->lcn  = (uint16_t)field.num; }
+	if ( g_str_equal ( key, "tsid"           ) ) { field.type = CHANNEL_FIELD_SERVICE; channel->tsid = (uint16_t)field.num; }
+	if ( g_str_equal ( key, "onid"           ) ) { field.type = CHANNEL_FIELD_SERVICE; channel->onid = (uint16_t)field.num; }
+
+	if ( g_str_equal ( key, "lnb-type" ) ) field.type = CHANNEL_FIELD_LNB;
+
+	if ( g_str_equal ( key, "delsys"   ) ) channel->delsys   = (uint8_t)field.num;
+	if ( g_str_equal ( key, "adapter"  ) ) channel->adapter  = (int)field.num;
+	if ( g_str_equal ( key, "frontend" ) ) channel->frontend = (int)field.num;
+
+	if ( field.type == CHANNEL_FIELD_UNKNOWN ) channel_field_prop ( &field, channel_dvbsrc_class () );
+
+	g_array_append_val ( channel->fields, field );
+
+	return field.type;
+}
+
+static void channel_field_clear ( ChannelField *field )
+{
+	if ( field->pspec ) g_value_unset ( &field->value );
+
+	free ( field->str );
+}
+
+Channel * channel_new_empty ( const char *data, const char *name )
+{
+	Channel *channel = g_new0 ( Channel, 1 );
+
+	channel->name  = g_strdup ( name );
+	channel->data  = g_strdup ( data );
+	channel->mux   = g_strdup ( "" );
+	channel->index = -1;
+
+	channel->fields = g_array_new ( FALSE, TRUE, sizeof ( ChannelField ) );
+	g_array_set_clear_func ( channel->fields, (GDestroyNotify)channel_field_clear );
+
+	return channel;
+}
+
+void channel_add_field ( const char *key, const char *value, Channel *channel )
+{
+	enum ChannelFieldType type = channel_field ( key, value, channel );
+
+	channel->video = ( channel->vpid ) ? TRUE : FALSE;
+
+	if ( type == CHANNEL_FIELD_SERVICE || g_str_equal ( key, "adapter" ) || g_str_equal ( key, "frontend" ) ) return;
+
+	char *mux = g_strdup_printf ( "%s:%s=%s", channel->mux, key, value );
+
+	free ( channel->mux );
+	channel->mux = mux;
+}
+
+Channel * channel_new ( const char *data )
+{
+	if ( !data || !data[0] || data[0] == ':' ) return NULL;
+
+	char **fields = g_strsplit ( data, ":", 0 );
+
+	Channel *channel = channel_new_empty ( data, fields[0] );
+
+	uint j = 0; for ( j = 1; fields[j] != NULL; j++ )
+	{
+		char *value = strchr ( fields[j], '=' );
+
+		if ( !value ) continue;
+
+		*value++ = '\0';
+
+		channel_add_field ( fields[j], value, channel );
+	}
+
+	g_strfreev ( fields );
+
+	return channel;
+}
+
+void channel_free ( Channel *channel )
+{
+	g_array_unref ( channel->fields );
+
+	free ( channel->name );
+	free ( channel->data );
+	free ( channel->mux );
+
+	free ( channel );
+}
+
+void channel_apply ( const Channel *channel, GstElement *element )
+{
+	GObject *object = G_OBJECT ( element );
+
+	g_object_freeze_notify ( object );
+
+	uint i = 0; for ( i = 0; i < channel->fields->len; i++ )
+	{
+		const ChannelField *field = &g_array_index ( channel->fields, ChannelField, i );
+
+		if ( field->type == CHANNEL_FIELD_PROP ) g_object_set_property ( object, field->pspec->name, &field->value );
+
+		if ( field->type == CHANNEL_FIELD_LNB ) set_lnb_lhs ( element, (int)field->num );
+	}
+
+	g_object_thaw_notify ( object );
+}
+
+gboolean channel_same_mux ( const Channel *channel_a, const Channel *channel_b )
+{
+	if ( !channel_a || !channel_b ) return FALSE;
+
+	return ( g_str_equal ( channel_a->mux, channel_b->mux ) ) ? TRUE : FALSE;
+}
@@ -0,0 +1,73 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+/* Channel record: a line of gtv-channel.conf parsed once ( on load ).
+ * The dvbsrc properties are resolved against the class of dvbsrc and hold a typed value; tuning is an apply loop */
+
+enum ChannelFieldType
+{
+	CHANNEL_FIELD_SERVICE,   // program-number, video-pid, audio-pid, lcn, tsid, onid
+	CHANNEL_FIELD_PROP,      // dvbsrc property
+	CHANNEL_FIELD_LNB,       // lnb-type
+	CHANNEL_FIELD_UNKNOWN
+};
+
+typedef struct _ChannelField ChannelField;
+
+struct _ChannelField
+{
+	const char *key;         // interned
+	char *str;               // value as written
+	long num;
+
+	enum ChannelFieldType type;
+
+	GParamSpec *pspec;       // CHANNEL_FIELD_PROP
+	GValue value;
+};
+
+typedef struct _Channel Channel;
+
+struct _Channel
+{
+	char *name;
+	char *data;              // the whole line
+	char *mux;               // tuning data without the service fields and the device: the same for all services of a multiplex
+
+	uint16_t sid, vpid, apid, lcn;
+	uint16_t tsid, onid;
+	uint8_t delsys;
+	int adapter, frontend;
+
+	int index;               // position in the channel list ( ChannelDb ), -1 - not listed
+
+	gboolean video;
+
+	GArray *fields;          // ChannelField, in the order of the line
+};
+
+/* data: name:program-number=..:video-pid=..:audio-pid=..:delsys=..:adapter=..:frontend=..:frequency=.. */
+Channel * channel_new ( const char *data );
+
+/* Without parsing the data ( cache of ChannelDb ): the fields are added one by one */
+Channel * channel_new_empty ( const char *data, const char *name );
+
+void channel_add_field ( const char *key, const char *value, Channel * );
+
+void channel_free ( Channel * );
+
+/* dvbsrc: all properties in one pass ( notify frozen ); lnb-type → set_lnb_lhs */
+void channel_apply ( const Channel *, GstElement *dvbsrc );
+
+gboolean channel_same_mux ( const Channel *, const Channel * );
@@ -17,6 +17,7 @@ struct _ControlTv
 	GtkWindow parent_instance;
 
 	GtkVolumeButton *volbutton;
+	GtkButton *pause;
 
 	GstElement *element;
 
@@ -42,6 +43,12 @@ void control_tv_set_run ( gboolean play, GstElement *element, GtkWindow *win_bas
 	gtk_widget_set_opacity ( GTK_WIDGET ( window ), ( (float)ctv->opacity / 100 ) );
 }
 
+/* Pause: timeshift only */
+void control_tv_set_pause ( gboolean sensitive, ControlTv *ctv )
+{
+	gtk_widget_set_sensitive ( GTK_WIDGET ( ctv->pause ), sensitive );
+}
+
 static void control_tv_signal_handler_num ( GtkButton *button, ControlTv *ctv )
 {
 	const char *name = gtk_widget_get_name ( GTK_WIDGET ( button ) );
@@ -107,11 +114,11 @@ static void control_tv_init ( ControlTv *ctv )
 	h_box = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_HORIZONTAL, 0 );
 	gtk_box_set_spacing ( h_box, 5 );
 
-	const char *icons_b[] = { "⏹", "⏺", "📡", "⏼", "🞬" };
-	const char *name_icons_b[] = { "helia-stop", "helia-record", "helia-display", "helia-info", "helia-exit" };
-	const gboolean swapped_b[] = { FALSE, FALSE, TRUE, TRUE, TRUE };
+	const char *icons_b[] = { "⏹", "⏯", "⏺", "📡", "⏼", "🞬" };
+	const char *name_icons_b[] = { "helia-stop", "helia-pause", "helia-record", "helia-display", "helia-info", "helia-exit" };
+	const gboolean swapped_b[] = { FALSE, FALSE, FALSE, TRUE, TRUE, TRUE };
 
-	for ( c = 0; c < BN; c++ )
+	for ( c = 0; c < G_N_ELEMENTS ( icons_b ); c++ )
 	{
 		GtkButton *button = helia_create_button ( h_box, name_icons_b[c], icons_b[c], ctv->icon_size );
 
@@ -119,6 +126,8 @@ static void control_tv_init ( ControlTv *ctv )
 		sprintf ( name, "%u", c + BN );
 		gtk_widget_set_name ( GTK_WIDGET ( button ), name );
 
+		if ( c == 1 ) ctv->pause = button;
+
 		g_signal_connect ( button, "clicked", G_CALLBACK ( control_tv_signal_handler_num ), ctv );
 		if ( swapped_b[c] ) g_signal_connect_swapped ( button, "clicked", G_CALLBACK ( gtk_widget_destroy ), window );
 	}
@@ -19,3 +19,5 @@ G_DECLARE_FINAL_TYPE ( ControlTv, control_tv, CONTROLTV, WINDOW, GtkWindow )
 ControlTv * control_tv_new (void);
 
 void control_tv_set_run ( gboolean , GstElement *, GtkWindow *, ControlTv * );
+
+void control_tv_set_pause ( gboolean , ControlTv * );
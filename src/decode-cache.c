@@ -0,0 +1,118 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "decode-cache.h"
+
+struct _DecodeCache
+{
+	GMutex mutex;
+
+	GKeyFile *key_file;   // [ service key ] pmt-version, audio-caps, audio-chain, video-caps, video-chain
+	char *file;
+
+	gboolean changed;
+	gboolean debug;
+};
+
+char * decode_cache_lookup ( const char *key, const char *type, const char *caps, int pmt_version, DecodeCache *cache )
+{
+	char *chain = NULL;
+
+	g_autofree char *key_caps  = g_strdup_printf ( "%s-caps",  type );
+	g_autofree char *key_chain = g_strdup_printf ( "%s-chain", type );
+
+	g_mutex_lock ( &cache->mutex );
+
+	g_autofree char *cache_caps = g_key_file_get_string ( cache->key_file, key, key_caps, NULL );
+
+	int cache_version = ( g_key_file_has_key ( cache->key_file, key, "pmt-version", NULL ) )
+		? g_key_file_get_integer ( cache->key_file, key, "pmt-version", NULL ) : -1;
+
+	gboolean same_version = ( pmt_version == -1 || cache_version == -1 || pmt_version == cache_version ) ? TRUE : FALSE;
+
+	if ( cache_caps && g_str_equal ( cache_caps, caps ) && same_version )
+		chain = g_key_file_get_string ( cache->key_file, key, key_chain, NULL );
+
+	g_mutex_unlock ( &cache->mutex );
+
+	if ( cache->debug ) g_message ( "%s: %s %s | pmt version %d ( cache %d ) | %s ", __func__, key, type, pmt_version, cache_version, ( chain ) ? chain : "miss" );
+
+	return chain;
+}
+
+void decode_cache_store ( const char *key, const char *type, const char *caps, int pmt_version, const char *chain, DecodeCache *cache )
+{
+	g_autofree char *key_caps  = g_strdup_printf ( "%s-caps",  type );
+	g_autofree char *key_chain = g_strdup_printf ( "%s-chain", type );
+
+	g_mutex_lock ( &cache->mutex );
+
+	g_key_file_set_string ( cache->key_file, key, key_caps,  caps  );
+	g_key_file_set_string ( cache->key_file, key, key_chain, chain );
+
+	if ( pmt_version != -1 ) g_key_file_set_integer ( cache->key_file, key, "pmt-version", pmt_version );
+
+	cache->changed = TRUE;
+
+	g_mutex_unlock ( &cache->mutex );
+
+	if ( cache->debug ) g_message ( "%s: %s %s | %s ", __func__, key, type, chain );
+}
+
+void decode_cache_drop ( const char *key, const char *type, DecodeCache *cache )
+{
+	g_autofree char *key_chain = g_strdup_printf ( "%s-chain", type );
+
+	g_mutex_lock ( &cache->mutex );
+
+	if ( g_key_file_remove_key ( cache->key_file, key, key_chain, NULL ) ) cache->changed = TRUE;
+
+	g_mutex_unlock ( &cache->mutex );
+}
+
+void decode_cache_save ( DecodeCache *cache )
+{
+	g_mutex_lock ( &cache->mutex );
+
+	GError *error = NULL;
+
+	if ( cache->changed && !g_key_file_save_to_file ( cache->key_file, cache->file, &error ) )
+	{
+		g_warning ( "%s: %s ", __func__, error->message );
+		g_error_free ( error );
+	}
+
+	cache->changed = FALSE;
+
+	g_mutex_unlock ( &cache->mutex );
+}
+
+DecodeCache * decode_cache_new ( const char *file )
+{
+	DecodeCache *cache = g_new0 ( DecodeCache, 1 );
+
+	g_mutex_init ( &cache->mutex );
+
+	cache->file  = g_strdup ( file );
+	cache->debug = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
+
+	cache->key_file = g_key_file_new ();
+	g_key_file_load_from_file ( cache->key_file, file, G_KEY_FILE_NONE, NULL );
+
+	return cache;
+}
+
+void decode_cache_free ( DecodeCache *cache )
+{
+	g_key_file_free ( cache->key_file );
+	g_mutex_clear ( &cache->mutex );
+
+	free ( cache->file );
+	free ( cache );
+}
@@ -0,0 +1,34 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+/* Decode cache: per service and stream type ( audio / video ) the caps of the elementary stream ( tsdemux pad ),
+ * the parsers / decoder that decodebin plugged for them and the PMT version they were seen with.
+ * Key file ( ~/.config/helia/decode.cache ); lookups and stores come from the streaming threads */
+
+typedef struct _DecodeCache DecodeCache;
+
+DecodeCache * decode_cache_new ( const char *file );
+
+void decode_cache_free ( DecodeCache * );
+
+/* Written if changed */
+void decode_cache_save ( DecodeCache * );
+
+/* pmt_version: -1 - not known yet. Returns the chain ( factory names, space separated ) if the caps are the same
+ * and the PMT version is unchanged, otherwise NULL. Free with free() */
+char * decode_cache_lookup ( const char *key, const char *type, const char *caps, int pmt_version, DecodeCache * );
+
+void decode_cache_store ( const char *key, const char *type, const char *caps, int pmt_version, const char *chain, DecodeCache * );
+
+/* The chain could not be built ( plugin removed ): decodebin again */
+void decode_cache_drop ( const char *key, const char *type, DecodeCache * );
@@ -20,12 +20,35 @@
 #include "control-tv.h"
 #include "enc-prop.h"
 #include "settings.h"
+#include "recorder.h"
+#include "timeshift.h"
+#include "mpegts.h"
+#include "psi.h"
+#include "analyzer.h"
+#include "epg.h"
+#include "timer.h"
+#include "tuner.h"
+#include "channel-db.h"
+#include "decode-cache.h"
+#include "tsbatch.h"
+#include "buffering.h"
+#include "sighistory.h"
 
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
 
 #include <gst/video/videooverlay.h>
 
+typedef struct _DvbSet DvbSet;
+
+struct _DvbSet
+{
+	GstElement *demux;
+	GstElement *volume;
+	GstElement *videoblnc;
+	GstElement *equalizer;
+};
+
 struct _Dvb
 {
 	GtkBox parent_instance;
@@ -36,9 +59,53 @@ struct _Dvb
 	GtkDrawingArea *video;
 
 	Level *level;
+	SigHistory *sighist;
+	uint tick_id;
+	Epg *epg;
+	Psi *psi;
+	Analyzer *analyzer;
+	Recorder *recorder;
+	Timeshift *timeshift;
+
+	TimerList *timers;
+	Recorder *bgrec;
+	GstElement *bgdvb;
+	char *bgdata;
+	int bgtuner;
+
+	GPtrArray *timer_live;  // data of the timer recordings on the live tee
+	GPtrArray *timer_bg;    // on the timer pipeline
+
+	ChannelDb *db;
+	gboolean db_dirty;
+
+	DecodeCache *decode;
+	char *audio_lang;
+
+	uint batch_packets;
+	uint batch_latency;
+
+	BufferingProfile buffering;
+
+	char digits[5];
+	uint digits_src;
 
 	GstElement *playdvb;
+	GstElement *capdvb;
+
+	/* Zap-ahead: the predicted channel on a spare tuner, demuxed with the decoders gated ( dvb_gate_probe ); the zap swaps the pipelines; NULL - zap-ahead off */
+	GstElement *ahead;
+	GstElement *ahead_src;
+	GstElement *ahead_tee;
+	DvbSet ahead_set;
+	char *ahead_data;
+	int ahead_tuner;
+	uint ahead_src_id;
+	int zap_dir;
+	gboolean zap_ahead;
 	GstElement *dvbsrc;
+	GstElement *tee;
+	GstElement *feed;
 	GstElement *demux;
 	GstElement *volume;
 	GstElement *videoblnc;
@@ -49,17 +116,22 @@ struct _Dvb
 	GstElement *enc_muxer;
 
 	time_t t_hide;
+	gint64 zap_start;
+	gint64 zap_lock;
+	gboolean zap_warm;
 
 	ulong xid;
+	int tuner;
 	uint16_t sid;
 	uint16_t opacity;
 
 	char *data;
+	char *ts_file;
 
 	gboolean run;
 	gboolean quit;
 	gboolean debug;
-	gboolean rec_tv;
+	gboolean rec_passthrough;
 	gboolean checked_video;
 };
 
@@ -68,8 +140,23 @@ G_DEFINE_TYPE ( Dvb, dvb, GTK_TYPE_BOX );
 typedef void ( *fp ) ( Dvb *dvb );
 
 static void dvb_record ( Dvb *dvb );
+static void dvb_timer_add_next ( const char *data, Dvb *dvb );
+static void dvb_tuner_release ( Dvb *dvb );
+static gboolean dvb_timer_live_move ( Dvb *dvb );
+static void dvb_timer_failed ( GPtrArray *timers, Dvb *dvb );
+static void dvb_treeview_model_changed ( GtkTreeModel *, GtkTreePath *, Dvb * );
+static void dvb_treeview_model_written ( GtkTreeModel *, GtkTreePath *, GtkTreeIter *, Dvb * );
+static void dvb_record_data ( const char *data, Dvb *dvb );
+static gboolean dvb_data_same_mux ( const char *data_old, const char *data_new, Dvb *dvb );
 static void dvb_run_info ( Dvb *dvb );
+static void dvb_level_tick_start ( Dvb *dvb );
+static void dvb_level_tick_stop ( Dvb *dvb );
 static void dvb_stop_set_play ( const char *data, Dvb *dvb );
+static void dvb_tuning_done ( GstElement *dvbsrc, Dvb *dvb );
+static void dvb_tuning_fail ( GstElement *dvbsrc, Dvb *dvb );
+static void dvb_ahead_stop ( Dvb *dvb );
+static gboolean dvb_ahead_swap ( const char *data, Dvb *dvb );
+static void dvb_ahead_schedule ( Dvb *dvb );
 GstElement * dvb_iterate_element ( GstElement *it_e, const char *name1, const char *name2 );
 
 static void dvb_message_dialog ( const char *f_error, const char *file_or_info, GtkMessageType mesg_type, Dvb *dvb )
@@ -90,6 +177,7 @@ static void dvb_message_dialog ( const char *f_error, const char *file_or_info,
 static void dvb_set_base ( Dvb *dvb )
 {
 	gst_element_set_state ( dvb->playdvb, GST_STATE_NULL );
+	if ( dvb->capdvb ) gst_element_set_state ( dvb->capdvb, GST_STATE_NULL );
 
 	dvb->volume = NULL;
 	level_set_sgn_snr ( 0, 0, FALSE, FALSE, dvb->level );
@@ -136,16 +224,39 @@ static void dvb_set_mute ( Dvb *dvb )
 
 static void dvb_set_stop ( Dvb *dvb )
 {
+	dvb_ahead_stop ( dvb );
+
+	if ( !dvb_timer_live_move ( dvb ) ) dvb_timer_failed ( dvb->timer_live, dvb );
+
 	gst_element_set_state ( dvb->playdvb, GST_STATE_NULL );
+	if ( dvb->capdvb ) gst_element_set_state ( dvb->capdvb, GST_STATE_NULL );
+
+	dvb_level_tick_stop ( dvb );
 
 	g_signal_emit_by_name ( dvb, "power-set", FALSE );
 
+	recorder_set_source ( NULL, NULL, dvb->recorder );
+	dvb_tuner_release ( dvb );
+
 	dvb->volume = NULL;
 	level_set_sgn_snr ( 0, 0, FALSE, FALSE, dvb->level );
 
 	gtk_widget_queue_draw ( GTK_WIDGET ( dvb->video ) );
 }
 
+/* Timeshift: only the play pipeline is paused, the capture keeps writing the ring */
+static void dvb_set_pause ( Dvb *dvb )
+{
+	if ( !dvb->timeshift ) return;
+
+	GstState state = GST_ELEMENT_CAST ( dvb->playdvb )->current_state;
+
+	if ( state == GST_STATE_PLAYING )
+		gst_element_set_state ( dvb->playdvb, GST_STATE_PAUSED );
+	else if ( state == GST_STATE_PAUSED )
+		gst_element_set_state ( dvb->playdvb, GST_STATE_PLAYING );
+}
+
 static void dvb_set_rec ( Dvb *dvb )
 {
 	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_PLAYING ) return;
@@ -171,7 +282,7 @@ static void dvb_set_scan ( Dvb *dvb )
 static void dvb_clicked_handler ( G_GNUC_UNUSED ControlTv *ctv, uint8_t num, Dvb *dvb )
 {
 	fp funcs[] =  { dvb_set_base, dvb_set_playlist, dvb_set_eqa,  dvb_set_eqv,  dvb_set_mute, 
-			dvb_set_stop, dvb_set_rec,      dvb_set_scan, dvb_set_info, NULL };
+			dvb_set_stop, dvb_set_pause,    dvb_set_rec,  dvb_set_scan, dvb_set_info, NULL };
 
 	if ( funcs[num] ) funcs[num] ( dvb );
 }
@@ -280,6 +391,35 @@ static void dvb_treeview_row_activated ( GtkTreeView *tree_view, GtkTreePath *pa
 	}
 }
 
+/* Right click: record the service ( same multiplex only ) alongside the live view; Ctrl + right click: timer for the next EPG event */
+static gboolean dvb_treeview_press_event ( GtkTreeView *tree_view, GdkEventButton *event, Dvb *dvb )
+{
+	if ( event->button != 3 ) return GDK_EVENT_PROPAGATE;
+
+	GtkTreePath *path = NULL;
+	if ( !gtk_tree_view_get_path_at_pos ( tree_view, (int)event->x, (int)event->y, &path, NULL, NULL, NULL ) ) return GDK_EVENT_STOP;
+
+	GtkTreeIter iter;
+	GtkTreeModel *model = gtk_tree_view_get_model ( tree_view );
+
+	if ( gtk_tree_model_get_iter ( model, &iter, path ) )
+	{
+		g_autofree char *data = NULL;
+		gtk_tree_model_get ( model, &iter, COL_DATA, &data, -1 );
+
+		if ( event->state & GDK_CONTROL_MASK )
+			dvb_timer_add_next ( data, dvb );
+		else if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state == GST_STATE_PLAYING && dvb_data_same_mux ( dvb->data, data, dvb ) )
+			dvb_record_data ( data, dvb );
+		else
+			dvb_message_dialog ( "", "Not the current multiplex.", GTK_MESSAGE_WARNING, dvb );
+	}
+
+	gtk_tree_path_free ( path );
+
+	return GDK_EVENT_STOP;
+}
+
 static GtkBox * dvb_create_treeview_scroll ( Dvb *dvb )
 {
 	GtkBox *v_box = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_VERTICAL, 0 );
@@ -298,6 +438,13 @@ static GtkBox * dvb_create_treeview_scroll ( Dvb *dvb )
 
 	dvb->treeview = create_treeview ( G_N_ELEMENTS ( column_n ), column_n );
 	g_signal_connect ( dvb->treeview, "row-activated", G_CALLBACK ( dvb_treeview_row_activated ), dvb );
+	g_signal_connect ( dvb->treeview, "button-press-event", G_CALLBACK ( dvb_treeview_press_event ), dvb );
+
+	GtkTreeModel *model = gtk_tree_view_get_model ( dvb->treeview );
+	g_signal_connect ( model, "row-deleted",    G_CALLBACK ( dvb_treeview_model_changed ), dvb );
+	g_signal_connect ( model, "rows-reordered", G_CALLBACK ( dvb_treeview_model_changed ), dvb );
+	g_signal_connect ( model, "row-inserted",   G_CALLBACK ( dvb_treeview_model_written ), dvb );
+	g_signal_connect ( model, "row-changed",    G_CALLBACK ( dvb_treeview_model_written ), dvb );
 
 	gtk_container_add ( GTK_CONTAINER ( scroll ), GTK_WIDGET ( dvb->treeview ) );
 
@@ -330,6 +477,8 @@ static gboolean dvb_video_press_event ( GtkDrawingArea *draw, GdkEventButton *ev
 {
 	GtkWindow *window_base = GTK_WINDOW ( gtk_widget_get_toplevel ( GTK_WIDGET ( draw ) ) );
 
+	gtk_widget_grab_focus ( GTK_WIDGET ( draw ) );
+
 	if ( event->button == 1 )
 	{
 		if ( event->type == GDK_2BUTTON_PRESS )
@@ -360,12 +509,26 @@ static gboolean dvb_video_press_event ( GtkDrawingArea *draw, GdkEventButton *ev
 
 		ControlTv *ctv = control_tv_new ();
 		control_tv_set_run ( play, dvb->volume, window_base, ctv );
+		control_tv_set_pause ( ( dvb->timeshift ) ? TRUE : FALSE, ctv );
 		g_signal_connect ( ctv, "button-click-num", G_CALLBACK ( dvb_clicked_handler ), dvb );
 	}
 
 	return TRUE;
 }
 
+/* Timeshift: scroll up / down - 20 seconds forward ( up to the live position ) / back */
+static gboolean dvb_video_scroll_event ( G_GNUC_UNUSED GtkDrawingArea *draw, GdkEventScroll *evscroll, Dvb *dvb )
+{
+	if ( !dvb->timeshift || GST_ELEMENT_CAST ( dvb->playdvb )->current_state < GST_STATE_PAUSED ) return TRUE;
+
+	if ( evscroll->direction == GDK_SCROLL_UP   ) timeshift_seek (  20, dvb->timeshift );
+	if ( evscroll->direction == GDK_SCROLL_DOWN ) timeshift_seek ( -20, dvb->timeshift );
+
+	if ( dvb->debug ) g_message ( "%s: delay %u sec ", __func__, timeshift_get_delay ( dvb->timeshift ) );
+
+	return TRUE;
+}
+
 static void dvb_video_draw_black ( GtkDrawingArea *widget, cairo_t *cr, const char *name, uint16_t size )
 {
 	GdkRGBA color; color.red = 0; color.green = 0; color.blue = 0; color.alpha = 1.0;
@@ -423,19 +586,73 @@ static GtkPaned * dvb_create_paned ( GtkBox *playlist, GtkDrawingArea *video )
 
 
 
-static void dvb_treeview_append ( const char *name, const char *data, Dvb *dvb )
+static Channel * dvb_channel_get ( const char *data, Dvb *dvb )
+{
+	return channel_db_get ( data, dvb->db );
+}
+
+static void dvb_treeview_append_row ( const Channel *channel, Dvb *dvb )
 {
 	GtkTreeIter iter;
 	GtkTreeModel *model = gtk_tree_view_get_model ( dvb->treeview );
 
 	int ind = gtk_tree_model_iter_n_children ( model, NULL );
 
+	/* The caller keeps the database in step */
+	g_signal_handlers_block_by_func ( model, dvb_treeview_model_written, dvb );
+
 	gtk_list_store_append ( GTK_LIST_STORE ( model ), &iter );
 	gtk_list_store_set    ( GTK_LIST_STORE ( model ), &iter,
 				COL_NUM,  ind + 1,
-				COL_FLCH, name,
-				COL_DATA, data,
+				COL_FLCH, channel->name,
+				COL_DATA, channel->data,
 				-1 );
+
+	g_signal_handlers_unblock_by_func ( model, dvb_treeview_model_written, dvb );
+}
+
+static void dvb_treeview_append ( Channel *channel, Dvb *dvb )
+{
+	dvb_treeview_append_row ( channel, dvb );
+
+	if ( !dvb->db_dirty ) channel_db_append ( channel, dvb->db );
+}
+
+/* Rows removed or moved: the list of the database is rebuilt on the next use */
+static void dvb_treeview_model_changed ( G_GNUC_UNUSED GtkTreeModel *model, G_GNUC_UNUSED GtkTreePath *path, Dvb *dvb )
+{
+	dvb->db_dirty = TRUE;
+}
+
+/* Rows added or edited outside dvb_treeview_append ( scanner, rename ): the same */
+static void dvb_treeview_model_written ( G_GNUC_UNUSED GtkTreeModel *model, G_GNUC_UNUSED GtkTreePath *path, G_GNUC_UNUSED GtkTreeIter *iter, Dvb *dvb )
+{
+	dvb->db_dirty = TRUE;
+}
+
+static void dvb_channel_db_sync ( Dvb *dvb )
+{
+	if ( !dvb->db_dirty ) return;
+
+	GtkTreeIter iter;
+	GtkTreeModel *model = gtk_tree_view_get_model ( dvb->treeview );
+
+	channel_db_clear ( dvb->db );
+
+	gboolean valid = FALSE;
+	for ( valid = gtk_tree_model_get_iter_first ( model, &iter ); valid; valid = gtk_tree_model_iter_next ( model, &iter ) )
+	{
+		g_autofree char *data = NULL;
+		gtk_tree_model_get ( model, &iter, COL_DATA, &data, -1 );
+
+		Channel *channel = dvb_channel_get ( data, dvb );
+
+		if ( channel ) channel_db_append ( channel, dvb->db );
+	}
+
+	dvb->db_dirty = FALSE;
+
+	if ( dvb->debug ) g_message ( "%s: channels %u ", __func__, channel_db_count ( dvb->db ) );
 }
 
 static void dvb_treeview_add_channels ( const char *file, Dvb *dvb )
@@ -452,11 +669,9 @@ static void dvb_treeview_add_channels ( const char *file, Dvb *dvb )
 		{
 			if ( g_str_has_prefix ( lines[i], "#" ) || strlen ( lines[i] ) < 2 ) continue;
 
-			char **data = g_strsplit ( lines[i], ":", 0 );
-
-			dvb_treeview_append ( data[0], lines[i], dvb );
+			Channel *channel = dvb_channel_get ( lines[i], dvb );
 
-			g_strfreev ( data );
+			if ( channel ) dvb_treeview_append ( channel, dvb );
 		}
 
 		g_strfreev ( lines );
@@ -490,17 +705,6 @@ static void dvb_video_drag_in ( G_GNUC_UNUSED GtkDrawingArea *draw, GdkDragConte
 
 
 
-typedef struct _DvbSet DvbSet;
-
-struct _DvbSet
-{
-	GstElement *dvbsrc;
-	GstElement *demux;
-	GstElement *volume;
-	GstElement *videoblnc;
-	GstElement *equalizer;
-};
-
 static gboolean dvb_pad_check_type ( GstPad *pad, const char *type )
 {
 	gboolean ret = FALSE;
@@ -526,718 +730,2028 @@ static void dvb_pad_link ( GstPad *pad, GstElement *element, const char *name )
 		g_debug ( "%s:: linking demux/decode name %s video/audio pad failed ", __func__, name );
 }
 
-static void dvb_pad_demux_audio ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *element_audio )
-{
-	if ( dvb_pad_check_type ( pad, "audio" ) ) dvb_pad_link ( pad, element_audio, "demux audio" );
-}
+typedef struct _DvbDecode DvbDecode;
 
-static void dvb_pad_demux_video ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *element_video )
+/* Decoded stream of the live view: demux pad → queue → decode stage → sinkpad ( videoconvert / input-selector ).
+ * PMT update ( new pids / codec ): the new pad is linked to the same queue, a codec change replaces the queue
+ * and the decode stage only; what follows the sinkpad ( the sink, the video overlay ) keeps running */
+struct _DvbDecode
 {
-	if ( dvb_pad_check_type ( pad, "video" ) ) dvb_pad_link ( pad, element_video, "demux video" );
-}
+	const char *type;     // "audio" / "video"
+	char *key;            // service in the decode cache
+	char *caps;           // of the linked demux pad
+	char *chain;          // of the decode stage ( cached or learned from decodebin )
+	int pmt_version;      // -1 - not seen yet
+
+	GstPad *pad;          // demux pad ( audio track )
+	uint16_t pid;
+	char lang[4];         // ISO-639 of the PMT
+
+	GPtrArray *stage;     // decode stage: the chain or decodebin
+	GstElement *queue;
+	GstPad *sinkpad;
+
+	BufferingProfile profile;
+
+	gint64 lost;          // the demux pad went away ( PMT update ), 0 - linked
 
-static void dvb_pad_decode ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *element_va )
+	DecodeCache *cache;
+	gboolean debug;
+};
+
+static DvbDecode * dvb_decode_new ( const char *type, const char *key, BufferingProfile profile, GstElement *queue, GstPad *sinkpad, DecodeCache *cache, gboolean debug )
 {
-	dvb_pad_link ( pad, element_va, "decode  audio / video" );
+	DvbDecode *decode = g_new0 ( DvbDecode, 1 );
+
+	decode->type    = type;
+	decode->key     = g_strdup ( key );
+	decode->stage   = g_ptr_array_new ();
+	decode->queue   = queue;
+	decode->sinkpad = sinkpad;
+	decode->profile = profile;
+	decode->cache   = cache;
+	decode->debug   = debug;
+	decode->pmt_version = -1;
+
+	return decode;
 }
 
-static DvbSet dvb_create_bin ( GstElement *element, gboolean video_enable )
+static void dvb_decode_free ( DvbDecode *decode )
 {
-	struct dvb_all_list { const char *name; } dvb_all_list_n[] =
-	{
-		{ "dvbsrc" }, { "tsdemux"   },
-		{ "queue2" }, { "decodebin" }, { "audioconvert" }, { "equalizer-nbands" }, { "volume" }, { "autoaudiosink" },
-		{ "queue2" }, { "decodebin" }, { "videoconvert" }, { "videobalance"     }, { "autovideosink" }
-	};
+	g_ptr_array_free ( decode->stage, TRUE );
 
-	DvbSet dvbset;
+	if ( decode->pad ) gst_object_unref ( decode->pad );
+	gst_object_unref ( decode->sinkpad );
 
-	GstElement *elements[ G_N_ELEMENTS ( dvb_all_list_n ) ];
+	free ( decode->key );
+	free ( decode->caps );
+	free ( decode->chain );
+	free ( decode );
+}
 
-	uint c = 0;
-	for ( c = 0; c < G_N_ELEMENTS ( dvb_all_list_n ); c++ )
-	{
-		if ( !video_enable && c > 7 ) continue;
+/* The parsers and the decoder that decodebin plugged, walked upstream from its src pad: "h264parse avdec_h264" */
+static char * dvb_decode_chain ( GstPad *pad )
+{
+	GString *chain = g_string_new ( NULL );
 
-		elements[c] = gst_element_factory_make ( dvb_all_list_n[c].name, NULL );
+	GstPad *target = gst_ghost_pad_get_target ( GST_GHOST_PAD ( pad ) );
 
-		if ( !elements[c] )
-			g_critical ( "%s:: element (factory make) - %s not created. \n", __func__, dvb_all_list_n[c].name );
+	while ( target )
+	{
+		GstElement *element = gst_pad_get_parent_element ( target );
 
-		if ( c == 2 ) gst_element_set_name ( elements[c], "queue-tee-audio" );
+		if ( !element ) { gst_object_unref ( target ); break; }
 
-		gst_bin_add ( GST_BIN ( element ), elements[c] );
+		GstElementFactory *factory = gst_element_get_factory ( element );
+		const char *klass = ( factory ) ? gst_element_factory_get_metadata ( factory, GST_ELEMENT_METADATA_KLASS ) : NULL;
 
-		if (  c == 0 || c == 2 || c == 4 || c == 8 || c == 10 ) continue;
+		if ( klass && ( g_strrstr ( klass, "Parser" ) || g_strrstr ( klass, "Decoder" ) ) )
+		{
+			if ( chain->len ) g_string_prepend_c ( chain, ' ' );
+			g_string_prepend ( chain, GST_OBJECT_NAME ( factory ) );
+		}
 
-		gst_element_link ( elements[c-1], elements[c] );
-	}
+		/* multiqueue: src_N → sink_N */
+		GstPad *sink = gst_element_get_static_pad ( element, "sink" );
 
-	g_signal_connect ( elements[1], "pad-added", G_CALLBACK ( dvb_pad_demux_audio ), elements[2] );
-	if ( video_enable ) g_signal_connect ( elements[1], "pad-added", G_CALLBACK ( dvb_pad_demux_video ), elements[8] );
+		if ( !sink && g_str_has_prefix ( GST_OBJECT_NAME ( target ), "src" ) )
+		{
+			g_autofree char *name = g_strdup_printf ( "sink%s", GST_OBJECT_NAME ( target ) + 3 );
+			sink = gst_element_get_static_pad ( element, name );
+		}
 
-	g_signal_connect ( elements[3], "pad-added", G_CALLBACK ( dvb_pad_decode ), elements[4] );
-	if ( video_enable ) g_signal_connect ( elements[9], "pad-added", G_CALLBACK ( dvb_pad_decode ), elements[10] );
+		gst_object_unref ( target );
+		gst_object_unref ( element );
 
-	g_object_set ( elements[6], "volume", VOLUME, NULL );
+		target = ( sink ) ? gst_pad_get_peer ( sink ) : NULL;
 
-	dvbset.dvbsrc = elements[0];
-	dvbset.demux  = elements[1];
-	dvbset.volume = elements[6];
-	dvbset.equalizer = elements[5];
-	dvbset.videoblnc = elements[11];
+		if ( sink ) gst_object_unref ( sink );
+	}
 
-	return dvbset;
+	return g_string_free ( chain, FALSE );
 }
 
-static void dvb_remove_bin ( GstElement *pipeline, const char *name )
+/* Streaming thread: decodebin did typefind and autoplugging, its chain is kept for the next tune of the service */
+static void dvb_pad_decode ( G_GNUC_UNUSED GstElement *element, GstPad *pad, DvbDecode *decode )
 {
-	GstIterator *it = gst_bin_iterate_elements ( GST_BIN ( pipeline ) );
-	GValue item = { 0, };
-	gboolean done = FALSE;
-
-	while ( !done )
-	{
-		switch ( gst_iterator_next ( it, &item ) )
-		{
-			case GST_ITERATOR_OK:
-			{
-				GstElement *element = GST_ELEMENT ( g_value_get_object (&item) );
-
-				char *object_name = gst_object_get_name ( GST_OBJECT ( element ) );
+	if ( gst_pad_link ( pad, decode->sinkpad ) != GST_PAD_LINK_OK ) g_debug ( "%s:: linking decode %s pad failed ", __func__, decode->type );
 
-				if ( name && g_strrstr ( object_name, name ) )
-				{
-					g_debug ( "%s:: Object Not remove: %s \n", __func__, object_name );
-				}
-				else
-				{
-					gst_element_set_state ( element, GST_STATE_NULL );
-					gst_bin_remove ( GST_BIN ( pipeline ), element );
+	char *chain = dvb_decode_chain ( pad );
 
-					g_debug ( "%s:: Object remove: %s \n", __func__, object_name );
-				}
+	free ( decode->chain );
+	decode->chain = chain;
 
-				g_free ( object_name );
-				g_value_reset (&item);
+	if ( chain[0] && decode->caps ) decode_cache_store ( decode->key, decode->type, decode->caps, decode->pmt_version, chain, decode->cache );
+}
 
-				break;
-			}
+static void dvb_decode_bin_create ( DvbDecode *decode )
+{
+	GstElement *decodebin = gst_element_factory_make ( "decodebin", NULL );
 
-			case GST_ITERATOR_RESYNC:
-				gst_iterator_resync (it);
-				break;
+	if ( !decodebin ) { g_critical ( "%s:: element (factory make) - decodebin not created. \n", __func__ ); return; }
 
-			case GST_ITERATOR_ERROR:
-				done = TRUE;
-				break;
+	gst_bin_add ( GST_BIN ( GST_ELEMENT_PARENT ( decode->queue ) ), decodebin );
+	g_ptr_array_add ( decode->stage, decodebin );
 
-			case GST_ITERATOR_DONE:
-				done = TRUE;
-				break;
-		}
-	}
+	g_signal_connect ( decodebin, "pad-added", G_CALLBACK ( dvb_pad_decode ), decode );
 
-	g_value_unset ( &item );
-	gst_iterator_free ( it );
+	gst_element_link ( decode->queue, decodebin );
+	gst_element_sync_state_with_parent ( decodebin );
 }
 
-GstElement * dvb_iterate_element ( GstElement *it_e, const char *name1, const char *name2 )
+/* The cached chain without typefind and autoplugging. Returns FALSE if an element is missing or can't be linked */
+static gboolean dvb_decode_chain_create ( const char *chain, DvbDecode *decode )
 {
-	GstIterator *it = gst_bin_iterate_recurse ( GST_BIN ( it_e ) );
+	GstBin *bin = GST_BIN ( GST_ELEMENT_PARENT ( decode->queue ) );
 
-	GValue item = { 0, };
-	gboolean done = FALSE;
+	char **names = g_strsplit ( chain, " ", 0 );
 
-	GstElement *element_ret = NULL;
+	gboolean ret = TRUE;
 
-	while ( !done )
+	uint i = 0; for ( i = 0; ret && names[i] != NULL; i++ )
 	{
-		switch ( gst_iterator_next ( it, &item ) )
-		{
-			case GST_ITERATOR_OK:
-			{
-				GstElement *element = GST_ELEMENT ( g_value_get_object (&item) );
+		GstElement *element = gst_element_factory_make ( names[i], NULL );
 
-				char *object_name = gst_object_get_name ( GST_OBJECT ( element ) );
+		if ( !element ) { ret = FALSE; break; }
 
-				if ( g_strrstr ( object_name, name1 ) )
-				{
-					if ( name2 && g_strrstr ( object_name, name2 ) )
-						element_ret = element;
-					else
-						element_ret = element;
-				}
+		gst_bin_add ( bin, element );
+		g_ptr_array_add ( decode->stage, element );
+	}
 
-				g_free ( object_name );
-				g_value_reset (&item);
+	g_strfreev ( names );
 
-				break;
-			}
+	GstElement *prev = decode->queue;
 
-			case GST_ITERATOR_RESYNC:
-				gst_iterator_resync (it);
-				break;
+	for ( i = 0; ret && i < decode->stage->len; i++ )
+	{
+		ret = gst_element_link ( prev, g_ptr_array_index ( decode->stage, i ) );
+		prev = g_ptr_array_index ( decode->stage, i );
+	}
 
-			case GST_ITERATOR_ERROR:
-				done = TRUE;
-				break;
+	if ( ret )
+	{
+		GstPad *pad = gst_element_get_static_pad ( prev, "src" );
 
-			case GST_ITERATOR_DONE:
-				done = TRUE;
-				break;
-		}
+		ret = ( pad && gst_pad_link ( pad, decode->sinkpad ) == GST_PAD_LINK_OK ) ? TRUE : FALSE;
+
+		if ( pad ) gst_object_unref ( pad );
 	}
 
-	g_value_unset ( &item );
-	gst_iterator_free ( it );
+	/* Downstream first: no element pushes into one that isn't running */
+	for ( i = decode->stage->len; i > 0; i-- )
+	{
+		GstElement *element = g_ptr_array_index ( decode->stage, i - 1 );
 
-	return element_ret;
+		if ( ret )
+			gst_element_sync_state_with_parent ( element );
+		else
+			gst_bin_remove ( bin, element );
+	}
+
+	if ( !ret ) g_ptr_array_set_size ( decode->stage, 0 );
+
+	return ret;
 }
 
-static GstElementFactory * dvb_find_factory ( GstCaps *caps, guint64 num )
+/* The cached chain if the caps and the PMT version are unchanged, otherwise decodebin ( its chain is cached then ) */
+static void dvb_decode_stage_create ( DvbDecode *decode )
 {
-	GList *list, *list_filter;
+	g_autofree char *chain = ( decode->key ) ? decode_cache_lookup ( decode->key, decode->type, decode->caps, decode->pmt_version, decode->cache ) : NULL;
 
-	static GMutex mutex;
+	gboolean cached = ( chain && dvb_decode_chain_create ( chain, decode ) ) ? TRUE : FALSE;
 
-	g_mutex_lock ( &mutex );
-		list = gst_element_factory_list_get_elements ( num, GST_RANK_MARGINAL );
-		list_filter = gst_element_factory_list_filter ( list, caps, GST_PAD_SINK, gst_caps_is_fixed ( caps ) );
-	g_mutex_unlock ( &mutex );
+	if ( chain && !cached ) decode_cache_drop ( decode->key, decode->type, decode->cache );
 
-	GstElementFactory *factory = GST_ELEMENT_FACTORY_CAST ( list_filter->data );
+	free ( decode->chain );
+	decode->chain = ( cached ) ? g_strdup ( chain ) : NULL;
 
-	gst_plugin_feature_list_free ( list_filter );
-	gst_plugin_feature_list_free ( list );
+	if ( !cached ) dvb_decode_bin_create ( decode );
 
-	return factory;
+	if ( decode->debug ) g_message ( "%s: %s | %s ", __func__, decode->type, ( cached ) ? chain : "decodebin" );
 }
 
-static gboolean dvb_typefind_remove ( const char *name, Dvb *dvb )
+/* The queue and the decode stage are stopped and removed */
+static void dvb_decode_stage_clear ( DvbDecode *decode )
 {
-	GstElement *element = dvb_iterate_element ( dvb->playdvb, name, NULL );
+	GstBin *bin = GST_BIN ( GST_ELEMENT_PARENT ( decode->queue ) );
 
-	if ( element )
+	g_ptr_array_add ( decode->stage, decode->queue );
+
+	uint i = 0; for ( i = 0; i < decode->stage->len; i++ )
 	{
-		gst_element_set_state ( element, GST_STATE_NULL );
-		gst_bin_remove ( GST_BIN ( dvb->playdvb ), element );
+		GstElement *element = g_ptr_array_index ( decode->stage, i );
 
-		return TRUE;
+		gst_element_set_state ( element, GST_STATE_NULL );
+		gst_bin_remove ( bin, element );
 	}
 
-	return FALSE;
+	g_ptr_array_set_size ( decode->stage, 0 );
+
+	decode->queue = NULL;
 }
 
-static void dvb_typefind_parser ( GstElement *typefind, uint probability, GstCaps *caps, Dvb *dvb )
+/* Codec change: a new queue ( its task is bound to the old stream ) and a new decode stage in front of the sinkpad */
+static void dvb_decode_stage_replace ( DvbDecode *decode )
 {
-	const char *name_caps = gst_structure_get_name ( gst_caps_get_structure ( caps, 0 ) );
+	GstBin *bin = GST_BIN ( GST_ELEMENT_PARENT ( decode->queue ) );
 
-	GstElementFactory *factory = dvb_find_factory ( caps, GST_ELEMENT_FACTORY_TYPE_PARSER );
+	dvb_decode_stage_clear ( decode );
 
-	GstElement *mpegtsmux = dvb_iterate_element ( dvb->playdvb, "mpegtsmux", NULL );
+	decode->queue = buffering_queue_new ( decode->profile, decode->type );
+	gst_bin_add ( bin, decode->queue );
 
-	GstElement *element = gst_element_factory_create ( factory, NULL );
+	dvb_decode_stage_create ( decode );
+}
 
-	gboolean remove = FALSE;
+static GstPadProbeReturn dvb_decode_recovered ( G_GNUC_UNUSED GstPad *pad, G_GNUC_UNUSED GstPadProbeInfo *info, DvbDecode *decode )
+{
+	if ( decode->debug ) g_message ( "%s: %s | PMT update, first buffer after %ld ms ", __func__, decode->type, (long)( ( g_get_monotonic_time () - decode->lost ) / 1000 ) );
 
-	if ( g_str_has_prefix ( name_caps, "audio" ) )
-	{
-		remove = dvb_typefind_remove ( "parser-audio", dvb );
-		gst_element_set_name ( element, "parser-audio" );
-	}
+	decode->lost = 0;
 
-	if ( g_str_has_prefix ( name_caps, "video" ) )
-	{
-		remove = dvb_typefind_remove ( "parser-video", dvb );
-		gst_element_set_name ( element, "parser-video" );
-	}
+	return GST_PAD_PROBE_REMOVE;
+}
+
+/* Zap-ahead gate in front of the decoders: a buffer probe on the src pad of every queue of the ahead demux.
+ * The buffers pass up to the first keyframe ( the decoder is set up ), then only the latest GOP is kept;
+ * the swap opens the gate, the kept GOP goes to the decoder. In the background only tsdemux works */
+#define GATE_GOP_MAX 1024
 
-	if ( remove == FALSE ) gst_element_unlink ( typefind, mpegtsmux );
+typedef struct _DvbGate DvbGate;
+
+struct _DvbGate
+{
+	int open;             // atomic
+};
 
-	gst_bin_add ( GST_BIN ( dvb->playdvb ), element );
+typedef struct _DvbGatePad DvbGatePad;
 
-	gst_element_link ( typefind, element );
-	gst_element_link ( element, mpegtsmux );
+struct _DvbGatePad
+{
+	GstElement *demux;    // holds the gate
+	DvbGate *gate;
+	GQueue gop;
+	gboolean key;         // the first keyframe has passed
+};
 
-	gst_element_set_state ( element, GST_STATE_PLAYING );
+static void dvb_gate_gop_clear ( DvbGatePad *gp )
+{
+	GstBuffer *buffer = NULL;
 
-	g_debug ( "%s: probability %d%% | name_caps %s ", __func__, probability, name_caps );
+	while ( ( buffer = g_queue_pop_head ( &gp->gop ) ) ) gst_buffer_unref ( buffer );
 }
 
-static DvbSet dvb_create_rec_bin ( GstElement *element, gboolean video, Dvb *dvb )
+static void dvb_gate_pad_free ( DvbGatePad *gp )
 {
-	struct dvb_all_list { const char *name; } dvb_all_list_n[] =
-	{
-		{ "tsdemux" },
-		{ "tee"     }, { "queue2"     }, { "decodebin" }, { "audioconvert" }, { "equalizer-nbands" }, { "volume" }, { "autoaudiosink" },
-		{ "tee"     }, { "queue2"     }, { "decodebin" }, { "videoconvert" }, { "videobalance"     }, { "autovideosink" },
-		{ "queue2"  }, { "typefind"   },
-		{ "queue2"  }, { "typefind"   },
-		{ "mpegtsmux" }, { "filesink" }
-	};
+	dvb_gate_gop_clear ( gp );
+	gst_object_unref ( gp->demux );
 
-	DvbSet dvbset;
+	free ( gp );
+}
 
-	GstElement *elements[ G_N_ELEMENTS ( dvb_all_list_n ) ];
+/* Streaming thread */
+static GstPadProbeReturn dvb_gate_probe ( GstPad *pad, GstPadProbeInfo *info, DvbGatePad *gp )
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
 
-	uint8_t c = 0; for ( c = 0; c < G_N_ELEMENTS ( dvb_all_list_n ); c++ )
+	if ( g_atomic_int_get ( &gp->gate->open ) )
 	{
-		if ( !video && ( c > 7 && c < 14 ) ) continue;
-		if ( !video && ( c == 16 || c == 17 ) ) continue;
+		GstPad *peer = gst_pad_get_peer ( pad );
+		GstBuffer *kept = NULL;
 
-		elements[c] = gst_element_factory_make ( dvb_all_list_n[c].name, NULL );
+		/* Past the probes of this pad: straight into the decode stage */
+		while ( ( kept = g_queue_pop_head ( &gp->gop ) ) )
+			if ( peer ) gst_pad_chain ( peer, kept ); else gst_buffer_unref ( kept );
 
-		if ( !elements[c] )
-			g_critical ( "%s:: element (factory make) - %s not created. \n", __func__, dvb_all_list_n[c].name );
+		if ( peer ) gst_object_unref ( peer );
 
-		if ( c == 1 ) gst_element_set_name ( elements[c], "queue-tee-audio" );
+		return GST_PAD_PROBE_REMOVE;
+	}
 
-		gst_bin_add ( GST_BIN ( element ), elements[c] );
+	gboolean key = !GST_BUFFER_FLAG_IS_SET ( buffer, GST_BUFFER_FLAG_DELTA_UNIT );
 
-		if ( c > 13 ) continue;
+	if ( !gp->key ) { gp->key = key; return GST_PAD_PROBE_OK; }
 
-		if (  c == 0 || c == 1 || c == 4 || c == 8 || c == 11 ) continue;
+	if ( key || gp->gop.length >= GATE_GOP_MAX ) dvb_gate_gop_clear ( gp );
 
-		gst_element_link ( elements[c-1], elements[c] );
-	}
+	/* After an overflow: from the next keyframe */
+	if ( key || gp->gop.length ) g_queue_push_tail ( &gp->gop, gst_buffer_ref ( buffer ) );
 
-	g_signal_connect ( elements[0], "pad-added", G_CALLBACK ( dvb_pad_demux_audio ), elements[1] );
-	if ( video ) g_signal_connect ( elements[0], "pad-added", G_CALLBACK ( dvb_pad_demux_video ), elements[8] );
+	return GST_PAD_PROBE_DROP;
+}
 
-	g_signal_connect ( elements[3], "pad-added", G_CALLBACK ( dvb_pad_decode ), elements[4] );
-	if ( video ) g_signal_connect ( elements[10], "pad-added", G_CALLBACK ( dvb_pad_decode ), elements[11] );
+/* Streaming thread: the queue of a new pad, if the demux is of the ahead pipeline */
+static void dvb_gate_add ( GstElement *demux, GstElement *queue )
+{
+	DvbGate *gate = g_object_get_data ( G_OBJECT ( demux ), "ahead-gate" );
 
-	gst_element_link_many ( elements[1], elements[14], elements[15], NULL );
-	if ( video ) gst_element_link_many ( elements[8], elements[16], elements[17], NULL );
+	if ( !gate || g_atomic_int_get ( &gate->open ) ) return;
 
-	gst_element_link ( elements[15], elements[18] );
-	if ( video ) gst_element_link ( elements[17], elements[18] );
+	DvbGatePad *gp = g_new0 ( DvbGatePad, 1 );
 
-	gst_element_link ( elements[18], elements[19] );
+	gp->demux = gst_object_ref ( demux );
+	gp->gate  = gate;
+	g_queue_init ( &gp->gop );
 
-	g_signal_connect ( elements[15], "have-type", G_CALLBACK ( dvb_typefind_parser ), dvb );
-	if ( video ) g_signal_connect ( elements[17], "have-type", G_CALLBACK ( dvb_typefind_parser ), dvb );
+	GstPad *pad = gst_element_get_static_pad ( queue, "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)dvb_gate_probe, gp, (GDestroyNotify)dvb_gate_pad_free );
+	gst_object_unref ( pad );
+}
 
+static void dvb_gate_new ( GstElement *demux )
+{
+	g_object_set_data_full ( G_OBJECT ( demux ), "ahead-gate", g_new0 ( DvbGate, 1 ), free );
+}
+
+static void dvb_gate_open ( GstElement *demux )
+{
+	DvbGate *gate = ( demux ) ? g_object_get_data ( G_OBJECT ( demux ), "ahead-gate" ) : NULL;
+
+	if ( gate ) g_atomic_int_set ( &gate->open, TRUE );
+}
+
+/* Streaming thread: the demux pad goes to the queue, the decode stage is built ( first pad ), kept ( same caps ) or replaced */
+static void dvb_decode_link ( GstElement *demux, GstPad *pad, DvbDecode *decode )
+{
+	GstCaps *caps = gst_pad_get_current_caps ( pad );
+	char *caps_str = gst_caps_to_string ( caps );
+	gst_caps_unref ( caps );
+
+	int pmt_version = GPOINTER_TO_INT ( g_object_get_data ( G_OBJECT ( demux ), "pmt-version" ) ) - 1;
+
+	gboolean same_caps = ( decode->caps && g_str_equal ( decode->caps, caps_str ) ) ? TRUE : FALSE;
+
+	free ( decode->caps );
+	decode->caps = caps_str;
+
+	if ( decode->stage->len && same_caps )
+	{
+		if ( decode->chain && decode->chain[0] && pmt_version != -1 && pmt_version != decode->pmt_version )
+			decode_cache_store ( decode->key, decode->type, decode->caps, pmt_version, decode->chain, decode->cache );
+
+		decode->pmt_version = pmt_version;
+	}
+	else
+	{
+		decode->pmt_version = pmt_version;
+
+		if ( decode->stage->len ) dvb_decode_stage_replace ( decode ); else dvb_decode_stage_create ( decode );
+	}
+
+	dvb_gate_add ( demux, decode->queue );
+
+	/* Running before the demux pushes into it */
+	gst_element_sync_state_with_parent ( decode->queue );
+
+	dvb_pad_link ( pad, decode->queue, decode->type );
+
+	if ( decode->lost )
+	{
+		gst_pad_add_probe ( decode->sinkpad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)dvb_decode_recovered, decode, NULL );
+
+		if ( decode->debug ) g_message ( "%s: %s | %s | %s ", __func__, decode->type, GST_OBJECT_NAME ( pad ), ( same_caps ) ? "relinked" : "new decode stage" );
+	}
+}
+
+/* tsdemux pads: audio_0_0044 */
+static uint16_t dvb_pad_pid ( GstPad *pad )
+{
+	const char *name = g_strrstr ( GST_OBJECT_NAME ( pad ), "_" );
+
+	return ( name ) ? (uint16_t)strtoul ( name + 1, NULL, 16 ) : 0;
+}
+
+static gboolean dvb_decode_queue_linked ( DvbDecode *decode )
+{
+	GstPad *sink = gst_element_get_static_pad ( decode->queue, "sink" );
+
+	gboolean linked = gst_pad_is_linked ( sink );
+
+	gst_object_unref ( sink );
+
+	return linked;
+}
+
+/* Streaming thread: the first pad of the type; other pads ( audio tracks ) stay unlinked while the branch is fed */
+static void dvb_pad_demux ( GstElement *element, GstPad *pad, DvbDecode *decode )
+{
+	if ( !dvb_pad_check_type ( pad, decode->type ) || dvb_decode_queue_linked ( decode ) ) return;
+
+	dvb_decode_link ( element, pad, decode );
+}
+
+/* Streaming thread: PMT update - the pad that fed the branch is gone, a remaining pad of the type takes over
+ * ( tsdemux adds the pads of the new PMT before it removes the old ones ) */
+static void dvb_pad_demux_removed ( GstElement *element, GstPad *pad, DvbDecode *decode )
+{
+	if ( GST_STATE_TARGET ( element ) < GST_STATE_PAUSED ) return;
+
+	if ( !g_str_has_prefix ( GST_OBJECT_NAME ( pad ), decode->type ) || dvb_decode_queue_linked ( decode ) ) return;
+
+	if ( !decode->lost ) decode->lost = g_get_monotonic_time ();
+
+	GstIterator *it = gst_element_iterate_src_pads ( element );
+	GValue item = { 0, };
+
+	GstPad *pad_new = NULL;
+
+	while ( !pad_new && gst_iterator_next ( it, &item ) == GST_ITERATOR_OK )
+	{
+		GstPad *pad_src = GST_PAD ( g_value_get_object (&item) );
+
+		if ( pad_src != pad && !gst_pad_is_linked ( pad_src ) && g_str_has_prefix ( GST_OBJECT_NAME ( pad_src ), decode->type ) )
+			pad_new = gst_object_ref ( pad_src );
+
+		g_value_reset (&item);
+	}
+
+	g_value_unset ( &item );
+	gst_iterator_free ( it );
+
+	if ( !pad_new ) return;
+
+	dvb_decode_link ( element, pad_new, decode );
+
+	gst_object_unref ( pad_new );
+}
+
+/* EOS of a removed demux pad ( PMT update ) would end the sink; only the EOS of the stream passes */
+static GstPadProbeReturn dvb_decode_eos ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, GstElement *demux )
+{
+	if ( GST_EVENT_TYPE ( GST_PAD_PROBE_INFO_EVENT ( info ) ) != GST_EVENT_EOS ) return GST_PAD_PROBE_OK;
+
+	return ( g_object_get_data ( G_OBJECT ( demux ), "eos" ) ) ? GST_PAD_PROBE_OK : GST_PAD_PROBE_DROP;
+}
+
+static GstPadProbeReturn dvb_decode_demux_eos ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, GstElement *demux )
+{
+	if ( GST_EVENT_TYPE ( GST_PAD_PROBE_INFO_EVENT ( info ) ) == GST_EVENT_EOS ) g_object_set_data ( G_OBJECT ( demux ), "eos", GINT_TO_POINTER ( TRUE ) );
+
+	return GST_PAD_PROBE_OK;
+}
+
+static char * dvb_decode_key ( const Channel *channel )
+{
+	if ( !channel ) return NULL;
+
+	if ( channel->tsid ) return g_strdup_printf ( "%u-%u-%u", channel->onid, channel->tsid, channel->sid );
+
+	return g_strdup_printf ( "%u-%08x", channel->sid, g_str_hash ( channel->mux ) );
+}
+
+static void dvb_decode_eos_probe ( GstElement *demux, GstElement *convert )
+{
+	GstPad *pad = gst_element_get_static_pad ( convert, "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)dvb_decode_eos, demux, NULL );
+	gst_object_unref ( pad );
+}
+
+static void dvb_decode_video ( GstElement *demux, GstElement *queue, GstElement *convert, const Channel *channel, Dvb *dvb )
+{
+	g_autofree char *key = dvb_decode_key ( channel );
+
+	DvbDecode *decode = dvb_decode_new ( "video", key, dvb->buffering, queue, gst_element_get_static_pad ( convert, "sink" ), dvb->decode, dvb->debug );
+
+	/* convert outlives the queue and the decode stage */
+	g_object_set_data_full ( G_OBJECT ( convert ), "decode", decode, (GDestroyNotify)dvb_decode_free );
+
+	dvb_decode_eos_probe ( demux, convert );
+
+	g_signal_connect ( demux, "pad-added",   G_CALLBACK ( dvb_pad_demux ), decode );
+	g_signal_connect ( demux, "pad-removed", G_CALLBACK ( dvb_pad_demux_removed ), decode );
+}
+
+typedef struct _DvbTracks DvbTracks;
+
+/* Audio tracks of the live view: every audio pad of tsdemux has its queue and decode stage into input-selector,
+ * a track switch is the active pad of the selector ( no relink, no renegotiation of a decoder ) */
+struct _DvbTracks
+{
+	GMutex mutex;
+
+	GPtrArray *tracks;    // DvbDecode, in the order of the demux pads
+	GHashTable *langs;    // pid → ISO-639 ( PMT )
+	DvbDecode *active;
+
+	GstElement *selector;
+	char *lang;           // preferred ISO-639, NULL - the first track
+	gboolean manual;      // chosen in the info window: the preference is not applied any more
+	gint64 lost;          // the active track went away ( PMT update )
+
+	BufferingProfile profile;
+
+	char *key;
+	DecodeCache *cache;
+	gboolean debug;
+};
+
+static void dvb_tracks_free ( DvbTracks *tracks )
+{
+	g_ptr_array_foreach ( tracks->tracks, (GFunc)dvb_decode_free, NULL );
+	g_ptr_array_unref ( tracks->tracks );
+	g_hash_table_unref ( tracks->langs );
+	g_mutex_clear ( &tracks->mutex );
+
+	free ( tracks->lang );
+	free ( tracks->key );
+	free ( tracks );
+}
+
+static gboolean dvb_tracks_lang_match ( const DvbDecode *decode, const char *lang )
+{
+	return ( lang && decode->lang[0] && g_ascii_strncasecmp ( decode->lang, lang, 3 ) == 0 ) ? TRUE : FALSE;
+}
+
+static GstPadProbeReturn dvb_tracks_recovered ( G_GNUC_UNUSED GstPad *pad, G_GNUC_UNUSED GstPadProbeInfo *info, DvbTracks *tracks )
+{
+	if ( tracks->debug ) g_message ( "%s: PMT update, first audio buffer after %ld ms ", __func__, (long)( ( g_get_monotonic_time () - tracks->lost ) / 1000 ) );
+
+	tracks->lost = 0;
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+/* Locked */
+static void dvb_tracks_activate ( DvbDecode *decode, DvbTracks *tracks )
+{
+	if ( !decode || decode == tracks->active ) return;
+
+	tracks->active = decode;
+
+	g_object_set ( tracks->selector, "active-pad", decode->sinkpad, NULL );
+
+	if ( tracks->lost )
+	{
+		GstPad *pad = gst_element_get_static_pad ( tracks->selector, "src" );
+		gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)dvb_tracks_recovered, tracks, NULL );
+		gst_object_unref ( pad );
+	}
+
+	if ( tracks->debug ) g_message ( "%s: pid %u | %s ", __func__, decode->pid, ( decode->lang[0] ) ? decode->lang : "-" );
+}
+
+/* Locked. The track of the preferred language, otherwise the active one stays ( the first one ) */
+static void dvb_tracks_prefer ( DvbTracks *tracks )
+{
+	DvbDecode *first = NULL, *prefer = NULL;
+
+	uint i = 0; for ( i = 0; i < tracks->tracks->len; i++ )
+	{
+		DvbDecode *decode = g_ptr_array_index ( tracks->tracks, i );
+
+		if ( !first ) first = decode;
+		if ( !prefer && dvb_tracks_lang_match ( decode, tracks->lang ) ) prefer = decode;
+	}
+
+	if ( tracks->active && ( tracks->manual || !prefer || dvb_tracks_lang_match ( tracks->active, tracks->lang ) ) ) return;
+
+	dvb_tracks_activate ( ( prefer ) ? prefer : first, tracks );
+}
+
+/* Streaming thread: the languages of the PMT ( ISO 639 descriptor ) */
+static void dvb_tracks_set_langs ( const GstMpegtsPMT *pmt, DvbTracks *tracks )
+{
+	g_mutex_lock ( &tracks->mutex );
+
+	uint i = 0; for ( i = 0; i < pmt->streams->len; i++ )
+	{
+		const GstMpegtsPMTStream *stream = g_ptr_array_index ( pmt->streams, i );
+		const GstMpegtsDescriptor *desc = gst_mpegts_find_descriptor ( stream->descriptors, GST_MTS_DESC_ISO_639_LANGUAGE );
+
+		char *lang = NULL;
+
+		if ( !desc || !gst_mpegts_descriptor_parse_iso_639_language_idx ( desc, 0, &lang, NULL ) ) continue;
+
+		uint j = 0; for ( j = 0; j < tracks->tracks->len; j++ )
+		{
+			DvbDecode *decode = g_ptr_array_index ( tracks->tracks, j );
+
+			if ( decode->pid == stream->pid ) g_strlcpy ( decode->lang, lang, sizeof ( decode->lang ) );
+		}
+
+		g_hash_table_replace ( tracks->langs, GUINT_TO_POINTER ( stream->pid ), lang );
+	}
+
+	dvb_tracks_prefer ( tracks );
+
+	g_mutex_unlock ( &tracks->mutex );
+}
+
+/* Streaming thread: every audio pad is a track */
+static void dvb_tracks_pad_added ( GstElement *element, GstPad *pad, DvbTracks *tracks )
+{
+	if ( !dvb_pad_check_type ( pad, "audio" ) ) return;
+
+	GstElement *queue = buffering_queue_new ( tracks->profile, "audio" );
+	gst_bin_add ( GST_BIN ( GST_ELEMENT_PARENT ( tracks->selector ) ), queue );
+
+	uint16_t pid = dvb_pad_pid ( pad );
+
+	/* One cache entry per track: the tracks of a service differ in codec ( AAC, AC-3, MPEG ) */
+	g_autofree char *key = ( tracks->key ) ? g_strdup_printf ( "%s-%u", tracks->key, pid ) : NULL;
+
+	DvbDecode *decode = dvb_decode_new ( "audio", key, tracks->profile, queue, gst_element_get_request_pad ( tracks->selector, "sink_%u" ), tracks->cache, tracks->debug );
+
+	decode->pad = gst_object_ref ( pad );
+	decode->pid = pid;
+
+	dvb_decode_link ( element, pad, decode );
+
+	g_mutex_lock ( &tracks->mutex );
+
+	const char *lang = g_hash_table_lookup ( tracks->langs, GUINT_TO_POINTER ( decode->pid ) );
+	if ( lang ) g_strlcpy ( decode->lang, lang, sizeof ( decode->lang ) );
+
+	g_ptr_array_add ( tracks->tracks, decode );
+
+	dvb_tracks_prefer ( tracks );
+
+	g_mutex_unlock ( &tracks->mutex );
+}
+
+/* Streaming thread: PMT update - the track is gone; if it was the active one, another track takes over */
+static void dvb_tracks_pad_removed ( GstElement *element, GstPad *pad, DvbTracks *tracks )
+{
+	if ( GST_STATE_TARGET ( element ) < GST_STATE_PAUSED ) return;
+
+	DvbDecode *decode = NULL;
+
+	g_mutex_lock ( &tracks->mutex );
+
+	uint i = 0; for ( i = 0; i < tracks->tracks->len; i++ )
+		if ( ( (DvbDecode *)g_ptr_array_index ( tracks->tracks, i ) )->pad == pad ) decode = g_ptr_array_index ( tracks->tracks, i );
+
+	if ( decode ) g_ptr_array_remove ( tracks->tracks, decode );
+
+	if ( decode && decode == tracks->active )
+	{
+		tracks->active = NULL;
+		tracks->lost = g_get_monotonic_time ();
+
+		dvb_tracks_prefer ( tracks );
+	}
+
+	g_mutex_unlock ( &tracks->mutex );
+
+	if ( !decode ) return;
+
+	dvb_decode_stage_clear ( decode );
+	gst_element_release_request_pad ( tracks->selector, decode->sinkpad );
+
+	dvb_decode_free ( decode );
+}
+
+static void dvb_tracks_new ( GstElement *demux, GstElement *selector, GstElement *convert, const Channel *channel, Dvb *dvb )
+{
+	DvbTracks *tracks = g_new0 ( DvbTracks, 1 );
+
+	g_mutex_init ( &tracks->mutex );
+
+	tracks->tracks   = g_ptr_array_new ();
+	tracks->langs    = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, free );
+	tracks->selector = selector;
+	tracks->lang     = ( dvb->audio_lang && dvb->audio_lang[0] ) ? g_strdup ( dvb->audio_lang ) : NULL;
+	tracks->profile  = dvb->buffering;
+	tracks->key      = dvb_decode_key ( channel );
+	tracks->cache    = dvb->decode;
+	tracks->debug    = dvb->debug;
+
+	g_object_set_data_full ( G_OBJECT ( demux ), "tracks", tracks, (GDestroyNotify)dvb_tracks_free );
+
+	dvb_decode_eos_probe ( demux, convert );
+
+	g_signal_connect ( demux, "pad-added",   G_CALLBACK ( dvb_tracks_pad_added ), tracks );
+	g_signal_connect ( demux, "pad-removed", G_CALLBACK ( dvb_tracks_pad_removed ), tracks );
+}
+
+/* Main loop: the tracks for the info window ( pid, language ). Returns the number of the active one */
+static uint8_t dvb_tracks_fill ( GtkComboBoxText *combo, GstElement *demux )
+{
+	DvbTracks *tracks = ( demux ) ? g_object_get_data ( G_OBJECT ( demux ), "tracks" ) : NULL;
+
+	if ( !tracks ) return 0;
+
+	uint8_t num = 0;
+
+	g_mutex_lock ( &tracks->mutex );
+
+	uint i = 0; for ( i = 0; i < tracks->tracks->len; i++ )
+	{
+		const DvbDecode *decode = g_ptr_array_index ( tracks->tracks, i );
+
+		char buf[100] = {};
+		sprintf ( buf, "%d  ( 0x%.4X )  %s", decode->pid, decode->pid, decode->lang );
+
+		gtk_combo_box_text_append_text ( combo, buf );
+
+		if ( decode == tracks->active ) num = (uint8_t)i;
+	}
+
+	g_mutex_unlock ( &tracks->mutex );
+
+	return num;
+}
+
+/* Main loop: the selector switches on the next buffer */
+static void dvb_tracks_select ( uint num, GstElement *demux )
+{
+	DvbTracks *tracks = ( demux ) ? g_object_get_data ( G_OBJECT ( demux ), "tracks" ) : NULL;
+
+	if ( !tracks ) return;
+
+	g_mutex_lock ( &tracks->mutex );
+
+	if ( num < tracks->tracks->len )
+	{
+		tracks->manual = TRUE;
+		dvb_tracks_activate ( g_ptr_array_index ( tracks->tracks, num ), tracks );
+	}
+
+	g_mutex_unlock ( &tracks->mutex );
+}
+
+/* Streaming thread: the PMT version of the program is kept on tsdemux, the decode cache compares it */
+static void dvb_decode_pmt ( GstMessage *message )
+{
+	GstMpegtsSection *section = gst_message_parse_mpegts_section ( message );
+
+	if ( !section ) return;
+
+	GObject *demux = G_OBJECT ( GST_MESSAGE_SRC ( message ) );
+
+	if ( GST_MPEGTS_SECTION_TYPE ( section ) == GST_MPEGTS_SECTION_PMT && g_object_class_find_property ( G_OBJECT_GET_CLASS ( demux ), "program-number" ) )
+	{
+		int sid = 0;
+		g_object_get ( demux, "program-number", &sid, NULL );
+
+		if ( section->subtable_extension == sid )
+		{
+			g_object_set_data ( demux, "pmt-version", GINT_TO_POINTER ( section->version_number + 1 ) );
+
+			DvbTracks *tracks = g_object_get_data ( demux, "tracks" );
+			const GstMpegtsPMT *pmt = gst_mpegts_section_get_pmt ( section );
+
+			if ( tracks && pmt ) dvb_tracks_set_langs ( pmt, tracks );
+		}
+	}
+
+	gst_mpegts_section_unref ( section );
+}
+
+
+/* Timeshift: tee → queue → fakesink, the buffers of the fakesink are written to the ring */
+static void dvb_create_timeshift ( Dvb *dvb )
+{
+	GstElement *queue = gst_element_factory_make ( "queue",    NULL );
+	GstElement *sink  = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !queue || !sink )
+		g_critical ( "%s:: element (factory make) - queue / fakesink not created. \n", __func__ );
+
+	g_object_set ( sink, "sync", FALSE, "async", FALSE, NULL );
+
+	gst_bin_add_many ( GST_BIN ( dvb->capdvb ), queue, sink, NULL );
+	gst_element_link_many ( dvb->tee, queue, sink, NULL );
+
+	GstPad *pad = gst_element_get_static_pad ( sink, "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)timeshift_probe, dvb->timeshift, NULL );
+	gst_object_unref ( pad );
+
+	timeshift_reset ( dvb->timeshift );
+
+	dvb->feed = timeshift_create_src ( "dvbsrc-timeshift", dvb->timeshift );
+	gst_bin_add ( GST_BIN ( dvb->playdvb ), dvb->feed );
+}
+
+/* The reads of dvbsrc are gathered into batches of N × 188 bytes for the tee and everything behind it ( tsbatch.c ) */
+static void dvb_src_batch ( GstPad *pad, Dvb *dvb )
+{
+	if ( dvb->batch_packets == 0 ) return;
+
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)ts_batch_probe,
+		ts_batch_new ( dvb->batch_packets, dvb->batch_latency ), (GDestroyNotify)ts_batch_free );
+}
+
+/* dvbsrc ( filesrc for DVB_TS_FILE ) → tee: the live branch and the record branches ( recorder.c ) are linked to the tee.
+ * Timeshift: dvbsrc and tee are in the capture pipeline, the live branch is fed by the ring ( appsrc ) */
+/* EIT: sections are assembled on the streaming thread, the changed ones reach the EPG store; the analyzer counts all packets */
+static void dvb_src_probes ( GstElement *dvbsrc, Dvb *dvb )
+{
+	psi_reset ( dvb->psi );
+
+	analyzer_reset ( dvb->analyzer );
+
+	GstPad *pad = gst_element_get_static_pad ( dvbsrc, "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)psi_probe, dvb->psi, NULL );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)analyzer_probe, dvb->analyzer, NULL );
+	dvb_src_batch ( pad, dvb );
+	gst_object_unref ( pad );
+}
+
+static void dvb_create_src ( Dvb *dvb )
+{
+	GstElement *pipeline = ( dvb->timeshift ) ? dvb->capdvb : dvb->playdvb;
+
+	dvb->dvbsrc = gst_element_factory_make ( ( dvb->ts_file ) ? "filesrc" : "dvbsrc", "dvbsrc" );
+	dvb->tee    = gst_element_factory_make ( "tee", "dvbsrc-tee" );
+
+	if ( !dvb->dvbsrc || !dvb->tee )
+		g_critical ( "%s:: element (factory make) - dvbsrc / tee not created. \n", __func__ );
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), dvb->dvbsrc, dvb->tee, NULL );
+	gst_element_link ( dvb->dvbsrc, dvb->tee );
+
+	g_object_set ( dvb->tee, "allow-not-linked", TRUE, NULL );
+
+	if ( dvb->ts_file ) g_object_set ( dvb->dvbsrc, "location", dvb->ts_file, NULL );
+
+	if ( !dvb->ts_file )
+	{
+		g_signal_connect ( dvb->dvbsrc, "tuning-done", G_CALLBACK ( dvb_tuning_done ), dvb );
+		g_signal_connect ( dvb->dvbsrc, "tuning-fail", G_CALLBACK ( dvb_tuning_fail ), dvb );
+	}
+
+	dvb_src_probes ( dvb->dvbsrc, dvb );
+
+	dvb->feed = dvb->tee;
+
+	if ( dvb->timeshift ) dvb_create_timeshift ( dvb );
+}
+
+/* The decode stages ( in front of input-selector and videoconvert ) are built on the pads of tsdemux;
+ * the queues in front of them are of the buffering profile of the live view */
+static DvbSet dvb_create_bin ( GstElement *element, GstElement *feed, const Channel *channel, Dvb *dvb )
+{
+	struct dvb_all_list { const char *name; } dvb_all_list_n[] =
+	{
+		{ "tsdemux" },
+		{ "input-selector" }, { "audioconvert" }, { "equalizer-nbands" }, { "volume" }, { "autoaudiosink" },
+		{ "queue"   }, { "videoconvert" }, { "videobalance"     }, { "autovideosink" }
+	};
+
+	DvbSet dvbset;
+
+	gboolean video_enable = channel->video;
+
+	GstElement *elements[ G_N_ELEMENTS ( dvb_all_list_n ) ] = { NULL };
+
+	uint c = 0;
+	for ( c = 0; c < G_N_ELEMENTS ( dvb_all_list_n ); c++ )
+	{
+		if ( !video_enable && c > 5 ) continue;
+
+		elements[c] = ( c == 6 ) ? buffering_queue_new ( dvb->buffering, "video" ) : gst_element_factory_make ( dvb_all_list_n[c].name, NULL );
+
+		if ( !elements[c] )
+			g_critical ( "%s:: element (factory make) - %s not created. \n", __func__, dvb_all_list_n[c].name );
+
+		gst_bin_add ( GST_BIN ( element ), elements[c] );
+
+		if (  c == 0 || c == 1 || c == 6 || c == 7 ) continue;
+
+		gst_element_link ( elements[c-1], elements[c] );
+	}
+
+	gst_element_link ( feed, elements[0] );
+
+	GstPad *pad = gst_element_get_static_pad ( elements[0], "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)dvb_decode_demux_eos, elements[0], NULL );
+	gst_object_unref ( pad );
+
+	buffering_demux_set ( elements[0], dvb->buffering );
+
+	dvb_tracks_new ( elements[0], elements[1], elements[2], channel, dvb );
+	if ( video_enable ) dvb_decode_video ( elements[0], elements[6], elements[7], channel, dvb );
+
+	buffering_meter_add ( elements[4], "audio" );
+	if ( video_enable ) buffering_meter_add ( elements[8], "video" );
+
+	g_object_set ( elements[4], "volume", VOLUME, NULL );
+
+	dvbset.demux  = elements[0];
+	dvbset.volume = elements[4];
+	dvbset.equalizer = elements[3];
+	dvbset.videoblnc = elements[8];
+
+	return dvbset;
+}
+
+/* Unlinks the src pad that feeds the element, a tee request pad is released */
+static void dvb_feed_release ( GstElement *feed, GstElement *element )
+{
+	GstPad *sinkpad = gst_element_get_static_pad ( element, "sink" );
+	GstPad *srcpad  = gst_pad_get_peer ( sinkpad );
+
+	if ( srcpad )
+	{
+		gst_pad_unlink ( srcpad, sinkpad );
+
+		GstPadTemplate *templ = gst_pad_get_pad_template ( srcpad );
+
+		if ( templ && GST_PAD_TEMPLATE_PRESENCE ( templ ) == GST_PAD_REQUEST ) gst_element_release_request_pad ( feed, srcpad );
+		if ( templ ) gst_object_unref ( templ );
+
+		gst_object_unref ( srcpad );
+	}
+
+	gst_object_unref ( sinkpad );
+}
+
+static void dvb_remove_bin ( GstElement *pipeline, const char *name )
+{
+	GstIterator *it = gst_bin_iterate_elements ( GST_BIN ( pipeline ) );
+	GValue item = { 0, };
+	gboolean done = FALSE;
+
+	while ( !done )
+	{
+		switch ( gst_iterator_next ( it, &item ) )
+		{
+			case GST_ITERATOR_OK:
+			{
+				GstElement *element = GST_ELEMENT ( g_value_get_object (&item) );
+
+				char *object_name = gst_object_get_name ( GST_OBJECT ( element ) );
+
+				if ( name && g_strrstr ( object_name, name ) )
+				{
+					g_debug ( "%s:: Object Not remove: %s \n", __func__, object_name );
+				}
+				else
+				{
+					gst_element_set_state ( element, GST_STATE_NULL );
+					gst_bin_remove ( GST_BIN ( pipeline ), element );
+
+					g_debug ( "%s:: Object remove: %s \n", __func__, object_name );
+				}
+
+				g_free ( object_name );
+				g_value_reset (&item);
+
+				break;
+			}
+
+			case GST_ITERATOR_RESYNC:
+				gst_iterator_resync (it);
+				break;
+
+			case GST_ITERATOR_ERROR:
+				done = TRUE;
+				break;
+
+			case GST_ITERATOR_DONE:
+				done = TRUE;
+				break;
+		}
+	}
+
+	g_value_unset ( &item );
+	gst_iterator_free ( it );
+}
+
+static void dvb_sync_bin ( GstElement *pipeline, const char *name )
+{
+	GstIterator *it = gst_bin_iterate_elements ( GST_BIN ( pipeline ) );
+	GValue item = { 0, };
+	gboolean done = FALSE;
+
+	while ( !done )
+	{
+		switch ( gst_iterator_next ( it, &item ) )
+		{
+			case GST_ITERATOR_OK:
+			{
+				GstElement *element = GST_ELEMENT ( g_value_get_object (&item) );
+
+				char *object_name = gst_object_get_name ( GST_OBJECT ( element ) );
+
+				if ( !name || !g_strrstr ( object_name, name ) )
+					gst_element_sync_state_with_parent ( element );
+
+				g_free ( object_name );
+				g_value_reset (&item);
+
+				break;
+			}
+
+			case GST_ITERATOR_RESYNC:
+				gst_iterator_resync (it);
+				break;
+
+			case GST_ITERATOR_ERROR:
+				done = TRUE;
+				break;
+
+			case GST_ITERATOR_DONE:
+				done = TRUE;
+				break;
+		}
+	}
+
+	g_value_unset ( &item );
+	gst_iterator_free ( it );
+}
+
+GstElement * dvb_iterate_element ( GstElement *it_e, const char *name1, const char *name2 )
+{
+	GstIterator *it = gst_bin_iterate_recurse ( GST_BIN ( it_e ) );
+
+	GValue item = { 0, };
+	gboolean done = FALSE;
+
+	GstElement *element_ret = NULL;
+
+	while ( !done )
+	{
+		switch ( gst_iterator_next ( it, &item ) )
+		{
+			case GST_ITERATOR_OK:
+			{
+				GstElement *element = GST_ELEMENT ( g_value_get_object (&item) );
+
+				char *object_name = gst_object_get_name ( GST_OBJECT ( element ) );
+
+				if ( g_strrstr ( object_name, name1 ) )
+				{
+					if ( name2 && g_strrstr ( object_name, name2 ) )
+						element_ret = element;
+					else
+						element_ret = element;
+				}
+
+				g_free ( object_name );
+				g_value_reset (&item);
+
+				break;
+			}
+
+			case GST_ITERATOR_RESYNC:
+				gst_iterator_resync (it);
+				break;
+
+			case GST_ITERATOR_ERROR:
+				done = TRUE;
+				break;
+
+			case GST_ITERATOR_DONE:
+				done = TRUE;
+				break;
+		}
+	}
+
+	g_value_unset ( &item );
+	gst_iterator_free ( it );
+
+	return element_ret;
+}
+
+/* Returns a newly-allocated string holding the result. Free with free() */
+static char * dvb_rec_get_path ( const Channel *channel )
+{
 	g_autofree char *dt = helia_time_to_str ();
-	char **lines = g_strsplit ( dvb->data, ":", 0 );
 
-	g_autofree char *rec_dir = NULL;
-	GSettings *setting = settings_init ();
-	if ( setting ) rec_dir = g_settings_get_string ( setting, "rec-dir" );
+	g_autofree char *rec_dir = NULL;
+	GSettings *setting = settings_init ();
+	if ( setting ) rec_dir = g_settings_get_string ( setting, "rec-dir" );
+
+	char *path = NULL;
+
+	if ( setting && rec_dir && !g_str_has_prefix ( rec_dir, "none" ) )
+		path = g_strdup_printf ( "%s/%s-%s.m2ts", rec_dir, channel->name, dt );
+	else
+		path = g_strdup_printf ( "%s/%s-%s.m2ts", g_get_home_dir (), channel->name, dt );
+
+	if ( setting ) g_object_unref ( setting );
+
+	return path;
+}
+
+static void dvb_combo_lang_changed ( GtkComboBox *combo, Dvb *dvb )
+{
+	int num = gtk_combo_box_get_active ( GTK_COMBO_BOX ( combo ) );
+
+	if ( num >= 0 ) dvb_tracks_select ( (uint)num, dvb->demux );
+}
+
+static void dvb_run_info ( Dvb *dvb )
+{
+	GtkWindow *window = GTK_WINDOW ( gtk_widget_get_toplevel ( GTK_WIDGET ( dvb->video ) ) );
+
+	GtkComboBoxText *combo_lang = helia_info_dvb ( dvb_channel_get ( dvb->data, dvb ), window, dvb->dvbsrc, dvb->playdvb, dvb->analyzer, dvb->sighist );
+
+	if ( combo_lang )
+	{
+		uint8_t num = dvb_tracks_fill ( combo_lang, dvb->demux );
+
+		gtk_combo_box_set_active ( GTK_COMBO_BOX ( combo_lang ), num );
+		g_signal_connect ( combo_lang, "changed", G_CALLBACK ( dvb_combo_lang_changed ), dvb );
+	}
+}
+
+static void dvb_set_tuning_timeout ( GstElement *element )
+{
+	guint64 timeout = 0;
+	g_object_get ( element, "tuning-timeout", &timeout, NULL );
+	g_object_set ( element, "tuning-timeout", (guint64)timeout / 4, NULL );
+}
+
+static void dvb_rinit ( GstElement *element )
+{
+	int adapter = 0, frontend = 0;
+	g_object_get ( element, "adapter",  &adapter,  NULL );
+	g_object_get ( element, "frontend", &frontend, NULL );
+
+	helia_dvb_init ( adapter, frontend );
+}
+
+/* Tuning: the record of the channel is applied as is ( ts file: the program-number only ) */
+static void dvb_data_set ( const Channel *channel, GstElement *element, GstElement *demux, Dvb *dvb )
+{
+	if ( !dvb->ts_file )
+	{
+		dvb_set_tuning_timeout ( element );
+		channel_apply ( channel, element );
+	}
+
+	if ( demux && channel->sid )
+	{
+		dvb->sid = channel->sid;
+		g_object_set ( demux, "program-number", channel->sid, NULL );
+	}
+
+	if ( dvb->debug ) g_message ( "%s: %s | program-number %u | fields %u ", __func__, channel->name, channel->sid, channel->fields->len );
+}
+
+static gboolean dvb_data_same_mux ( const char *data_old, const char *data_new, Dvb *dvb )
+{
+	if ( !data_old || !data_new ) return FALSE;
+
+	return channel_same_mux ( dvb_channel_get ( data_old, dvb ), dvb_channel_get ( data_new, dvb ) );
+}
+
+static GstPadProbeReturn dvb_zap_first_buffer ( G_GNUC_UNUSED GstPad *pad, G_GNUC_UNUSED GstPadProbeInfo *info, Dvb *dvb )
+{
+	gint64 zap_ms = ( g_get_monotonic_time () - dvb->zap_start ) / 1000;
+
+	gint64 lock_ms = ( dvb->zap_lock > dvb->zap_start ) ? ( dvb->zap_lock - dvb->zap_start ) / 1000 : 0;
+
+	if ( dvb->debug ) g_message ( "%s: zap %u | lock %ld ms | first %s buffer %ld ms ", __func__, dvb->sid, (long)lock_ms, ( dvb->checked_video ) ? "video" : "audio", (long)zap_ms );
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+static void dvb_zap_latency ( DvbSet dvbset, Dvb *dvb )
+{
+	GstElement *element = ( dvb->checked_video ) ? dvbset.videoblnc : dvbset.volume;
+
+	GstPad *pad = gst_element_get_static_pad ( element, "sink" );
+
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)dvb_zap_first_buffer, dvb, NULL );
+
+	gst_object_unref ( pad );
+}
 
-	char path[PATH_MAX] = {};
+/* Resolved on the main loop: the probe touches neither dvb->data nor the channel db ( the records stay in the db ) */
+typedef struct _DvbZap DvbZap;
 
-	if ( setting && rec_dir && !g_str_has_prefix ( rec_dir, "none" ) )
-		sprintf ( path, "%s/%s-%s.m2ts", rec_dir, lines[0], dt );
-	else
-		sprintf ( path, "%s/%s-%s.m2ts", g_get_home_dir (), lines[0], dt );
+struct _DvbZap
+{
+	Dvb *dvb;
+	const Channel *channel;
+};
 
-	g_object_set ( elements[19], "location", path, NULL );
+/* Streaming thread */
+static GstPadProbeReturn dvb_zap_blockpad_probe ( GstPad *pad, GstPadProbeInfo *info, DvbZap *zap )
+{
+	Dvb *dvb = zap->dvb;
 
-	g_strfreev ( lines );
-	if ( setting ) g_object_unref ( setting );
+	double value = VOLUME;
+	if ( dvb->volume ) g_object_get ( dvb->volume, "volume", &value, NULL );
 
-	dvbset.demux  = elements[0];
-	dvbset.volume = elements[6];
-	dvbset.equalizer = elements[5];
-	dvbset.videoblnc = elements[12];
+	dvb_feed_release ( dvb->feed, dvb->demux );
+	dvb_remove_bin ( dvb->playdvb, "dvbsrc" );
 
-	return dvbset;
+	DvbSet dvbset = dvb_create_bin ( dvb->playdvb, dvb->feed, zap->channel, dvb );
+
+	dvb->demux  = dvbset.demux;
+	dvb->volume = dvbset.volume;
+	dvb->equalizer = dvbset.equalizer;
+	dvb->videoblnc = dvbset.videoblnc;
+
+	g_object_set ( dvb->volume, "volume", value, NULL );
+	g_object_set ( dvb->demux, "program-number", zap->channel->sid, NULL );
+
+	dvb_zap_latency ( dvbset, dvb );
+
+	dvb_sync_bin ( dvb->playdvb, "dvbsrc" );
+
+	gst_pad_remove_probe ( pad, GST_PAD_PROBE_INFO_ID (info) );
+
+	return GST_PAD_PROBE_OK;
 }
 
-static GstPadProbeReturn dvb_blockpad_probe ( GstPad *pad, GstPadProbeInfo *info, gpointer data )
+/* Live view ( and its recordings on the tee ) hold one shared tuner of the pool;
+ * the timer pipeline holds its tuner exclusively ( a second dvbsrc can't open the same frontend ) */
+static gboolean dvb_tuner_acquire ( const Channel *channel, gboolean exclusive, int *tuner )
 {
-	Dvb *dvb = (Dvb *) data;
-/*
-	GSettings *setting = settings_init ();
+	TunerPool *pool = tuner_pool_get_default ();
 
-	gboolean enc_b = FALSE;
-	if ( setting ) enc_b = g_settings_get_boolean ( setting, "encoding-tv" );
+	if ( tuner_pool_count ( pool ) == 0 ) return TRUE;
+
+	*tuner = tuner_pool_acquire ( channel->mux, channel->delsys, channel->adapter, channel->frontend, exclusive, pool );
+
+	return ( *tuner != -1 ) ? TRUE : FALSE;
+}
+
+static void dvb_tuner_release ( Dvb *dvb )
+{
+	tuner_pool_release ( dvb->tuner, tuner_pool_get_default () );
+
+	dvb->tuner = -1;
+}
+
+static void dvb_tuner_set ( GstElement *element, int tuner, Dvb *dvb )
+{
+	if ( tuner == -1 || dvb->ts_file ) return;
+
+	TunerPool *pool = tuner_pool_get_default ();
+
+	g_object_set ( element, "adapter",  tuner_pool_get_adapter  ( tuner, pool ), NULL );
+	g_object_set ( element, "frontend", tuner_pool_get_frontend ( tuner, pool ), NULL );
+
+	/* The device info is read once per frontend, not on every zap */
+	if ( tuner_pool_first_use ( tuner, pool ) ) dvb_rinit ( element );
+}
+
+/* Main loop: the lock is stored in the tuning state of the frontend */
+static gboolean dvb_zap_locked ( Dvb *dvb )
+{
+	const Channel *channel = dvb_channel_get ( dvb->data, dvb );
+
+	if ( !channel || dvb->zap_lock < dvb->zap_start ) return FALSE;
+
+	tuner_pool_set_locked ( dvb->tuner, channel->mux, TRUE, tuner_pool_get_default () );
+
+	if ( dvb->debug ) g_message ( "%s: zap %u | lock %ld ms ( %s frontend ) ", __func__, dvb->sid, 
+		(long)( ( dvb->zap_lock - dvb->zap_start ) / 1000 ), ( dvb->zap_warm ) ? "warm" : "cold" );
+
+	return FALSE;
+}
+
+static gboolean dvb_zap_lock_failed ( Dvb *dvb )
+{
+	tuner_pool_set_locked ( dvb->tuner, NULL, FALSE, tuner_pool_get_default () );
+
+	if ( dvb->debug ) g_message ( "%s: zap %u | no lock ", __func__, dvb->sid );
+
+	return FALSE;
+}
+
+/* Emitted by dvbsrc in its start(), inside the state change: on the thread of set_state ( the main loop ).
+ * The pool is updated from an idle, after the state change has returned */
+static void dvb_tuning_done ( G_GNUC_UNUSED GstElement *dvbsrc, Dvb *dvb )
+{
+	dvb->zap_lock = g_get_monotonic_time ();
+
+	g_idle_add ( (GSourceFunc)dvb_zap_locked, dvb );
+}
+
+static void dvb_tuning_fail ( G_GNUC_UNUSED GstElement *dvbsrc, Dvb *dvb )
+{
+	g_idle_add ( (GSourceFunc)dvb_zap_lock_failed, dvb );
+}
+
+/* Same multiplex: the frontend stays locked and dvbsrc keeps running, only the demux and decode branches are replaced;
+ * a running record branch ( "dvbsrc-rec-N" ) stays on the tee */
+static gboolean dvb_zap_same_mux ( const char *data, Dvb *dvb )
+{
+	if ( !dvb->dvbsrc || GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_PLAYING ) return FALSE;
+
+	if ( !dvb_data_same_mux ( dvb->data, data, dvb ) ) return FALSE;
+
+	const Channel *channel = dvb_channel_get ( data, dvb );
+
+	free ( dvb->data );
+	dvb->data = g_strdup ( data );
+
+	dvb->sid = channel->sid;
+	dvb->checked_video = channel->video;
+	dvb->zap_start = g_get_monotonic_time ();
+
+	GstPad *blockpad = gst_element_get_static_pad ( ( dvb->timeshift ) ? dvb->feed : dvb->dvbsrc, "src" );
+
+	DvbZap *zap = g_new0 ( DvbZap, 1 );
+
+	zap->dvb = dvb;
+	zap->channel = channel;
+
+	gst_pad_add_probe ( blockpad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, (GstPadProbeCallback)dvb_zap_blockpad_probe, zap, free );
+
+	gst_object_unref ( blockpad );
+
+	if ( dvb->debug ) g_message ( "%s: same multiplex, program-number %u ", __func__, dvb->sid );
+
+	return TRUE;
+}
+
+static void dvb_stop_set_play ( const char *data, Dvb *dvb )
+{
+	const Channel *channel = dvb_channel_get ( data, dvb );
+
+	if ( !channel ) return;
+
+	if ( dvb_zap_same_mux ( data, dvb ) ) { dvb_ahead_schedule ( dvb ); return; }
+
+	if ( !dvb_timer_live_move ( dvb ) )
+	{
+		dvb_message_dialog ( "", "Timer recording: no free tuner to go on with it.", GTK_MESSAGE_WARNING, dvb );
+		return;
+	}
+
+	if ( dvb_ahead_swap ( data, dvb ) ) return;
+
+	dvb->zap_start = g_get_monotonic_time ();
 
-	if ( setting ) g_object_unref ( setting );
-*/
 	double value = VOLUME;
-	g_object_get ( dvb->volume, "volume", &value, NULL );
+	if ( dvb->volume ) g_object_get ( dvb->volume, "volume", &value, NULL );
 
-	gst_element_set_state ( dvb->playdvb, GST_STATE_PAUSED );
-	dvb_remove_bin ( dvb->playdvb, "dvbsrc" );
+	dvb_set_stop ( dvb );
 
-	DvbSet dvbset;
+	dvb_remove_bin ( dvb->playdvb, NULL );
+	if ( dvb->capdvb ) dvb_remove_bin ( dvb->capdvb, NULL );
+
+	if ( !dvb_tuner_acquire ( channel, FALSE, &dvb->tuner ) )
+	{
+		dvb_message_dialog ( "", "All tuners are busy.", GTK_MESSAGE_WARNING, dvb );
+		return;
+	}
+
+	/* Only with a tuner: the data is of the channel being played */
+	free ( dvb->data );
+	dvb->data = g_strdup ( data );
+
+	dvb->checked_video = channel->video;
 
-	// if ( enc_b )
-	// 	dvbset = dvb_create_rec_enc_bin ( dvb->playdvb, dvb->checked_video, dvb );
-	// else
+	dvb_create_src ( dvb );
+	recorder_set_source ( ( dvb->timeshift ) ? dvb->capdvb : dvb->playdvb, dvb->tee, dvb->recorder );
 
-	dvbset = dvb_create_rec_bin ( dvb->playdvb, dvb->checked_video, dvb );
+	DvbSet dvbset;
+	dvbset = dvb_create_bin ( dvb->playdvb, dvb->feed, channel, dvb );
 
 	dvb->demux  = dvbset.demux;
-	dvb->volume = dvbset.volume;
 	dvb->equalizer = dvbset.equalizer;
 	dvb->videoblnc = dvbset.videoblnc;
 
-	gst_element_link ( dvb->dvbsrc, dvbset.demux );
+	dvb->volume = dvbset.volume;
+	dvb_data_set ( channel, dvb->dvbsrc, dvbset.demux, dvb );
+	dvb_tuner_set ( dvb->dvbsrc, dvb->tuner, dvb );
+
+	dvb->zap_lock = 0;
+	dvb->zap_warm = tuner_pool_is_locked ( dvb->tuner, channel->mux, tuner_pool_get_default () );
 
 	g_object_set ( dvb->volume, "volume", value, NULL );
-	g_object_set ( dvbset.demux, "program-number", dvb->sid, NULL );
 
-	gst_pad_remove_probe ( pad, GST_PAD_PROBE_INFO_ID (info) );
+	dvb_zap_latency ( dvbset, dvb );
+
+	if ( dvb->timeshift ) gst_element_set_state ( dvb->capdvb, GST_STATE_PLAYING );
+
 	gst_element_set_state ( dvb->playdvb, GST_STATE_PLAYING );
 
-	return GST_PAD_PROBE_OK;
+	dvb_ahead_schedule ( dvb );
 }
 
-static void dvb_combo_append_text ( GtkComboBoxText *combo, char *name, uint8_t num )
+/* Buffers and caps before the volume and the video balance: dropped while the pipeline is ahead.
+ * Without caps the video sink is not negotiated and asks for no window; the dropped caps are sent again after the swap */
+static GstPadProbeReturn dvb_ahead_drop ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, G_GNUC_UNUSED Dvb *dvb )
 {
-	if ( g_strrstr ( name, "_0_" ) )
-	{
-		char **data = g_strsplit ( name, "_0_", 0 );
+	if ( info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM && GST_EVENT_TYPE ( GST_PAD_PROBE_INFO_EVENT ( info ) ) != GST_EVENT_CAPS ) return GST_PAD_PROBE_OK;
 
-		uint32_t pid = 0;
-		sscanf ( data[1], "%4x", &pid );
+	return GST_PAD_PROBE_DROP;
+}
 
-		char buf[100] = {};
-		sprintf ( buf, "%d  ( 0x%.4X )", pid, pid );
+static void dvb_ahead_output ( GstElement *element, gboolean drop )
+{
+	if ( !element ) return;
 
-		gtk_combo_box_text_append_text ( combo, buf );
+	GstPad *pad = gst_element_get_static_pad ( element, "sink" );
 
-		g_strfreev ( data );
+	if ( drop )
+	{
+		gulong probe = gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)dvb_ahead_drop, NULL, NULL );
+		g_object_set_data ( G_OBJECT ( element ), "ahead-probe", GUINT_TO_POINTER ( probe ) );
 	}
 	else
 	{
-		char buf[100] = {};
-		sprintf ( buf, "%.4d", num + 1 );
+		gulong probe = GPOINTER_TO_UINT ( g_object_get_data ( G_OBJECT ( element ), "ahead-probe" ) );
+		if ( probe ) gst_pad_remove_probe ( pad, probe );
+	}
 
-		gtk_combo_box_text_append_text ( combo, buf );
+	gst_object_unref ( pad );
+}
+
+static void dvb_ahead_stop ( Dvb *dvb )
+{
+	if ( !dvb->ahead_data ) return;
+
+	gst_element_set_state ( dvb->ahead, GST_STATE_NULL );
+	dvb_remove_bin ( dvb->ahead, NULL );
+
+	tuner_pool_release ( dvb->ahead_tuner, tuner_pool_get_default () );
+
+	if ( dvb->debug ) g_message ( "%s: %s ", __func__, dvb->ahead_data );
+
+	free ( dvb->ahead_data );
+
+	dvb->ahead_data  = NULL;
+	dvb->ahead_src   = NULL;
+	dvb->ahead_tee   = NULL;
+	dvb->ahead_tuner = -1;
+	dvb->ahead_set   = (DvbSet){ NULL, NULL, NULL, NULL };
+}
+
+/* Main loop: a recording, the live view or a scan wants the spare tuner */
+static void dvb_ahead_reclaim ( G_GNUC_UNUSED int id, Dvb *dvb )
+{
+	dvb_ahead_stop ( dvb );
+}
+
+/* The neighbour in the direction of the last channel up / down, on another multiplex, on a free tuner */
+static gboolean dvb_ahead_start ( Dvb *dvb )
+{
+	dvb->ahead_src_id = 0;
+
+	TunerPool *pool = tuner_pool_get_default ();
+
+	if ( !dvb->ahead || dvb->timeshift || tuner_pool_count ( pool ) < 2 ) return FALSE;
+
+	if ( GST_ELEMENT_CAST ( dvb->playdvb )->current_state != GST_STATE_PLAYING ) return FALSE;
+
+	dvb_channel_db_sync ( dvb );
+
+	const Channel *channel = dvb_channel_get ( dvb->data, dvb );
+	const Channel *next = channel_db_step ( channel, dvb->zap_dir, dvb->db );
+
+	if ( !channel || !next || next == channel || channel_same_mux ( channel, next ) ) return FALSE;
+
+	if ( dvb->ahead_data && g_str_equal ( dvb->ahead_data, next->data ) ) return FALSE;
+
+	dvb_ahead_stop ( dvb );
+
+	int tuner = tuner_pool_acquire ( next->mux, next->delsys, next->adapter, next->frontend, TRUE, pool );
+
+	if ( tuner == -1 ) return FALSE;
+
+	GstElement *dvbsrc = gst_element_factory_make ( ( dvb->ts_file ) ? "filesrc" : "dvbsrc", "dvbsrc" );
+	GstElement *tee    = gst_element_factory_make ( "tee", "dvbsrc-tee" );
+
+	if ( !dvbsrc || !tee )
+	{
+		g_critical ( "%s:: element (factory make) - dvbsrc / tee not created. \n", __func__ );
+
+		if ( dvbsrc ) gst_object_unref ( dvbsrc );
+		if ( tee ) gst_object_unref ( tee );
+
+		tuner_pool_release ( tuner, pool );
+
+		return FALSE;
 	}
+
+	gst_bin_add_many ( GST_BIN ( dvb->ahead ), dvbsrc, tee, NULL );
+	gst_element_link ( dvbsrc, tee );
+
+	g_object_set ( tee, "allow-not-linked", TRUE, NULL );
+
+	if ( dvb->ts_file ) g_object_set ( dvbsrc, "location", dvb->ts_file, NULL );
+
+	DvbSet dvbset = dvb_create_bin ( dvb->ahead, tee, next, dvb );
+	dvb->ahead_set = dvbset;
+
+	dvb_gate_new ( dvbset.demux );
+
+	dvb_data_set ( next, dvbsrc, NULL, dvb );
+	dvb_tuner_set ( dvbsrc, tuner, dvb );
+
+	g_object_set ( dvbset.demux, "program-number", next->sid, NULL );
+
+	dvb_ahead_output ( dvbset.volume, TRUE );
+	if ( next->video ) dvb_ahead_output ( dvbset.videoblnc, TRUE );
+
+	tuner_pool_set_spare ( tuner, (TunerReclaim)dvb_ahead_reclaim, dvb, pool );
+
+	dvb->ahead_src   = dvbsrc;
+	dvb->ahead_tee   = tee;
+	dvb->ahead_tuner = tuner;
+	dvb->ahead_data  = g_strdup ( next->data );
+
+	gst_element_set_state ( dvb->ahead, GST_STATE_PLAYING );
+
+	if ( dvb->debug ) g_message ( "%s: %s ( adapter%d/frontend%d ) ", __func__, next->name, tuner_pool_get_adapter ( tuner, pool ), tuner_pool_get_frontend ( tuner, pool ) );
+
+	return FALSE;
 }
 
-static uint8_t dvb_add_audio_track ( GtkComboBoxText *combo, GstElement *element )
+/* After a zap: the prediction follows once the live view has settled */
+static void dvb_ahead_schedule ( Dvb *dvb )
 {
-	GstIterator *it = gst_element_iterate_src_pads ( element );
-	GValue item = { 0, };
+	if ( !dvb->zap_ahead ) return;
 
-	uint8_t i = 0, num = 0;
-	gboolean done = FALSE;
+	if ( dvb->ahead_src_id ) g_source_remove ( dvb->ahead_src_id );
 
-	while ( !done )
+	dvb->ahead_src_id = g_timeout_add ( 1000, (GSourceFunc)dvb_ahead_start, dvb );
+}
+
+/* The zap to the predicted channel: the running ahead pipeline becomes the live one, the old one is the next shell */
+static gboolean dvb_ahead_swap ( const char *data, Dvb *dvb )
+{
+	if ( !dvb->ahead_data || !g_str_equal ( dvb->ahead_data, data ) ) return FALSE;
+
+	/* The sinks of the ahead pipeline get no buffer: its state change to PLAYING completes after the swap */
+	if ( GST_STATE_TARGET ( dvb->ahead ) != GST_STATE_PLAYING ) return FALSE;
+
+	const Channel *channel = dvb_channel_get ( data, dvb );
+
+	TunerPool *pool = tuner_pool_get_default ();
+
+	double value = VOLUME;
+	if ( dvb->volume ) g_object_get ( dvb->volume, "volume", &value, NULL );
+
+	dvb->zap_start = g_get_monotonic_time ();
+
+	/* Taken out of the ahead state before the stop: the stop ends the ahead pipeline otherwise */
+	char *ahead_data = dvb->ahead_data;
+	int ahead_tuner  = dvb->ahead_tuner;
+	dvb->dvbsrc = dvb->ahead_src;
+	dvb->tee = dvb->feed = dvb->ahead_tee;
+
+	dvb->ahead_data  = NULL;
+	dvb->ahead_src   = NULL;
+	dvb->ahead_tee   = NULL;
+	dvb->ahead_tuner = -1;
+
+	dvb_set_stop ( dvb );
+	dvb_remove_bin ( dvb->playdvb, NULL );
+
+	GstElement *pipeline = dvb->playdvb;
+	dvb->playdvb = dvb->ahead;
+	dvb->ahead = pipeline;
+
+	/* The elements of dvb_create_bin ( ahead_start ): no search in the bin */
+	DvbSet dvbset = dvb->ahead_set;
+	dvb->ahead_set = (DvbSet){ NULL, NULL, NULL, NULL };
+
+	dvb_gate_open ( dvbset.demux );
+
+	dvb->demux     = dvbset.demux;
+	dvb->volume    = dvbset.volume;
+	dvb->equalizer = dvbset.equalizer;
+	dvb->videoblnc = dvbset.videoblnc;
+
+	dvb->tuner = ahead_tuner;
+	tuner_pool_set_spare  ( dvb->tuner, NULL, NULL, pool );
+	tuner_pool_set_locked ( dvb->tuner, channel->mux, TRUE, pool );
+
+	free ( dvb->data );
+	dvb->data = ahead_data;
+
+	dvb->sid = channel->sid;
+	dvb->checked_video = channel->video;
+	dvb->zap_lock = dvb->zap_start;
+	dvb->zap_warm = TRUE;
+
+	if ( !dvb->ts_file )
 	{
-		switch ( gst_iterator_next ( it, &item ) )
-		{
-			case GST_ITERATOR_OK:
-			{
-				GstPad *pad_src = GST_PAD ( g_value_get_object (&item) );
+		g_signal_connect ( dvb->dvbsrc, "tuning-done", G_CALLBACK ( dvb_tuning_done ), dvb );
+		g_signal_connect ( dvb->dvbsrc, "tuning-fail", G_CALLBACK ( dvb_tuning_fail ), dvb );
+	}
 
-				char *name = gst_object_get_name ( GST_OBJECT ( pad_src ) );
+	dvb_src_probes ( dvb->dvbsrc, dvb );
+	recorder_set_source ( dvb->playdvb, dvb->tee, dvb->recorder );
 
-				if ( g_str_has_prefix ( name, "audio" ) )
-				{
-					if ( gst_pad_is_linked ( pad_src ) ) num = i;
+	g_object_set ( dvb->volume, "volume", value, NULL );
 
-					dvb_combo_append_text ( combo, name, i );
-					i++;
-				}
+	dvb_zap_latency ( dvbset, dvb );
 
-				free ( name );
-				g_value_reset (&item);
+	dvb_ahead_output ( dvb->volume, FALSE );
+	if ( dvb->checked_video ) dvb_ahead_output ( dvb->videoblnc, FALSE );
 
-				break;
-			}
+	if ( dvb->checked_video ) g_signal_emit_by_name ( dvb, "power-set", TRUE );
 
-			case GST_ITERATOR_RESYNC:
-				gst_iterator_resync (it);
-				break;
+	if ( dvb->debug ) g_message ( "%s: %s ", __func__, channel->name );
 
-			case GST_ITERATOR_ERROR:
-				done = TRUE;
-				break;
+	dvb_ahead_schedule ( dvb );
+
+	return TRUE;
+}
+
+/* Zap to a channel of the list, its row is selected */
+static void dvb_zap_channel ( const Channel *channel, Dvb *dvb )
+{
+	if ( !channel || channel->index < 0 ) return;
+
+	dvb_stop_set_play ( channel->data, dvb );
+
+	GtkTreePath *path = gtk_tree_path_new_from_indices ( channel->index, -1 );
+
+	gtk_tree_selection_select_path ( gtk_tree_view_get_selection ( dvb->treeview ), path );
+	gtk_tree_view_scroll_to_cell ( dvb->treeview, path, NULL, FALSE, 0, 0 );
+
+	gtk_tree_path_free ( path );
+}
+
+void dvb_start_channel ( const char *ch, Dvb *dvb )
+{
+	dvb_channel_db_sync ( dvb );
+
+	Channel *channel = ( ch ) ? channel_db_find_name ( ch, dvb->db ) : NULL;
+
+	dvb_zap_channel ( ( channel ) ? channel : channel_db_nth ( 0, dvb->db ), dvb );
+}
+
+/* Channel up / down of the list */
+static void dvb_zap_step ( int step, Dvb *dvb )
+{
+	dvb->zap_dir = step;
+
+	dvb_channel_db_sync ( dvb );
+
+	dvb_zap_channel ( channel_db_step ( dvb_channel_get ( dvb->data, dvb ), step, dvb->db ), dvb );
+}
+
+/* Typed number: the LCN, otherwise the number of the list */
+static gboolean dvb_zap_number ( Dvb *dvb )
+{
+	uint num = (uint)atoi ( dvb->digits );
+
+	dvb->digits[0] = '\0';
+	dvb->digits_src = 0;
+
+	dvb_channel_db_sync ( dvb );
+
+	Channel *channel = channel_db_find_lcn ( (uint16_t)num, dvb->db );
+
+	if ( !channel && num > 0 ) channel = channel_db_nth ( num - 1, dvb->db );
+
+	if ( dvb->debug ) g_message ( "%s: number %u | %s ", __func__, num, ( channel ) ? channel->name : "none" );
+
+	dvb_zap_channel ( channel, dvb );
+
+	return FALSE;
+}
+
+static void dvb_zap_digit ( char digit, Dvb *dvb )
+{
+	size_t len = strlen ( dvb->digits );
+
+	if ( len == sizeof ( dvb->digits ) - 1 ) return;
+
+	dvb->digits[len] = digit;
+	dvb->digits[len + 1] = '\0';
+
+	if ( dvb->digits_src ) g_source_remove ( dvb->digits_src );
+
+	dvb->digits_src = g_timeout_add ( 1500, (GSourceFunc)dvb_zap_number, dvb );
+}
+
+/* Digits: numeric zapping ( Enter or a pause of 1.5 s ); Page Up / Page Down: channel up / down */
+static gboolean dvb_video_key_press_event ( G_GNUC_UNUSED GtkDrawingArea *draw, GdkEventKey *event, Dvb *dvb )
+{
+	uint keyval = event->keyval;
+
+	if ( keyval >= GDK_KEY_0    && keyval <= GDK_KEY_9    ) { dvb_zap_digit ( (char)( '0' + keyval - GDK_KEY_0    ), dvb ); return GDK_EVENT_STOP; }
+	if ( keyval >= GDK_KEY_KP_0 && keyval <= GDK_KEY_KP_9 ) { dvb_zap_digit ( (char)( '0' + keyval - GDK_KEY_KP_0 ), dvb ); return GDK_EVENT_STOP; }
 
-			case GST_ITERATOR_DONE:
-				done = TRUE;
-				break;
-		}
+	if ( ( keyval == GDK_KEY_Return || keyval == GDK_KEY_KP_Enter ) && dvb->digits_src )
+	{
+		g_source_remove ( dvb->digits_src );
+		dvb_zap_number ( dvb );
+
+		return GDK_EVENT_STOP;
 	}
 
-	g_value_unset ( &item );
-	gst_iterator_free ( it );
+	if ( keyval == GDK_KEY_Page_Up   ) { dvb_zap_step (  1, dvb ); return GDK_EVENT_STOP; }
+	if ( keyval == GDK_KEY_Page_Down ) { dvb_zap_step ( -1, dvb ); return GDK_EVENT_STOP; }
 
-	return num;
+	return GDK_EVENT_PROPAGATE;
 }
 
-static void dvb_change_audio_track ( GstElement *e_unlink, GstElement *e_link, uint8_t num )
+static gboolean dvb_record_start ( const char *data, Recorder *recorder, Dvb *dvb )
 {
-	GstIterator *it = gst_element_iterate_src_pads ( e_unlink );
-	GValue item = { 0, };
+	const Channel *channel = dvb_channel_get ( data, dvb );
 
-	uint8_t i = 0;
-	gboolean done = FALSE;
+	if ( !channel ) return FALSE;
 
-	GstPad *pad_link = NULL;
-	GstPad *pad_sink = gst_element_get_static_pad ( e_link, "sink" );
+	GSettings *setting = settings_init ();
+	dvb->rec_passthrough = ( setting ) ? g_settings_get_boolean ( setting, "rec-passthrough" ) : TRUE;
+	if ( setting ) g_object_unref ( setting );
 
-	while ( !done )
-	{
-		switch ( gst_iterator_next ( it, &item ) )
-		{
-			case GST_ITERATOR_OK:
-			{
-				GstPad *pad_src = GST_PAD ( g_value_get_object (&item) );
+	g_autofree char *path = dvb_rec_get_path ( channel );
 
-				char *name = gst_object_get_name ( GST_OBJECT ( pad_src ) );
+	gboolean ret = recorder_start ( channel->sid, channel->name, channel->video, dvb->rec_passthrough, path, 0, recorder );
 
-				if ( g_str_has_prefix ( name, "audio" ) )
-				{
-					if ( gst_pad_is_linked ( pad_src ) )
-					{
-						if ( gst_pad_unlink ( pad_src, pad_sink ) )
-							g_debug ( "%s: unlink Ok ", __func__ );
-						else
-							g_warning ( "%s: unlink Failed ", __func__ );
-					}
-					else
-						if ( i == num ) pad_link = pad_src;
+	if ( dvb->debug ) g_message ( "%s: record %s | %s ", __func__, ( ret ) ? "start" : "failed", path );
 
-					i++;
-				}
+	return ret;
+}
 
-				free ( name );
-				g_value_reset (&item);
+/* Start / stop the recording of a service of the current multiplex; the live view is not touched */
+static void dvb_record_data ( const char *data, Dvb *dvb )
+{
+	const Channel *channel = dvb_channel_get ( data, dvb );
 
-				break;
-			}
+	if ( !channel ) return;
 
-			case GST_ITERATOR_RESYNC:
-				gst_iterator_resync (it);
-				break;
+	uint16_t sid = channel->sid;
 
-			case GST_ITERATOR_ERROR:
-				done = TRUE;
-				break;
+	if ( recorder_is_active ( sid, dvb->recorder ) )
+		recorder_stop ( sid, dvb->recorder );
+	else
+		dvb_record_start ( data, dvb->recorder, dvb );
 
-			case GST_ITERATOR_DONE:
-				done = TRUE;
-				break;
-		}
+	if ( dvb->debug )
+	{
+		g_autofree char *info = recorder_get_info ( dvb->recorder );
+		g_message ( "%s: recordings %u \n%s", __func__, recorder_count ( dvb->recorder ), info );
 	}
+}
 
-	if ( gst_pad_link ( pad_link, pad_sink ) == GST_PAD_LINK_OK )
-		g_debug ( "%s: link Ok ", __func__ );
-	else
-		g_warning ( "%s: link Failed ", __func__ );
+static void dvb_record ( Dvb *dvb )
+{
+	dvb_record_data ( dvb->data, dvb );
+}
 
-	gst_object_unref ( pad_sink );
+static void dvb_timer_track_remove ( uint16_t sid, GPtrArray *timers, Dvb *dvb )
+{
+	uint i = timers->len; for ( ; i > 0; i-- )
+	{
+		const Channel *channel = dvb_channel_get ( g_ptr_array_index ( timers, i - 1 ), dvb );
 
-	g_value_unset ( &item );
-	gst_iterator_free ( it );
+		if ( !channel || channel->sid == sid ) g_ptr_array_remove_index ( timers, i - 1 );
+	}
 }
 
-static void dvb_combo_lang_changed ( GtkComboBox *combo, Dvb *dvb )
+/* The recordings are lost: their timers fail */
+static void dvb_timer_failed ( GPtrArray *timers, Dvb *dvb )
 {
-	int num = gtk_combo_box_get_active ( GTK_COMBO_BOX ( combo ) );
+	uint i = 0; for ( i = 0; i < timers->len; i++ )
+	{
+		const Channel *channel = dvb_channel_get ( g_ptr_array_index ( timers, i ), dvb );
 
-	GstElement *e_link = dvb_iterate_element ( dvb->playdvb, "queue-tee-audio", NULL );
+		if ( channel ) timer_list_set_failed ( channel->onid, channel->tsid, channel->sid, dvb->timers );
+	}
 
-	if ( e_link ) dvb_change_audio_track ( dvb->demux, e_link, (uint8_t)num );
+	g_ptr_array_set_size ( timers, 0 );
 }
 
-static void dvb_run_info ( Dvb *dvb )
+/* Timer recordings of another multiplex: dvbsrc → tee on a free tuner, without the live view */
+static void dvb_timer_bg_stop ( Dvb *dvb )
 {
-	GtkWindow *window = GTK_WINDOW ( gtk_widget_get_toplevel ( GTK_WIDGET ( dvb->video ) ) );
+	if ( !dvb->bgdvb ) return;
 
-	GtkComboBoxText *combo_lang = helia_info_dvb ( dvb->data, window, dvb->dvbsrc );
+	GstBus *bus = gst_element_get_bus ( dvb->bgdvb );
+	gst_bus_remove_signal_watch ( bus );
+	gst_object_unref ( bus );
 
-	if ( combo_lang )
-	{
-		uint8_t num = dvb_add_audio_track ( combo_lang, dvb->demux );
+	gst_element_set_state ( dvb->bgdvb, GST_STATE_NULL );
+	gst_object_unref ( dvb->bgdvb );
 
-		gtk_combo_box_set_active ( GTK_COMBO_BOX ( combo_lang ), num );
-		g_signal_connect ( combo_lang, "changed", G_CALLBACK ( dvb_combo_lang_changed ), dvb );
-	}
+	recorder_set_source ( NULL, NULL, dvb->bgrec );
+	tuner_pool_release ( dvb->bgtuner, tuner_pool_get_default () );
+
+	free ( dvb->bgdata );
+	g_ptr_array_set_size ( dvb->timer_bg, 0 );
+
+	dvb->bgdvb   = NULL;
+	dvb->bgdata  = NULL;
+	dvb->bgtuner = -1;
 }
 
-static void dvb_set_tuning_timeout ( GstElement *element )
+static gboolean dvb_timer_bg_check ( Dvb *dvb )
 {
-	guint64 timeout = 0;
-	g_object_get ( element, "tuning-timeout", &timeout, NULL );
-	g_object_set ( element, "tuning-timeout", (guint64)timeout / 4, NULL );
+	if ( recorder_count ( dvb->bgrec ) == 0 ) dvb_timer_bg_stop ( dvb );
+
+	return FALSE;
 }
 
-static void dvb_rinit ( GstElement *element )
+static void dvb_timer_msg_err ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Dvb *dvb )
 {
-	int adapter = 0, frontend = 0;
-	g_object_get ( element, "adapter",  &adapter,  NULL );
-	g_object_get ( element, "frontend", &frontend, NULL );
+	GError *err = NULL;
+	char   *dbg = NULL;
 
-	helia_dvb_init ( adapter, frontend );
+	gst_message_parse_error ( msg, &err, &dbg );
+
+	g_critical ( "%s: %s (%s)", __func__, err->message, (dbg) ? dbg : "no details" );
+
+	g_error_free ( err );
+	g_free ( dbg );
+
+	dvb_timer_failed ( dvb->timer_bg, dvb );
+	dvb_timer_bg_stop ( dvb );
 }
 
-static void dvb_data_set ( const char *data, GstElement *element, GstElement *demux, Dvb *dvb )
+static gboolean dvb_timer_bg_start ( const char *data, Dvb *dvb )
 {
-	dvb_set_tuning_timeout ( element );
+	const Channel *channel = dvb_channel_get ( data, dvb );
+
+	if ( !channel || !dvb_tuner_acquire ( channel, TRUE, &dvb->bgtuner ) ) return FALSE;
 
-	char **fields = g_strsplit ( data, ":", 0 );
-	uint j = 0, numfields = g_strv_length ( fields );
+	GstElement *pipeline = gst_pipeline_new ( "pipeline-timer" );
+	GstElement *dvbsrc = gst_element_factory_make ( ( dvb->ts_file ) ? "filesrc" : "dvbsrc", NULL );
+	GstElement *tee    = gst_element_factory_make ( "tee", NULL );
 
-	for ( j = 1; j < numfields; j++ )
+	if ( !pipeline || !dvbsrc || !tee )
 	{
-		if ( g_strrstr ( fields[j], "audio-pid" ) || g_strrstr ( fields[j], "video-pid" ) ) continue;
+		g_critical ( "%s:: element (factory make) - dvbsrc / tee not created. \n", __func__ );
 
-		if ( !g_strrstr ( fields[j], "=" ) ) continue;
+		if ( dvbsrc ) gst_object_unref ( dvbsrc );
+		if ( tee ) gst_object_unref ( tee );
+		if ( pipeline ) gst_object_unref ( pipeline );
 
-		char **splits = g_strsplit ( fields[j], "=", 0 );
+		tuner_pool_release ( dvb->bgtuner, tuner_pool_get_default () );
+		dvb->bgtuner = -1;
 
-		if ( dvb->debug ) g_message ( "%s: gst-param %s | gst-value %s ", __func__, splits[0], splits[1] );
+		return FALSE;
+	}
 
-		if ( g_strrstr ( splits[0], "polarity" ) )
-		{
-			if ( splits[1][0] == 'v' || splits[1][0] == 'V' || splits[1][0] == '0' )
-				g_object_set ( element, "polarity", "V", NULL );
-			else
-				g_object_set ( element, "polarity", "H", NULL );
+	gst_bin_add_many ( GST_BIN ( pipeline ), dvbsrc, tee, NULL );
+	gst_element_link ( dvbsrc, tee );
 
-			g_strfreev (splits);
+	g_object_set ( tee, "allow-not-linked", TRUE, NULL );
 
-			continue;
-		}
+	if ( dvb->ts_file ) g_object_set ( dvbsrc, "location", dvb->ts_file, NULL );
 
-		long dat = atol ( splits[1] );
+	dvb_data_set ( channel, dvbsrc, NULL, dvb );
+	dvb_tuner_set ( dvbsrc, dvb->bgtuner, dvb );
 
-		if ( g_strrstr ( splits[0], "program-number" ) )
-		{
-			dvb->sid = (uint16_t)dat;
-			g_object_set ( demux, "program-number", dat, NULL );
-		}
-		else if ( g_strrstr ( splits[0], "symbol-rate" ) )
-		{
-			g_object_set ( element, "symbol-rate", ( dat > 100000) ? dat / 1000 : dat, NULL );
-		}
-		else if ( g_strrstr ( splits[0], "lnb-type" ) )
-		{
-			set_lnb_lhs ( element, (int)dat );
-		}
-		else
-		{
-			g_object_set ( element, splits[0], dat, NULL );
-		}
+	GstPad *pad = gst_element_get_static_pad ( dvbsrc, "src" );
+	dvb_src_batch ( pad, dvb );
+	gst_object_unref ( pad );
 
-		g_strfreev (splits);
-	}
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	gst_bus_add_signal_watch_full ( bus, G_PRIORITY_DEFAULT );
+	g_signal_connect ( bus, "message::error", G_CALLBACK ( dvb_timer_msg_err ), dvb );
+	gst_object_unref ( bus );
+
+	dvb->bgdvb  = pipeline;
+	dvb->bgdata = g_strdup ( data );
+
+	recorder_set_source ( pipeline, tee, dvb->bgrec );
 
-	g_strfreev (fields);
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
 
-	dvb_rinit ( element );
+	return TRUE;
 }
 
-static gboolean dvb_checked_video ( const char *data )
+/* The live view leaves the multiplex ( zap, stop ): its timer recordings go on in the timer pipeline on a free tuner ( in a new file ).
+ * Returns FALSE if they can't: no free tuner or the timer pipeline is on another multiplex */
+static gboolean dvb_timer_live_move ( Dvb *dvb )
 {
-	gboolean video_enable = TRUE;
+	GPtrArray *live = dvb->timer_live;
 
-	if ( !g_strrstr ( data, "video-pid" ) || g_strrstr ( data, "video-pid=0" ) ) video_enable = FALSE;
+	/* Stopped by hand */
+	uint i = live->len; for ( ; i > 0; i-- )
+	{
+		const Channel *channel = dvb_channel_get ( g_ptr_array_index ( live, i - 1 ), dvb );
 
-	return video_enable;
-}
+		if ( !channel || !recorder_is_active ( channel->sid, dvb->recorder ) ) g_ptr_array_remove_index ( live, i - 1 );
+	}
 
-static void dvb_stop_set_play ( const char *data, Dvb *dvb )
-{
-	free ( dvb->data );
-	dvb->data = g_strdup ( data );
+	if ( live->len == 0 ) return TRUE;
 
-	double value = VOLUME;
-	if ( dvb->volume ) g_object_get ( dvb->volume, "volume", &value, NULL );
+	const char *first = g_ptr_array_index ( live, 0 );
 
-	dvb->rec_tv = FALSE;
-	dvb_set_stop ( dvb );
+	if ( dvb->bgdvb && !dvb_data_same_mux ( dvb->bgdata, first, dvb ) ) return FALSE;
 
-	dvb_remove_bin ( dvb->playdvb, NULL );
+	if ( !dvb->bgdvb && !dvb_timer_bg_start ( first, dvb ) ) return FALSE;
 
-	dvb->checked_video = dvb_checked_video ( data );
+	for ( i = 0; i < live->len; i++ )
+	{
+		const char *data = g_ptr_array_index ( live, i );
+		const Channel *channel = dvb_channel_get ( data, dvb );
 
-	DvbSet dvbset;
-	dvbset = dvb_create_bin ( dvb->playdvb, dvb->checked_video );
+		recorder_stop ( channel->sid, dvb->recorder );
 
-	dvb->dvbsrc = dvbset.dvbsrc;
-	dvb->demux  = dvbset.demux;
-	dvb->equalizer = dvbset.equalizer;
-	dvb->videoblnc = dvbset.videoblnc;
+		if ( dvb_record_start ( data, dvb->bgrec, dvb ) )
+			g_ptr_array_add ( dvb->timer_bg, g_strdup ( data ) );
+		else
+			timer_list_set_failed ( channel->onid, channel->tsid, channel->sid, dvb->timers );
+	}
 
-	dvb->volume = dvbset.volume;
-	dvb_data_set ( data, dvbset.dvbsrc, dvbset.demux, dvb );
+	g_ptr_array_set_size ( live, 0 );
 
-	g_object_set ( dvb->volume, "volume", value, NULL );
+	if ( recorder_count ( dvb->bgrec ) == 0 ) dvb_timer_bg_stop ( dvb );
 
-	gst_element_set_state ( dvb->playdvb, GST_STATE_PLAYING );
+	if ( dvb->debug ) g_message ( "%s: timer recordings %u → timer pipeline ", __func__, recorder_count ( dvb->bgrec ) );
+
+	return TRUE;
 }
 
-static gboolean dvb_search_channel ( const char *channel, GtkTreeModel *model, Dvb *dvb )
+/* Recorder of the multiplex: the live tee, the running timer pipeline or a new one on a free tuner */
+static Recorder * dvb_timer_recorder ( const char *data, Dvb *dvb )
 {
-	GtkTreeIter iter;
-	gboolean valid, break_f = FALSE;
+	GstElement *live = ( dvb->timeshift ) ? dvb->capdvb : dvb->playdvb;
+
+	if ( dvb->tee && GST_ELEMENT_CAST ( live )->current_state == GST_STATE_PLAYING && dvb_data_same_mux ( dvb->data, data, dvb ) ) return dvb->recorder;
+
+	if ( dvb->bgdvb ) return ( dvb_data_same_mux ( dvb->bgdata, data, dvb ) ) ? dvb->bgrec : NULL;
+
+	return ( dvb_timer_bg_start ( data, dvb ) ) ? dvb->bgrec : NULL;
+}
 
-	for ( valid = gtk_tree_model_get_iter_first ( model, &iter ); valid;
-		valid = gtk_tree_model_iter_next ( model, &iter ) )
+static gboolean dvb_timer_func ( const Timer *timer, gboolean start, Dvb *dvb )
+{
+	if ( !start )
 	{
-		char *data = NULL;
-		gtk_tree_model_get ( model, &iter, COL_DATA, &data, -1 );
+		recorder_stop ( timer->sid, dvb->recorder );
+		recorder_stop ( timer->sid, dvb->bgrec );
 
-		if ( g_str_has_prefix ( data, channel ) )
-		{
-			break_f = TRUE;
-			dvb_stop_set_play ( data, dvb );
-			gtk_tree_selection_select_iter ( gtk_tree_view_get_selection ( dvb->treeview ), &iter );
-		}
+		dvb_timer_track_remove ( timer->sid, dvb->timer_live, dvb );
+		dvb_timer_track_remove ( timer->sid, dvb->timer_bg,   dvb );
+
+		if ( dvb->bgdvb && recorder_count ( dvb->bgrec ) == 0 ) g_timeout_add_seconds ( 3, (GSourceFunc)dvb_timer_bg_check, dvb );
 
-		free ( data );
-		if ( break_f ) break;
+		return TRUE;
 	}
 
-	return break_f;
+	Recorder *recorder = dvb_timer_recorder ( timer->data, dvb );
+
+	if ( !recorder ) return FALSE;
+
+	if ( recorder_is_active ( timer->sid, recorder ) ) return TRUE;
+
+	gboolean ret = dvb_record_start ( timer->data, recorder, dvb );
+
+	if ( ret ) g_ptr_array_add ( ( recorder == dvb->bgrec ) ? dvb->timer_bg : dvb->timer_live, g_strdup ( timer->data ) );
+
+	if ( !ret && recorder == dvb->bgrec && recorder_count ( dvb->bgrec ) == 0 ) dvb_timer_bg_stop ( dvb );
+
+	return ret;
 }
 
-void dvb_start_channel ( const char *ch, Dvb *dvb )
+/* Timer for the next EPG event of the channel */
+static void dvb_timer_add_next ( const char *data, Dvb *dvb )
 {
-	GtkTreeIter iter;
-	GtkTreeModel *model = gtk_tree_view_get_model ( dvb->treeview );
+	const Channel *channel = dvb_channel_get ( data, dvb );
 
-	int indx = gtk_tree_model_iter_n_children ( model, NULL );
-	if ( indx == 0 ) return;
+	if ( !channel ) return;
 
-	if ( ch )
-	{
-		if ( dvb_search_channel ( ch, model, dvb ) ) return;
-	}
+	uint16_t sid = channel->sid;
 
-	if ( gtk_tree_model_get_iter_first ( model, &iter ) )
-	{
-		g_autofree char *data = NULL;
-		gtk_tree_model_get ( model, &iter, COL_DATA, &data, -1 );
+	const EpgEvent *event = epg_get_next ( channel->onid, channel->tsid, sid, timer_list_now ( dvb->timers ), dvb->epg );
 
-		dvb_stop_set_play ( data, dvb );
-		gtk_tree_selection_select_iter ( gtk_tree_view_get_selection ( dvb->treeview ), &iter );
-	}
+	if ( !event ) { dvb_message_dialog ( "", "No EPG event.", GTK_MESSAGE_WARNING, dvb ); return; }
+
+	GSettings *setting = settings_init ();
+	uint pad_before = ( setting ) ? g_settings_get_uint ( setting, "timer-pad-before" ) : 2;
+	uint pad_after  = ( setting ) ? g_settings_get_uint ( setting, "timer-pad-after"  ) : 5;
+	if ( setting ) g_object_unref ( setting );
+
+	timer_list_add ( data, sid, event->event_id, event->start, event->start + (time_t)event->duration, pad_before * 60, pad_after * 60, dvb->timers );
+
+	GDateTime *dt = g_date_time_new_from_unix_local ( (gint64)event->start );
+	g_autofree char *str_time = g_date_time_format ( dt, "%a %d %b  %H:%M" );
+	g_autofree char *info = g_strdup_printf ( "%s\n%s", str_time, event->title );
+	g_date_time_unref ( dt );
+
+	dvb_message_dialog ( "Timer", info, GTK_MESSAGE_INFO, dvb );
 }
 
-static void dvb_record ( Dvb *dvb )
+/* Posting thread ( dvbsrc ): the frontend stats go to the history ring without blocking; the spare tuner is not the live one */
+static void dvb_sig_push ( GstMessage *message, Dvb *dvb )
 {
-	if ( dvb->rec_tv )
-	{
-		dvb->rec_tv = FALSE;
-		dvb_set_stop ( dvb );
-	}
-	else
-	{
-		GstPad *blockpad = gst_element_get_static_pad ( dvb->dvbsrc, "src" );
+	if ( dvb->quit || !gst_message_has_name ( message, "dvb-frontend-stats" ) ) return;
 
-		gst_pad_add_probe ( blockpad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, dvb_blockpad_probe, dvb, NULL );
+	if ( dvb->ahead && gst_object_has_as_ancestor ( GST_MESSAGE_SRC ( message ), GST_OBJECT ( dvb->ahead ) ) ) return;
 
-		gst_object_unref ( blockpad );
-		dvb->rec_tv = TRUE;
-	}
+	const GstStructure *structure = gst_message_get_structure ( message );
+
+	int signal = 0, snr = 0, ber = 0;
+	gboolean lock = FALSE;
+
+	if ( !gst_structure_get_int ( structure, "signal", &signal ) ) return;
+
+	gst_structure_get_int     ( structure, "snr",  &snr  );
+	gst_structure_get_int     ( structure, "ber",  &ber  );
+	gst_structure_get_boolean ( structure, "lock", &lock );
+
+	sig_history_push ( signal, snr, lock, ber, dvb->sighist );
 }
 
 static GstBusSyncReply dvb_sync_handler ( G_GNUC_UNUSED GstBus *bus, GstMessage *message, Dvb *dvb )
 {
+	if ( GST_MESSAGE_TYPE ( message ) == GST_MESSAGE_ELEMENT ) { dvb_decode_pmt ( message ); dvb_sig_push ( message, dvb ); }
+
 	if ( !gst_is_video_overlay_prepare_window_handle_message ( message ) ) return GST_BUS_PASS;
 
+	/* The window of the live view is not handed to the ahead pipeline ( its sink asks only after the swap ) */
+	if ( dvb->ahead && gst_object_has_as_ancestor ( GST_MESSAGE_SRC ( message ), GST_OBJECT ( dvb->ahead ) ) )
+	{
+		g_warning ( "%s: window handle asked by the ahead pipeline. ", __func__ );
+
+		gst_message_unref ( message );
+
+		return GST_BUS_DROP;
+	}
+
 	if ( dvb->xid != 0 )
 	{
 		GstVideoOverlay *xoverlay = GST_VIDEO_OVERLAY ( GST_MESSAGE_SRC ( message ) );
@@ -1271,6 +2785,8 @@ static void dvb_msg_cng ( G_GNUC_UNUSED GstBus *bus, G_GNUC_UNUSED GstMessage *m
 
 		case GST_STATE_PLAYING:
 		{
+			dvb_level_tick_start ( dvb );
+
 			if ( dvb->checked_video ) g_signal_emit_by_name ( dvb, "power-set", TRUE );
 			break;
 		}
@@ -1280,28 +2796,48 @@ static void dvb_msg_cng ( G_GNUC_UNUSED GstBus *bus, G_GNUC_UNUSED GstMessage *m
 	}
 }
 
-static void dvb_msg_all ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Dvb *dvb )
+static void dvb_psi_sections ( GPtrArray *sections, Dvb *dvb )
 {
 	if ( dvb->quit ) return;
 
-	const GstStructure *structure = gst_message_get_structure ( msg );
+	uint i = 0; for ( i = 0; i < sections->len; i++ ) mpegts_add_eit ( g_ptr_array_index ( sections, i ), dvb->epg );
+}
 
-	if ( structure )
-	{
-		int signal = 0, snr = 0;
-		gboolean lock = FALSE;
+/* Frame clock: the history ring is drained into the aggregates of the channel, the level shows the latest sample */
+static gboolean dvb_level_tick ( G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED GdkFrameClock *clock, Dvb *dvb )
+{
+	GstElement *pipeline = ( dvb->timeshift ) ? dvb->capdvb : dvb->playdvb;
 
-		if (  gst_structure_get_int ( structure, "signal", &signal )  )
-		{
-			gst_structure_get_int     ( structure, "snr",  &snr  );
-			gst_structure_get_boolean ( structure, "lock", &lock );
+	const Channel *channel = ( dvb->data && GST_STATE_TARGET ( pipeline ) == GST_STATE_PLAYING ) ? dvb_channel_get ( dvb->data, dvb ) : NULL;
 
-			uint8_t ret_sgl = (uint8_t)(signal*100/0xffff);
-			uint8_t ret_snr = (uint8_t)(snr*100/0xffff);
+	sig_history_set_channel ( ( channel ) ? channel->name : NULL, dvb->sighist );
 
-			level_set_sgn_snr ( ret_sgl, ret_snr, lock, dvb->rec_tv, dvb->level );
-		}
-	}
+	uint8_t sgl = 0, snr = 0;
+	gboolean lock = FALSE;
+
+	if ( sig_history_update ( &sgl, &snr, &lock, dvb->sighist ) )
+		level_set_sgn_snr ( sgl, snr, lock, ( recorder_count ( dvb->recorder ) + recorder_count ( dvb->bgrec ) > 0 ), dvb->level );
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* The tick runs while the live pipeline plays: from PLAYING ( dvb_msg_cng ) to dvb_set_stop */
+static void dvb_level_tick_start ( Dvb *dvb )
+{
+	if ( dvb->tick_id ) return;
+
+	dvb->tick_id = gtk_widget_add_tick_callback ( GTK_WIDGET ( dvb ), (GtkTickCallback)dvb_level_tick, dvb, NULL );
+}
+
+static void dvb_level_tick_stop ( Dvb *dvb )
+{
+	if ( !dvb->tick_id ) return;
+
+	gtk_widget_remove_tick_callback ( GTK_WIDGET ( dvb ), dvb->tick_id );
+	dvb->tick_id = 0;
+
+	/* The last samples; the pipeline is stopped: the channel is closed in the history */
+	dvb_level_tick ( NULL, NULL, dvb );
 }
 
 static void dvb_msg_err ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Dvb *dvb )
@@ -1313,6 +2849,16 @@ static void dvb_msg_err ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Dvb *dvb )
 
 	g_critical ( "%s: %s (%s)", __func__, err->message, (dbg) ? dbg : "no details" );
 
+	/* Zap-ahead: the spare channel is dropped silently */
+	if ( dvb->ahead && gst_object_has_as_ancestor ( GST_MESSAGE_SRC ( msg ), GST_OBJECT ( dvb->ahead ) ) )
+	{
+		g_error_free ( err );
+		g_free ( dbg );
+
+		dvb_ahead_stop ( dvb );
+		return;
+	}
+
 	dvb_message_dialog ( "", err->message, GTK_MESSAGE_ERROR, dvb );
 
 	g_error_free ( err );
@@ -1341,9 +2887,9 @@ static void dvb_enc_create_elements ( Dvb *dvb )
 	if ( setting ) g_object_unref ( setting );
 }
 
-static GstElement * dvb_create ( Dvb *dvb )
+static GstElement * dvb_create_pipeline ( const char *name, Dvb *dvb )
 {
-	GstElement *dvbplay = gst_pipeline_new ( "pipeline" );
+	GstElement *dvbplay = gst_pipeline_new ( name );
 
 	if ( !dvbplay )
 	{
@@ -1356,18 +2902,54 @@ static GstElement * dvb_create ( Dvb *dvb )
 	gst_bus_add_signal_watch_full ( bus, G_PRIORITY_DEFAULT );
 	gst_bus_set_sync_handler ( bus, (GstBusSyncHandler)dvb_sync_handler, dvb, NULL );
 
-	g_signal_connect ( bus, "message",        G_CALLBACK ( dvb_msg_all ), dvb );
 	g_signal_connect ( bus, "message::error", G_CALLBACK ( dvb_msg_err ), dvb );
 	g_signal_connect ( bus, "message::state-changed", G_CALLBACK ( dvb_msg_cng ), dvb );
 
 	gst_object_unref (bus);
 
+	return dvbplay;
+}
+
+static GstElement * dvb_create ( Dvb *dvb )
+{
+	GstElement *dvbplay = dvb_create_pipeline ( "pipeline", dvb );
+
 	dvb_enc_create_elements ( dvb );
 
 	return dvbplay;
 }
 
 
+/* Timeshift: dvbsrc and the record branches; the play pipeline reads the ring */
+static GstElement * dvb_create_capture ( Dvb *dvb )
+{
+	GSettings *setting = settings_init ();
+	uint size = ( setting ) ? g_settings_get_uint ( setting, "timeshift-size" ) : 0;
+	if ( setting ) g_object_unref ( setting );
+
+	if ( size == 0 ) return NULL;
+
+	g_autofree char *path = timeshift_get_path ( "timeshift-dvb.ts" );
+
+	dvb->timeshift = timeshift_new ( path, (guint64)size * 1024 * 1024 );
+
+	if ( !dvb->timeshift ) return NULL;
+
+	GstElement *capdvb = gst_pipeline_new ( "pipeline-capture" );
+
+	GstBus *bus = gst_element_get_bus ( capdvb );
+
+	gst_bus_add_signal_watch_full ( bus, G_PRIORITY_DEFAULT );
+	gst_bus_set_sync_handler ( bus, (GstBusSyncHandler)dvb_sync_handler, dvb, NULL );
+
+	g_signal_connect ( bus, "message::error", G_CALLBACK ( dvb_msg_err ), dvb );
+
+	gst_object_unref (bus);
+
+	if ( dvb->debug ) g_message ( "%s: timeshift %u MB | %s ", __func__, size, path );
+
+	return capdvb;
+}
 
 static void dvb_show_cursor ( GtkDrawingArea *draw, gboolean show_cursor )
 {
@@ -1413,6 +2995,41 @@ static gboolean dvb_video_hide_cursor ( Dvb *dvb )
 
 
 
+/* The channel list: from the binary cache while gtv-channel.conf is unchanged, otherwise parsed ( and cached ) */
+static void dvb_load_channels ( Dvb *dvb )
+{
+	char path[PATH_MAX], cache[PATH_MAX];
+	sprintf ( path,  "%s/helia/gtv-channel.conf",  g_get_user_config_dir () );
+	sprintf ( cache, "%s/helia/gtv-channel.cache", g_get_user_config_dir () );
+
+	if ( !g_file_test ( path, G_FILE_TEST_EXISTS ) ) return;
+
+	gint64 time = g_get_monotonic_time ();
+
+	gboolean cached = channel_db_load ( cache, path, dvb->db );
+
+	if ( cached )
+	{
+		uint i = 0, n = channel_db_count ( dvb->db );
+		for ( i = 0; i < n; i++ ) dvb_treeview_append_row ( channel_db_nth ( i, dvb->db ), dvb );
+	}
+	else
+	{
+		dvb_treeview_add_channels ( path, dvb );
+		channel_db_save ( cache, path, dvb->db );
+	}
+
+	if ( dvb->debug ) g_message ( "%s: %u channels ( %s ) %ld us ", __func__, channel_db_count ( dvb->db ), ( cached ) ? "cache" : "conf", (long)( g_get_monotonic_time () - time ) );
+}
+
+static DecodeCache * dvb_decode_cache_new ( void )
+{
+	char path[PATH_MAX];
+	sprintf ( path, "%s/helia/decode.cache", g_get_user_config_dir () );
+
+	return decode_cache_new ( path );
+}
+
 static void dvb_init ( Dvb *dvb )
 {
 	dvb->enc_video = NULL;
@@ -1422,7 +3039,38 @@ static void dvb_init ( Dvb *dvb )
 	dvb->run  = FALSE;
 	dvb->quit = FALSE;
 	dvb->data = NULL;
+	dvb->dvbsrc = NULL;
+	dvb->tee = NULL;
+	dvb->feed = NULL;
+	dvb->tuner = -1;
+	dvb->zap_lock = 0;
+	dvb->zap_warm = FALSE;
+	dvb->timeshift = NULL;
 	dvb->volume = NULL;
+	dvb->epg = epg_new ();
+	dvb->psi = psi_new ( FALSE, FALSE, (PsiFunc)dvb_psi_sections, dvb );
+	psi_add_pid ( 0x12, dvb->psi );
+	dvb->analyzer = analyzer_new ();
+	dvb->recorder = recorder_new ( "dvbsrc-rec" );
+	dvb->bgrec = recorder_new ( "dvbsrc-timer-rec" );
+	dvb->bgdvb = NULL;
+	dvb->bgdata = NULL;
+	dvb->bgtuner = -1;
+	dvb->timer_live = g_ptr_array_new_with_free_func ( g_free );
+	dvb->timer_bg   = g_ptr_array_new_with_free_func ( g_free );
+	dvb->db = channel_db_new ();
+	dvb->decode = dvb_decode_cache_new ();
+	dvb->sighist = sig_history_new ();
+	dvb->db_dirty = FALSE;
+	dvb->digits[0] = '\0';
+	dvb->digits_src = 0;
+	dvb->ahead_src = NULL;
+	dvb->ahead_tee = NULL;
+	dvb->ahead_data = NULL;
+	dvb->ahead_tuner = -1;
+	dvb->ahead_src_id = 0;
+	dvb->zap_dir = 1;
+	dvb->ts_file = g_strdup ( g_getenv ( "DVB_TS_FILE" ) );
 	dvb->opacity = OPACITY;
 	dvb->debug = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
 
@@ -1430,18 +3078,39 @@ static void dvb_init ( Dvb *dvb )
 	gtk_orientable_set_orientation ( GTK_ORIENTABLE ( box ), GTK_ORIENTATION_VERTICAL );
 	gtk_box_set_spacing ( box, 3 );
 
+	mpegts_initialize ();
+
+	GSettings *setting = settings_init ();
+	dvb->zap_ahead = ( setting ) ? g_settings_get_boolean ( setting, "zap-ahead" ) : FALSE;
+	dvb->audio_lang = ( setting ) ? g_settings_get_string ( setting, "audio-language" ) : NULL;
+	dvb->batch_packets = ( setting ) ? g_settings_get_uint ( setting, "ts-batch-packets" ) : 0;
+	dvb->batch_latency = ( setting ) ? g_settings_get_uint ( setting, "ts-batch-latency" ) : 0;
+
+	g_autofree char *buf_tv  = ( setting ) ? g_settings_get_string ( setting, "buffering-tv"  ) : NULL;
+	g_autofree char *buf_rec = ( setting ) ? g_settings_get_string ( setting, "buffering-rec" ) : NULL;
+
+	dvb->buffering = buffering_profile_get ( buf_tv, BUFFERING_LIVE );
+	recorder_set_buffering ( buffering_profile_get ( buf_rec, BUFFERING_RECORD ), dvb->recorder );
+	recorder_set_buffering ( buffering_profile_get ( buf_rec, BUFFERING_RECORD ), dvb->bgrec );
+	if ( setting ) g_object_unref ( setting );
+
 	dvb->playdvb = dvb_create ( dvb );
+	dvb->ahead   = ( dvb->zap_ahead ) ? dvb_create_pipeline ( "pipeline-ahead", dvb ) : NULL;
+	dvb->capdvb  = dvb_create_capture ( dvb );
 
 	dvb->playlist = dvb_create_treeview_scroll ( dvb );
 
 	dvb->video = (GtkDrawingArea *)gtk_drawing_area_new ();
-	gtk_widget_set_events ( GTK_WIDGET ( dvb->video ), GDK_BUTTON_PRESS_MASK | GDK_POINTER_MOTION_MASK );
+	gtk_widget_set_events ( GTK_WIDGET ( dvb->video ), GDK_BUTTON_PRESS_MASK | GDK_POINTER_MOTION_MASK | GDK_SCROLL_MASK | GDK_KEY_PRESS_MASK );
+	gtk_widget_set_can_focus ( GTK_WIDGET ( dvb->video ), TRUE );
 
 	g_signal_connect ( dvb->video, "draw", G_CALLBACK ( dvb_video_draw ), dvb );
 	g_signal_connect ( dvb->video, "realize", G_CALLBACK ( dvb_video_realize ), dvb );
 
 	g_signal_connect ( dvb->video, "button-press-event",  G_CALLBACK ( dvb_video_press_event  ), dvb );
 	g_signal_connect ( dvb->video, "motion-notify-event", G_CALLBACK ( dvb_video_notify_event ), dvb );
+	g_signal_connect ( dvb->video, "scroll-event",        G_CALLBACK ( dvb_video_scroll_event ), dvb );
+	g_signal_connect ( dvb->video, "key-press-event",     G_CALLBACK ( dvb_video_key_press_event ), dvb );
 
 	gtk_drag_dest_set ( GTK_WIDGET ( dvb->video ), GTK_DEST_DEFAULT_ALL, NULL, 0, GDK_ACTION_COPY );
 	gtk_drag_dest_add_uri_targets  ( GTK_WIDGET ( dvb->video ) );
@@ -1450,20 +3119,29 @@ static void dvb_init ( Dvb *dvb )
 	GtkPaned *paned = dvb_create_paned ( dvb->playlist, dvb->video );
 	gtk_box_pack_start ( box, GTK_WIDGET ( paned ), TRUE, TRUE, 0 );
 
+	dvb_load_channels ( dvb );
+
 	char path[PATH_MAX];
-	sprintf ( path, "%s/helia/gtv-channel.conf", g_get_user_config_dir () );
 
-	if ( g_file_test ( path, G_FILE_TEST_EXISTS ) ) dvb_treeview_add_channels ( path, dvb );
+	sprintf ( path, "%s/helia/timers.conf", g_get_user_config_dir () );
+
+	dvb->timers = timer_list_new ( path, dvb->epg, (TimerFunc)dvb_timer_func, dvb );
 
 	g_timeout_add_seconds ( 2, (GSourceFunc)dvb_video_hide_cursor, dvb );
 }
 
 static void dvb_autosave ( Dvb *dvb )
 {
-	char path[PATH_MAX];
-	sprintf ( path, "%s/helia/gtv-channel.conf", g_get_user_config_dir () );
+	char path[PATH_MAX], cache[PATH_MAX];
+	sprintf ( path,  "%s/helia/gtv-channel.conf",  g_get_user_config_dir () );
+	sprintf ( cache, "%s/helia/gtv-channel.cache", g_get_user_config_dir () );
 
 	helia_treeview_to_file ( path, FALSE, dvb->treeview );
+
+	dvb_channel_db_sync ( dvb );
+	channel_db_save ( cache, path, dvb->db );
+
+	decode_cache_save ( dvb->decode );
 }
 
 void dvb_quit ( Dvb *dvb )
@@ -1472,9 +3150,36 @@ void dvb_quit ( Dvb *dvb )
 
 	dvb->quit = TRUE;
 
+	if ( dvb->digits_src ) g_source_remove ( dvb->digits_src );
+	if ( dvb->ahead_src_id ) g_source_remove ( dvb->ahead_src_id );
+
+	dvb_ahead_stop ( dvb );
+
 	gst_element_set_state ( dvb->playdvb, GST_STATE_NULL );
+	if ( dvb->capdvb ) gst_element_set_state ( dvb->capdvb, GST_STATE_NULL );
+
+	timer_list_free ( dvb->timers );
+	dvb_timer_bg_stop ( dvb );
+
+	recorder_free ( dvb->recorder );
+	recorder_free ( dvb->bgrec );
+	g_ptr_array_unref ( dvb->timer_live );
+	g_ptr_array_unref ( dvb->timer_bg );
+	dvb_tuner_release ( dvb );
+	epg_free ( dvb->epg );
+	psi_free ( dvb->psi );
+	analyzer_free ( dvb->analyzer );
+	channel_db_free ( dvb->db );
+	decode_cache_free ( dvb->decode );
+	free ( dvb->audio_lang );
 
 	gst_object_unref ( dvb->playdvb );
+	if ( dvb->ahead ) gst_object_unref ( dvb->ahead );
+	if ( dvb->capdvb ) gst_object_unref ( dvb->capdvb );
+	if ( dvb->timeshift ) timeshift_free ( dvb->timeshift );
+
+	if ( dvb->tick_id ) gtk_widget_remove_tick_callback ( GTK_WIDGET ( dvb ), dvb->tick_id );
+	sig_history_free ( dvb->sighist );
 
 	gst_object_unref ( dvb->enc_audio );
 	gst_object_unref ( dvb->enc_video );
@@ -0,0 +1,294 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "epg.h"
+
+/* The string chunk is rebuilt when the removed events ( replaced, expired ) outnumber the stored ones */
+#define EPG_REBUILD_MIN 1024
+
+struct _Epg
+{
+	GHashTable *services;  // onid << 32 | tsid << 16 | sid → GSequence of EpgEvent, sorted by start
+	GHashTable *sections;
+	GStringChunk *strings;
+
+	uint count;
+	uint removed;          // events removed since the last rebuild: their strings are still in the chunk
+};
+
+Epg * epg_new ( void )
+{
+	Epg *epg = g_new0 ( Epg, 1 );
+
+	epg->services = g_hash_table_new_full ( g_int64_hash, g_int64_equal, free, (GDestroyNotify)g_sequence_free );
+	epg->sections = g_hash_table_new_full ( g_int64_hash, g_int64_equal, free, NULL );
+	epg->strings  = g_string_chunk_new ( 64 * 1024 );
+
+	return epg;
+}
+
+void epg_free ( Epg *epg )
+{
+	g_hash_table_destroy ( epg->services );
+	g_hash_table_destroy ( epg->sections );
+	g_string_chunk_free  ( epg->strings  );
+
+	free ( epg );
+}
+
+void epg_clear ( Epg *epg )
+{
+	g_hash_table_remove_all ( epg->services );
+	g_hash_table_remove_all ( epg->sections );
+	g_string_chunk_clear ( epg->strings );
+
+	epg->count = 0;
+	epg->removed = 0;
+}
+
+gboolean epg_section_check ( uint16_t onid, uint16_t tsid, uint8_t table_id, uint16_t sid, uint8_t section_number, uint8_t version, Epg *epg )
+{
+	gint64 key = (gint64)( ( (guint64)onid << 48 ) | ( (guint64)tsid << 32 ) | ( (guint64)table_id << 24 ) | ( (guint64)sid << 8 ) | section_number );
+
+	gpointer value = NULL;
+
+	if ( g_hash_table_lookup_extended ( epg->sections, &key, NULL, &value ) && GPOINTER_TO_UINT ( value ) == (uint)version + 1 ) return FALSE;
+
+	gint64 *new_key = g_new ( gint64, 1 );
+	*new_key = key;
+
+	g_hash_table_insert ( epg->sections, new_key, GUINT_TO_POINTER ( (uint)version + 1 ) );
+
+	return TRUE;
+}
+
+/* tsid 0 ( channel without tsid / onid ): the first service with the sid */
+static GSequence * epg_service_get ( uint16_t onid, uint16_t tsid, uint16_t sid, Epg *epg )
+{
+	gint64 key = (gint64)( ( (guint64)onid << 32 ) | ( (guint64)tsid << 16 ) | sid );
+
+	GSequence *events = g_hash_table_lookup ( epg->services, &key );
+
+	if ( events || tsid ) return events;
+
+	GHashTableIter iter;
+	gpointer hkey, value;
+
+	g_hash_table_iter_init ( &iter, epg->services );
+
+	while ( g_hash_table_iter_next ( &iter, &hkey, &value ) )
+		if ( (uint16_t)( *(gint64 *)hkey & 0xffff ) == sid ) return value;
+
+	return NULL;
+}
+
+/* g_sequence_search: the first event for which the result is > 0 */
+static int epg_cmp_start ( const EpgEvent *event, const EpgEvent *probe, gpointer equal )
+{
+	return ( event->start > probe->start || ( equal && event->start == probe->start ) ) ? 1 : -1;
+}
+
+/* First event with start > t ( start >= t if equal ), O(log n) */
+static GSequenceIter * epg_bound ( GSequence *events, time_t t, gboolean equal )
+{
+	EpgEvent probe = { .start = t };
+
+	return g_sequence_search ( events, &probe, (GCompareDataFunc)epg_cmp_start, GINT_TO_POINTER ( equal ) );
+}
+
+void epg_add ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t start, uint32_t duration, uint16_t event_id, uint8_t running_status, const char *title, const char *text, Epg *epg )
+{
+	gint64 key = (gint64)( ( (guint64)onid << 32 ) | ( (guint64)tsid << 16 ) | sid );
+
+	GSequence *events = g_hash_table_lookup ( epg->services, &key );
+
+	if ( !events )
+	{
+		gint64 *new_key = g_new ( gint64, 1 );
+		*new_key = key;
+
+		events = g_sequence_new ( free );
+		g_hash_table_insert ( epg->services, new_key, events );
+	}
+
+	EpgEvent *event = g_new ( EpgEvent, 1 );
+
+	event->start    = start;
+	event->duration = duration;
+	event->event_id = event_id;
+	event->running_status = running_status;
+
+	event->title = g_string_chunk_insert_const ( epg->strings, ( title ) ? title : "" );
+	event->text  = g_string_chunk_insert_const ( epg->strings, ( text  ) ? text  : "" );
+
+	GSequenceIter *iter = epg_bound ( events, start, TRUE );
+
+	uint removed = 0;
+
+	/* An earlier event running into the new one */
+	if ( !g_sequence_iter_is_begin ( iter ) )
+	{
+		GSequenceIter *prev = g_sequence_iter_prev ( iter );
+		const EpgEvent *event_prev = g_sequence_get ( prev );
+
+		if ( event_prev->start + (time_t)event_prev->duration > start ) { g_sequence_remove ( prev ); removed++; }
+	}
+
+	while ( !g_sequence_iter_is_end ( iter ) )
+	{
+		const EpgEvent *next = g_sequence_get ( iter );
+
+		if ( next->start != start && next->start >= start + (time_t)duration ) break;
+
+		GSequenceIter *old = iter;
+		iter = g_sequence_iter_next ( iter );
+
+		g_sequence_remove ( old );
+		removed++;
+	}
+
+	g_sequence_insert_before ( iter, event );
+
+	epg->count += 1 - removed;
+	epg->removed += removed;
+}
+
+/* New chunk with the strings of the stored events only */
+static void epg_strings_rebuild ( Epg *epg )
+{
+	GStringChunk *strings = g_string_chunk_new ( 64 * 1024 );
+
+	GHashTableIter hash_iter;
+	gpointer value;
+
+	g_hash_table_iter_init ( &hash_iter, epg->services );
+
+	while ( g_hash_table_iter_next ( &hash_iter, NULL, &value ) )
+	{
+		GSequenceIter *iter = g_sequence_get_begin_iter ( (GSequence *)value );
+
+		for ( ; !g_sequence_iter_is_end ( iter ); iter = g_sequence_iter_next ( iter ) )
+		{
+			EpgEvent *event = g_sequence_get ( iter );
+
+			event->title = g_string_chunk_insert_const ( strings, event->title );
+			event->text  = g_string_chunk_insert_const ( strings, event->text  );
+		}
+	}
+
+	g_string_chunk_free ( epg->strings );
+
+	epg->strings = strings;
+	epg->removed = 0;
+}
+
+void epg_expire ( time_t t, Epg *epg )
+{
+	GHashTableIter hash_iter;
+	gpointer value;
+
+	g_hash_table_iter_init ( &hash_iter, epg->services );
+
+	while ( g_hash_table_iter_next ( &hash_iter, NULL, &value ) )
+	{
+		GSequenceIter *iter = g_sequence_get_begin_iter ( (GSequence *)value );
+
+		while ( !g_sequence_iter_is_end ( iter ) )
+		{
+			const EpgEvent *event = g_sequence_get ( iter );
+
+			if ( event->start + (time_t)event->duration > t ) break;
+
+			GSequenceIter *old = iter;
+			iter = g_sequence_iter_next ( iter );
+
+			g_sequence_remove ( old );
+
+			epg->count--;
+			epg->removed++;
+		}
+
+		if ( g_sequence_is_empty ( (GSequence *)value ) ) g_hash_table_iter_remove ( &hash_iter );
+	}
+
+	if ( epg->removed >= EPG_REBUILD_MIN && epg->removed > epg->count ) epg_strings_rebuild ( epg );
+}
+
+const EpgEvent * epg_get_now ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t t, Epg *epg )
+{
+	GSequence *events = epg_service_get ( onid, tsid, sid, epg );
+
+	if ( !events ) return NULL;
+
+	GSequenceIter *iter = epg_bound ( events, t, FALSE );
+
+	if ( g_sequence_iter_is_begin ( iter ) ) return NULL;
+
+	const EpgEvent *event = g_sequence_get ( g_sequence_iter_prev ( iter ) );
+
+	return ( event->start + (time_t)event->duration > t ) ? event : NULL;
+}
+
+const EpgEvent * epg_get_next ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t t, Epg *epg )
+{
+	GSequence *events = epg_service_get ( onid, tsid, sid, epg );
+
+	if ( !events ) return NULL;
+
+	GSequenceIter *iter = epg_bound ( events, t, FALSE );
+
+	return ( g_sequence_iter_is_end ( iter ) ) ? NULL : g_sequence_get ( iter );
+}
+
+const EpgEvent * epg_get_event ( uint16_t onid, uint16_t tsid, uint16_t sid, uint16_t event_id, Epg *epg )
+{
+	GSequence *events = epg_service_get ( onid, tsid, sid, epg );
+
+	if ( !events ) return NULL;
+
+	GSequenceIter *iter = g_sequence_get_begin_iter ( events );
+
+	for ( ; !g_sequence_iter_is_end ( iter ); iter = g_sequence_iter_next ( iter ) )
+	{
+		const EpgEvent *event = g_sequence_get ( iter );
+
+		if ( event->event_id == event_id ) return event;
+	}
+
+	return NULL;
+}
+
+GPtrArray * epg_get_range ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t from, time_t to, Epg *epg )
+{
+	GPtrArray *array = g_ptr_array_new ();
+
+	GSequence *events = epg_service_get ( onid, tsid, sid, epg );
+
+	if ( !events ) return array;
+
+	GSequenceIter *iter = epg_bound ( events, from, FALSE );
+
+	if ( !g_sequence_iter_is_begin ( iter ) ) iter = g_sequence_iter_prev ( iter );
+
+	for ( ; !g_sequence_iter_is_end ( iter ); iter = g_sequence_iter_next ( iter ) )
+	{
+		EpgEvent *event = g_sequence_get ( iter );
+
+		if ( event->start >= to ) break;
+
+		if ( event->start + (time_t)event->duration > from ) g_ptr_array_add ( array, event );
+	}
+
+	return array;
+}
+
+uint epg_count ( Epg *epg )
+{
+	return epg->count;
+}
@@ -0,0 +1,64 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+/* EPG store: per service ( onid, tsid, sid - the services of several multiplexes are kept apart ) a sequence of events
+ * sorted by start time ( insert, now / next / range in O(log n) ).
+ * Titles and texts are kept once in a string chunk, sections already stored ( same version ) are skipped.
+ * Lookups with tsid 0 ( channel data without tsid / onid ) take the first service with the sid */
+
+typedef struct _EpgEvent EpgEvent;
+
+struct _EpgEvent
+{
+	time_t start;
+	uint32_t duration;
+
+	uint16_t event_id;
+	uint8_t running_status;
+
+	const char *title;
+	const char *text;
+};
+
+typedef struct _Epg Epg;
+
+Epg * epg_new ( void );
+
+void epg_free ( Epg * );
+
+void epg_clear ( Epg * );
+
+/* TRUE if the section is not stored yet ( or has a new version ): it is marked as stored */
+gboolean epg_section_check ( uint16_t onid, uint16_t tsid, uint8_t table_id, uint16_t sid, uint8_t section_number, uint8_t version, Epg * );
+
+/* Events of the service starting in [ start, start + duration ) and an earlier event running into start are replaced; title and text are copied */
+void epg_add ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t start, uint32_t duration, uint16_t event_id, uint8_t running_status, const char *title, const char *text, Epg * );
+
+/* Events ended before time t are removed; the strings of the removed events are dropped once they outnumber the stored ones */
+void epg_expire ( time_t t, Epg * );
+
+/* The returned events are valid until the next epg_add of the service / epg_expire / epg_clear */
+
+/* Event running at time t or NULL */
+const EpgEvent * epg_get_now ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t t, Epg * );
+
+/* First event starting after time t or NULL */
+const EpgEvent * epg_get_next ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t t, Epg * );
+
+/* Event with the event_id or NULL */
+const EpgEvent * epg_get_event ( uint16_t onid, uint16_t tsid, uint16_t sid, uint16_t event_id, Epg * );
+
+/* Returns a new array of the events ( const EpgEvent * ) overlapping [ from, to ). Free with g_ptr_array_unref() */
+GPtrArray * epg_get_range ( uint16_t onid, uint16_t tsid, uint16_t sid, time_t from, time_t to, Epg * );
+
+uint epg_count ( Epg * );
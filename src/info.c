@@ -11,6 +11,8 @@
 #include "default.h"
 #include "scan.h"
 #include "button.h"
+#include "file.h"
+#include "buffering.h"
 
 #include <linux/dvb/frontend.h>
 #include <gst/pbutils/pbutils.h>
@@ -578,7 +580,7 @@ void helia_info_player ( GtkWindow *win_base, GtkTreeView *treeview, GstElement
 
 
 
-static GtkBox * helia_info_tv ( const char *data, GstElement *element, GtkComboBoxText *combo_lang )
+static GtkBox * helia_info_tv ( const Channel *channel, GstElement *element, GtkComboBoxText *combo_lang )
 {
 	GtkBox *v_box = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_VERTICAL, 0 );
 	gtk_box_set_spacing ( v_box, 5 );
@@ -599,48 +601,48 @@ static GtkBox * helia_info_tv ( const char *data, GstElement *element, GtkComboB
 
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( gtk_label_new ( dvb_name ) ), FALSE, FALSE, 0 );
 
-	char **fields = g_strsplit ( data, ":", 0 );
-	uint numfields = g_strv_length ( fields );
-
 	GtkEntry *entry_ch = (GtkEntry *) gtk_entry_new ();
 	g_object_set ( entry_ch, "editable", FALSE, NULL );
-	gtk_entry_set_text ( entry_ch, fields[0] );
+	gtk_entry_set_text ( entry_ch, channel->name );
 
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( entry_ch ), FALSE, FALSE, 0 );
 
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( combo_lang ), FALSE, FALSE, 0 );
 
-	uint8_t j = 0; for ( j = 1; j < numfields; j++ )
+	uint j = 0; for ( j = 0; j < channel->fields->len; j++ )
 	{
-		if ( g_strrstr ( fields[j], "delsys" ) || g_strrstr ( fields[j], "adapter" ) || g_strrstr ( fields[j], "frontend" ) ) continue;
+		const ChannelField *field = &g_array_index ( channel->fields, ChannelField, j );
 
-		if ( !g_strrstr ( fields[j], "=" ) ) continue;
+		const char *key = field->key;
 
-		char **splits = g_strsplit ( fields[j], "=", 0 );
+		if ( g_str_equal ( key, "delsys" ) || g_str_equal ( key, "adapter" ) || g_str_equal ( key, "frontend" ) ) continue;
 
-		const char *set = scan_get_info ( splits[0] );
+		const char *set = scan_get_info ( key );
 
-		if ( g_strrstr ( splits[0], "code-rate-hp" ) )
+		if ( g_str_equal ( key, "code-rate-hp" ) )
 		{
 			if ( delsys == SYS_DVBT || delsys == SYS_DVBT2 ) ; else set = "Inner Fec";
 		}
 
-		if ( g_str_has_prefix ( splits[0], "lnb-lof1" ) ) set = "   LO1  MHz";
-		if ( g_str_has_prefix ( splits[0], "lnb-lof2" ) ) set = "   LO2  MHz";
-		if ( g_str_has_prefix ( splits[0], "lnb-slof" ) ) set = "   Switch  MHz";
+		if ( g_str_equal ( key, "lcn" ) ) set = "LCN";
+		if ( g_str_equal ( key, "tsid" ) ) set = "TSID";
+		if ( g_str_equal ( key, "onid" ) ) set = "ONID";
+		if ( g_str_equal ( key, "lnb-lof1" ) ) set = "   LO1  MHz";
+		if ( g_str_equal ( key, "lnb-lof2" ) ) set = "   LO2  MHz";
+		if ( g_str_equal ( key, "lnb-slof" ) ) set = "   Switch  MHz";
 
 		GtkLabel *label = (GtkLabel *)gtk_label_new ( set );
 		gtk_widget_set_halign ( GTK_WIDGET ( label ), GTK_ALIGN_START );
 
-		gtk_grid_attach ( grid, GTK_WIDGET ( label ), 0, j+1, 1, 1 );
+		gtk_grid_attach ( grid, GTK_WIDGET ( label ), 0, (int)j+2, 1, 1 );
 
-		const char *set_v = scan_get_info_descr_vis ( splits[0], atoi ( splits[1] ) );
+		const char *set_v = scan_get_info_descr_vis ( key, (int)field->num );
 
-		if ( g_strrstr ( splits[0], "polarity" ) ) set_v = splits[1];
+		if ( g_str_equal ( key, "polarity" ) ) set_v = field->str;
 
-		if ( g_str_has_prefix ( splits[0], "frequency" ) || g_str_has_prefix ( splits[0], "lnb-lo" ) || g_str_has_prefix ( splits[0], "lnb-sl" ) )
+		if ( g_str_equal ( key, "frequency" ) || g_str_has_prefix ( key, "lnb-lo" ) || g_str_has_prefix ( key, "lnb-sl" ) )
 		{
-			long dat = atol ( splits[1] );
+			long dat = field->num;
 
 			if ( delsys == SYS_DVBS || delsys == SYS_TURBO || delsys == SYS_DVBS2 || delsys == SYS_ISDBS )
 				dat = dat / 1000;
@@ -653,25 +655,191 @@ static GtkBox * helia_info_tv ( const char *data, GstElement *element, GtkComboB
 			label = (GtkLabel *)gtk_label_new ( buf );
 		}
 		else
-			label = (GtkLabel *)gtk_label_new ( ( set_v ) ? set_v : splits[1] );
+			label = (GtkLabel *)gtk_label_new ( ( set_v ) ? set_v : field->str );
 
 		gtk_widget_set_halign ( GTK_WIDGET ( label ), GTK_ALIGN_START );
 
-		gtk_grid_attach ( grid, GTK_WIDGET ( label ), 1, j+1, 1, 1 );
-
-		g_strfreev (splits);
+		gtk_grid_attach ( grid, GTK_WIDGET ( label ), 1, (int)j+2, 1, 1 );
 	}
 
-	g_strfreev (fields);
-
 	gtk_box_pack_start ( v_box, GTK_WIDGET ( grid ), TRUE, TRUE, 10 );
 
 	return v_box;
 }
 
-GtkComboBoxText * helia_info_dvb ( const char *data, GtkWindow *win_base, GstElement *element )
+typedef struct _InfoTs InfoTs;
+
+struct _InfoTs
+{
+	GtkTextView *textview;
+	Analyzer *analyzer;
+
+	uint src_id;
+};
+
+static gboolean helia_info_ts_update ( InfoTs *its )
+{
+	g_autofree char *report = analyzer_get_report ( FALSE, its->analyzer );
+
+	gtk_text_buffer_set_text ( gtk_text_view_get_buffer ( its->textview ), report, -1 );
+
+	return TRUE;
+}
+
+static void helia_info_ts_save ( G_GNUC_UNUSED GtkButton *button, InfoTs *its )
 {
-	if ( !data ) return NULL;
+	GtkWindow *window = GTK_WINDOW ( gtk_widget_get_toplevel ( GTK_WIDGET ( its->textview ) ) );
+
+	g_autofree char *path = helia_save_file ( g_get_home_dir (), "helia-ts-analyzer.csv", "csv", "*.csv", window );
+
+	if ( path == NULL ) return;
+
+	g_autofree char *report = analyzer_get_report ( TRUE, its->analyzer );
+
+	GError *error = NULL;
+
+	if ( !g_file_set_contents ( path, report, -1, &error ) )
+	{
+		g_warning ( "%s: %s ", __func__, error->message );
+		g_error_free ( error );
+	}
+}
+
+static void helia_info_ts_quit ( G_GNUC_UNUSED GtkWindow *window, InfoTs *its )
+{
+	g_source_remove ( its->src_id );
+
+	free ( its );
+}
+
+/* Per pid table of the analyzer, updated every second */
+static GtkScrolledWindow * helia_info_ts ( GtkWindow *window, GtkBox *h_box, Analyzer *analyzer )
+{
+	InfoTs *its = g_new0 ( InfoTs, 1 );
+	its->analyzer = analyzer;
+
+	its->textview = (GtkTextView *)gtk_text_view_new ();
+	gtk_text_view_set_editable  ( its->textview, FALSE );
+	gtk_text_view_set_monospace ( its->textview, TRUE );
+	gtk_text_view_set_cursor_visible ( its->textview, FALSE );
+
+	GtkScrolledWindow *scroll = (GtkScrolledWindow *)gtk_scrolled_window_new ( NULL, NULL );
+	gtk_scrolled_window_set_policy ( scroll, GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC );
+	gtk_widget_set_size_request ( GTK_WIDGET ( scroll ), -1, 200 );
+	gtk_container_add ( GTK_CONTAINER ( scroll ), GTK_WIDGET ( its->textview ) );
+
+	GtkButton *button_save = helia_create_button ( h_box, "helia-save", "🖴", ICON_SIZE );
+	g_signal_connect ( button_save, "clicked", G_CALLBACK ( helia_info_ts_save ), its );
+
+	helia_info_ts_update ( its );
+	its->src_id = g_timeout_add_seconds ( 1, (GSourceFunc)helia_info_ts_update, its );
+
+	g_signal_connect ( window, "destroy", G_CALLBACK ( helia_info_ts_quit ), its );
+
+	return scroll;
+}
+
+typedef struct _InfoBuf InfoBuf;
+
+struct _InfoBuf
+{
+	GtkLabel *label;
+	GstElement *pipeline;
+
+	uint src_id;
+};
+
+static gboolean helia_info_buf_update ( InfoBuf *ibuf )
+{
+	g_autofree char *info = buffering_get_info ( ibuf->pipeline );
+
+	gtk_label_set_text ( ibuf->label, info );
+
+	return TRUE;
+}
+
+static void helia_info_buf_quit ( G_GNUC_UNUSED GtkWindow *window, InfoBuf *ibuf )
+{
+	g_source_remove ( ibuf->src_id );
+
+	gst_object_unref ( ibuf->pipeline );
+	free ( ibuf );
+}
+
+/* Buffering profile, end-to-end latency and queue fill of the live view, updated every second */
+static GtkLabel * helia_info_buf ( GtkWindow *window, GstElement *pipeline )
+{
+	InfoBuf *ibuf = g_new0 ( InfoBuf, 1 );
+	ibuf->pipeline = gst_object_ref ( pipeline );
+
+	ibuf->label = (GtkLabel *)gtk_label_new ( NULL );
+	gtk_widget_set_halign ( GTK_WIDGET ( ibuf->label ), GTK_ALIGN_START );
+	gtk_label_set_selectable ( ibuf->label, TRUE );
+
+	helia_info_buf_update ( ibuf );
+	ibuf->src_id = g_timeout_add_seconds ( 1, (GSourceFunc)helia_info_buf_update, ibuf );
+
+	g_signal_connect ( window, "destroy", G_CALLBACK ( helia_info_buf_quit ), ibuf );
+
+	return ibuf->label;
+}
+
+typedef struct _InfoSig InfoSig;
+
+struct _InfoSig
+{
+	GtkTextView *textview;
+	SigHistory *sighist;
+	char *name;
+
+	uint src_id;
+};
+
+static gboolean helia_info_sig_update ( InfoSig *isig )
+{
+	g_autofree char *report = sig_history_get_report ( isig->name, isig->sighist );
+
+	gtk_text_buffer_set_text ( gtk_text_view_get_buffer ( isig->textview ), ( report ) ? report : "", -1 );
+
+	return TRUE;
+}
+
+static void helia_info_sig_quit ( G_GNUC_UNUSED GtkWindow *window, InfoSig *isig )
+{
+	g_source_remove ( isig->src_id );
+
+	free ( isig->name );
+	free ( isig );
+}
+
+/* Signal history of the channel ( 1 s / 1 min / 1 h ), updated every second */
+static GtkScrolledWindow * helia_info_sig ( GtkWindow *window, const char *name, SigHistory *sighist )
+{
+	InfoSig *isig = g_new0 ( InfoSig, 1 );
+	isig->sighist = sighist;
+	isig->name = g_strdup ( name );
+
+	isig->textview = (GtkTextView *)gtk_text_view_new ();
+	gtk_text_view_set_editable  ( isig->textview, FALSE );
+	gtk_text_view_set_monospace ( isig->textview, TRUE );
+	gtk_text_view_set_cursor_visible ( isig->textview, FALSE );
+
+	GtkScrolledWindow *scroll = (GtkScrolledWindow *)gtk_scrolled_window_new ( NULL, NULL );
+	gtk_scrolled_window_set_policy ( scroll, GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC );
+	gtk_widget_set_size_request ( GTK_WIDGET ( scroll ), -1, 200 );
+	gtk_container_add ( GTK_CONTAINER ( scroll ), GTK_WIDGET ( isig->textview ) );
+
+	helia_info_sig_update ( isig );
+	isig->src_id = g_timeout_add_seconds ( 1, (GSourceFunc)helia_info_sig_update, isig );
+
+	g_signal_connect ( window, "destroy", G_CALLBACK ( helia_info_sig_quit ), isig );
+
+	return scroll;
+}
+
+GtkComboBoxText * helia_info_dvb ( const Channel *channel, GtkWindow *win_base, GstElement *element, GstElement *pipeline, Analyzer *analyzer, SigHistory *sighist )
+{
+	if ( !channel ) return NULL;
 
 	GtkWindow *window = (GtkWindow *)gtk_window_new ( GTK_WINDOW_TOPLEVEL );
 	gtk_window_set_title ( window, "" );
@@ -680,13 +848,20 @@ GtkComboBoxText * helia_info_dvb ( const char *data, GtkWindow *win_base, GstEle
 	gtk_window_set_icon_name ( window, DEF_ICON );
 	gtk_window_set_position  ( window, GTK_WIN_POS_CENTER_ON_PARENT );
 
-	gtk_window_set_default_size ( window, 400, -1 );
+	gtk_window_set_default_size ( window, ( analyzer || sighist ) ? 700 : 400, -1 );
 
 	GtkBox *m_box = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_VERTICAL,   0 );
 	GtkBox *h_box = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_HORIZONTAL, 0 );
+	gtk_box_set_spacing ( h_box, 5 );
 
 	GtkComboBoxText *combo_lang = (GtkComboBoxText *)gtk_combo_box_text_new ();
-	gtk_box_pack_start ( m_box, GTK_WIDGET ( helia_info_tv ( data, element, combo_lang ) ), FALSE, FALSE, 0 );
+	gtk_box_pack_start ( m_box, GTK_WIDGET ( helia_info_tv ( channel, element, combo_lang ) ), FALSE, FALSE, 0 );
+
+	if ( pipeline ) gtk_box_pack_start ( m_box, GTK_WIDGET ( helia_info_buf ( window, pipeline ) ), FALSE, FALSE, 5 );
+
+	if ( analyzer ) gtk_box_pack_start ( m_box, GTK_WIDGET ( helia_info_ts ( window, h_box, analyzer ) ), TRUE, TRUE, 0 );
+
+	if ( sighist ) gtk_box_pack_start ( m_box, GTK_WIDGET ( helia_info_sig ( window, channel->name, sighist ) ), TRUE, TRUE, 5 );
 
 	GtkButton *button_close = helia_create_button ( h_box, "helia-exit", "🞬", ICON_SIZE );
 	g_signal_connect_swapped ( button_close, "clicked", G_CALLBACK ( gtk_widget_destroy ), window );
@@ -12,6 +12,11 @@
 #include <gtk/gtk.h>
 #include <gst/gst.h>
 
+#include "analyzer.h"
+#include "sighistory.h"
+#include "channel.h"
+
 void helia_info_player ( GtkWindow *, GtkTreeView *, GstElement * );
 
-GtkComboBoxText * helia_info_dvb ( const char *, GtkWindow *, GstElement * );
+/* pipeline: the buffering of the live view ( buffering.c ); analyzer: NULL - no TS analysis; sighist: NULL - no signal history */
+GtkComboBoxText * helia_info_dvb ( const Channel *, GtkWindow *, GstElement *, GstElement *pipeline, Analyzer *, SigHistory *sighist );
@@ -9,8 +9,20 @@
 
 #include "mpegts.h"
 
-#define GST_USE_UNSTABLE_API
-#include <gst/mpegts/mpegts.h>
+#include <linux/dvb/frontend.h>
+
+/* Maximum repetition intervals ( EN 300 468 ): a table not complete after 2 intervals is missing */
+#define PAT_REPEAT_MS  100
+#define PMT_REPEAT_MS  100
+#define SDT_REPEAT_MS  2000
+#define SCAN_MARGIN_MS 300  // section batches ( psi.c ) and start of the stream
+#define NOLOCK_MS      2000
+#define NIT_REPEAT_MS  10000
+
+/* Logical channel descriptor ( EICTA / NorDig v1 ) */
+#define DESC_LCN 0x83
+
+#define SCAN_TIMEOUT_US( repeat ) ( ( 2 * (gint64)( repeat ) + SCAN_MARGIN_MS ) * 1000 )
 
 void mpegts_initialize ( void )
 {
@@ -30,27 +42,117 @@ void mpegts_initialize ( void )
 	g_type_class_ref ( GST_TYPE_MPEGTS_COMPONENT_STREAM_CONTENT );
 }
 
+static void mpegts_service_free ( MpegTsService *srv )
+{
+	free ( srv->ch_name );
+	free ( srv );
+}
+
+static void mpegts_mux_free ( MpegTsMux *mux )
+{
+	free ( mux->data );
+	free ( mux );
+}
+
+MpegTs * mpegts_new ( void )
+{
+	MpegTs *mpegts = g_new0 ( MpegTs, 1 );
+
+	mpegts->services = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)mpegts_service_free );
+	mpegts->versions = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	mpegts->order    = g_array_new ( FALSE, FALSE, sizeof ( uint16_t ) );
+
+	mpegts->sdt_pending = g_ptr_array_new_with_free_func ( (GDestroyNotify)gst_mpegts_section_unref );
+
+	mpegts->muxes = g_ptr_array_new_with_free_func ( (GDestroyNotify)mpegts_mux_free );
+	mpegts->lcns  = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	mpegts->sdt_versions = g_hash_table_new ( g_direct_hash, g_direct_equal );
+
+	mpegts->nit_version = -1;
+
+	return mpegts;
+}
+
+void mpegts_free ( MpegTs *mpegts )
+{
+	g_hash_table_destroy ( mpegts->services );
+	g_hash_table_destroy ( mpegts->versions );
+	g_array_free ( mpegts->order, TRUE );
+	g_ptr_array_unref ( mpegts->sdt_pending );
+
+	g_ptr_array_unref ( mpegts->muxes );
+	g_hash_table_destroy ( mpegts->lcns );
+	g_hash_table_destroy ( mpegts->sdt_versions );
+
+	free ( mpegts );
+}
+
 void mpegts_clear ( MpegTs *mpegts )
 {
 	mpegts->pat_done = FALSE;
 	mpegts->pmt_done = FALSE;
 	mpegts->sdt_done = FALSE;
 
-	mpegts->pat_count = 0;
 	mpegts->pmt_count = 0;
 	mpegts->sdt_count = 0;
 
-	uint8_t j = 0; for ( j = 0; j < MAX_RUN_PAT; j++ )
-	{
-		mpegts->pids[j].pat_sid = 0;
-		mpegts->pids[j].pmt_sid = 0;
-		mpegts->pids[j].sdt_sid = 0;
+	mpegts->tsid = 0;
+	mpegts->onid = 0;
+	mpegts->time_pat = 0;
 
-		mpegts->pids[j].pmt_apid = 0;
-		mpegts->pids[j].pmt_vpid = 0;
+	mpegts->nit_done = FALSE;
+	mpegts->nit_version = -1;
+	mpegts->network_id = 0;
 
-		mpegts->pids[j].ch_name = NULL;
-	}
+	uint i = 0; for ( i = 0; i < G_N_ELEMENTS ( mpegts->pat_sections ); i++ ) mpegts->pat_sections[i] = mpegts->sdt_sections[i] = mpegts->nit_sections[i] = 0;
+
+	g_hash_table_remove_all ( mpegts->services );
+	g_hash_table_remove_all ( mpegts->versions );
+	g_array_set_size ( mpegts->order, 0 );
+	g_ptr_array_set_size ( mpegts->sdt_pending, 0 );
+
+	g_ptr_array_set_size ( mpegts->muxes, 0 );
+	g_hash_table_remove_all ( mpegts->lcns );
+	g_hash_table_remove_all ( mpegts->sdt_versions );
+}
+
+uint mpegts_get_n_services ( MpegTs *mpegts )
+{
+	return mpegts->order->len;
+}
+
+MpegTsService * mpegts_get_service ( uint16_t sid, MpegTs *mpegts )
+{
+	return g_hash_table_lookup ( mpegts->services, GUINT_TO_POINTER ( sid ) );
+}
+
+MpegTsService * mpegts_get_service_nth ( uint n, MpegTs *mpegts )
+{
+	if ( n >= mpegts->order->len ) return NULL;
+
+	return mpegts_get_service ( g_array_index ( mpegts->order, uint16_t, n ), mpegts );
+}
+
+uint mpegts_get_n_muxes ( MpegTs *mpegts )
+{
+	return mpegts->muxes->len;
+}
+
+const MpegTsMux * mpegts_get_mux_nth ( uint n, MpegTs *mpegts )
+{
+	if ( n >= mpegts->muxes->len ) return NULL;
+
+	return g_ptr_array_index ( mpegts->muxes, n );
+}
+
+uint16_t mpegts_get_lcn ( uint16_t tsid, uint16_t sid, MpegTs *mpegts )
+{
+	return (uint16_t)GPOINTER_TO_UINT ( g_hash_table_lookup ( mpegts->lcns, GUINT_TO_POINTER ( ( (uint)tsid << 16 ) | sid ) ) );
+}
+
+int mpegts_get_sdt_version ( uint16_t onid, uint16_t tsid, MpegTs *mpegts )
+{
+	return (int)GPOINTER_TO_UINT ( g_hash_table_lookup ( mpegts->sdt_versions, GUINT_TO_POINTER ( ( (uint)onid << 16 ) | tsid ) ) ) - 1;
 }
 
 static const char * mpegts_enum_name ( GType instance_type, int val )
@@ -62,26 +164,100 @@ static const char * mpegts_enum_name ( GType instance_type, int val )
 	return en->value_nick;
 }
 
+/* TRUE if the section is new or has a new version: the version is stored */
+static gboolean mpegts_section_check ( GstMpegtsSection *section, MpegTs *mpegts )
+{
+	gpointer key = GUINT_TO_POINTER ( ( (uint)section->table_id << 24 ) | ( (uint)section->subtable_extension << 8 ) | section->section_number );
+
+	uint version = (uint)section->version_number + 1;
+
+	if ( GPOINTER_TO_UINT ( g_hash_table_lookup ( mpegts->versions, key ) ) == version ) return FALSE;
+
+	g_hash_table_insert ( mpegts->versions, key, GUINT_TO_POINTER ( version ) );
+
+	return TRUE;
+}
+
+/* Marks the section number as received. Returns TRUE if all the sections of the table are received */
+static gboolean mpegts_sections_all ( uint32_t *sections, GstMpegtsSection *section )
+{
+	sections[section->section_number / 32] |= 1u << ( section->section_number % 32 );
+
+	uint i = 0; for ( i = 0; i <= section->last_section_number; i++ )
+		if ( !( sections[i / 32] & ( 1u << ( i % 32 ) ) ) ) return FALSE;
+
+	return TRUE;
+}
+
+static void mpegts_check_done ( MpegTs *mpegts )
+{
+	uint n = mpegts->order->len;
+
+	if ( !mpegts->pmt_done && n > 0 && mpegts->pmt_count == n )
+	{
+		mpegts->pmt_done = TRUE;
+		if ( mpegts->debug ) g_message ( "PMT Done: pmt_count %u \n", mpegts->pmt_count );
+	}
+
+	if ( !mpegts->sdt_done && n > 0 && mpegts->sdt_count == n )
+	{
+		mpegts->sdt_done = TRUE;
+		if ( mpegts->debug ) g_message ( "SDT Done: sdt_count %u \n", mpegts->sdt_count );
+	}
+}
+
+static void mpegts_sdt ( GstMpegtsSection *section, MpegTs *mpegts );
+
+/* nth service of the PAT: the counts go down, its PMT is parsed again if it comes back */
+static void mpegts_service_remove ( uint n, MpegTs *mpegts )
+{
+	uint16_t sid = g_array_index ( mpegts->order, uint16_t, n );
+
+	MpegTsService *srv = mpegts_get_service ( sid, mpegts );
+
+	if ( mpegts->debug ) g_message ( "PAT: service %u removed ", sid );
+
+	if ( srv->pmt ) mpegts->pmt_count--;
+	if ( srv->sdt ) mpegts->sdt_count--;
+
+	g_hash_table_remove ( mpegts->versions, GUINT_TO_POINTER ( ( (uint)GST_MTS_TABLE_ID_TS_PROGRAM_MAP << 24 ) | ( (uint)sid << 8 ) ) );
+
+	g_array_remove_index ( mpegts->order, n );
+	g_hash_table_remove ( mpegts->services, GUINT_TO_POINTER ( sid ) );
+}
+
 static void mpegts_pat ( GstMpegtsSection *section, MpegTs *mpegts )
 {
+	if ( !mpegts_section_check ( section, mpegts ) ) return;
+
 	GPtrArray *pat = gst_mpegts_section_get_pat ( section );
 
+	if ( !pat ) return;
+
 	if ( mpegts->debug ) g_message ( "PAT: %u Programs ", pat->len );
 
-	uint8_t i = 0; for ( i = 0; i < pat->len; i++ )
-	{
-		if ( i >= MAX_RUN_PAT )
-		{
-			g_print ( "MAX %u: PAT scan stop  \n", MAX_RUN_PAT );
-			break;
-		}
+	mpegts->tsid = section->subtable_extension;
 
+	uint i = 0; for ( i = 0; i < pat->len; i++ )
+	{
 		GstMpegtsPatProgram *patp = g_ptr_array_index ( pat, i );
 
 		if ( patp->program_number == 0 ) continue;
 
-		mpegts->pids[mpegts->pat_count].pat_sid = patp->program_number;
-		mpegts->pat_count++;
+		MpegTsService *srv = mpegts_get_service ( patp->program_number, mpegts );
+
+		if ( !srv )
+		{
+			srv = g_new0 ( MpegTsService, 1 );
+			srv->sid = patp->program_number;
+
+			g_hash_table_insert ( mpegts->services, GUINT_TO_POINTER ( srv->sid ), srv );
+			g_array_append_val ( mpegts->order, srv->sid );
+		}
+
+		srv->pmt_pid = patp->network_or_program_map_PID;
+		srv->pat_section = section->section_number;
+		srv->pat_version = section->version_number;
 
 		if ( mpegts->debug ) g_message ( "     Program number: %u (0x%04x) | network or pg-map pid: 0x%04x ", 
 				patp->program_number, patp->program_number, patp->network_or_program_map_PID );
@@ -89,25 +265,42 @@ static void mpegts_pat ( GstMpegtsSection *section, MpegTs *mpegts )
 
 	g_ptr_array_unref ( pat );
 
+	/* New version: the services of the section that are not listed any more */
+	for ( i = mpegts->order->len; i > 0; i-- )
+	{
+		const MpegTsService *srv = mpegts_get_service_nth ( i - 1, mpegts );
+
+		if ( srv->pat_section == section->section_number && srv->pat_version != section->version_number ) mpegts_service_remove ( i - 1, mpegts );
+	}
+
+	if ( mpegts->pat_done || !mpegts_sections_all ( mpegts->pat_sections, section ) ) { mpegts_check_done ( mpegts ); return; }
+
 	mpegts->pat_done = TRUE;
-	if ( mpegts->debug ) g_message ( "PAT Done: pat_count %u \n", mpegts->pat_count );
+	mpegts->time_pat = g_get_monotonic_time ();
+	if ( mpegts->debug ) g_message ( "PAT Done: services %u \n", mpegts->order->len );
+
+	for ( i = 0; i < mpegts->sdt_pending->len; i++ ) mpegts_sdt ( g_ptr_array_index ( mpegts->sdt_pending, i ), mpegts );
+
+	g_ptr_array_set_size ( mpegts->sdt_pending, 0 );
+
+	mpegts_check_done ( mpegts );
 }
 
 static void mpegts_pmt ( GstMpegtsSection *section, MpegTs *mpegts )
 {
-	if ( mpegts->pmt_count >= MAX_RUN_PAT )
-	{
-		g_print ( "MAX %u: PMT scan stop  \n", MAX_RUN_PAT );
-		return;
-	}
+	MpegTsService *srv = mpegts_get_service ( section->subtable_extension, mpegts );
 
-	uint8_t i = 0, len = 0;
-	gboolean first_audio = TRUE;
+	if ( !srv || !mpegts_section_check ( section, mpegts ) ) return;
 
 	const GstMpegtsPMT *pmt = gst_mpegts_section_get_pmt ( section );
-	len = (uint8_t)pmt->streams->len;
 
-	mpegts->pids[mpegts->pmt_count].pmt_sid = pmt->program_number;
+	if ( !pmt ) return;
+
+	uint i = 0, len = pmt->streams->len;
+	gboolean first_audio = TRUE;
+
+	srv->pmt_vpid = 0;
+	srv->pmt_apid = 0;
 
 	if ( mpegts->debug ) g_message ( "PMT: %u  ( %u )", mpegts->pmt_count + 1, len );
 
@@ -125,62 +318,61 @@ static void mpegts_pmt ( GstMpegtsSection *section, MpegTs *mpegts )
 		const char *name_t = mpegts_enum_name ( GST_TYPE_MPEGTS_STREAM_TYPE, stream->stream_type );
 
 		if ( g_strrstr ( name_t, "video" ) )
-			mpegts->pids[mpegts->pmt_count].pmt_vpid = stream->pid;
+			srv->pmt_vpid = stream->pid;
 
 		if ( g_strrstr ( name_t, "audio" ) )
 		{
 			if ( first_audio )
-				mpegts->pids[mpegts->pmt_count].pmt_apid = stream->pid;
+				srv->pmt_apid = stream->pid;
 
 			first_audio = FALSE;
 		}
 	}
 
-	mpegts->pmt_count++;
+	if ( !srv->pmt ) { srv->pmt = TRUE; mpegts->pmt_count++; }
 
-	if ( mpegts->pat_count > 0 && mpegts->pat_count == mpegts->pmt_count )
-	{
-		mpegts->pmt_done = TRUE;
-		if ( mpegts->debug ) g_message ( "PMT Done: pmt_count %u \n", mpegts->pmt_count );
-	}
+	mpegts_check_done ( mpegts );
+}
+
+/* SDT other: only its version, the services are scanned on their own multiplex */
+static void mpegts_sdt_other ( GstMpegtsSection *section, MpegTs *mpegts )
+{
+	if ( section->section_length < 11 || !mpegts_section_check ( section, mpegts ) ) return;
+
+	uint16_t onid = (uint16_t)( ( section->data[8] << 8 ) | section->data[9] );
+
+	g_hash_table_insert ( mpegts->sdt_versions, GUINT_TO_POINTER ( ( (uint)onid << 16 ) | section->subtable_extension ), GUINT_TO_POINTER ( section->version_number + 1 ) );
 }
 
 static void mpegts_sdt ( GstMpegtsSection *section, MpegTs *mpegts )
 {
-	if ( mpegts->sdt_done ) return;
+	if ( section->table_id == GST_MTS_TABLE_ID_SERVICE_DESCRIPTION_OTHER_TS ) { mpegts_sdt_other ( section, mpegts ); return; }
 
-	if ( mpegts->sdt_count >= MAX_RUN_PAT )
-	{
-		g_print ( "MAX %u: SDT scan stop  \n", MAX_RUN_PAT );
-		return;
-	}
+	if ( section->table_id != GST_MTS_TABLE_ID_SERVICE_DESCRIPTION_ACTUAL_TS ) return;
+
+	if ( !mpegts->pat_done ) { g_ptr_array_add ( mpegts->sdt_pending, gst_mpegts_section_ref ( section ) ); return; }
 
-	uint8_t i = 0, z = 0, c = 0, len = 0;
+	if ( !mpegts_section_check ( section, mpegts ) ) return;
 
 	const GstMpegtsSDT *sdt = gst_mpegts_section_get_sdt ( section );
 
-	len = (uint8_t)sdt->services->len;
+	if ( !sdt ) return;
+
+	mpegts->onid = sdt->original_network_id;
+
+	g_hash_table_insert ( mpegts->sdt_versions, GUINT_TO_POINTER ( ( (uint)mpegts->onid << 16 ) | section->subtable_extension ), GUINT_TO_POINTER ( section->version_number + 1 ) );
+
+	uint i = 0, c = 0, len = sdt->services->len;
+
 	if ( mpegts->debug ) g_message ( "Services: %u  ( %u ) ", mpegts->sdt_count + 1, len );
 
 	for ( i = 0; i < len; i++ )
 	{
-		if ( i >= MAX_RUN_PAT ) break;
-
 		GstMpegtsSDTService *service = g_ptr_array_index ( sdt->services, i );
 
-		mpegts->pids[mpegts->sdt_count].ch_name = NULL;
-		mpegts->pids[mpegts->sdt_count].sdt_sid = service->service_id;
-
-		gboolean get_descr = FALSE;
-
-		if ( mpegts->pat_done )
-		{
-			for ( z = 0; z < mpegts->pat_count; z++ )
-				if ( mpegts->pids[z].pat_sid == service->service_id )
-					{  get_descr = TRUE; break; }
-		}
+		MpegTsService *srv = mpegts_get_service ( service->service_id, mpegts );
 
-		if ( !get_descr ) continue;
+		if ( !srv ) continue;
 
 		if ( mpegts->debug ) g_message ( "  Service id:  %u | %u  ( 0x%04x ) ", mpegts->sdt_count + 1, service->service_id, service->service_id );
 
@@ -196,7 +388,8 @@ static void mpegts_sdt ( GstMpegtsSection *section, MpegTs *mpegts )
 			{
 				if ( gst_mpegts_descriptor_parse_dvb_service ( desc, &service_type, &service_name, &provider_name ) )
 				{
-					mpegts->pids[mpegts->sdt_count].ch_name = g_strdup ( service_name );
+					free ( srv->ch_name );
+					srv->ch_name = g_strdup ( service_name );
 
 					if ( mpegts->debug ) g_message ( "    Service Descriptor, type:0x%02x (%s) ",
 						service_type, mpegts_enum_name (GST_TYPE_MPEGTS_DVB_SERVICE_TYPE, service_type) );
@@ -210,40 +403,289 @@ static void mpegts_sdt ( GstMpegtsSection *section, MpegTs *mpegts )
 
 		}
 
-		mpegts->sdt_count++;
+		if ( !srv->sdt ) { srv->sdt = TRUE; mpegts->sdt_count++; }
 	}
 
-	if ( mpegts->pat_count > 0 && mpegts->pat_count == mpegts->sdt_count )
+	if ( !mpegts->sdt_done && mpegts_sections_all ( mpegts->sdt_sections, section ) )
 	{
 		mpegts->sdt_done = TRUE;
-		if ( mpegts->debug ) g_message ( "SDT Done: sdt_count %u \n", mpegts->sdt_count );
+		if ( mpegts->debug ) g_message ( "SDT Done: sections %u, sdt_count %u \n", section->last_section_number + 1, mpegts->sdt_count );
 	}
+
+	mpegts_check_done ( mpegts );
 }
 
-void mpegts_parse_section ( GstMessage *message, MpegTs *mpegts )
+/* Delivery system descriptors → tuning data of dvbsrc. The enums of the descriptors have the values of linux/dvb/frontend.h */
+static char * mpegts_nit_mux_data ( GPtrArray *descriptors, uint8_t *delsys )
 {
-	GstMpegtsSection *section = gst_message_parse_mpegts_section ( message );
+	uint32_t frequency = 0;
 
-	if ( section )
+	GString *gstring = g_string_new ( NULL );
+
+	uint c = 0; for ( c = 0; c < descriptors->len; c++ )
 	{
-		switch ( GST_MPEGTS_SECTION_TYPE ( section ) )
+		GstMpegtsDescriptor *desc = g_ptr_array_index ( descriptors, c );
+
+		if ( desc->tag == GST_MTS_DESC_DVB_TERRESTRIAL_DELIVERY_SYSTEM )
+		{
+			GstMpegtsTerrestrialDeliverySystemDescriptor ter;
+
+			if ( !gst_mpegts_descriptor_parse_terrestrial_delivery_system ( desc, &ter ) ) continue;
+
+			if ( *delsys != SYS_DVBT2 ) *delsys = SYS_DVBT;
+
+			frequency = ter.frequency;
+
+			g_string_append_printf ( gstring, ":bandwidth-hz=%u:modulation=%d:code-rate-hp=%d:code-rate-lp=%d:guard=%d:trans-mode=%d:hierarchy=%d",
+				ter.bandwidth, ter.constellation, ter.code_rate_hp, ter.code_rate_lp, ter.guard_interval, ter.transmission_mode, ter.hierarchy );
+		}
+
+		if ( desc->tag == GST_MTS_DESC_DVB_EXTENSION && desc->tag_extension == GST_MTS_DESC_EXT_DVB_T2_DELIVERY_SYSTEM )
+		{
+			GstMpegtsT2DeliverySystemDescriptor *t2 = NULL;
+
+			if ( !gst_mpegts_descriptor_parse_dvb_t2_delivery_system ( desc, &t2 ) ) continue;
+
+			*delsys = SYS_DVBT2;
+
+			g_string_append_printf ( gstring, ":stream-id=%u", t2->plp_id );
+
+			if ( t2->cells && t2->cells->len )
+			{
+				GstMpegtsT2DeliverySystemCell *cell = g_ptr_array_index ( t2->cells, 0 );
+
+				if ( frequency == 0 && cell->centre_frequencies && cell->centre_frequencies->len )
+				{
+					frequency = g_array_index ( cell->centre_frequencies, guint32, 0 );
+
+					g_string_append_printf ( gstring, ":bandwidth-hz=%u:guard=%d:trans-mode=%d", t2->bandwidth, t2->guard_interval, t2->transmission_mode );
+				}
+			}
+
+			gst_mpegts_t2_delivery_system_descriptor_free ( t2 );
+		}
+
+		if ( desc->tag == GST_MTS_DESC_DVB_CABLE_DELIVERY_SYSTEM )
+		{
+			GstMpegtsCableDeliverySystemDescriptor cab;
+
+			if ( !gst_mpegts_descriptor_parse_cable_delivery_system ( desc, &cab ) ) continue;
+
+			*delsys = SYS_DVBC_ANNEX_A;
+
+			frequency = cab.frequency;
+
+			g_string_append_printf ( gstring, ":symbol-rate=%u:modulation=%d:code-rate-hp=%d", cab.symbol_rate / 1000, cab.modulation, cab.fec_inner );
+		}
+
+		if ( desc->tag == GST_MTS_DESC_DVB_SATELLITE_DELIVERY_SYSTEM )
 		{
-			case GST_MPEGTS_SECTION_PAT:
-				mpegts_pat ( section, mpegts );
-				break;
+			GstMpegtsSatelliteDeliverySystemDescriptor sat;
+
+			if ( !gst_mpegts_descriptor_parse_satellite_delivery_system ( desc, &sat ) ) continue;
+
+			*delsys = ( sat.modulation_system ) ? SYS_DVBS2 : SYS_DVBS;
+
+			frequency = sat.frequency;
+
+			g_string_append_printf ( gstring, ":polarity=%s:symbol-rate=%u:code-rate-hp=%d",
+				( sat.polarization == GST_MPEGTS_POLARIZATION_LINEAR_VERTICAL || sat.polarization == GST_MPEGTS_POLARIZATION_CIRCULAR_RIGHT ) ? "V" : "H",
+				sat.symbol_rate / 1000, sat.fec_inner );
+
+			if ( sat.modulation_system )
+				g_string_append_printf ( gstring, ":modulation=%d:rolloff=%d", sat.modulation_type, ( sat.roll_off <= GST_MPEGTS_ROLLOFF_25 ) ? (int)sat.roll_off : ROLLOFF_AUTO );
+		}
+	}
+
+	char *data = ( frequency ) ? g_strdup_printf ( ":frequency=%u%s", frequency, gstring->str ) : NULL;
+
+	g_string_free ( gstring, TRUE );
+
+	return data;
+}
+
+static void mpegts_nit_mux ( uint16_t tsid, uint16_t onid, uint8_t delsys, char *data, MpegTs *mpegts )
+{
+	MpegTsMux *mux = NULL;
+
+	uint i = 0; for ( i = 0; i < mpegts->muxes->len; i++ )
+	{
+		MpegTsMux *m = g_ptr_array_index ( mpegts->muxes, i );
+
+		if ( m->tsid == tsid && m->onid == onid ) { mux = m; break; }
+	}
+
+	if ( !mux ) { mux = g_new0 ( MpegTsMux, 1 ); g_ptr_array_add ( mpegts->muxes, mux ); }
+
+	free ( mux->data );
+
+	mux->tsid = tsid;
+	mux->onid = onid;
+	mux->delsys = delsys;
+	mux->data = data;
+}
+
+/* Logical channel numbers: service_id ( 16 ), visible ( 1 ), reserved ( 5 ), lcn ( 10 ) */
+static void mpegts_nit_lcn ( uint16_t tsid, GstMpegtsDescriptor *desc, MpegTs *mpegts )
+{
+	const uint8_t *data = desc->data + 2;
+
+	uint d = 0; for ( d = 0; d + 4 <= desc->length; d += 4 )
+	{
+		uint16_t sid = (uint16_t)( ( data[d] << 8 ) | data[d + 1] );
+		uint16_t lcn = (uint16_t)( ( ( data[d + 2] & 0x03 ) << 8 ) | data[d + 3] );
+
+		if ( lcn ) g_hash_table_insert ( mpegts->lcns, GUINT_TO_POINTER ( ( (uint)tsid << 16 ) | sid ), GUINT_TO_POINTER ( lcn ) );
+	}
+}
+
+static void mpegts_nit ( GstMpegtsSection *section, MpegTs *mpegts )
+{
+	if ( section->table_id != GST_MTS_TABLE_ID_NETWORK_INFORMATION_ACTUAL_NETWORK ) return;
+
+	if ( !mpegts_section_check ( section, mpegts ) ) return;
+
+	const GstMpegtsNIT *nit = gst_mpegts_section_get_nit ( section );
 
-			case GST_MPEGTS_SECTION_PMT:
-				mpegts_pmt ( section, mpegts );
-				break;
+	if ( !nit ) return;
 
-			case GST_MPEGTS_SECTION_SDT:
-				mpegts_sdt ( section, mpegts );
-				break;
+	mpegts->network_id  = nit->network_id;
+	mpegts->nit_version = section->version_number;
 
-			default:
+	if ( mpegts->debug ) g_message ( "NIT: network id %u | version %u | %u Streams ", nit->network_id, section->version_number, nit->streams->len );
+
+	uint i = 0, c = 0; for ( i = 0; i < nit->streams->len; i++ )
+	{
+		GstMpegtsNITStream *stream = g_ptr_array_index ( nit->streams, i );
+
+		uint8_t delsys = SYS_UNDEFINED;
+
+		char *data = mpegts_nit_mux_data ( stream->descriptors, &delsys );
+
+		if ( data ) mpegts_nit_mux ( stream->transport_stream_id, stream->original_network_id, delsys, data, mpegts );
+
+		if ( mpegts->debug ) g_message ( "     tsid %u | onid %u | delsys %u | %s ", stream->transport_stream_id, stream->original_network_id, delsys, ( data ) ? data : "no delivery" );
+
+		for ( c = 0; c < stream->descriptors->len; c++ )
+		{
+			GstMpegtsDescriptor *desc = g_ptr_array_index ( stream->descriptors, c );
+
+			if ( desc->tag == DESC_LCN ) mpegts_nit_lcn ( stream->transport_stream_id, desc, mpegts );
+		}
+	}
+
+	if ( !mpegts->nit_done && mpegts_sections_all ( mpegts->nit_sections, section ) )
+	{
+		mpegts->nit_done = TRUE;
+		if ( mpegts->debug ) g_message ( "NIT Done: sections %u, muxes %u \n", section->last_section_number + 1, mpegts->muxes->len );
+	}
+}
+
+void mpegts_add_section ( GstMpegtsSection *section, MpegTs *mpegts )
+{
+	switch ( GST_MPEGTS_SECTION_TYPE ( section ) )
+	{
+		case GST_MPEGTS_SECTION_PAT:
+			mpegts_pat ( section, mpegts );
+			break;
+
+		case GST_MPEGTS_SECTION_PMT:
+			mpegts_pmt ( section, mpegts );
+			break;
+
+		case GST_MPEGTS_SECTION_SDT:
+			mpegts_sdt ( section, mpegts );
+			break;
+
+		case GST_MPEGTS_SECTION_NIT:
+			mpegts_nit ( section, mpegts );
 			break;
+
+		default:
+		break;
+	}
+}
+
+/* Only the tables of the actual TS: 0x4E present / following, 0x50 - 0x5F schedule */
+static gboolean mpegts_eit ( GstMpegtsSection *section, Epg *epg )
+{
+	uint8_t table_id = section->table_id;
+
+	if ( table_id != 0x4E && ( table_id < 0x50 || table_id > 0x5F ) ) return FALSE;
+
+	if ( !section->data || section->section_length < 14 ) return FALSE;
+
+	uint16_t sid  = section->subtable_extension;
+	uint16_t tsid = (uint16_t)( ( section->data[8]  << 8 ) | section->data[9]  );
+	uint16_t onid = (uint16_t)( ( section->data[10] << 8 ) | section->data[11] );
+
+	if ( !epg_section_check ( onid, tsid, table_id, sid, section->section_number, section->version_number, epg ) ) return FALSE;
+
+	const GstMpegtsEIT *eit = gst_mpegts_section_get_eit ( section );
+
+	if ( !eit ) return FALSE;
+
+	uint i = 0, c = 0;
+	for ( i = 0; i < eit->events->len; i++ )
+	{
+		GstMpegtsEITEvent *event = g_ptr_array_index ( eit->events, i );
+
+		if ( !event->start_time ) continue;
+
+		GDateTime *dt = gst_date_time_to_g_date_time ( event->start_time );
+
+		if ( !dt ) continue;
+
+		time_t start = (time_t)g_date_time_to_unix ( dt );
+		g_date_time_unref ( dt );
+
+		char *title = NULL, *text = NULL;
+
+		for ( c = 0; c < event->descriptors->len && !title; c++ )
+		{
+			GstMpegtsDescriptor *desc = g_ptr_array_index ( event->descriptors, c );
+
+			if ( desc->tag != GST_MTS_DESC_DVB_SHORT_EVENT ) continue;
+
+			char *lang = NULL;
+
+			if ( gst_mpegts_descriptor_parse_dvb_short_event ( desc, &lang, &title, &text ) ) free ( lang );
 		}
 
-		gst_mpegts_section_unref ( section );
+		epg_add ( onid, tsid, sid, start, event->duration, event->event_id, (uint8_t)event->running_status, title, text, epg );
+
+		free ( title );
+		free ( text  );
 	}
+
+	return TRUE;
+}
+
+gboolean mpegts_add_eit ( GstMpegtsSection *section, Epg *epg )
+{
+	if ( GST_MPEGTS_SECTION_TYPE ( section ) != GST_MPEGTS_SECTION_EIT ) return FALSE;
+
+	return mpegts_eit ( section, epg );
+}
+
+gint64 mpegts_scan_deadline ( gint64 time_start, gint64 time_lock, MpegTs *mpegts )
+{
+	gboolean nit_done = ( !mpegts->nit_wanted || mpegts->nit_done );
+
+	if ( mpegts->pat_done && mpegts->pmt_done && mpegts->sdt_done && nit_done ) return 0;
+
+	if ( !time_lock ) return time_start + NOLOCK_MS * 1000;
+
+	if ( !mpegts->pat_done ) return time_lock + SCAN_TIMEOUT_US ( PAT_REPEAT_MS );
+
+	gint64 deadline = 0;
+
+	if ( !mpegts->pmt_done ) deadline = mpegts->time_pat + SCAN_TIMEOUT_US ( PMT_REPEAT_MS );
+
+	if ( !mpegts->sdt_done ) deadline = MAX ( deadline, time_lock + SCAN_TIMEOUT_US ( SDT_REPEAT_MS ) );
+
+	/* One interval: the NIT is the long one */
+	if ( !nit_done ) deadline = MAX ( deadline, time_lock + ( NIT_REPEAT_MS + SCAN_MARGIN_MS ) * 1000 );
+
+	return deadline;
 }
@@ -12,16 +12,40 @@
 #include <gtk/gtk.h>
 #include <gst/gst.h>
 
-#define MAX_RUN_PAT 128
+#define GST_USE_UNSTABLE_API
+#include <gst/mpegts/mpegts.h>
 
-typedef struct _PatPmtSdt PatPmtSdt;
+#include "epg.h"
 
-struct _PatPmtSdt
+/* Services of the multiplex keyed by service_id ( program_number ), in PAT order; a new version of a PAT section removes the services it no longer lists.
+ * PAT / SDT done: all the sections of the table; the SDT also when it has all the services of the PAT. PMT done: all the PMT of the PAT.
+ * A section ( table, extension, number ) with an unchanged version is skipped without parsing */
+
+typedef struct _MpegTsService MpegTsService;
+
+struct _MpegTsService
 {
-	uint16_t pat_sid, pmt_sid, sdt_sid;
+	uint16_t sid;
+	uint16_t pmt_pid;
 	uint16_t pmt_vpid, pmt_apid;
 
 	char *ch_name;
+
+	gboolean pmt, sdt;
+
+	/* PAT section that lists the service */
+	uint8_t pat_section, pat_version;
+};
+
+/* Multiplex of the NIT actual: the tuning data from its delivery system descriptor */
+typedef struct _MpegTsMux MpegTsMux;
+
+struct _MpegTsMux
+{
+	uint16_t tsid, onid;
+	uint8_t delsys;
+
+	char *data; // :frequency=..:.. ( properties of dvbsrc )
 };
 
 typedef struct _MpegTs MpegTs;
@@ -29,17 +53,68 @@ typedef struct _MpegTs MpegTs;
 struct _MpegTs
 {
 	gboolean pat_done, pmt_done, sdt_done;
-	uint8_t pat_count, pmt_count, sdt_count;
+	uint pmt_count, sdt_count;
+
+	uint16_t tsid, onid;
+	gint64 time_pat;
+
+	/* NIT actual ( pid 0x10 ). nit_wanted: the scan waits for it */
+	gboolean nit_wanted, nit_done;
+	int nit_version;
+	uint16_t network_id;
+	uint32_t nit_sections[8];
+
+	GPtrArray *muxes;
+	GHashTable *lcns;         // tsid << 16 | sid → logical channel number
+	GHashTable *sdt_versions; // onid << 16 | tsid → version + 1 ( SDT actual and other )
+
+	/* Received section numbers: a table is done when all its sections ( 0 - last_section_number ) are in */
+	uint32_t pat_sections[8], sdt_sections[8];
 
-	PatPmtSdt pids[MAX_RUN_PAT];
+	GHashTable *services;
+	GArray *order;
+	GHashTable *versions;
+
+	/* SDT sections received before the PAT is done ( psi.c delivers a section only once ) */
+	GPtrArray *sdt_pending;
 
 	gboolean debug;
 };
 
-
 void mpegts_initialize ( void );
 
+MpegTs * mpegts_new ( void );
+
+void mpegts_free ( MpegTs * );
+
 void mpegts_clear ( MpegTs * );
 
-void mpegts_parse_section ( GstMessage *, MpegTs * );
+/* Number of services in the PAT */
+uint mpegts_get_n_services ( MpegTs * );
+
+/* nth service of the PAT */
+MpegTsService * mpegts_get_service_nth ( uint n, MpegTs * );
+
+MpegTsService * mpegts_get_service ( uint16_t sid, MpegTs * );
+
+/* Multiplexes of the NIT */
+uint mpegts_get_n_muxes ( MpegTs * );
+
+const MpegTsMux * mpegts_get_mux_nth ( uint n, MpegTs * );
+
+/* Logical channel number ( NIT: descriptor 0x83 ), 0 - none */
+uint16_t mpegts_get_lcn ( uint16_t tsid, uint16_t sid, MpegTs * );
+
+/* Version of the SDT ( actual or other ) of the multiplex, -1 - not received */
+int mpegts_get_sdt_version ( uint16_t onid, uint16_t tsid, MpegTs * );
+
+/* PAT, PMT, SDT actual, SDT other ( version only ), NIT actual ( psi.c sections ) */
+void mpegts_add_section ( GstMpegtsSection *, MpegTs * );
+
+/* EIT actual ( present / following and schedule ) into the store. Returns TRUE if a new section was stored */
+gboolean mpegts_add_eit ( GstMpegtsSection *, Epg * );
+
+/* Scan of a transponder: monotonic time at which the missing tables are given up, 0 - all done.
+ * time_start: the tuning is over ( set_state returned ); time_lock: 0 - no lock yet */
+gint64 mpegts_scan_deadline ( gint64 time_start, gint64 time_lock, MpegTs * );
 
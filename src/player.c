@@ -19,8 +19,10 @@
 #include "control-mp.h"
 #include "enc-prop.h"
 #include "settings.h"
+#include "timeshift.h"
 
 #include <time.h>
+#include <string.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
 
@@ -51,6 +53,10 @@ struct _Player
 	GFile *file_rec;
 	GstElement *pipeline_rec;
 
+	Timeshift *timeshift;
+	GstElement *pipeline_ts;
+	char *uri_ts;
+
 	time_t t_hide;
 	time_t t_start;
 	gboolean pulse;
@@ -71,6 +77,7 @@ typedef void ( *fp ) ( Player *player );
 
 static void player_record ( Player *player );
 static void player_next_play ( char *file, Player *player );
+static const char * player_timeshift_start ( const char *uri, Player *player );
 
 static void player_message_dialog ( const char *f_error, const char *file_or_info, GtkMessageType mesg_type, Player *player )
 {
@@ -101,11 +108,44 @@ static void player_stop_record ( Player *player )
 	gtk_widget_queue_draw ( GTK_WIDGET ( player->video ) );
 }
 
+static void player_timeshift_stop ( Player *player )
+{
+	if ( !player->pipeline_ts ) return;
+
+	gst_element_set_state ( player->pipeline_ts, GST_STATE_NULL );
+
+	/* The watch holds a ref of the bus: without the removal the bus and its source stay */
+	GstBus *bus = gst_element_get_bus ( player->pipeline_ts );
+	gst_bus_remove_signal_watch ( bus );
+	gst_object_unref ( bus );
+
+	gst_object_unref ( player->pipeline_ts );
+
+	free ( player->uri_ts );
+
+	player->uri_ts = NULL;
+	player->pipeline_ts = NULL;
+}
+
+/* Returns a newly-allocated string holding the uri of the stream ( not "appsrc://" of the timeshift ). Free with free() */
+static char * player_get_uri ( Player *player )
+{
+	char *uri = NULL;
+
+	if ( player->pipeline_ts )
+		uri = g_strdup ( player->uri_ts );
+	else
+		g_object_get ( player->playbin, "current-uri", &uri, NULL );
+
+	return uri;
+}
+
 static void player_set_base ( Player *player )
 {
 	player_stop_record ( player );
 
 	gst_element_set_state ( player->playbin, GST_STATE_NULL );
+	player_timeshift_stop ( player );
 
 	slider_clear_all ( player->slider );
 
@@ -171,6 +211,7 @@ static void player_set_stop ( Player *player )
 	player_stop_record ( player );
 
 	gst_element_set_state ( player->playbin, GST_STATE_NULL );
+	player_timeshift_stop ( player );
 
 	slider_clear_all ( player->slider );
 
@@ -209,7 +250,7 @@ static void player_stop_set_play ( const char *file, Player *player )
 
 	if ( g_strrstr ( file, "://" ) )
 	{
-		g_object_set ( player->playbin, "uri", file, NULL );
+		g_object_set ( player->playbin, "uri", player_timeshift_start ( file, player ), NULL );
 	}
 	else
 	{
@@ -308,8 +349,7 @@ static void player_msg_buf ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Player
 
 static void player_msg_eos ( G_GNUC_UNUSED GstBus *bus, G_GNUC_UNUSED GstMessage *msg, Player *player )
 {
-	g_autofree char *uri = NULL;
-	g_object_get ( player->playbin, "current-uri", &uri, NULL );
+	g_autofree char *uri = player_get_uri ( player );
 
 	if ( uri && ( g_str_has_suffix ( uri, ".png" ) || g_str_has_suffix ( uri, ".jpg" ) ) ) return;
 
@@ -355,6 +395,97 @@ static void player_enc_create_elements ( Player *player )
 	if ( setting ) g_object_unref ( setting );
 }
 
+/* Live MPEG-TS network stream ( udp, http .ts ): not HLS, not a seekable file, not another container */
+static gboolean player_timeshift_check ( const char *uri )
+{
+	if ( g_str_has_prefix ( uri, "udp://" ) ) return TRUE;
+
+	if ( !g_str_has_prefix ( uri, "http://" ) && !g_str_has_prefix ( uri, "https://" ) ) return FALSE;
+
+	/* The path without the query */
+	g_autofree char *path = g_strndup ( uri, strcspn ( uri, "?#" ) );
+
+	return g_str_has_suffix ( path, ".ts" );
+}
+
+static void player_msg_err_ts ( GstBus *bus, GstMessage *msg, Player *player )
+{
+	player_msg_err ( bus, msg, player );
+
+	player_set_stop ( player );
+}
+
+/* Timeshift: uri → queue → fakesink writes the ring, playbin reads it through "appsrc://".
+ * Returns the uri for playbin */
+static const char * player_timeshift_start ( const char *uri, Player *player )
+{
+	if ( !player->timeshift || !player_timeshift_check ( uri ) ) return uri;
+
+	GstElement *pipeline = gst_pipeline_new ( "pipeline-timeshift" );
+	GstElement *src   = gst_element_make_from_uri ( GST_URI_SRC, uri, NULL, NULL );
+	GstElement *queue = gst_element_factory_make ( "queue",    NULL );
+	GstElement *sink  = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !pipeline || !src || !queue || !sink )
+	{
+		g_critical ( "%s:: element (factory make) - source / queue / fakesink not created. \n", __func__ );
+
+		if ( src   ) gst_object_unref ( src   );
+		if ( queue ) gst_object_unref ( queue );
+		if ( sink  ) gst_object_unref ( sink  );
+		if ( pipeline ) gst_object_unref ( pipeline );
+
+		return uri;
+	}
+
+	g_object_set ( sink, "sync", FALSE, "async", FALSE, NULL );
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), src, queue, sink, NULL );
+	gst_element_link_many ( src, queue, sink, NULL );
+
+	GstPad *pad = gst_element_get_static_pad ( sink, "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)timeshift_probe, player->timeshift, NULL );
+	gst_object_unref ( pad );
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	gst_bus_add_signal_watch_full ( bus, G_PRIORITY_DEFAULT );
+	g_signal_connect ( bus, "message::error", G_CALLBACK ( player_msg_err_ts ), player );
+	gst_object_unref ( bus );
+
+	timeshift_reset ( player->timeshift );
+
+	player->uri_ts = g_strdup ( uri );
+	player->pipeline_ts = pipeline;
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	if ( player->debug ) g_message ( "%s: %s ", __func__, uri );
+
+	return "appsrc://";
+}
+
+static void player_source_setup ( G_GNUC_UNUSED GstElement *playbin, GstElement *source, Player *player )
+{
+	if ( !player->pipeline_ts ) return;
+
+	GstElementFactory *factory = gst_element_get_factory ( source );
+
+	if ( factory && g_str_equal ( GST_OBJECT_NAME ( factory ), "appsrc" ) ) timeshift_set_src ( source, player->timeshift );
+}
+
+static void player_create_timeshift ( Player *player )
+{
+	GSettings *setting = settings_init ();
+	uint size = ( setting ) ? g_settings_get_uint ( setting, "timeshift-size" ) : 0;
+	if ( setting ) g_object_unref ( setting );
+
+	if ( size == 0 ) return;
+
+	g_autofree char *path = timeshift_get_path ( "timeshift-iptv.ts" );
+
+	player->timeshift = timeshift_new ( path, (guint64)size * 1024 * 1024 );
+}
+
 static GstElement * player_create ( Player *player )
 {
 	GstElement *playbin = gst_element_factory_make ( "playbin", NULL );
@@ -394,6 +525,8 @@ static GstElement * player_create ( Player *player )
 
 	g_object_set ( playbin, "volume", VOLUME, NULL );
 
+	g_signal_connect ( playbin, "source-setup", G_CALLBACK ( player_source_setup ), player );
+
 	GstBus *bus = gst_element_get_bus ( playbin );
 
 	gst_bus_add_signal_watch_full ( bus, G_PRIORITY_DEFAULT );
@@ -620,8 +753,7 @@ static void player_record ( Player *player )
 {
 	if ( player->pipeline_rec == NULL )
 	{
-		g_autofree char *uri = NULL;
-		g_object_get ( player->playbin, "current-uri", &uri, NULL );
+		g_autofree char *uri = player_get_uri ( player );
 
 		if ( !uri ) return;
 
@@ -1081,6 +1213,8 @@ static void player_video_scroll_new_pos ( gint64 set_pos, gboolean up_dwn, Playe
 	gboolean dur_b = FALSE;
 	gint64 current = 0, duration = 0, new_pos = 0, skip = (gint64)( set_pos * GST_SECOND );
 
+	if ( player->pipeline_ts ) { timeshift_seek ( ( up_dwn ) ? (int)set_pos : -(int)set_pos, player->timeshift ); return; }
+
 	if ( gst_element_query_position ( player->playbin, GST_FORMAT_TIME, &current ) )
 	{
 		if ( gst_element_query_duration ( player->playbin, GST_FORMAT_TIME, &duration ) ) dur_b = TRUE;
@@ -1338,8 +1472,13 @@ static void player_init ( Player *player )
 	gtk_box_set_spacing ( box, 3 );
 
 	player->pipeline_rec = NULL;
+	player->pipeline_ts  = NULL;
+	player->timeshift = NULL;
+	player->uri_ts = NULL;
 	player->playbin = player_create ( player );
 
+	player_create_timeshift ( player );
+
 	player->playlist = player_create_treeview_scroll ( player );
 
 	player->video = (GtkDrawingArea *)gtk_drawing_area_new ();
@@ -1378,8 +1517,10 @@ void player_quit ( Player *player )
 
 	g_object_set ( player->playbin, "mute", FALSE, NULL );
 	gst_element_set_state ( player->playbin, GST_STATE_NULL );
+	player_timeshift_stop ( player );
 
 	gst_object_unref ( player->playbin );
+	if ( player->timeshift ) timeshift_free ( player->timeshift );
 }
 
 void player_run_status ( uint16_t opacity, gboolean status, Player *player )
@@ -0,0 +1,400 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "psi.h"
+
+#include <string.h>
+
+#define TS_PACKET   188
+#define TS_SYNC     0x47
+#define MAX_PID     8192
+#define MAX_SECTION ( 4096 + 3 )
+#define FLUSH_MS    100
+
+typedef struct _PsiPid PsiPid;
+
+struct _PsiPid
+{
+	uint8_t buf[MAX_SECTION];
+	uint len, size;
+
+	int cc;
+	gboolean sync, fixed;
+};
+
+typedef struct _PsiSection PsiSection;
+
+struct _PsiSection
+{
+	uint16_t pid;
+	uint size;
+	uint8_t *data;
+};
+
+struct _Psi
+{
+	PsiPid *pids[MAX_PID];
+	GHashTable *crcs;
+
+	uint8_t carry[TS_PACKET];
+	uint carry_len;
+
+	gboolean follow_pat;
+
+	GMutex mutex;
+	GArray *pending;
+	uint flush_id;
+	uint flush_ms;         // 0 - immediate
+
+	PsiFunc func;
+	gpointer data;
+
+	/* Debug counters: written on the streaming thread, read on the main loop ( atomic ) */
+	int n_sections, n_changed, n_crc_err;
+	gboolean debug;
+};
+
+static uint32_t crc_table[8][256];
+
+static void psi_crc32_init ( void )
+{
+	static gsize init = 0;
+
+	if ( !g_once_init_enter ( &init ) ) return;
+
+	uint n = 0, k = 0;
+	for ( n = 0; n < 256; n++ )
+	{
+		uint32_t crc = (uint32_t)n << 24;
+
+		for ( k = 0; k < 8; k++ ) crc = ( crc & 0x80000000 ) ? ( crc << 1 ) ^ 0x04C11DB7 : crc << 1;
+
+		crc_table[0][n] = crc;
+	}
+
+	for ( n = 0; n < 256; n++ )
+		for ( k = 1; k < 8; k++ )
+			crc_table[k][n] = ( crc_table[k-1][n] << 8 ) ^ crc_table[0][crc_table[k-1][n] >> 24];
+
+	g_once_init_leave ( &init, 1 );
+}
+
+/* Slice-by-8: 8 bytes per step, 8 table lookups */
+uint32_t psi_crc32 ( const uint8_t *data, gsize len )
+{
+	psi_crc32_init ();
+
+	uint32_t crc = 0xFFFFFFFF;
+
+	while ( len >= 8 )
+	{
+		uint32_t a = crc ^ ( ( (uint32_t)data[0] << 24 ) | ( (uint32_t)data[1] << 16 ) | ( (uint32_t)data[2] << 8 ) | data[3] );
+
+		crc = crc_table[7][a >> 24] ^ crc_table[6][( a >> 16 ) & 0xFF] ^ crc_table[5][( a >> 8 ) & 0xFF] ^ crc_table[4][a & 0xFF]
+			^ crc_table[3][data[4]] ^ crc_table[2][data[5]] ^ crc_table[1][data[6]] ^ crc_table[0][data[7]];
+
+		data += 8;
+		len  -= 8;
+	}
+
+	while ( len-- ) crc = ( crc << 8 ) ^ crc_table[0][( crc >> 24 ) ^ *data++];
+
+	return crc;
+}
+
+static PsiPid * psi_pid_new ( gboolean fixed )
+{
+	PsiPid *pp = g_new0 ( PsiPid, 1 );
+
+	pp->cc = -1;
+	pp->fixed = fixed;
+
+	return pp;
+}
+
+void psi_add_pid ( uint16_t pid, Psi *psi )
+{
+	if ( pid >= MAX_PID ) return;
+
+	if ( psi->pids[pid] ) psi->pids[pid]->fixed = TRUE; else psi->pids[pid] = psi_pid_new ( TRUE );
+}
+
+static gboolean psi_flush ( Psi *psi )
+{
+	g_mutex_lock ( &psi->mutex );
+
+		GArray *pending = psi->pending;
+		psi->pending  = g_array_new ( FALSE, FALSE, sizeof ( PsiSection ) );
+		psi->flush_id = 0;
+
+	g_mutex_unlock ( &psi->mutex );
+
+	GPtrArray *sections = g_ptr_array_new_with_free_func ( (GDestroyNotify)gst_mpegts_section_unref );
+
+	uint i = 0; for ( i = 0; i < pending->len; i++ )
+	{
+		PsiSection *ps = &g_array_index ( pending, PsiSection, i );
+
+		GstMpegtsSection *section = gst_mpegts_section_new ( ps->pid, ps->data, ps->size );
+
+		if ( section ) g_ptr_array_add ( sections, section );
+	}
+
+	if ( psi->debug ) g_message ( "%s: %u changed | sections %d, changed %d, crc errors %d ", __func__, sections->len,
+		g_atomic_int_get ( &psi->n_sections ), g_atomic_int_get ( &psi->n_changed ), g_atomic_int_get ( &psi->n_crc_err ) );
+
+	if ( sections->len ) psi->func ( sections, psi->data );
+
+	g_ptr_array_unref ( sections );
+	g_array_free ( pending, TRUE );
+
+	return FALSE;
+}
+
+/* PAT: program 0 - NIT pid, other - PMT pid */
+static void psi_follow_pat ( const uint8_t *buf, uint size, Psi *psi )
+{
+	uint i = 0; for ( i = 8; i + 4 <= size - 4; i += 4 )
+	{
+		uint16_t pid = (uint16_t)( ( ( buf[i + 2] & 0x1F ) << 8 ) | buf[i + 3] );
+
+		if ( !psi->pids[pid] ) psi->pids[pid] = psi_pid_new ( FALSE );
+	}
+}
+
+static void psi_section_done ( uint16_t pid, PsiPid *pp, Psi *psi )
+{
+	const uint8_t *buf = pp->buf;
+	uint size = pp->size;
+
+	/* Only sections with the syntax indicator ( and CRC ) */
+	if ( !( buf[1] & 0x80 ) || size < 12 ) return;
+
+	g_atomic_int_inc ( &psi->n_sections );
+
+	if ( psi_crc32 ( buf, size ) != 0 ) { g_atomic_int_inc ( &psi->n_crc_err ); return; }
+
+	gint64 key = ( (gint64)pid << 40 ) | ( (gint64)buf[0] << 32 ) | ( (gint64)( ( buf[3] << 8 ) | buf[4] ) << 16 ) | buf[6];
+
+	uint32_t crc = (uint32_t)( ( buf[size - 4] << 24 ) | ( buf[size - 3] << 16 ) | ( buf[size - 2] << 8 ) | buf[size - 1] );
+
+	gpointer value = NULL;
+
+	if ( g_hash_table_lookup_extended ( psi->crcs, &key, NULL, &value ) && GPOINTER_TO_UINT ( value ) == crc ) return;
+
+	gint64 *new_key = g_new ( gint64, 1 );
+	*new_key = key;
+
+	g_hash_table_insert ( psi->crcs, new_key, GUINT_TO_POINTER ( crc ) );
+
+	g_atomic_int_inc ( &psi->n_changed );
+
+	if ( psi->follow_pat && pid == 0 && buf[0] == 0x00 ) psi_follow_pat ( buf, size, psi );
+
+	PsiSection ps;
+
+	ps.pid  = pid;
+	ps.size = size;
+	ps.data = g_malloc ( size );
+
+	memcpy ( ps.data, buf, size );
+
+	g_mutex_lock ( &psi->mutex );
+
+		g_array_append_val ( psi->pending, ps );
+
+		if ( !psi->flush_id ) psi->flush_id = g_timeout_add ( psi->flush_ms, (GSourceFunc)psi_flush, psi );
+
+	g_mutex_unlock ( &psi->mutex );
+}
+
+static void psi_pid_feed ( uint16_t pid, const uint8_t *data, uint len, PsiPid *pp, Psi *psi )
+{
+	while ( len > 0 )
+	{
+		if ( pp->len == 0 && data[0] == 0xFF ) return; // stuffing
+
+		uint need = ( pp->size ) ? pp->size - pp->len : 3 - pp->len;
+		uint part = MIN ( need, len );
+
+		memcpy ( pp->buf + pp->len, data, part );
+
+		pp->len += part;
+		data += part;
+		len  -= part;
+
+		if ( pp->size == 0 && pp->len == 3 )
+		{
+			pp->size = 3 + ( ( ( pp->buf[1] & 0x0F ) << 8 ) | pp->buf[2] );
+
+			if ( pp->size > MAX_SECTION ) { pp->len = pp->size = 0; pp->sync = FALSE; return; }
+		}
+
+		if ( pp->size && pp->len == pp->size )
+		{
+			psi_section_done ( pid, pp, psi );
+
+			pp->len = pp->size = 0;
+		}
+	}
+}
+
+static void psi_packet ( const uint8_t *packet, Psi *psi )
+{
+	if ( packet[1] & 0x80 ) return; // transport error
+
+	uint16_t pid = (uint16_t)( ( ( packet[1] & 0x1F ) << 8 ) | packet[2] );
+
+	PsiPid *pp = psi->pids[pid];
+
+	if ( !pp ) return;
+
+	uint8_t afc = ( packet[3] >> 4 ) & 0x03;
+	int cc = packet[3] & 0x0F;
+
+	if ( !( afc & 0x01 ) ) return; // no payload
+
+	if ( cc == pp->cc ) return; // duplicate
+
+	if ( pp->cc != -1 && cc != ( ( pp->cc + 1 ) & 0x0F ) ) { pp->len = pp->size = 0; pp->sync = FALSE; }
+
+	pp->cc = cc;
+
+	uint off = 4;
+
+	if ( afc & 0x02 ) off += 1 + packet[4];
+
+	if ( off >= TS_PACKET ) return;
+
+	const uint8_t *payload = packet + off;
+	uint len = TS_PACKET - off;
+
+	if ( packet[1] & 0x40 )
+	{
+		uint pointer = payload[0];
+
+		if ( 1 + pointer > len ) { pp->len = pp->size = 0; pp->sync = FALSE; return; }
+
+		if ( pp->sync && pp->len ) psi_pid_feed ( pid, payload + 1, pointer, pp, psi );
+
+		pp->len = pp->size = 0;
+		pp->sync = TRUE;
+
+		psi_pid_feed ( pid, payload + 1 + pointer, len - 1 - pointer, pp, psi );
+	}
+	else if ( pp->sync && pp->len )
+		psi_pid_feed ( pid, payload, len, pp, psi );
+}
+
+GstPadProbeReturn psi_probe ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, Psi *psi )
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	GstMapInfo map;
+	if ( !gst_buffer_map ( buffer, &map, GST_MAP_READ ) ) return GST_PAD_PROBE_OK;
+
+	const uint8_t *data = map.data;
+	gsize len = map.size;
+
+	if ( psi->carry_len )
+	{
+		uint part = (uint)MIN ( (gsize)( TS_PACKET - psi->carry_len ), len );
+
+		memcpy ( psi->carry + psi->carry_len, data, part );
+
+		psi->carry_len += part;
+		data += part;
+		len  -= part;
+
+		if ( psi->carry_len == TS_PACKET )
+		{
+			if ( psi->carry[0] == TS_SYNC ) psi_packet ( psi->carry, psi );
+
+			psi->carry_len = 0;
+		}
+	}
+
+	while ( len >= TS_PACKET )
+	{
+		if ( data[0] != TS_SYNC ) { data++; len--; continue; }
+
+		psi_packet ( data, psi );
+
+		data += TS_PACKET;
+		len  -= TS_PACKET;
+	}
+
+	if ( len && data[0] == TS_SYNC )
+	{
+		memcpy ( psi->carry, data, len );
+		psi->carry_len = (uint)len;
+	}
+
+	gst_buffer_unmap ( buffer, &map );
+
+	return GST_PAD_PROBE_OK;
+}
+
+void psi_reset ( Psi *psi )
+{
+	uint i = 0; for ( i = 0; i < MAX_PID; i++ )
+	{
+		if ( !psi->pids[i] ) continue;
+
+		if ( !psi->pids[i]->fixed ) { free ( psi->pids[i] ); psi->pids[i] = NULL; continue; }
+
+		psi->pids[i]->len = psi->pids[i]->size = 0;
+		psi->pids[i]->cc = -1;
+		psi->pids[i]->sync = FALSE;
+	}
+
+	g_hash_table_remove_all ( psi->crcs );
+
+	psi->carry_len = 0;
+	g_atomic_int_set ( &psi->n_sections, 0 );
+	g_atomic_int_set ( &psi->n_changed,  0 );
+	g_atomic_int_set ( &psi->n_crc_err,  0 );
+}
+
+Psi * psi_new ( gboolean follow_pat, gboolean immediate, PsiFunc func, gpointer data )
+{
+	Psi *psi = g_new0 ( Psi, 1 );
+
+	g_mutex_init ( &psi->mutex );
+
+	psi->crcs    = g_hash_table_new_full ( g_int64_hash, g_int64_equal, free, NULL );
+	psi->pending = g_array_new ( FALSE, FALSE, sizeof ( PsiSection ) );
+
+	psi->follow_pat = follow_pat;
+	psi->flush_ms = ( immediate ) ? 0 : FLUSH_MS;
+	psi->func = func;
+	psi->data = data;
+
+	psi->debug = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
+
+	if ( follow_pat ) psi_add_pid ( 0, psi );
+
+	return psi;
+}
+
+void psi_free ( Psi *psi )
+{
+	if ( psi->flush_id ) g_source_remove ( psi->flush_id );
+
+	uint i = 0; for ( i = 0; i < MAX_PID; i++ ) free ( psi->pids[i] );
+
+	for ( i = 0; i < psi->pending->len; i++ ) free ( g_array_index ( psi->pending, PsiSection, i ).data );
+
+	g_array_free ( psi->pending, TRUE );
+	g_hash_table_destroy ( psi->crcs );
+
+	g_mutex_clear ( &psi->mutex );
+
+	free ( psi );
+}
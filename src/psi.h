@@ -0,0 +1,42 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/mpegts/mpegts.h>
+
+/* PSI / SI sections assembled from the TS packets in a buffer probe ( streaming thread ), CRC32 checked ( slice-by-8 ).
+ * A section with the same CRC as the last one of its pid / table / extension / number is dropped there,
+ * the changed ones are handed to the main loop in batches ( every 100 ms, or at once for the offline timings ) */
+
+typedef struct _Psi Psi;
+
+/* Main loop. sections: GstMpegtsSection *, owned by the caller of the func */
+typedef void ( *PsiFunc ) ( GPtrArray *sections, gpointer data );
+
+/* follow_pat: the PMT pids of the PAT ( pid 0 ) are added to the filter; immediate: no batching, each section goes to the main loop at once */
+Psi * psi_new ( gboolean follow_pat, gboolean immediate, PsiFunc func, gpointer data );
+
+void psi_free ( Psi * );
+
+/* Before the stream is started */
+void psi_add_pid ( uint16_t pid, Psi * );
+
+/* New stream: partial sections, the stored CRCs and the pids of the PAT are dropped */
+void psi_reset ( Psi * );
+
+/* Buffer probe: any buffer size ( dvbsrc, filesrc ) */
+GstPadProbeReturn psi_probe ( GstPad *, GstPadProbeInfo *, Psi * );
+
+/* CRC32/MPEG-2 of the sections ( psi, rec-ts ): 0 over a whole section with its CRC */
+uint32_t psi_crc32 ( const uint8_t *data, gsize len );
@@ -0,0 +1,307 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+/* Passthrough record: original TS packets of one service ( PAT / PMT / PCR / all ES ), no demux / remux */
+
+#include "rec-ts.h"
+#include "psi.h"
+
+#include <string.h>
+
+#define MAX_SECTION 4096
+
+typedef struct _RecSection RecSection;
+
+struct _RecSection
+{
+	uint8_t data[MAX_SECTION];
+	uint len, need;
+};
+
+struct _RecTs
+{
+	uint16_t sid;
+	uint16_t tsid;
+	uint16_t pmt_pid;
+	uint16_t pcr_pid;
+
+	uint8_t pat_cc;
+	uint8_t pat_version;
+	uint8_t pmt_version;
+
+	gboolean pat_done;
+	gboolean pmt_done;
+
+	RecSection pat;
+	RecSection pmt;
+
+	uint8_t pids[TS_MAX_PID / 8];
+
+	/* Partial packet at the end of the last buffer */
+	uint8_t carry[TS_PACKET_SIZE];
+	uint carry_len;
+};
+
+static void rec_ts_pid_set ( uint16_t pid, RecTs *rec )
+{
+	rec->pids[pid >> 3] |= (uint8_t)( 1 << ( pid & 7 ) );
+}
+
+static gboolean rec_ts_pid_get ( uint16_t pid, RecTs *rec )
+{
+	return ( rec->pids[pid >> 3] & ( 1 << ( pid & 7 ) ) ) ? TRUE : FALSE;
+}
+
+/* Returns TRUE when a complete section with a valid CRC is in sec->data */
+static gboolean rec_ts_section_push ( const uint8_t *pkt, RecSection *sec )
+{
+	uint8_t afc = ( pkt[3] >> 4 ) & 3;
+	uint off = 4;
+
+	if ( !( afc & 1 ) ) return FALSE;
+	if ( afc & 2 ) off += 1 + pkt[4];
+	if ( off >= TS_PACKET_SIZE ) return FALSE;
+
+	if ( pkt[1] & 0x40 )
+	{
+		off += 1 + pkt[off];
+		if ( off >= TS_PACKET_SIZE ) return FALSE;
+
+		sec->len  = 0;
+		sec->need = 0;
+	}
+	else if ( sec->need == 0 ) return FALSE;
+
+	uint size = TS_PACKET_SIZE - off;
+	if ( sec->len + size > MAX_SECTION ) size = MAX_SECTION - sec->len;
+
+	memcpy ( sec->data + sec->len, pkt + off, size );
+	sec->len += size;
+
+	if ( sec->need == 0 && sec->len >= 3 ) sec->need = 3 + ( ( ( sec->data[1] & 0x0f ) << 8 ) | sec->data[2] );
+
+	if ( sec->need == 0 || sec->len < sec->need ) return FALSE;
+
+	uint need = sec->need;
+	sec->need = 0;
+
+	if ( need < 12 || need > MAX_SECTION ) return FALSE;
+
+	return ( psi_crc32 ( sec->data, need ) == 0 ) ? TRUE : FALSE;
+}
+
+static void rec_ts_parse_pat ( RecTs *rec )
+{
+	const uint8_t *data = rec->pat.data;
+
+	if ( data[0] != 0x00 ) return;
+
+	uint len = 3 + ( ( ( data[1] & 0x0f ) << 8 ) | data[2] );
+
+	rec->tsid = (uint16_t)( ( data[3] << 8 ) | data[4] );
+
+	uint i = 0; for ( i = 8; i + 4 <= len - 4; i += 4 )
+	{
+		uint16_t program = (uint16_t)( ( data[i] << 8 ) | data[i+1] );
+		uint16_t pid = (uint16_t)( ( ( data[i+2] & 0x1f ) << 8 ) | data[i+3] );
+
+		if ( program != rec->sid ) continue;
+
+		if ( rec->pmt_pid != pid ) { rec->pmt_done = FALSE; rec->pat_version = ( rec->pat_version + 1 ) & 0x1f; }
+
+		rec->pmt_pid  = pid;
+		rec->pat_done = TRUE;
+
+		rec_ts_pid_set ( pid, rec );
+	}
+}
+
+static void rec_ts_parse_pmt ( RecTs *rec )
+{
+	const uint8_t *data = rec->pmt.data;
+
+	if ( data[0] != 0x02 ) return;
+	if ( (uint16_t)( ( data[3] << 8 ) | data[4] ) != rec->sid ) return;
+
+	uint8_t version = ( data[5] >> 1 ) & 0x1f;
+
+	if ( rec->pmt_done && rec->pmt_version == version ) return;
+
+	memset ( rec->pids, 0, sizeof ( rec->pids ) );
+	rec_ts_pid_set ( rec->pmt_pid, rec );
+
+	uint len = 3 + ( ( ( data[1] & 0x0f ) << 8 ) | data[2] );
+
+	rec->pcr_pid = (uint16_t)( ( ( data[8] & 0x1f ) << 8 ) | data[9] );
+	if ( rec->pcr_pid != 0x1fff ) rec_ts_pid_set ( rec->pcr_pid, rec );
+
+	uint i = 12 + ( ( ( data[10] & 0x0f ) << 8 ) | data[11] );
+
+	while ( i + 5 <= len - 4 )
+	{
+		uint16_t pid = (uint16_t)( ( ( data[i+1] & 0x1f ) << 8 ) | data[i+2] );
+		uint es_len  = ( ( data[i+3] & 0x0f ) << 8 ) | data[i+4];
+
+		rec_ts_pid_set ( pid, rec );
+
+		i += 5 + es_len;
+	}
+
+	rec->pmt_version = version;
+	rec->pmt_done = TRUE;
+}
+
+/* Single program PAT: sid -> pmt_pid */
+static void rec_ts_write_pat ( uint8_t *pkt, RecTs *rec )
+{
+	memset ( pkt, 0xff, TS_PACKET_SIZE );
+
+	pkt[0] = 0x47;
+	pkt[1] = 0x40;
+	pkt[2] = 0x00;
+	pkt[3] = 0x10 | ( rec->pat_cc & 0x0f );
+	pkt[4] = 0x00;
+
+	rec->pat_cc++;
+
+	uint8_t *sec = pkt + 5;
+
+	sec[0]  = 0x00;
+	sec[1]  = 0xb0;
+	sec[2]  = 13;
+	sec[3]  = (uint8_t)( rec->tsid >> 8 );
+	sec[4]  = (uint8_t)( rec->tsid & 0xff );
+	sec[5]  = (uint8_t)( 0xc1 | ( rec->pat_version << 1 ) );
+	sec[6]  = 0x00;
+	sec[7]  = 0x00;
+	sec[8]  = (uint8_t)( rec->sid >> 8 );
+	sec[9]  = (uint8_t)( rec->sid & 0xff );
+	sec[10] = (uint8_t)( 0xe0 | ( rec->pmt_pid >> 8 ) );
+	sec[11] = (uint8_t)( rec->pmt_pid & 0xff );
+
+	uint32_t crc = psi_crc32 ( sec, 12 );
+
+	sec[12] = (uint8_t)( crc >> 24 );
+	sec[13] = (uint8_t)( crc >> 16 );
+	sec[14] = (uint8_t)( crc >> 8  );
+	sec[15] = (uint8_t)( crc & 0xff );
+}
+
+/* Returns the size written to out: 0 or one packet ( the service packets, the PAT rewritten ) */
+static gsize rec_ts_packet ( const uint8_t *pkt, uint8_t *out, RecTs *rec )
+{
+	uint16_t pid = (uint16_t)( ( ( pkt[1] & 0x1f ) << 8 ) | pkt[2] );
+
+	if ( pid == 0 )
+	{
+		if ( rec_ts_section_push ( pkt, &rec->pat ) ) rec_ts_parse_pat ( rec );
+
+		if ( !( ( pkt[1] & 0x40 ) && rec->pat_done && rec->pmt_done ) ) return 0;
+
+		rec_ts_write_pat ( out, rec );
+
+		return TS_PACKET_SIZE;
+	}
+
+	if ( rec->pat_done && pid == rec->pmt_pid )
+		if ( rec_ts_section_push ( pkt, &rec->pmt ) ) rec_ts_parse_pmt ( rec );
+
+	if ( !( rec->pmt_done && rec_ts_pid_get ( pid, rec ) ) ) return 0;
+
+	memcpy ( out, pkt, TS_PACKET_SIZE );
+
+	return TS_PACKET_SIZE;
+}
+
+GstBuffer * rec_ts_filter ( GstBuffer *buffer, RecTs *rec )
+{
+	GstMapInfo map_in, map_out;
+
+	if ( !gst_buffer_map ( buffer, &map_in, GST_MAP_READ ) ) return NULL;
+
+	/* One more packet: the one completed from the carry */
+	GstBuffer *out = gst_buffer_new_allocate ( NULL, map_in.size + TS_PACKET_SIZE, NULL );
+	gst_buffer_map ( out, &map_out, GST_MAP_WRITE );
+
+	const uint8_t *data = map_in.data;
+	gsize len = map_in.size, size = 0;
+
+	/* A packet split over two buffers ( reads not packet aligned ) */
+	if ( rec->carry_len )
+	{
+		uint part = (uint)MIN ( (gsize)( TS_PACKET_SIZE - rec->carry_len ), len );
+
+		memcpy ( rec->carry + rec->carry_len, data, part );
+
+		rec->carry_len += part;
+		data += part;
+		len  -= part;
+
+		if ( rec->carry_len == TS_PACKET_SIZE )
+		{
+			if ( rec->carry[0] == 0x47 ) size += rec_ts_packet ( rec->carry, map_out.data + size, rec );
+
+			rec->carry_len = 0;
+		}
+	}
+
+	while ( len >= TS_PACKET_SIZE )
+	{
+		if ( data[0] != 0x47 ) { data++; len--; continue; }
+
+		size += rec_ts_packet ( data, map_out.data + size, rec );
+
+		data += TS_PACKET_SIZE;
+		len  -= TS_PACKET_SIZE;
+	}
+
+	if ( len && data[0] == 0x47 )
+	{
+		memcpy ( rec->carry, data, len );
+		rec->carry_len = (uint)len;
+	}
+
+	gst_buffer_unmap ( out, &map_out );
+	gst_buffer_unmap ( buffer, &map_in );
+
+	if ( size == 0 ) { gst_buffer_unref ( out ); return NULL; }
+
+	gst_buffer_set_size ( out, (gssize)size );
+	gst_buffer_copy_into ( out, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1 );
+
+	return out;
+}
+
+GstPadProbeReturn rec_ts_probe ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, RecTs *rec )
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	GstBuffer *out = rec_ts_filter ( buffer, rec );
+
+	if ( out == NULL ) return GST_PAD_PROBE_DROP;
+
+	gst_buffer_unref ( buffer );
+	GST_PAD_PROBE_INFO_DATA ( info ) = out;
+
+	return GST_PAD_PROBE_OK;
+}
+
+RecTs * rec_ts_new ( uint16_t sid )
+{
+	RecTs *rec = g_new0 ( RecTs, 1 );
+
+	rec->sid = sid;
+
+	return rec;
+}
+
+void rec_ts_free ( RecTs *rec )
+{
+	free ( rec );
+}
@@ -0,0 +1,27 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+#define TS_PACKET_SIZE 188
+#define TS_MAX_PID     8192
+
+typedef struct _RecTs RecTs;
+
+RecTs * rec_ts_new ( uint16_t );
+
+void rec_ts_free ( RecTs * );
+
+/* Returns a new buffer with the service packets only, or NULL if nothing left. A partial packet at the end goes on with the next buffer */
+GstBuffer * rec_ts_filter ( GstBuffer *, RecTs * );
+
+GstPadProbeReturn rec_ts_probe ( GstPad *, GstPadProbeInfo *, RecTs * );
@@ -0,0 +1,507 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+/* Record branches on a tee after dvbsrc: attach / detach without touching the live branch */
+
+#include "recorder.h"
+#include "rec-ts.h"
+
+typedef struct _RecItem RecItem;
+
+struct _RecItem
+{
+	GstElement *branch;
+
+	char *name;
+	char *path;
+
+	uint16_t sid;
+
+	time_t start;
+	time_t stop;
+
+	GMutex stats;          // bytes, buffers: the streaming thread adds, the main thread reads
+	guint64 bytes;
+	guint64 buffers;
+};
+
+struct _Recorder
+{
+	GstElement *pipeline;
+	GstElement *tee;
+
+	GList *items;
+
+	char *prefix;
+	uint timeout;
+
+	BufferingProfile profile;
+};
+
+static gboolean recorder_pad_check_type ( GstPad *pad, const char *type )
+{
+	gboolean ret = FALSE;
+
+	GstCaps *caps = gst_pad_get_current_caps ( pad );
+
+	if ( !caps ) return FALSE;
+
+	const char *name = gst_structure_get_name ( gst_caps_get_structure ( caps, 0 ) );
+
+	if ( g_str_has_prefix ( name, type ) ) ret = TRUE;
+
+	gst_caps_unref (caps);
+
+	return ret;
+}
+
+static void recorder_pad_link ( GstPad *pad, GstElement *element )
+{
+	GstPad *pad_va_sink = gst_element_get_static_pad ( element, "sink" );
+
+	if ( gst_pad_is_linked ( pad_va_sink ) || gst_pad_link ( pad, pad_va_sink ) != GST_PAD_LINK_OK )
+		g_debug ( "%s:: linking demux %s pad failed ", __func__, GST_PAD_NAME ( pad ) );
+
+	gst_object_unref ( pad_va_sink );
+}
+
+static void recorder_pad_demux_audio ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *element_audio )
+{
+	if ( recorder_pad_check_type ( pad, "audio" ) ) recorder_pad_link ( pad, element_audio );
+}
+
+static void recorder_pad_demux_video ( G_GNUC_UNUSED GstElement *element, GstPad *pad, GstElement *element_video )
+{
+	if ( recorder_pad_check_type ( pad, "video" ) ) recorder_pad_link ( pad, element_video );
+}
+
+static GstElementFactory * recorder_find_factory ( GstCaps *caps, guint64 num )
+{
+	GList *list, *list_filter;
+
+	static GMutex mutex;
+
+	g_mutex_lock ( &mutex );
+		list = gst_element_factory_list_get_elements ( num, GST_RANK_MARGINAL );
+		list_filter = gst_element_factory_list_filter ( list, caps, GST_PAD_SINK, gst_caps_is_fixed ( caps ) );
+	g_mutex_unlock ( &mutex );
+
+	GstElementFactory *factory = ( list_filter ) ? GST_ELEMENT_FACTORY_CAST ( gst_object_ref ( list_filter->data ) ) : NULL;
+
+	gst_plugin_feature_list_free ( list_filter );
+	gst_plugin_feature_list_free ( list );
+
+	return factory;
+}
+
+static void recorder_typefind_parser ( GstElement *typefind, uint probability, GstCaps *caps, GstElement *mpegtsmux )
+{
+	const char *name_caps = gst_structure_get_name ( gst_caps_get_structure ( caps, 0 ) );
+
+	GstElementFactory *factory = recorder_find_factory ( caps, GST_ELEMENT_FACTORY_TYPE_PARSER );
+
+	if ( !factory ) { g_debug ( "%s: no parser for %s ", __func__, name_caps ); return; }
+
+	GstElement *element = gst_element_factory_create ( factory, NULL );
+	GstObject  *bin     = gst_element_get_parent ( typefind );
+
+	gst_element_unlink ( typefind, mpegtsmux );
+
+	gst_bin_add ( GST_BIN ( bin ), element );
+
+	gst_element_link ( typefind, element );
+	gst_element_link ( element, mpegtsmux );
+
+	gst_element_sync_state_with_parent ( element );
+
+	gst_object_unref ( bin );
+	gst_object_unref ( factory );
+
+	g_debug ( "%s: probability %d%% | name_caps %s ", __func__, probability, name_caps );
+}
+
+static GstElement * recorder_branch_remux ( GstElement *bin, GstElement *queue, GstElement *filesink, uint16_t sid, gboolean video, BufferingProfile profile )
+{
+	struct rec_all_list { const char *name; } rec_all_list_n[] =
+	{
+		{ "tsdemux"   },
+		{ "queue"     }, { "typefind" },
+		{ "queue"     }, { "typefind" },
+		{ "mpegtsmux" }
+	};
+
+	GstElement *elements[ G_N_ELEMENTS ( rec_all_list_n ) ];
+
+	uint8_t c = 0; for ( c = 0; c < G_N_ELEMENTS ( rec_all_list_n ); c++ )
+	{
+		if ( !video && ( c == 3 || c == 4 ) ) continue;
+
+		elements[c] = ( c == 1 || c == 3 ) ? buffering_queue_new ( profile, "rec" ) : gst_element_factory_make ( rec_all_list_n[c].name, NULL );
+
+		if ( !elements[c] )
+		{
+			g_critical ( "%s:: element (factory make) - %s not created. \n", __func__, rec_all_list_n[c].name );
+			return NULL;
+		}
+
+		gst_bin_add ( GST_BIN ( bin ), elements[c] );
+
+		if ( c == 2 || c == 4 ) gst_element_link ( elements[c-1], elements[c] );
+	}
+
+	gst_element_link ( queue, elements[0] );
+
+	g_signal_connect ( elements[0], "pad-added", G_CALLBACK ( recorder_pad_demux_audio ), elements[1] );
+	if ( video ) g_signal_connect ( elements[0], "pad-added", G_CALLBACK ( recorder_pad_demux_video ), elements[3] );
+
+	gst_element_link ( elements[2], elements[5] );
+	if ( video ) gst_element_link ( elements[4], elements[5] );
+
+	gst_element_link ( elements[5], filesink );
+
+	g_signal_connect ( elements[2], "have-type", G_CALLBACK ( recorder_typefind_parser ), elements[5] );
+	if ( video ) g_signal_connect ( elements[4], "have-type", G_CALLBACK ( recorder_typefind_parser ), elements[5] );
+
+	g_object_set ( elements[0], "program-number", sid, NULL );
+
+	return elements[0];
+}
+
+static GstElement * recorder_branch_new ( const char *prefix, uint16_t sid, gboolean video, gboolean passthrough, const char *path, BufferingProfile profile )
+{
+	static uint num = 0;
+
+	g_autofree char *name = g_strdup_printf ( "%s-%u", prefix, num++ );
+
+	GstElement *bin      = gst_bin_new ( name );
+	GstElement *queue    = buffering_queue_new ( profile, "rec" );
+	GstElement *filesink = gst_element_factory_make ( "filesink", NULL );
+
+	if ( !queue || !filesink )
+	{
+		g_critical ( "%s:: element (factory make) - queue / filesink not created. \n", __func__ );
+
+		if ( queue ) gst_object_unref ( queue );
+		if ( filesink ) gst_object_unref ( filesink );
+		gst_object_unref ( bin );
+
+		return NULL;
+	}
+
+	gst_bin_add_many ( GST_BIN ( bin ), queue, filesink, NULL );
+
+	if ( passthrough )
+	{
+		gst_element_link ( queue, filesink );
+
+		GstPad *pad = gst_element_get_static_pad ( queue, "src" );
+		gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)rec_ts_probe, rec_ts_new ( sid ), (GDestroyNotify)rec_ts_free );
+		gst_object_unref ( pad );
+	}
+	else if ( !recorder_branch_remux ( bin, queue, filesink, sid, video, profile ) )
+	{
+		gst_object_unref ( bin );
+
+		return NULL;
+	}
+
+	g_object_set ( filesink, "location", path, NULL );
+
+	GstPad *pad = gst_element_get_static_pad ( queue, "sink" );
+	gst_element_add_pad ( bin, gst_ghost_pad_new ( "sink", pad ) );
+	gst_object_unref ( pad );
+
+	g_object_set_data ( G_OBJECT ( bin ), "filesink", filesink );
+
+	return bin;
+}
+
+static gboolean recorder_branch_attach ( GstElement *pipeline, GstElement *tee, GstElement *branch )
+{
+	if ( !gst_bin_add ( GST_BIN ( pipeline ), branch ) )
+	{
+		g_critical ( "%s:: adding %s failed ", __func__, GST_ELEMENT_NAME ( branch ) );
+
+		/* Still floating */
+		gst_object_unref ( gst_object_ref_sink ( branch ) );
+
+		return FALSE;
+	}
+
+	gst_element_sync_state_with_parent ( branch );
+
+	GstPad *teepad  = gst_element_get_request_pad ( tee, "src_%u" );
+	GstPad *sinkpad = gst_element_get_static_pad  ( branch, "sink" );
+
+	gboolean ret = ( gst_pad_link ( teepad, sinkpad ) == GST_PAD_LINK_OK ) ? TRUE : FALSE;
+
+	if ( !ret )
+	{
+		g_critical ( "%s:: linking tee - %s failed ", __func__, GST_ELEMENT_NAME ( branch ) );
+
+		gst_element_release_request_pad ( tee, teepad );
+
+		gst_element_set_state ( branch, GST_STATE_NULL );
+		gst_bin_remove ( GST_BIN ( pipeline ), branch );
+	}
+
+	gst_object_unref ( sinkpad );
+	gst_object_unref ( teepad );
+
+	return ret;
+}
+
+static gboolean recorder_branch_remove ( GstElement *branch )
+{
+	GstObject *parent = gst_element_get_parent ( branch );
+
+	gst_element_set_state ( branch, GST_STATE_NULL );
+
+	if ( parent )
+	{
+		gst_bin_remove ( GST_BIN ( parent ), branch );
+		gst_object_unref ( parent );
+	}
+
+	gst_object_unref ( branch );
+
+	return FALSE;
+}
+
+static GstPadProbeReturn recorder_eos_probe ( GstPad *pad, GstPadProbeInfo *info, GstElement *branch )
+{
+	if ( GST_EVENT_TYPE ( GST_PAD_PROBE_INFO_EVENT ( info ) ) != GST_EVENT_EOS ) return GST_PAD_PROBE_PASS;
+
+	g_debug ( "%s: %s closed ", __func__, GST_ELEMENT_NAME ( branch ) );
+
+	gst_pad_remove_probe ( pad, GST_PAD_PROBE_INFO_ID (info) );
+
+	g_idle_add ( (GSourceFunc)recorder_branch_remove, branch );
+
+	return GST_PAD_PROBE_DROP;
+}
+
+static GstPadProbeReturn recorder_unlink_probe ( GstPad *teepad, G_GNUC_UNUSED GstPadProbeInfo *info, GstElement *branch )
+{
+	GstPad *sinkpad = gst_element_get_static_pad ( branch, "sink" );
+	GstElement *tee = gst_pad_get_parent_element ( teepad );
+
+	gst_pad_unlink ( teepad, sinkpad );
+	gst_element_release_request_pad ( tee, teepad );
+
+	gst_pad_send_event ( sinkpad, gst_event_new_eos () );
+
+	gst_object_unref ( sinkpad );
+	gst_object_unref ( tee );
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+static void recorder_branch_detach ( GstElement *branch )
+{
+	GstElement *filesink = g_object_get_data ( G_OBJECT ( branch ), "filesink" );
+
+	gst_object_ref ( branch );
+
+	GstPad *pad = gst_element_get_static_pad ( filesink, "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)recorder_eos_probe, branch, NULL );
+	gst_object_unref ( pad );
+
+	GstPad *sinkpad = gst_element_get_static_pad ( branch, "sink" );
+	GstPad *teepad  = gst_pad_get_peer ( sinkpad );
+
+	if ( teepad )
+	{
+		gst_pad_add_probe ( teepad, GST_PAD_PROBE_TYPE_IDLE, (GstPadProbeCallback)recorder_unlink_probe, branch, NULL );
+		gst_object_unref ( teepad );
+	}
+	else
+		gst_pad_send_event ( sinkpad, gst_event_new_eos () );
+
+	gst_object_unref ( sinkpad );
+}
+
+static void recorder_item_free ( RecItem *item )
+{
+	g_mutex_clear ( &item->stats );
+
+	free ( item->name );
+	free ( item->path );
+	free ( item );
+}
+
+/* Statistics in the streaming thread; the item lives as long as the filesink pad */
+static GstPadProbeReturn recorder_stats_probe ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, RecItem *item )
+{
+	gsize size = gst_buffer_get_size ( GST_PAD_PROBE_INFO_BUFFER ( info ) );
+
+	g_mutex_lock ( &item->stats );
+		item->bytes += size;
+		item->buffers++;
+	g_mutex_unlock ( &item->stats );
+
+	return GST_PAD_PROBE_OK;
+}
+
+static RecItem * recorder_find ( uint16_t sid, Recorder *rec )
+{
+	GList *list = NULL;
+
+	for ( list = rec->items; list != NULL; list = list->next )
+	{
+		RecItem *item = (RecItem *)list->data;
+
+		if ( item->sid == sid ) return item;
+	}
+
+	return NULL;
+}
+
+static void recorder_item_stop ( RecItem *item, Recorder *rec )
+{
+	rec->items = g_list_remove ( rec->items, item );
+
+	g_mutex_lock ( &item->stats );
+		guint64 bytes = item->bytes, buffers = item->buffers;
+	g_mutex_unlock ( &item->stats );
+
+	g_debug ( "%s: %s ( %u ) | %" G_GUINT64_FORMAT " bytes | %" G_GUINT64_FORMAT " buffers | %ld s ", __func__, 
+		item->name, item->sid, bytes, buffers, (long)( time ( NULL ) - item->start ) );
+
+	recorder_branch_detach ( item->branch );
+}
+
+gboolean recorder_start ( uint16_t sid, const char *name, gboolean video, gboolean passthrough, const char *path, time_t stop, Recorder *rec )
+{
+	if ( !rec->tee || recorder_find ( sid, rec ) ) return FALSE;
+
+	GstElement *branch = recorder_branch_new ( rec->prefix, sid, video, passthrough, path, rec->profile );
+
+	if ( !branch ) return FALSE;
+
+	/* On failure the branch is gone: no item yet */
+	if ( !recorder_branch_attach ( rec->pipeline, rec->tee, branch ) ) return FALSE;
+
+	RecItem *item = g_new0 ( RecItem, 1 );
+
+	item->branch = branch;
+	item->name   = g_strdup ( name );
+	item->path   = g_strdup ( path );
+	item->sid    = sid;
+	item->start  = time ( NULL );
+	item->stop   = stop;
+
+	g_mutex_init ( &item->stats );
+
+	GstElement *filesink = g_object_get_data ( G_OBJECT ( branch ), "filesink" );
+
+	GstPad *pad = gst_element_get_static_pad ( filesink, "sink" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)recorder_stats_probe, item, (GDestroyNotify)recorder_item_free );
+	gst_object_unref ( pad );
+
+	rec->items = g_list_append ( rec->items, item );
+
+	return TRUE;
+}
+
+void recorder_stop ( uint16_t sid, Recorder *rec )
+{
+	RecItem *item = recorder_find ( sid, rec );
+
+	if ( item ) recorder_item_stop ( item, rec );
+}
+
+void recorder_stop_all ( Recorder *rec )
+{
+	while ( rec->items ) recorder_item_stop ( (RecItem *)rec->items->data, rec );
+}
+
+gboolean recorder_is_active ( uint16_t sid, Recorder *rec )
+{
+	return ( recorder_find ( sid, rec ) ) ? TRUE : FALSE;
+}
+
+uint recorder_count ( Recorder *rec )
+{
+	return g_list_length ( rec->items );
+}
+
+char * recorder_get_info ( Recorder *rec )
+{
+	GString *gstring = g_string_new ( NULL );
+
+	GList *list = NULL;
+	time_t now = time ( NULL );
+
+	for ( list = rec->items; list != NULL; list = list->next )
+	{
+		RecItem *item = (RecItem *)list->data;
+
+		g_mutex_lock ( &item->stats );
+			guint64 bytes = item->bytes;
+		g_mutex_unlock ( &item->stats );
+
+		g_string_append_printf ( gstring, "%s ( %u ):  %ld s  %.1f Mb  %s\n", item->name, item->sid, 
+			(long)( now - item->start ), (double)bytes / 1000000, item->path );
+	}
+
+	return g_string_free ( gstring, FALSE );
+}
+
+void recorder_set_source ( GstElement *pipeline, GstElement *tee, Recorder *rec )
+{
+	g_list_free ( rec->items );
+	rec->items = NULL;
+
+	rec->pipeline = pipeline;
+	rec->tee = tee;
+}
+
+static gboolean recorder_check_stop ( Recorder *rec )
+{
+	time_t now = time ( NULL );
+
+	GList *list = rec->items;
+
+	while ( list != NULL )
+	{
+		RecItem *item = (RecItem *)list->data;
+		list = list->next;
+
+		if ( item->stop && now >= item->stop ) recorder_item_stop ( item, rec );
+	}
+
+	return TRUE;
+}
+
+void recorder_set_buffering ( BufferingProfile profile, Recorder *rec )
+{
+	rec->profile = profile;
+}
+
+Recorder * recorder_new ( const char *prefix )
+{
+	Recorder *rec = g_new0 ( Recorder, 1 );
+
+	rec->prefix  = g_strdup ( prefix );
+	rec->profile = BUFFERING_RECORD;
+	rec->timeout = g_timeout_add_seconds ( 1, (GSourceFunc)recorder_check_stop, rec );
+
+	return rec;
+}
+
+void recorder_free ( Recorder *rec )
+{
+	g_source_remove ( rec->timeout );
+
+	g_list_free ( rec->items );
+
+	free ( rec->prefix );
+	free ( rec );
+}
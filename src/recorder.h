@@ -0,0 +1,47 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+#include "buffering.h"
+
+/* Recordings of several services of one multiplex: each one is a branch ( bin "<prefix>-N" ) on the tee after dvbsrc
+ *   passthrough: queue → filesink ( original packets of the service, see rec-ts.c )
+ *   remux:       queue → tsdemux → queue → typefind → parser → mpegtsmux → filesink
+ * The queues are of the buffering profile ( buffering.c, record by default ) */
+
+typedef struct _Recorder Recorder;
+
+Recorder * recorder_new ( const char *prefix );
+
+void recorder_free ( Recorder * );
+
+/* For the branches started after the call */
+void recorder_set_buffering ( BufferingProfile, Recorder * );
+
+/* New source ( pipeline, tee ) or NULL: recordings of the previous source are forgotten, their branches go with its pipeline */
+void recorder_set_source ( GstElement *pipeline, GstElement *tee, Recorder * );
+
+/* stop: time_t of the end, 0 - until recorder_stop */
+gboolean recorder_start ( uint16_t sid, const char *name, gboolean video, gboolean passthrough, const char *path, time_t stop, Recorder * );
+
+/* The branch is unlinked at the next idle point of the tee pad, gets EOS and is removed when the file is closed */
+void recorder_stop ( uint16_t sid, Recorder * );
+
+void recorder_stop_all ( Recorder * );
+
+gboolean recorder_is_active ( uint16_t sid, Recorder * );
+
+uint recorder_count ( Recorder * );
+
+/* Returns a newly-allocated string ( one line per recording ). Free with free() */
+char * recorder_get_info ( Recorder * );
@@ -14,6 +14,9 @@
 #include "button.h"
 
 #include "mpegts.h"
+#include "psi.h"
+#include "tuner.h"
+#include "scanjob.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -385,6 +388,8 @@ struct _Scan
 	GtkWindow parent_instance;
 
 	GtkLabel *label_device;
+	GtkLabel *label_job;
+	GtkSwitch *network;
 	GtkTreeView *treeview;
 	GtkTreeView *treeview_base;
 
@@ -393,18 +398,31 @@ struct _Scan
 	GstElement *dvbscan;
 	GstElement *dvbsrc;
 
+	GstElement *filescan;
+	GstElement *filesrc;
+	gint64 time_start, time_lock, time_pat, time_pmt, time_sdt;
+	uint check_id;
+
 	MpegTs *mpegts;
+	Psi *psi;
+
+	ScanJob *job;
 
 	uint8_t dvb_type;
 	uint8_t lnb_type;
 
+	int tuner;
 	gboolean debug;
 };
 
 G_DEFINE_TYPE ( Scan, scan, GTK_TYPE_WINDOW )
 
 static void helia_convert_dvb5 ( const char *file, Scan *scan );
+static void scan_file_start ( const char *file, Scan *scan );
+static void scan_initial_start ( const char *file, Scan *scan );
+static uint scan_initial_file ( const char *file, Scan *scan );
 static uint8_t scan_get_dvb_delsys ( int adapter, int frontend );
+static GstElement * scan_get_active ( Scan *scan );
 
 void scan_set_run ( GtkTreeView *treeview_base, GtkWindow *win_base, Scan *scan )
 {
@@ -808,6 +826,107 @@ static GtkBox * scan_convert ( Scan *scan )
 	return g_box;
 }
 
+static void scan_file_set_file ( GtkEntry *entry, G_GNUC_UNUSED GtkEntryIconPosition icon_pos, G_GNUC_UNUSED GdkEventButton *event, Scan *scan )
+{
+	if ( icon_pos == GTK_ENTRY_ICON_PRIMARY )
+	{
+		char *file = helia_open_file ( g_get_home_dir (), GTK_WINDOW ( scan ) );
+
+		if ( file == NULL ) return;
+
+		gtk_entry_set_text ( entry, file );
+
+		free ( file );
+	}
+
+	if ( icon_pos == GTK_ENTRY_ICON_SECONDARY )
+	{
+		const char *file = gtk_entry_get_text ( entry );
+
+		if ( g_file_test ( file, G_FILE_TEST_EXISTS ) )
+			scan_file_start ( file, scan );
+		else
+			scan_message_dialog ( file, g_strerror ( ENOENT ), GTK_MESSAGE_ERROR, scan );
+	}
+}
+
+/* Recorded multiplex ( .ts / .m2ts ): the tuning data of the channels is taken from the scanner pages */
+static GtkBox * scan_file ( Scan *scan )
+{
+	GtkBox *g_box  = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_VERTICAL, 0 );
+
+	GtkLabel *label = (GtkLabel *)gtk_label_new ( "TS file   ⇨  Scan" );
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( label ), FALSE, FALSE, 5 );
+
+	const char *file = g_getenv ( "DVB_SCAN_FILE" );
+
+	GtkEntry *entry = (GtkEntry *)gtk_entry_new ();
+	gtk_entry_set_text ( entry, ( file ) ? file : "record.ts" );
+
+	const char *icon = helia_check_icon_theme ( "helia-play" ) ? "helia-play" : "media-playback-start";
+
+	g_object_set ( entry, "editable", FALSE, NULL );
+	gtk_entry_set_icon_from_icon_name ( entry, GTK_ENTRY_ICON_PRIMARY, "folder" );
+	gtk_entry_set_icon_from_icon_name ( entry, GTK_ENTRY_ICON_SECONDARY, icon );
+	g_signal_connect ( entry, "icon-press", G_CALLBACK ( scan_file_set_file ), scan );
+
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( entry ), FALSE, FALSE, 5 );
+
+	return g_box;
+}
+
+static void scan_initial_set_file ( GtkEntry *entry, G_GNUC_UNUSED GtkEntryIconPosition icon_pos, G_GNUC_UNUSED GdkEventButton *event, Scan *scan )
+{
+	if ( icon_pos == GTK_ENTRY_ICON_PRIMARY )
+	{
+		char *file = helia_open_file ( g_get_home_dir (), GTK_WINDOW ( scan ) );
+
+		if ( file == NULL ) return;
+
+		gtk_entry_set_text ( entry, file );
+
+		free ( file );
+	}
+
+	if ( icon_pos == GTK_ENTRY_ICON_SECONDARY )
+	{
+		const char *file = gtk_entry_get_text ( entry );
+
+		if ( g_file_test ( file, G_FILE_TEST_EXISTS ) )
+			scan_initial_start ( file, scan );
+		else
+			scan_message_dialog ( file, g_strerror ( ENOENT ), GTK_MESSAGE_ERROR, scan );
+	}
+}
+
+/* Initial file ( dvbv5 or legacy frequency table ): all transponders, in parallel on the free tuners */
+static GtkBox * scan_initial ( Scan *scan )
+{
+	GtkBox *g_box  = (GtkBox *)gtk_box_new ( GTK_ORIENTATION_VERTICAL, 0 );
+
+	GtkLabel *label = (GtkLabel *)gtk_label_new ( "Initial file   ⇨  Scan all" );
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( label ), FALSE, FALSE, 5 );
+
+	const char *file = g_getenv ( "DVB_SCAN_INITIAL" );
+
+	GtkEntry *entry = (GtkEntry *)gtk_entry_new ();
+	gtk_entry_set_text ( entry, ( file ) ? file : "dvb-t.conf" );
+
+	const char *icon = helia_check_icon_theme ( "helia-play" ) ? "helia-play" : "media-playback-start";
+
+	g_object_set ( entry, "editable", FALSE, NULL );
+	gtk_entry_set_icon_from_icon_name ( entry, GTK_ENTRY_ICON_PRIMARY, "folder" );
+	gtk_entry_set_icon_from_icon_name ( entry, GTK_ENTRY_ICON_SECONDARY, icon );
+	g_signal_connect ( entry, "icon-press", G_CALLBACK ( scan_initial_set_file ), scan );
+
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( entry ), FALSE, FALSE, 5 );
+
+	scan->label_job = (GtkLabel *)gtk_label_new ( "" );
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( scan->label_job ), FALSE, FALSE, 0 );
+
+	return g_box;
+}
+
 static GtkBox * scan_device ( Scan *scan )
 {
 	GstElement *element = scan->dvbsrc;
@@ -867,6 +986,8 @@ static GtkBox * scan_device ( Scan *scan )
 	gtk_grid_attach ( grid, GTK_WIDGET ( combo_delsys ), 1, 3, 1, 1 );
 
 	gtk_box_pack_start ( g_box, GTK_WIDGET ( scan_convert ( scan ) ), TRUE, TRUE, 10 );
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( scan_file ( scan ) ), TRUE, TRUE, 10 );
+	gtk_box_pack_start ( g_box, GTK_WIDGET ( scan_initial ( scan ) ), TRUE, TRUE, 10 );
 
 	return g_box;
 }
@@ -981,7 +1102,8 @@ static GtkBox * scan_all_box ( uint8_t i, Scan *scan )
 
 
 
-static void scan_get_tp_data ( GString *gstring, Scan *scan )
+/* device: delsys, adapter and frontend first */
+static void scan_get_tp_data ( GString *gstring, gboolean device, Scan *scan )
 {
 	GstElement *element = scan->dvbsrc;
 
@@ -996,7 +1118,7 @@ static void scan_get_tp_data ( GString *gstring, Scan *scan )
 
 	const char *dvb_f[] = { "delsys", "adapter", "frontend" };
 
-	for ( d = 0; d < G_N_ELEMENTS ( dvb_f ); d++ )
+	for ( d = 0; device && d < G_N_ELEMENTS ( dvb_f ); d++ )
 	{
 		g_object_get ( element, dvb_f[d], &d_data, NULL );
 		g_string_append_printf ( gstring, ":%s=%d", dvb_f[d], d_data );
@@ -1152,42 +1274,64 @@ static void scan_set_data_to_treeview ( const char *ch_name, const char *ch_data
 				-1 );
 }
 
+static void scan_job_channel ( const char *ch_name, const char *ch_data, Scan *scan )
+{
+	scan_set_data_to_treeview ( ch_name, ch_data, scan->treeview );
+}
+
+static void scan_job_progress ( uint done, uint total, uint tuners, Scan *scan )
+{
+	char text[100];
+
+	if ( done < total )
+		sprintf ( text, "Transponders  %u / %u   Tuners  %u", done, total, tuners );
+	else
+		sprintf ( text, "Transponders  %u / %u", done, total );
+
+	gtk_label_set_text ( scan->label_job, text );
+}
+
 static void scan_read_ch_to_treeview ( Scan *scan )
 {
 	if ( scan->mpegts->pmt_count == 0 ) return;
 
 	GString *gstr_data = g_string_new ( NULL );
 
-	scan_get_tp_data ( gstr_data, scan );
+	scan_get_tp_data ( gstr_data, TRUE, scan );
 
-	uint8_t i = 0, c = 0;
+	uint i = 0, n = mpegts_get_n_services ( scan->mpegts );
 
-	for ( i = 0; i < scan->mpegts->pmt_count; i++ )
+	for ( i = 0; i < n; i++ )
 	{
-		char *ch_name = NULL;
+		MpegTsService *srv = mpegts_get_service_nth ( i, scan->mpegts );
 
-		for ( c = 0; c < scan->mpegts->sdt_count; c++ )
-			if ( scan->mpegts->pids[i].pmt_sid == scan->mpegts->pids[c].sdt_sid )
-				{ ch_name = scan->mpegts->pids[c].ch_name; break; }
+		if ( !srv->pmt ) continue;
 
 		GString *gstring = g_string_new ( NULL );
 
-		if ( ch_name )
-			ch_name = _strip_ch_name ( ch_name );
+		char *ch_name = NULL;
+
+		if ( srv->ch_name )
+			ch_name = _strip_ch_name ( g_strdup ( srv->ch_name ) );
 		else
-			ch_name = g_strdup_printf ( "Program-%d", scan->mpegts->pids[i].pmt_sid );
+			ch_name = g_strdup_printf ( "Program-%d", srv->sid );
 
-		g_string_append_printf ( gstring, "%s:program-number=%d:video-pid=%d:audio-pid=%d%s", 
+		g_string_append_printf ( gstring, "%s:program-number=%d:video-pid=%d:audio-pid=%d", 
 					ch_name,
-					scan->mpegts->pids[i].pmt_sid, 
-					scan->mpegts->pids[i].pmt_vpid,
-					scan->mpegts->pids[i].pmt_apid, 
-					gstr_data->str );
+					srv->sid, 
+					srv->pmt_vpid,
+					srv->pmt_apid );
+
+		if ( scan->mpegts->pat_done ) g_string_append_printf ( gstring, ":tsid=%u:onid=%u", scan->mpegts->tsid, scan->mpegts->onid );
+
+		g_string_append ( gstring, gstr_data->str );
+
+		GstElement *pipeline = scan_get_active ( scan );
 
 		gboolean play = FALSE;
-		if ( GST_ELEMENT_CAST ( scan->dvbscan )->current_state == GST_STATE_PLAYING ) play = TRUE;
+		if ( pipeline && GST_ELEMENT_CAST ( pipeline )->current_state == GST_STATE_PLAYING ) play = TRUE;
 
-		if ( play && scan->mpegts->pids[i].pmt_apid != 0 ) // ignore other
+		if ( play && srv->pmt_apid != 0 ) // ignore other
 			scan_set_data_to_treeview ( ch_name, gstring->str, scan->treeview );
 
 		g_string_free ( gstring, TRUE );
@@ -1197,39 +1341,172 @@ static void scan_read_ch_to_treeview ( Scan *scan )
 	g_string_free ( gstr_data, TRUE );
 }
 
+/* The scan pipeline not in the NULL state ( tuner or file ) or NULL */
+static GstElement * scan_get_active ( Scan *scan )
+{
+	if ( GST_ELEMENT_CAST ( scan->dvbscan  )->current_state != GST_STATE_NULL ) return scan->dvbscan;
+	if ( GST_ELEMENT_CAST ( scan->filescan )->current_state != GST_STATE_NULL ) return scan->filescan;
+
+	return NULL;
+}
+
+static void scan_file_report ( Scan *scan )
+{
+	gint64 pos = 0;
+	gst_element_query_position ( scan->filesrc, GST_FORMAT_BYTES, &pos );
+
+	g_message ( "%s: PAT %ld ms | PMT %ld ms | SDT %ld ms | read %ld KB | services %u ", __func__,
+		( scan->time_pat ) ? (long)( scan->time_pat - scan->time_start ) / 1000 : -1L,
+		( scan->time_pmt ) ? (long)( scan->time_pmt - scan->time_start ) / 1000 : -1L,
+		( scan->time_sdt ) ? (long)( scan->time_sdt - scan->time_start ) / 1000 : -1L,
+		(long)pos / 1024, mpegts_get_n_services ( scan->mpegts ) );
+}
+
 static void scan_stop ( G_GNUC_UNUSED GtkButton *button, Scan *scan )
 {
-	if ( GST_ELEMENT_CAST ( scan->dvbscan )->current_state == GST_STATE_NULL ) return;
+	if ( scan_job_is_run ( scan->job ) ) scan_job_stop ( scan->job );
+
+	GstElement *pipeline = scan_get_active ( scan );
+
+	if ( !pipeline ) return;
+
+	if ( scan->check_id ) g_source_remove ( scan->check_id );
+	scan->check_id = 0;
 
 	level_set_sgn_snr ( 0, 0, FALSE, FALSE, scan->level );
 
 	scan_read_ch_to_treeview ( scan );
 
-	gst_element_set_state ( scan->dvbscan, GST_STATE_NULL );
+	if ( pipeline == scan->filescan && scan->debug ) scan_file_report ( scan );
+
+	gst_element_set_state ( pipeline, GST_STATE_NULL );
+
+	if ( pipeline == scan->filescan ) return;
+
+	tuner_pool_release ( scan->tuner, tuner_pool_get_default () );
+	scan->tuner = -1;
 }
 
-static gboolean scan_start_time ( Scan *scan )
+static void scan_check ( Scan *scan );
+
+static gboolean scan_check_timeout ( Scan *scan )
 {
-	if ( GST_ELEMENT_CAST ( scan->dvbscan )->current_state == GST_STATE_NULL ) return FALSE;
+	scan->check_id = 0;
 
-	if ( scan->mpegts->pat_done && scan->mpegts->pmt_done && scan->mpegts->sdt_done )
-	{
-		scan_stop ( NULL, scan );
-		return FALSE;
-	}
+	scan_check ( scan );
+
+	return FALSE;
+}
+
+static void scan_check_arm ( gint64 delay, Scan *scan )
+{
+	if ( scan->check_id ) g_source_remove ( scan->check_id );
+
+	scan->check_id = g_timeout_add ( (uint)( delay / 1000 ) + 1, (GSourceFunc)scan_check_timeout, scan );
+}
+
+/* Called on every batch of sections, on the lock and at the next deadline: the scan ends when the tables are done,
+ * when the missing ones are past their timeout ( PAT from the lock; PMT from the PAT; SDT from the lock ) or without lock */
+static void scan_check ( Scan *scan )
+{
+	GstElement *pipeline = scan_get_active ( scan );
+
+	if ( !pipeline ) return;
+
+	MpegTs *mpegts = scan->mpegts;
+
+	gint64 now = g_get_monotonic_time (), deadline = mpegts_scan_deadline ( scan->time_start, scan->time_lock, mpegts );
+
+	if ( deadline == 0 ) { scan_stop ( NULL, scan ); return; }
+
+	if ( pipeline == scan->filescan ) return; // EOS
+
+	if ( now < deadline ) { scan_check_arm ( deadline - now, scan ); return; }
 
-	return TRUE;
+	if ( scan->debug ) g_message ( "%s: timeout | lock %s | pat %d, pmt %d ( %u / %u ), sdt %d ( %u ) ", __func__, ( scan->time_lock ) ? "yes" : "no",
+		mpegts->pat_done, mpegts->pmt_done, mpegts->pmt_count, mpegts_get_n_services ( mpegts ), mpegts->sdt_done, mpegts->sdt_count );
+
+	scan_stop ( NULL, scan );
+}
+
+/* The transponder of the pages as the home of the network: the other multiplexes come from its NIT */
+static void scan_network_start ( Scan *scan )
+{
+	int adapter = 0, frontend = 0, delsys = 0;
+	g_object_get ( scan->dvbsrc, "adapter", &adapter, "frontend", &frontend, "delsys", &delsys, NULL );
+
+	GString *gstring = g_string_new ( NULL );
+
+	scan_get_tp_data ( gstring, FALSE, scan );
+
+	scan_job_add ( (uint8_t)delsys, gstring->str, scan->job );
+
+	g_string_free ( gstring, TRUE );
+
+	if ( !scan_job_start ( adapter, frontend, TRUE, scan->job ) ) scan_message_dialog ( "", "All tuners are busy.", GTK_MESSAGE_WARNING, scan );
 }
 
 static void scan_start ( G_GNUC_UNUSED GtkButton *button, Scan *scan )
 {
-	if ( GST_ELEMENT_CAST ( scan->dvbscan )->current_state == GST_STATE_PLAYING ) return;
+	if ( scan_get_active ( scan ) || scan_job_is_run ( scan->job ) ) return;
+
+	if ( gtk_switch_get_active ( scan->network ) ) { scan_network_start ( scan ); return; }
+
+	TunerPool *pool = tuner_pool_get_default ();
+
+	if ( tuner_pool_count ( pool ) )
+	{
+		int adapter = 0, frontend = 0, delsys = 0;
+		g_object_get ( scan->dvbsrc, "adapter", &adapter, "frontend", &frontend, "delsys", &delsys, NULL );
+
+		scan->tuner = tuner_pool_acquire ( "scan", (uint8_t)delsys, adapter, frontend, TRUE, pool );
+
+		if ( scan->tuner == -1 ) { scan_message_dialog ( "", "All tuners are busy.", GTK_MESSAGE_WARNING, scan ); return; }
+
+		g_object_set ( scan->dvbsrc, "adapter",  tuner_pool_get_adapter  ( scan->tuner, pool ), NULL );
+		g_object_set ( scan->dvbsrc, "frontend", tuner_pool_get_frontend ( scan->tuner, pool ), NULL );
+	}
 
 	mpegts_clear ( scan->mpegts );
+	psi_reset ( scan->psi );
+
+	scan->time_lock = scan->time_pat = scan->time_pmt = scan->time_sdt = 0;
 
 	gst_element_set_state ( scan->dvbscan, GST_STATE_PLAYING );
 
-	g_timeout_add_seconds ( 1, (GSourceFunc)scan_start_time, scan );
+	/* dvbsrc tunes in the state change ( up to its tuning-timeout ): the no-lock deadline starts after it */
+	scan->time_start = g_get_monotonic_time ();
+
+	scan_check ( scan );
+}
+
+/* filesrc → fakesink without sync: the file is read at disk speed, the scan stops when PAT, PMT and SDT are done ( or at EOS ) */
+static void scan_file_start ( const char *file, Scan *scan )
+{
+	if ( scan_get_active ( scan ) || scan_job_is_run ( scan->job ) ) return;
+
+	g_object_set ( scan->filesrc, "location", file, NULL );
+
+	mpegts_clear ( scan->mpegts );
+	psi_reset ( scan->psi );
+
+	scan->time_lock = scan->time_pat = scan->time_pmt = scan->time_sdt = 0;
+	scan->time_start = g_get_monotonic_time ();
+
+	gst_element_set_state ( scan->filescan, GST_STATE_PLAYING );
+}
+
+/* Every transponder of the initial file on its own pipeline: as many at once as there are free tuners of the delivery system */
+static void scan_initial_start ( const char *file, Scan *scan )
+{
+	if ( scan_get_active ( scan ) || scan_job_is_run ( scan->job ) ) return;
+
+	if ( !scan_initial_file ( file, scan ) ) { scan_message_dialog ( file, "No transponders.", GTK_MESSAGE_WARNING, scan ); return; }
+
+	int adapter = 0, frontend = 0;
+	g_object_get ( scan->dvbsrc, "adapter", &adapter, "frontend", &frontend, NULL );
+
+	if ( !scan_job_start ( adapter, frontend, FALSE, scan->job ) ) scan_message_dialog ( "", "All tuners are busy.", GTK_MESSAGE_WARNING, scan );
 }
 
 static void scan_create_control_battons ( GtkBox *box, Scan *scan )
@@ -1250,6 +1527,12 @@ static void scan_create_control_battons ( GtkBox *box, Scan *scan )
 	button = helia_create_button ( hb_box, "helia-stop", "⏹", ICON_SIZE );
 	g_signal_connect ( button, "clicked", G_CALLBACK ( scan_stop ), scan );
 
+	scan->network = (GtkSwitch *)gtk_switch_new ();
+	gtk_widget_set_valign ( GTK_WIDGET ( scan->network ), GTK_ALIGN_CENTER );
+	gtk_widget_set_tooltip_text ( GTK_WIDGET ( scan->network ), "Network ( NIT ): all the multiplexes, unchanged ones from the cache" );
+
+	gtk_box_pack_start ( hb_box, GTK_WIDGET ( scan->network ), FALSE, FALSE, 0 );
+
 	gtk_box_pack_start ( box, GTK_WIDGET ( hb_box ), FALSE, FALSE, 5 );
 }
 
@@ -1275,10 +1558,32 @@ static void scan_msg_all ( G_GNUC_UNUSED GstBus *bus, GstMessage *message, Scan
 			uint8_t ret_snr = (uint8_t)(snr*100/0xffff);
 
 			level_set_sgn_snr ( ret_sgl, ret_snr, lock, FALSE, scan->level );
+
+			if ( lock && !scan->time_lock ) { scan->time_lock = g_get_monotonic_time (); scan_check ( scan ); }
 		}
 	}
+}
+
+static void scan_psi_sections ( GPtrArray *sections, Scan *scan )
+{
+	GstElement *pipeline = scan_get_active ( scan );
+
+	if ( !pipeline || GST_ELEMENT_CAST ( pipeline )->current_state != GST_STATE_PLAYING ) return;
+
+	uint i = 0; for ( i = 0; i < sections->len; i++ ) mpegts_add_section ( g_ptr_array_index ( sections, i ), scan->mpegts );
+
+	gint64 now = g_get_monotonic_time ();
 
-	mpegts_parse_section ( message, scan->mpegts );
+	if ( !scan->time_pat && scan->mpegts->pat_done ) scan->time_pat = now;
+	if ( !scan->time_pmt && scan->mpegts->pmt_done ) scan->time_pmt = now;
+	if ( !scan->time_sdt && scan->mpegts->sdt_done ) scan->time_sdt = now;
+
+	scan_check ( scan );
+}
+
+static void scan_msg_eos ( G_GNUC_UNUSED GstBus *bus, G_GNUC_UNUSED GstMessage *msg, Scan *scan )
+{
+	scan_stop ( NULL, scan );
 }
 
 static void scan_msg_err ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, Scan *scan )
@@ -1313,25 +1618,59 @@ static void scan_set_tune_timeout ( GstElement *element, guint64 time_set )
 	g_debug ( "scan_set_tune_timeout: timeout %ld | timeout set %ld", timeout, timeout_get );
 }
 
+static void scan_create_file ( Scan *scan )
+{
+	scan->filescan = gst_pipeline_new ( "pipeline-scan-file" );
+	scan->filesrc  = gst_element_factory_make ( "filesrc",  NULL );
+	GstElement *filesink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !scan->filescan || !scan->filesrc || !filesink )
+		g_critical ( "%s:: pipeline scan file - not be created.\n", __func__ );
+
+	g_object_set ( filesink, "sync", FALSE, NULL );
+
+	gst_bin_add_many ( GST_BIN ( scan->filescan ), scan->filesrc, filesink, NULL );
+	gst_element_link_many ( scan->filesrc, filesink, NULL );
+
+	GstPad *pad = gst_element_get_static_pad ( scan->filesrc, "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)psi_probe, scan->psi, NULL );
+	gst_object_unref ( pad );
+
+	GstBus *bus = gst_element_get_bus ( scan->filescan );
+	gst_bus_add_signal_watch ( bus );
+
+	g_signal_connect ( bus, "message::eos",   G_CALLBACK ( scan_msg_eos ), scan );
+	g_signal_connect ( bus, "message::error", G_CALLBACK ( scan_msg_err ), scan );
+
+	gst_object_unref ( bus );
+}
+
 static void scan_create ( Scan *scan )
 {
 	mpegts_initialize ();
 
-	scan->mpegts = g_new0 ( MpegTs, 1 );
+	scan->mpegts = mpegts_new ();
 	scan->mpegts->debug = scan->debug;
 
-	GstElement *tsparse, *filesink;
+	GstElement *filesink;
 
 	scan->dvbscan = gst_pipeline_new ( "pipeline-scan" );
 	scan->dvbsrc  = gst_element_factory_make ( "dvbsrc",   NULL );
-	tsparse       = gst_element_factory_make ( "tsparse",  NULL );
 	filesink      = gst_element_factory_make ( "fakesink", NULL );
 
-	if ( !scan->dvbscan || !scan->dvbsrc || !tsparse || !filesink )
+	if ( !scan->dvbscan || !scan->dvbsrc || !filesink )
 		g_critical ( "%s:: pipeline scan - not be created.\n", __func__ );
 
-	gst_bin_add_many ( GST_BIN ( scan->dvbscan ), scan->dvbsrc, tsparse, filesink, NULL );
-	gst_element_link_many ( scan->dvbsrc, tsparse, filesink, NULL );
+	gst_bin_add_many ( GST_BIN ( scan->dvbscan ), scan->dvbsrc, filesink, NULL );
+	gst_element_link_many ( scan->dvbsrc, filesink, NULL );
+
+	/* PAT, SDT ( and the PMT of the PAT ) are assembled on the streaming thread */
+	scan->psi = psi_new ( TRUE, FALSE, (PsiFunc)scan_psi_sections, scan );
+	psi_add_pid ( 0x11, scan->psi );
+
+	GstPad *pad = gst_element_get_static_pad ( scan->dvbsrc, "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)psi_probe, scan->psi, NULL );
+	gst_object_unref ( pad );
 
 	GstBus *bus_scan = gst_element_get_bus ( scan->dvbscan );
 	gst_bus_add_signal_watch ( bus_scan );
@@ -1342,19 +1681,33 @@ static void scan_create ( Scan *scan )
 	gst_object_unref ( bus_scan );
 
 	scan_set_tune_timeout ( scan->dvbsrc, 5 );
+
+	scan_create_file ( scan );
+
+	scan->job = scan_job_new ( (ScanJobFunc)scan_job_channel, (ScanJobProgress)scan_job_progress, scan );
 }
 
 static void scan_window_quit ( G_GNUC_UNUSED GtkWindow *window, Scan *scan )
 {
-	gst_element_set_state ( scan->dvbscan, GST_STATE_NULL );
+	if ( scan->check_id ) g_source_remove ( scan->check_id );
+
+	scan_job_free ( scan->job );
+
+	gst_element_set_state ( scan->dvbscan,  GST_STATE_NULL );
+	gst_element_set_state ( scan->filescan, GST_STATE_NULL );
 
-	g_object_unref ( scan->dvbscan );
+	tuner_pool_release ( scan->tuner, tuner_pool_get_default () );
 
-	free ( scan->mpegts );
+	g_object_unref ( scan->dvbscan  );
+	g_object_unref ( scan->filescan );
+
+	psi_free ( scan->psi );
+	mpegts_free ( scan->mpegts );
 }
 
 static void scan_init ( Scan *scan )
 {
+	scan->tuner = -1;
 	scan->debug = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
 	scan_create ( scan );
 
@@ -1402,6 +1755,12 @@ static void scan_init ( Scan *scan )
 
 	gtk_container_set_border_width ( GTK_CONTAINER ( m_box ), 5 );
 	gtk_container_add ( GTK_CONTAINER ( window ), GTK_WIDGET ( m_box ) );
+
+	const char *file = g_getenv ( "DVB_SCAN_FILE" );
+	if ( file ) scan_file_start ( file, scan );
+
+	const char *initial = g_getenv ( "DVB_SCAN_INITIAL" );
+	if ( initial ) scan_initial_start ( initial, scan );
 }
 
 static void scan_finalize ( GObject *object )
@@ -1517,6 +1876,62 @@ static uint8_t scan_get_dvb_delsys ( int adapter, int frontend )
 	return dtv_delsys;
 }
 
+uint8_t scan_get_dvb_delsys_all ( int adapter, int frontend, uint8_t *list, uint8_t max )
+{
+	uint8_t num = 0;
+
+	char path[80];
+	sprintf ( path, "/dev/dvb/adapter%d/frontend%d", adapter, frontend );
+
+	int fd = open ( path, O_RDONLY );
+
+	if ( fd == -1 )
+	{
+		g_critical ( "%s: %s %s \n", __func__, path, g_strerror ( errno ) );
+		return 0;
+	}
+
+	struct dtv_property dvb_prop[1];
+	struct dtv_properties cmdseq;
+
+	dvb_prop[0].cmd = DTV_ENUM_DELSYS;
+
+	cmdseq.num = 1;
+	cmdseq.props = dvb_prop;
+
+	if ( ( ioctl ( fd, FE_GET_PROPERTY, &cmdseq ) ) == -1 )
+	{
+		perror ( "scan_get_dvb_delsys_all: ioctl FE_GET_PROPERTY " );
+	}
+	else
+	{
+		uint32_t i = 0; for ( i = 0; i < dvb_prop[0].u.buffer.len && num < max; i++ )
+			list[num++] = dvb_prop[0].u.buffer.data[i];
+	}
+
+	close ( fd );
+
+	if ( num == 0 && max > 0 )
+	{
+		list[0] = scan_get_dvb_delsys ( adapter, frontend );
+
+		if ( list[0] != SYS_UNDEFINED ) num = 1;
+	}
+
+	return num;
+}
+
+uint8_t scan_get_dvb_delsys_num ( const char *name )
+{
+	uint8_t i = 0; for ( i = 0; i < G_N_ELEMENTS ( dvb_descr_delsys_type_n ); i++ )
+	{
+		if ( g_str_equal ( name, dvb_descr_delsys_type_n[i].dvb_v5_name ) || g_str_equal ( name, dvb_descr_delsys_type_n[i].text_vis ) )
+			return (uint8_t)dvb_descr_delsys_type_n[i].descr_num;
+	}
+
+	return SYS_UNDEFINED;
+}
+
 char * scan_get_dvb_info ( int adapter, int frontend )
 {
 	int fd = 0, flags = O_RDWR;
@@ -1583,9 +1998,45 @@ static char * _strip_ch_name_convert ( char *name )
 	return g_strstrip ( name );
 }
 
+/* DVBv5 "KEY = VALUE" → :gst-param=value */
+void helia_dvb5_param ( const char *line, GString *gstring )
+{
+	uint z = 0, x = 0;
+
+	char **value_key = g_strsplit ( line, " = ", 0 );
+
+	if ( value_key[0] == NULL || value_key[1] == NULL ) { g_strfreev ( value_key ); return; }
+
+	g_strstrip ( value_key[0] );
+	g_strstrip ( value_key[1] );
+
+	for ( z = 0; z < G_N_ELEMENTS ( param_dvb_n ); z++ )
+	{
+		if ( g_str_equal ( param_dvb_n[z].dvb_v5_name, value_key[0] ) )
+		{
+			g_string_append_printf ( gstring, ":%s=", param_dvb_n[z].gst_param );
+
+			if ( param_dvb_n[z].cdsc == 0 || g_strrstr ( value_key[0], "SAT_NUMBER" ) )
+			{
+				g_string_append ( gstring, value_key[1] );
+			}
+			else
+			{
+				for ( x = 0; x < param_dvb_n[z].cdsc; x++ )
+					if ( g_strrstr ( value_key[1], param_dvb_n[z].dvb_descr[x].dvb_v5_name ) )
+						g_string_append_printf ( gstring, "%d", param_dvb_n[z].dvb_descr[x].descr_num );
+			}
+
+			// g_debug ( "  %s = %s ", param_dvb_n[z].gst_param, value_key[1] );
+		}
+	}
+
+	g_strfreev ( value_key );
+}
+
 static void helia_read_dvb5_data ( const char *ch_data, uint num, int adapter, int frontend, int delsys, Scan *scan )
 {
-	uint n = 0, z = 0, x = 0;
+	uint n = 0;
 
 	char **data = g_strsplit ( ch_data, "\n", 0 );
 
@@ -1596,33 +2047,7 @@ static void helia_read_dvb5_data ( const char *ch_data, uint num, int adapter, i
 
 		g_debug ( "Channel ( %d ): %s ", num, data[0] );
 
-		for ( n = 1; data[n] != NULL && *data[n]; n++ )
-		{
-			char **value_key = g_strsplit ( data[n], " = ", 0 );
-
-			for ( z = 0; z < G_N_ELEMENTS ( param_dvb_n ); z++ )
-			{
-				if ( g_strrstr ( param_dvb_n[z].dvb_v5_name, g_strstrip ( value_key[0] ) ) )
-				{
-					g_string_append_printf ( gstring, ":%s=", param_dvb_n[z].gst_param );
-
-					if ( param_dvb_n[z].cdsc == 0 || g_strrstr ( value_key[0], "SAT_NUMBER" ) )
-					{
-						g_string_append ( gstring, value_key[1] );
-					}
-					else
-					{
-						for ( x = 0; x < param_dvb_n[z].cdsc; x++ )
-							if ( g_strrstr ( value_key[1], param_dvb_n[z].dvb_descr[x].dvb_v5_name ) )
-								g_string_append_printf ( gstring, "%d", param_dvb_n[z].dvb_descr[x].descr_num );
-					}
-
-					// g_debug ( "  %s = %s ", param_dvb_n[z].gst_param, value_key[1] );
-				}
-			}
-
-			g_strfreev ( value_key );
-		}
+		for ( n = 1; data[n] != NULL && *data[n]; n++ ) helia_dvb5_param ( data[n], gstring );
 
 		if ( g_strrstr ( gstring->str, "audio-pid" ) ) // ignore other
 			scan_treeview_dvb_save ( data[0], gstring->str, scan->treeview_base );
@@ -1666,3 +2091,45 @@ static void helia_convert_dvb5 ( const char *file, Scan *scan )
 		return;
 	}
 }
+
+
+
+// Initial file ⇨ Scan job
+
+/* LNB and DiSEqC of the DVB-S/S2 page */
+static void scan_initial_lnb ( GString *gstring, Scan *scan )
+{
+	int d_data = 0;
+
+	g_string_append_printf ( gstring, ":lnb-type=%d", scan->lnb_type );
+
+	if ( scan->lnb_type == LNB_MNL )
+	{
+		const char *lnbf_gst[] = { "lnb-lof1", "lnb-lof2", "lnb-slof" };
+
+		uint8_t l = 0; for ( l = 0; l < G_N_ELEMENTS ( lnbf_gst ); l++ )
+		{
+			g_object_get ( scan->dvbsrc, lnbf_gst[l], &d_data, NULL );
+			g_string_append_printf ( gstring, ":%s=%d", lnbf_gst[l], d_data );
+		}
+	}
+
+	g_object_get ( scan->dvbsrc, "diseqc-source", &d_data, NULL );
+	g_string_append_printf ( gstring, ":diseqc-source=%d", d_data );
+}
+
+/* Returns the number of transponders queued */
+static uint scan_initial_file ( const char *file, Scan *scan )
+{
+	GString *lnb = g_string_new ( NULL );
+
+	scan_initial_lnb ( lnb, scan );
+
+	uint num = scan_job_add_file ( file, lnb->str, scan->job );
+
+	g_string_free ( lnb, TRUE );
+
+	if ( scan->debug ) g_message ( "%s: %s | transponders %u ", __func__, file, num );
+
+	return num;
+}
@@ -24,8 +24,17 @@ void scan_set_run ( GtkTreeView *, GtkWindow *, Scan * );
 
 void set_lnb_lhs ( GstElement *, int );
 
+/* DVBv5 "KEY = VALUE" → :gst-param=value */
+void helia_dvb5_param ( const char *, GString * );
+
 char * scan_get_dvb_info ( int , int );
 
+/* Delivery systems of the frontend ( DTV_ENUM_DELSYS ); returns the number written to the list */
+uint8_t scan_get_dvb_delsys_all ( int , int , uint8_t *, uint8_t );
+
+/* DVBv5 name ( "DVBT2" ) or visible name ( "DVB-T2" ) → SYS_* */
+uint8_t scan_get_dvb_delsys_num ( const char * );
+
 const char * scan_get_info ( const char * );
 
 const char * scan_get_info_descr_vis ( const char *, int );
@@ -0,0 +1,911 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "scanjob.h"
+#include "scan.h"
+#include "mpegts.h"
+#include "psi.h"
+#include "tuner.h"
+#include "channel.h"
+
+#include <string.h>
+#include <linux/dvb/frontend.h>
+
+#define TUNING_TIMEOUT ( 5 * GST_SECOND )
+
+typedef struct _ScanTp ScanTp;
+
+struct _ScanTp
+{
+	uint8_t delsys;
+	char *data;
+};
+
+typedef struct _ScanWorker ScanWorker;
+
+struct _ScanWorker
+{
+	ScanJob *job;
+	ScanTp *tp;
+
+	GstElement *pipeline;
+	GstElement *src;
+
+	Psi *psi;
+	MpegTs *mpegts;
+
+	int tuner, adapter, frontend;
+
+	gint64 time_start, time_lock;
+	uint check_id;
+
+	gboolean tuning;
+	gboolean ended;
+};
+
+struct _ScanJob
+{
+	GQueue *queue;
+	GList *workers;
+	GList *finished;
+	uint idle_id;
+
+	uint total, done, tuners_max;
+	int adapter, frontend;
+
+	GHashTable *services;
+	uint n_channels;
+
+	/* Network: the multiplexes of the NIT are queued once ( onid << 16 | tsid, frequency in kHz );
+	 * a multiplex with an unchanged SDT version ( SDT other of the NIT home ) and tuning data is taken from the cache.
+	 * Only the first transponder ( the home ) waits for the NIT */
+	gboolean network;
+	gboolean nit_asked;
+	gboolean nit_done;
+	GHashTable *muxes;
+	GHashTable *freqs;
+	GHashTable *lcns;
+	GKeyFile *cache;
+	char *cache_file;
+	uint n_cached;
+
+	gint64 time_start;
+
+	ScanJobFunc func;
+	ScanJobProgress progress;
+	gpointer data;
+
+	char *sim_dir;
+	gboolean debug;
+};
+
+static void scan_tp_free ( ScanTp *tp )
+{
+	free ( tp->data );
+	free ( tp );
+}
+
+static long scan_tp_get_frequency ( ScanTp *tp )
+{
+	const char *freq = g_strrstr ( tp->data, ":frequency=" );
+
+	return ( freq ) ? atol ( freq + strlen ( ":frequency=" ) ) : 0;
+}
+
+static uint scan_job_freq_key ( long frequency )
+{
+	return (uint)( ( frequency + 500 ) / 1000 );
+}
+
+static char * scan_job_strip_name ( char *name )
+{
+	uint8_t i = 0; for ( i = 0; name[i] != '\0'; i++ )
+	{
+		if ( name[i] == ':' ) name[i] = ' ';
+	}
+
+	return g_strstrip ( name );
+}
+
+/* The tuning data of the transponder → dvbsrc: a channel record without service fields, applied as the channels of dvb.c */
+static void scan_worker_set_data ( const char *data, GstElement *element )
+{
+	g_autofree char *ch_data = g_strdup_printf ( "transponder%s", data );
+
+	Channel *channel = channel_new ( ch_data );
+
+	if ( !channel ) return;
+
+	channel_apply ( channel, element );
+	channel_free ( channel );
+}
+
+/* The services with audio, once per onid / tsid / sid of the whole job. Returns the channel data ( for the cache ) */
+static GPtrArray * scan_worker_channels ( ScanWorker *worker )
+{
+	GPtrArray *channels = g_ptr_array_new_with_free_func ( g_free );
+
+	ScanJob *job = worker->job;
+	MpegTs *mpegts = worker->mpegts;
+
+	uint i = 0, n = mpegts_get_n_services ( mpegts );
+
+	for ( i = 0; i < n; i++ )
+	{
+		MpegTsService *srv = mpegts_get_service_nth ( i, mpegts );
+
+		if ( !srv->pmt || srv->pmt_apid == 0 ) continue; // ignore other
+
+		uint key = ( (uint)mpegts->tsid << 16 ) | srv->sid;
+
+		char *service = g_strdup_printf ( "%u:%u:%u", mpegts->onid, mpegts->tsid, srv->sid );
+
+		if ( g_hash_table_contains ( job->services, service ) ) { free ( service ); continue; }
+
+		g_hash_table_add ( job->services, service );
+
+		char *ch_name = NULL;
+
+		if ( srv->ch_name )
+			ch_name = scan_job_strip_name ( g_strdup ( srv->ch_name ) );
+		else
+			ch_name = g_strdup_printf ( "Program-%d", srv->sid );
+
+		GString *gstring = g_string_new ( NULL );
+
+		g_string_append_printf ( gstring, "%s:program-number=%d:video-pid=%d:audio-pid=%d", ch_name, srv->sid, srv->pmt_vpid, srv->pmt_apid );
+
+		uint lcn = GPOINTER_TO_UINT ( g_hash_table_lookup ( job->lcns, GUINT_TO_POINTER ( key ) ) );
+		if ( lcn ) g_string_append_printf ( gstring, ":lcn=%u", lcn );
+
+		if ( mpegts->pat_done ) g_string_append_printf ( gstring, ":tsid=%u:onid=%u", mpegts->tsid, mpegts->onid );
+
+		g_string_append_printf ( gstring, ":delsys=%d:adapter=%d:frontend=%d%s", worker->tp->delsys, worker->adapter, worker->frontend, worker->tp->data );
+
+		job->func ( ch_name, gstring->str, job->data );
+		job->n_channels++;
+
+		g_ptr_array_add ( channels, g_string_free ( gstring, FALSE ) );
+
+		free ( ch_name );
+	}
+
+	return channels;
+}
+
+static void scan_job_cache_save ( ScanJob *job )
+{
+	GError *error = NULL;
+
+	if ( !g_key_file_save_to_file ( job->cache, job->cache_file, &error ) )
+	{
+		g_warning ( "%s: %s ", __func__, error->message );
+		g_error_free ( error );
+	}
+}
+
+/* Group of the multiplex: its tuning data, SDT version and channels */
+static void scan_job_cache_set ( uint16_t onid, uint16_t tsid, int sdt_version, ScanTp *tp, GPtrArray *channels, ScanJob *job )
+{
+	char group[32];
+	sprintf ( group, "Mux %u:%u", onid, tsid );
+
+	g_key_file_remove_group ( job->cache, group, NULL );
+
+	g_key_file_set_integer ( job->cache, group, "delsys", tp->delsys );
+	g_key_file_set_string  ( job->cache, group, "data", tp->data );
+	g_key_file_set_integer ( job->cache, group, "sdt-version", sdt_version );
+
+	g_key_file_set_string_list ( job->cache, group, "channels", (const char * const *)channels->pdata, channels->len );
+}
+
+/* Channels of the cache if the multiplex is unchanged: the same tuning data and the same SDT version ( known ) */
+static gboolean scan_job_cache_get ( const MpegTsMux *mux, const char *data, int sdt_version, ScanJob *job )
+{
+	char group[32];
+	sprintf ( group, "Mux %u:%u", mux->onid, mux->tsid );
+
+	if ( sdt_version == -1 || !g_key_file_has_group ( job->cache, group ) ) return FALSE;
+
+	g_autofree char *cache_data = g_key_file_get_string ( job->cache, group, "data", NULL );
+
+	if ( !cache_data || !g_str_equal ( cache_data, data ) ) return FALSE;
+
+	if ( g_key_file_get_integer ( job->cache, group, "sdt-version", NULL ) != sdt_version ) return FALSE;
+
+	char **channels = g_key_file_get_string_list ( job->cache, group, "channels", NULL, NULL );
+
+	uint i = 0; for ( i = 0; channels && channels[i] != NULL; i++ )
+	{
+		g_autofree char *ch_name = g_strndup ( channels[i], strcspn ( channels[i], ":" ) );
+
+		job->func ( ch_name, channels[i], job->data );
+		job->n_channels++;
+	}
+
+	g_strfreev ( channels );
+
+	if ( job->debug ) g_message ( "%s: %s unchanged | sdt version %d ", __func__, group, sdt_version );
+
+	return TRUE;
+}
+
+/* Another network or a new NIT version: the multiplexes of the cache are not trusted ( those scanned by this job are kept ) */
+static void scan_job_cache_network ( uint16_t network_id, int nit_version, ScanJob *job )
+{
+	GError *error = NULL;
+
+	int cache_id      = g_key_file_get_integer ( job->cache, "Network", "network-id",  &error );
+	int cache_version = ( error ) ? -1 : g_key_file_get_integer ( job->cache, "Network", "nit-version", &error );
+
+	if ( error ) g_error_free ( error );
+
+	if ( job->debug ) g_message ( "%s: network id %u | nit version %d | cache %d / %d ", __func__, network_id, nit_version, cache_id, cache_version );
+
+	if ( cache_id != network_id || cache_version != nit_version )
+	{
+		char **groups = g_key_file_get_groups ( job->cache, NULL );
+
+		uint i = 0; for ( i = 0; groups[i] != NULL; i++ )
+		{
+			uint onid = 0, tsid = 0;
+
+			if ( sscanf ( groups[i], "Mux %u:%u", &onid, &tsid ) != 2 ) continue;
+
+			if ( !g_hash_table_contains ( job->muxes, GUINT_TO_POINTER ( ( onid << 16 ) | tsid ) ) ) g_key_file_remove_group ( job->cache, groups[i], NULL );
+		}
+
+		g_strfreev ( groups );
+	}
+
+	g_key_file_set_integer ( job->cache, "Network", "network-id",  network_id  );
+	g_key_file_set_integer ( job->cache, "Network", "nit-version", nit_version );
+}
+
+/* LNB and DiSEqC of the transponder that carried the NIT */
+static char * scan_worker_mux_data ( const MpegTsMux *mux, ScanWorker *worker )
+{
+	GString *gstring = g_string_new ( mux->data );
+
+	if ( mux->delsys == SYS_DVBS || mux->delsys == SYS_DVBS2 )
+	{
+		char **fields = g_strsplit ( worker->tp->data, ":", 0 );
+
+		uint j = 0; for ( j = 0; fields[j] != NULL; j++ )
+			if ( g_str_has_prefix ( fields[j], "lnb-" ) || g_str_has_prefix ( fields[j], "diseqc-source" ) ) g_string_append_printf ( gstring, ":%s", fields[j] );
+
+		g_strfreev ( fields );
+	}
+
+	return g_string_free ( gstring, FALSE );
+}
+
+/* The multiplexes of the NIT not scanned yet: from the cache or into the queue */
+static void scan_worker_network ( ScanWorker *worker )
+{
+	ScanJob *job = worker->job;
+	MpegTs *mpegts = worker->mpegts;
+
+	if ( !job->network ) return;
+
+	if ( mpegts->nit_done && !job->nit_done )
+	{
+		job->nit_done = TRUE;
+
+		scan_job_cache_network ( mpegts->network_id, mpegts->nit_version, job );
+	}
+
+	uint i = 0; for ( i = 0; i < mpegts_get_n_muxes ( mpegts ); i++ )
+	{
+		const MpegTsMux *mux = mpegts_get_mux_nth ( i, mpegts );
+
+		gpointer key = GUINT_TO_POINTER ( ( (uint)mux->onid << 16 ) | mux->tsid );
+
+		g_autofree char *data = scan_worker_mux_data ( mux, worker );
+
+		ScanTp tp = { mux->delsys, data };
+		gpointer freq = GUINT_TO_POINTER ( scan_job_freq_key ( scan_tp_get_frequency ( &tp ) ) );
+
+		if ( g_hash_table_contains ( job->muxes, key ) || g_hash_table_contains ( job->freqs, freq ) ) continue;
+
+		g_hash_table_add ( job->muxes, key );
+		g_hash_table_add ( job->freqs, freq );
+
+		job->total++;
+
+		if ( scan_job_cache_get ( mux, data, mpegts_get_sdt_version ( mux->onid, mux->tsid, mpegts ), job ) ) { job->n_cached++; job->done++; continue; }
+
+		scan_job_add ( mux->delsys, data, job );
+	}
+}
+
+static gboolean scan_job_next ( ScanJob *job );
+
+static void scan_worker_stop ( ScanWorker *worker )
+{
+	gst_element_set_state ( worker->pipeline, GST_STATE_NULL );
+
+	tuner_pool_release ( worker->tuner, tuner_pool_get_default () );
+	worker->tuner = -1;
+}
+
+/* The pipeline is stopped here ( after the tuning if it is still on ), freed on the idle ( the end may come from its own bus or the PSI batch ) */
+static void scan_worker_end ( ScanWorker *worker )
+{
+	if ( worker->ended ) return;
+
+	ScanJob *job = worker->job;
+
+	worker->ended = TRUE;
+
+	if ( worker->check_id ) g_source_remove ( worker->check_id );
+	worker->check_id = 0;
+
+	if ( !worker->tuning ) scan_worker_stop ( worker );
+
+	MpegTs *mpegts = worker->mpegts;
+
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init ( &iter, mpegts->lcns );
+	while ( g_hash_table_iter_next ( &iter, &key, &value ) ) g_hash_table_insert ( job->lcns, key, value );
+
+	GPtrArray *channels = scan_worker_channels ( worker );
+
+	if ( mpegts->pat_done )
+	{
+		g_hash_table_add ( job->muxes, GUINT_TO_POINTER ( ( (uint)mpegts->onid << 16 ) | mpegts->tsid ) );
+
+		scan_job_cache_set ( mpegts->onid, mpegts->tsid, mpegts_get_sdt_version ( mpegts->onid, mpegts->tsid, mpegts ), worker->tp, channels, job );
+	}
+
+	g_ptr_array_unref ( channels );
+
+	scan_worker_network ( worker );
+
+	if ( job->debug ) g_message ( "%s: adapter%d/frontend%d | %ld | services %u | %ld ms ", __func__, worker->adapter, worker->frontend,
+		scan_tp_get_frequency ( worker->tp ), mpegts_get_n_services ( worker->mpegts ), (long)( g_get_monotonic_time () - worker->time_start ) / 1000 );
+
+	job->done++;
+
+	job->workers  = g_list_remove ( job->workers, worker );
+	job->finished = g_list_append ( job->finished, worker );
+
+	if ( !job->idle_id ) job->idle_id = g_idle_add ( (GSourceFunc)scan_job_next, job );
+}
+
+static void scan_worker_check ( ScanWorker *worker );
+
+static gboolean scan_worker_check_timeout ( ScanWorker *worker )
+{
+	worker->check_id = 0;
+
+	scan_worker_check ( worker );
+
+	return FALSE;
+}
+
+/* The deadlines of the tables as in the single scan ( mpegts_scan_deadline ) */
+static void scan_worker_check ( ScanWorker *worker )
+{
+	if ( worker->ended || worker->tuning ) return;
+
+	MpegTs *mpegts = worker->mpegts;
+
+	gint64 now = g_get_monotonic_time (), deadline = mpegts_scan_deadline ( worker->time_start, worker->time_lock, mpegts );
+
+	if ( deadline && now < deadline )
+	{
+		if ( worker->check_id ) g_source_remove ( worker->check_id );
+
+		worker->check_id = g_timeout_add ( (uint)( ( deadline - now ) / 1000 ) + 1, (GSourceFunc)scan_worker_check_timeout, worker );
+
+		return;
+	}
+
+	if ( deadline && worker->job->debug ) g_message ( "%s: timeout | %ld | lock %s | pat %d, pmt %d, sdt %d, nit %d ", __func__, scan_tp_get_frequency ( worker->tp ),
+		( worker->time_lock ) ? "yes" : "no", mpegts->pat_done, mpegts->pmt_done, mpegts->sdt_done, mpegts->nit_done );
+
+	scan_worker_end ( worker );
+}
+
+static void scan_worker_sections ( GPtrArray *sections, ScanWorker *worker )
+{
+	if ( worker->ended ) return;
+
+	uint i = 0; for ( i = 0; i < sections->len; i++ ) mpegts_add_section ( g_ptr_array_index ( sections, i ), worker->mpegts );
+
+	scan_worker_check ( worker );
+}
+
+static void scan_worker_msg_element ( G_GNUC_UNUSED GstBus *bus, GstMessage *message, ScanWorker *worker )
+{
+	if ( worker->ended || worker->time_lock ) return;
+
+	const GstStructure *structure = gst_message_get_structure ( message );
+
+	gboolean lock = FALSE;
+
+	if ( structure && gst_structure_get_boolean ( structure, "lock", &lock ) && lock )
+	{
+		worker->time_lock = g_get_monotonic_time ();
+
+		scan_worker_check ( worker );
+	}
+}
+
+/* set_state has returned in the pool thread: the deadlines start now */
+static void scan_worker_msg_tuned ( G_GNUC_UNUSED GstBus *bus, GstMessage *message, ScanWorker *worker )
+{
+	if ( !gst_message_has_name ( message, "scan-tuned" ) ) return;
+
+	worker->tuning = FALSE;
+
+	if ( worker->ended )
+	{
+		ScanJob *job = worker->job;
+
+		scan_worker_stop ( worker );
+
+		if ( !job->idle_id ) job->idle_id = g_idle_add ( (GSourceFunc)scan_job_next, job );
+
+		return;
+	}
+
+	worker->time_start = g_get_monotonic_time ();
+
+	if ( worker->job->sim_dir ) worker->time_lock = worker->time_start; // file: locked
+
+	scan_worker_check ( worker );
+}
+
+static void scan_worker_msg_eos ( G_GNUC_UNUSED GstBus *bus, G_GNUC_UNUSED GstMessage *msg, ScanWorker *worker )
+{
+	scan_worker_end ( worker );
+}
+
+static void scan_worker_msg_err ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, ScanWorker *worker )
+{
+	GError *err = NULL;
+	char  *dbg = NULL;
+
+	gst_message_parse_error ( msg, &err, &dbg );
+
+	g_warning ( "%s: adapter%d/frontend%d | %ld | %s ", __func__, worker->adapter, worker->frontend, scan_tp_get_frequency ( worker->tp ), err->message );
+
+	g_error_free ( err );
+	g_free ( dbg );
+
+	scan_worker_end ( worker );
+}
+
+static void scan_worker_free ( ScanWorker *worker )
+{
+	/* Job freed during the tuning: waits for it in the state lock */
+	if ( worker->tuning ) scan_worker_stop ( worker );
+
+	GstBus *bus = gst_element_get_bus ( worker->pipeline );
+	gst_bus_remove_signal_watch ( bus );
+	gst_object_unref ( bus );
+
+	gst_object_unref ( worker->pipeline );
+
+	psi_free ( worker->psi );
+	mpegts_free ( worker->mpegts );
+
+	scan_tp_free ( worker->tp );
+
+	free ( worker );
+}
+
+/* dvbsrc → fakesink or filesrc → fakesink ( simulated tuner ), PAT / PMT / SDT assembled on the src pad */
+static ScanWorker * scan_worker_new ( ScanTp *tp, int tuner, int adapter, int frontend, ScanJob *job )
+{
+	GstElement *pipeline = gst_pipeline_new ( NULL );
+	GstElement *src  = gst_element_factory_make ( ( job->sim_dir ) ? "filesrc" : "dvbsrc", NULL );
+	GstElement *sink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !pipeline || !src || !sink )
+	{
+		g_critical ( "%s:: pipeline scan job - not be created.\n", __func__ );
+
+		if ( pipeline ) gst_object_unref ( gst_object_ref_sink ( pipeline ) );
+		if ( src  ) gst_object_unref ( gst_object_ref_sink ( src  ) );
+		if ( sink ) gst_object_unref ( gst_object_ref_sink ( sink ) );
+
+		return NULL;
+	}
+
+	ScanWorker *worker = g_new0 ( ScanWorker, 1 );
+
+	worker->job = job;
+	worker->tp  = tp;
+	worker->pipeline = pipeline;
+	worker->src = src;
+
+	worker->tuner    = tuner;
+	worker->adapter  = adapter;
+	worker->frontend = frontend;
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), src, sink, NULL );
+	gst_element_link_many ( src, sink, NULL );
+
+	if ( job->sim_dir )
+	{
+		g_autofree char *file = g_strdup_printf ( "%s/%ld.ts", job->sim_dir, scan_tp_get_frequency ( tp ) );
+
+		g_object_set ( src,  "location", file, NULL );
+		g_object_set ( sink, "sync", FALSE, NULL );
+	}
+	else
+	{
+		g_object_set ( src, "adapter", adapter, "frontend", frontend, "delsys", tp->delsys, NULL );
+		g_object_set ( src, "tuning-timeout", (guint64)TUNING_TIMEOUT, NULL );
+
+		scan_worker_set_data ( tp->data, src );
+	}
+
+	worker->mpegts = mpegts_new ();
+	worker->mpegts->debug = FALSE;
+	worker->mpegts->nit_wanted = ( job->network && !job->nit_asked );
+
+	job->nit_asked = job->nit_asked || job->network;
+
+	worker->psi = psi_new ( TRUE, FALSE, (PsiFunc)scan_worker_sections, worker );
+	if ( job->network ) psi_add_pid ( 0x10, worker->psi );
+	psi_add_pid ( 0x11, worker->psi );
+
+	GstPad *pad = gst_element_get_static_pad ( src, "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)psi_probe, worker->psi, NULL );
+	gst_object_unref ( pad );
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	gst_bus_add_signal_watch ( bus );
+
+	g_signal_connect ( bus, "message::element",     G_CALLBACK ( scan_worker_msg_element ), worker );
+	g_signal_connect ( bus, "message::application", G_CALLBACK ( scan_worker_msg_tuned ), worker );
+	g_signal_connect ( bus, "message::eos",         G_CALLBACK ( scan_worker_msg_eos ), worker );
+	g_signal_connect ( bus, "message::error",       G_CALLBACK ( scan_worker_msg_err ), worker );
+
+	gst_object_unref ( bus );
+
+	return worker;
+}
+
+/* Pool thread: dvbsrc tunes in the state change ( up to the tuning-timeout ), the frontends of the job in parallel.
+ * Only the pipeline is used here: the worker is not freed before the message */
+static void scan_worker_tune ( GstElement *pipeline, G_GNUC_UNUSED gpointer data )
+{
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	gst_element_post_message ( pipeline, gst_message_new_application ( GST_OBJECT ( pipeline ), gst_structure_new_empty ( "scan-tuned" ) ) );
+}
+
+static void scan_worker_start ( ScanWorker *worker )
+{
+	worker->tuning = TRUE;
+
+	gst_element_call_async ( worker->pipeline, (GstElementCallAsyncFunc)scan_worker_tune, NULL, NULL );
+}
+
+static void scan_job_report ( ScanJob *job )
+{
+	g_message ( "%s: transponders %u ( cache %u ) | tuners %u | channels %u | %ld ms ", __func__, job->done, job->n_cached, job->tuners_max, job->n_channels,
+		(long)( g_get_monotonic_time () - job->time_start ) / 1000 );
+}
+
+/* Ended workers still in their tuning hold the frontend until the message */
+static gboolean scan_job_tuning ( ScanJob *job )
+{
+	GList *l = NULL;
+	for ( l = job->finished; l != NULL; l = l->next )
+		if ( ( (ScanWorker *)l->data )->tuning ) return TRUE;
+
+	return FALSE;
+}
+
+/* The next transponders to the free frontends: one worker per frontend of the pool ( exclusive ),
+ * without the pool one worker on the frontend of the job. A transponder no frontend can tune is dropped */
+static void scan_job_dispatch ( ScanJob *job )
+{
+	TunerPool *pool = tuner_pool_get_default ();
+
+	while ( !g_queue_is_empty ( job->queue ) )
+	{
+		ScanTp *tp = g_queue_peek_head ( job->queue );
+
+		int tuner = -1, adapter = job->adapter, frontend = job->frontend;
+
+		if ( tuner_pool_count ( pool ) )
+		{
+			tuner = tuner_pool_acquire ( "scan", tp->delsys, -1, -1, TRUE, pool );
+
+			if ( tuner != -1 ) { adapter = tuner_pool_get_adapter ( tuner, pool ); frontend = tuner_pool_get_frontend ( tuner, pool ); }
+		}
+		else if ( job->workers != NULL || scan_job_tuning ( job ) ) break;
+
+		if ( tuner == -1 && tuner_pool_count ( pool ) )
+		{
+			if ( job->workers != NULL || scan_job_tuning ( job ) ) break;
+
+			g_warning ( "%s: no frontend for %ld ( delsys %u ) ", __func__, scan_tp_get_frequency ( tp ), tp->delsys );
+
+			scan_tp_free ( g_queue_pop_head ( job->queue ) );
+			job->done++;
+
+			continue;
+		}
+
+		g_queue_pop_head ( job->queue );
+
+		ScanWorker *worker = scan_worker_new ( tp, tuner, adapter, frontend, job );
+
+		if ( !worker ) { tuner_pool_release ( tuner, pool ); scan_tp_free ( tp ); job->done++; continue; }
+
+		job->workers = g_list_append ( job->workers, worker );
+
+		scan_worker_start ( worker );
+	}
+
+	uint tuners = g_list_length ( job->workers );
+
+	if ( tuners > job->tuners_max ) job->tuners_max = tuners;
+
+	if ( job->workers == NULL ) scan_job_cache_save ( job );
+
+	if ( job->workers == NULL && ( job->debug || job->sim_dir ) ) scan_job_report ( job );
+
+	if ( job->progress ) job->progress ( job->done, job->total, tuners, job->data );
+}
+
+static gboolean scan_job_next ( ScanJob *job )
+{
+	job->idle_id = 0;
+
+	/* Those still tuning: on their message */
+	GList *l = job->finished;
+
+	while ( l != NULL )
+	{
+		GList *next = l->next;
+		ScanWorker *worker = (ScanWorker *)l->data;
+
+		if ( !worker->tuning ) { scan_worker_free ( worker ); job->finished = g_list_delete_link ( job->finished, l ); }
+
+		l = next;
+	}
+
+	scan_job_dispatch ( job );
+
+	return FALSE;
+}
+
+void scan_job_add ( uint8_t delsys, const char *tp_data, ScanJob *job )
+{
+	ScanTp *tp = g_new0 ( ScanTp, 1 );
+
+	tp->delsys = delsys;
+	tp->data   = g_strdup ( tp_data );
+
+	g_queue_push_tail ( job->queue, tp );
+
+	if ( job->debug ) g_message ( "%s: delsys %u | %s ", __func__, delsys, tp_data );
+}
+
+/* LNB and DiSEqC of the caller to the satellite transponders */
+static void scan_job_add_tp ( uint8_t delsys, GString *gstring, const char *lnb, ScanJob *job )
+{
+	if ( lnb && ( delsys == SYS_DVBS || delsys == SYS_DVBS2 || delsys == SYS_TURBO ) ) g_string_append ( gstring, lnb );
+
+	scan_job_add ( delsys, gstring->str, job );
+}
+
+/* dvbv5: [CHANNEL]  DELIVERY_SYSTEM = DVBT  FREQUENCY = 474000000 ... */
+static gboolean scan_job_add_dvb5 ( const char *tp_data, const char *lnb, ScanJob *job )
+{
+	uint8_t delsys = SYS_UNDEFINED;
+
+	GString *gstring = g_string_new ( NULL );
+
+	char **data = g_strsplit ( tp_data, "\n", 0 );
+
+	uint n = 0; for ( n = 1; data[n] != NULL; n++ )
+	{
+		char **value_key = g_strsplit ( data[n], "=", 2 );
+
+		if ( value_key[0] && value_key[1] && g_str_equal ( g_strstrip ( value_key[0] ), "DELIVERY_SYSTEM" ) )
+		{
+			char *name = g_strstrip ( value_key[1] );
+
+			if ( g_str_has_prefix ( name, "DVBC/ANNEX_" ) ) sprintf ( name, "DVBC/%c", name[11] ); // DVBC/ANNEX_A → DVBC/A
+
+			delsys = scan_get_dvb_delsys_num ( name );
+		}
+		else
+			helia_dvb5_param ( data[n], gstring );
+
+		g_strfreev ( value_key );
+	}
+
+	g_strfreev ( data );
+
+	gboolean ret = ( delsys != SYS_UNDEFINED && g_strrstr ( gstring->str, ":frequency=" ) ) ? TRUE : FALSE;
+
+	if ( ret ) scan_job_add_tp ( delsys, gstring, lnb, job ); else g_warning ( "%s: no delsys / frequency %s ", __func__, tp_data );
+
+	g_string_free ( gstring, TRUE );
+
+	return ret;
+}
+
+/* Legacy frequency table: T freq bw ... | T2 ... | C freq sr fec mod | S freq pol sr fec | S2 ... ( the rest auto ) */
+static gboolean scan_job_add_legacy ( const char *line, const char *lnb, ScanJob *job )
+{
+	char type[4], arg[16];
+	ulong freq = 0, value = 0;
+
+	int ret = sscanf ( line, "%3s %lu %15s %lu", type, &freq, arg, &value );
+
+	if ( ret < 3 ) return FALSE;
+
+	uint8_t delsys = SYS_UNDEFINED;
+
+	GString *gstring = g_string_new ( NULL );
+	g_string_append_printf ( gstring, ":frequency=%lu", freq );
+
+	if ( g_str_equal ( type, "T" ) || g_str_equal ( type, "T2" ) )
+	{
+		delsys = ( type[1] == '2' ) ? SYS_DVBT2 : SYS_DVBT;
+
+		if ( atol ( arg ) > 0 ) g_string_append_printf ( gstring, ":bandwidth-hz=%ld", atol ( arg ) * 1000000 ); // 8MHz
+	}
+	else if ( g_str_equal ( type, "C" ) )
+	{
+		delsys = SYS_DVBC_ANNEX_A;
+
+		g_string_append_printf ( gstring, ":symbol-rate=%ld", atol ( arg ) );
+	}
+	else if ( ( g_str_equal ( type, "S" ) || g_str_equal ( type, "S2" ) ) && ret == 4 )
+	{
+		delsys = ( type[1] == '2' ) ? SYS_DVBS2 : SYS_DVBS;
+
+		g_string_append_printf ( gstring, ":polarity=%c:symbol-rate=%lu", arg[0], value );
+	}
+
+	if ( delsys != SYS_UNDEFINED ) scan_job_add_tp ( delsys, gstring, lnb, job );
+
+	g_string_free ( gstring, TRUE );
+
+	return ( delsys != SYS_UNDEFINED ) ? TRUE : FALSE;
+}
+
+uint scan_job_add_file ( const char *file, const char *lnb, ScanJob *job )
+{
+	char *contents;
+	GError *err = NULL;
+
+	if ( !g_file_get_contents ( file, &contents, 0, &err ) )
+	{
+		g_warning ( "%s: %s ", __func__, err->message );
+		g_error_free ( err );
+
+		return 0;
+	}
+
+	uint n = 0, num = 0;
+
+	gboolean dvb5 = ( g_strrstr ( contents, "[" ) ) ? TRUE : FALSE;
+
+	char **lines = g_strsplit ( contents, ( dvb5 ) ? "[" : "\n", 0 );
+
+	for ( n = ( dvb5 ) ? 1 : 0; lines[n] != NULL; n++ )
+	{
+		if ( !dvb5 && ( lines[n][0] == '#' || lines[n][0] == '\0' ) ) continue;
+
+		if ( ( dvb5 ) ? scan_job_add_dvb5 ( lines[n], lnb, job ) : scan_job_add_legacy ( lines[n], lnb, job ) ) num++;
+	}
+
+	g_strfreev ( lines );
+	g_free ( contents );
+
+	return num;
+}
+
+gboolean scan_job_start ( int adapter, int frontend, gboolean network, ScanJob *job )
+{
+	if ( job->workers != NULL || g_queue_is_empty ( job->queue ) ) return FALSE;
+
+	job->adapter  = adapter;
+	job->frontend = frontend;
+	job->network  = network;
+
+	job->total = g_queue_get_length ( job->queue );
+	job->done  = 0;
+	job->tuners_max = 0;
+	job->n_channels = 0;
+	job->n_cached   = 0;
+	job->nit_asked  = FALSE;
+	job->nit_done   = FALSE;
+
+	g_hash_table_remove_all ( job->services );
+	g_hash_table_remove_all ( job->muxes );
+	g_hash_table_remove_all ( job->freqs );
+	g_hash_table_remove_all ( job->lcns  );
+
+	GList *l = NULL;
+	for ( l = job->queue->head; l != NULL; l = l->next )
+		g_hash_table_add ( job->freqs, GUINT_TO_POINTER ( scan_job_freq_key ( scan_tp_get_frequency ( (ScanTp *)l->data ) ) ) );
+
+	g_key_file_load_from_file ( job->cache, job->cache_file, G_KEY_FILE_NONE, NULL );
+
+	job->time_start = g_get_monotonic_time ();
+
+	scan_job_dispatch ( job );
+
+	return ( job->tuners_max ) ? TRUE : FALSE;
+}
+
+void scan_job_stop ( ScanJob *job )
+{
+	while ( job->workers != NULL ) scan_worker_end ( (ScanWorker *)job->workers->data );
+
+	g_queue_free_full ( job->queue, (GDestroyNotify)scan_tp_free );
+	job->queue = g_queue_new ();
+
+	job->total = job->done;
+}
+
+gboolean scan_job_is_run ( ScanJob *job )
+{
+	return ( job->workers != NULL ) ? TRUE : FALSE;
+}
+
+ScanJob * scan_job_new ( ScanJobFunc func, ScanJobProgress progress, gpointer data )
+{
+	ScanJob *job = g_new0 ( ScanJob, 1 );
+
+	job->queue    = g_queue_new ();
+	job->services = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+	job->muxes    = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	job->freqs    = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	job->lcns     = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	job->cache    = g_key_file_new ();
+
+	job->func     = func;
+	job->progress = progress;
+	job->data     = data;
+
+	job->debug   = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
+	job->sim_dir = g_strdup ( g_getenv ( "DVB_SCAN_SIM_DIR" ) );
+
+	job->cache_file = g_strdup_printf ( "%s/%s", ( job->sim_dir ) ? job->sim_dir : g_get_user_config_dir (), ( job->sim_dir ) ? "network.conf" : "helia/network.conf" );
+
+	return job;
+}
+
+void scan_job_free ( ScanJob *job )
+{
+	scan_job_stop ( job );
+
+	if ( job->idle_id ) g_source_remove ( job->idle_id );
+
+	g_list_free_full ( job->finished, (GDestroyNotify)scan_worker_free );
+
+	g_queue_free_full ( job->queue, (GDestroyNotify)scan_tp_free );
+	g_hash_table_destroy ( job->services );
+	g_hash_table_destroy ( job->muxes );
+	g_hash_table_destroy ( job->freqs );
+	g_hash_table_destroy ( job->lcns  );
+	g_key_file_free ( job->cache );
+
+	free ( job->cache_file );
+	free ( job->sim_dir );
+	free ( job );
+}
@@ -0,0 +1,47 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+/* Scan job: a queue of transponders spread over all free frontends of the tuner pool, one pipeline per frontend.
+ * Network job: the multiplexes of the NIT are queued too; those with an unchanged SDT version and tuning data are taken from
+ * the cache ( ~/.config/helia/network.conf ) without tuning.
+ * Simulated tuners ( DVB_TUNER_SIM ) read DVB_SCAN_SIM_DIR/<frequency>.ts instead of dvbsrc ( cache: DVB_SCAN_SIM_DIR/network.conf ) */
+
+typedef struct _ScanJob ScanJob;
+
+/* Main loop. ch_data: name:program-number=..:video-pid=..:audio-pid=..[:lcn=..]:tsid=..:onid=..:delsys=..:adapter=..:frontend=..<tp_data> */
+typedef void ( *ScanJobFunc ) ( const char *ch_name, const char *ch_data, gpointer data );
+
+/* Main loop: after every transponder; done == total - the job is finished */
+typedef void ( *ScanJobProgress ) ( uint done, uint total, uint tuners, gpointer data );
+
+ScanJob * scan_job_new ( ScanJobFunc func, ScanJobProgress progress, gpointer data );
+
+void scan_job_free ( ScanJob * );
+
+/* tp_data: :frequency=..:bandwidth-hz=.. ( gst properties of dvbsrc ) */
+void scan_job_add ( uint8_t delsys, const char *tp_data, ScanJob * );
+
+/* Initial file ( dvbv5 or legacy frequency table ): all its transponders are queued.
+ * lnb: fields added to the satellite ones ( :lnb-type=..:diseqc-source=.. ), NULL - none. Returns the number queued */
+uint scan_job_add_file ( const char *file, const char *lnb, ScanJob * );
+
+/* adapter / frontend: without the tuner pool the job runs on this frontend only.
+ * network: the first transponder waits for the NIT, its multiplexes are queued ( or taken from the cache ).
+ * Returns FALSE if the queue is empty or no frontend is free */
+gboolean scan_job_start ( int adapter, int frontend, gboolean network, ScanJob * );
+
+/* The running transponders are ended ( their channels are reported ), the queue is dropped */
+void scan_job_stop ( ScanJob * );
+
+gboolean scan_job_is_run ( ScanJob * );
@@ -0,0 +1,279 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "sighistory.h"
+
+#include <string.h>
+
+#define SIG_RING 8192      // samples, ~ 13 min of dvbsrc stats ( 100 ms )
+#define SIG_RES  3
+
+typedef struct _SigSample SigSample;
+
+struct _SigSample
+{
+	gint64 time;          // real time, us
+	uint channel;         // id, index + 1 in channels
+	uint ber;
+	uint16_t signal;
+	uint16_t snr;
+	gboolean lock;
+};
+
+/* seq: index + 1 of the sample in the slot, 0 - being written */
+typedef struct _SigSlot SigSlot;
+
+struct _SigSlot
+{
+	int seq;
+	SigSample sample;
+};
+
+typedef struct _SigBucket SigBucket;
+
+struct _SigBucket
+{
+	gint64 start;         // 0 - empty
+	uint n;
+	uint n_lock;
+	uint16_t sgl_min, sgl_max;
+	uint16_t snr_min, snr_max;
+	guint64 sgl_sum, snr_sum;
+	uint ber_max;
+};
+
+typedef struct _SigChannel SigChannel;
+
+struct _SigChannel
+{
+	uint id;              // index + 1
+	char *name;
+	SigBucket *buckets[SIG_RES];
+};
+
+struct _SigHistory
+{
+	SigSlot ring[SIG_RING];
+
+	int head;             // next index ( producers, atomic )
+	uint tail;            // next index to drain ( main loop )
+	int channel;          // current id ( atomic ), 0 - none
+	guint64 lost;         // overwritten before they were drained
+
+	GPtrArray *channels;  // SigChannel
+};
+
+static const struct sig_res_list { const char *name; const char *format; gint64 period; uint count; } sig_res_list_n[SIG_RES] =
+{
+	{ "1 s",   "%H:%M:%S",       G_USEC_PER_SEC,        120 },
+	{ "1 min", "%H:%M",          G_USEC_PER_SEC * 60,   180 },
+	{ "1 h",   "%a %d %b %H:00", G_USEC_PER_SEC * 3600, 168 }
+};
+
+static void sig_channel_free ( SigChannel *channel )
+{
+	uint r = 0; for ( r = 0; r < SIG_RES; r++ ) free ( channel->buckets[r] );
+
+	free ( channel->name );
+	free ( channel );
+}
+
+static SigChannel * sig_channel_find ( const char *name, SigHistory *hist )
+{
+	uint i = 0; for ( i = 0; i < hist->channels->len; i++ )
+	{
+		SigChannel *channel = g_ptr_array_index ( hist->channels, i );
+
+		if ( g_str_equal ( channel->name, name ) ) return channel;
+	}
+
+	return NULL;
+}
+
+void sig_history_push ( int signal, int snr, gboolean lock, int ber, SigHistory *hist )
+{
+	int channel = g_atomic_int_get ( &hist->channel );
+
+	if ( !channel ) return;
+
+	uint idx = (uint)g_atomic_int_add ( &hist->head, 1 );
+
+	SigSlot *slot = &hist->ring[idx % SIG_RING];
+
+	g_atomic_int_set ( &slot->seq, 0 );
+
+	slot->sample.time    = g_get_real_time ();
+	slot->sample.channel = (uint)channel;
+	slot->sample.ber     = (uint)MAX ( ber, 0 );
+	slot->sample.signal  = (uint16_t)CLAMP ( signal, 0, 0xffff );
+	slot->sample.snr     = (uint16_t)CLAMP ( snr,    0, 0xffff );
+	slot->sample.lock    = lock;
+
+	g_atomic_int_set ( &slot->seq, (int)( idx + 1 ) );
+}
+
+void sig_history_set_channel ( const char *name, SigHistory *hist )
+{
+	int id = g_atomic_int_get ( &hist->channel );
+
+	if ( !name ) { g_atomic_int_set ( &hist->channel, 0 ); return; }
+
+	if ( id && g_str_equal ( ( (SigChannel *)g_ptr_array_index ( hist->channels, (uint)id - 1 ) )->name, name ) ) return;
+
+	SigChannel *channel = sig_channel_find ( name, hist );
+
+	if ( !channel )
+	{
+		channel = g_new0 ( SigChannel, 1 );
+		channel->id   = hist->channels->len + 1;
+		channel->name = g_strdup ( name );
+
+		uint r = 0; for ( r = 0; r < SIG_RES; r++ ) channel->buckets[r] = g_new0 ( SigBucket, sig_res_list_n[r].count );
+
+		g_ptr_array_add ( hist->channels, channel );
+	}
+
+	g_atomic_int_set ( &hist->channel, (int)channel->id );
+}
+
+static void sig_bucket_add ( const SigSample *sample, gint64 start, SigBucket *bucket )
+{
+	if ( bucket->start != start )
+	{
+		memset ( bucket, 0, sizeof ( SigBucket ) );
+
+		bucket->start   = start;
+		bucket->sgl_min = 0xffff;
+		bucket->snr_min = 0xffff;
+	}
+
+	bucket->n++;
+	if ( sample->lock ) bucket->n_lock++;
+
+	bucket->sgl_min = MIN ( bucket->sgl_min, sample->signal );
+	bucket->sgl_max = MAX ( bucket->sgl_max, sample->signal );
+	bucket->snr_min = MIN ( bucket->snr_min, sample->snr );
+	bucket->snr_max = MAX ( bucket->snr_max, sample->snr );
+
+	bucket->sgl_sum += sample->signal;
+	bucket->snr_sum += sample->snr;
+
+	bucket->ber_max = MAX ( bucket->ber_max, sample->ber );
+}
+
+static void sig_channel_add ( const SigSample *sample, SigChannel *channel )
+{
+	uint r = 0; for ( r = 0; r < SIG_RES; r++ )
+	{
+		gint64 period = sig_res_list_n[r].period;
+		gint64 start  = sample->time - sample->time % period;
+
+		sig_bucket_add ( sample, start, &channel->buckets[r][ (guint64)( start / period ) % sig_res_list_n[r].count ] );
+	}
+}
+
+gboolean sig_history_update ( uint8_t *sgl, uint8_t *snr, gboolean *lock, SigHistory *hist )
+{
+	uint head = (uint)g_atomic_int_get ( &hist->head );
+	uint current = (uint)g_atomic_int_get ( &hist->channel );
+
+	if ( head - hist->tail > SIG_RING ) { hist->lost += head - hist->tail - SIG_RING; hist->tail = head - SIG_RING; }
+
+	gboolean ret = FALSE;
+
+	while ( hist->tail != head )
+	{
+		SigSlot *slot = &hist->ring[hist->tail % SIG_RING];
+
+		int seq = g_atomic_int_get ( &slot->seq );
+
+		/* Not published yet: the next update goes on from here */
+		if ( seq == 0 || (uint)seq < hist->tail + 1 ) break;
+
+		SigSample sample = slot->sample;
+
+		/* Overwritten by a newer sample ( before or while it was copied ) */
+		gboolean valid = ( (uint)seq == hist->tail + 1 && g_atomic_int_get ( &slot->seq ) == seq ) ? TRUE : FALSE;
+
+		hist->tail++;
+
+		if ( !valid ) { hist->lost++; continue; }
+
+		if ( sample.channel == 0 || sample.channel > hist->channels->len ) continue;
+
+		sig_channel_add ( &sample, g_ptr_array_index ( hist->channels, sample.channel - 1 ) );
+
+		if ( sample.channel != current ) continue;
+
+		*sgl  = (uint8_t)( sample.signal * 100 / 0xffff );
+		*snr  = (uint8_t)( sample.snr    * 100 / 0xffff );
+		*lock = sample.lock;
+
+		ret = TRUE;
+	}
+
+	return ret;
+}
+
+char * sig_history_get_report ( const char *name, SigHistory *hist )
+{
+	SigChannel *channel = ( name ) ? sig_channel_find ( name, hist ) : NULL;
+
+	if ( !channel ) return NULL;
+
+	GString *gstring = g_string_new ( NULL );
+
+	g_string_append_printf ( gstring, "%s  ( lost samples: %" G_GUINT64_FORMAT " ) \n", channel->name, hist->lost );
+
+	gint64 now = g_get_real_time ();
+
+	uint r = 0; for ( r = 0; r < SIG_RES; r++ )
+	{
+		gint64 period = sig_res_list_n[r].period;
+		gint64 newest = now - now % period;
+
+		g_string_append_printf ( gstring, "\n%-16s  %-17s  %-17s  %5s  %s \n", sig_res_list_n[r].name, "Sgn min/avg/max", "Snr min/avg/max", "Lock", "BER max" );
+
+		uint k = 0; for ( k = 0; k < sig_res_list_n[r].count; k++ )
+		{
+			gint64 start = newest - (gint64)k * period;
+
+			const SigBucket *bucket = &channel->buckets[r][ (guint64)( start / period ) % sig_res_list_n[r].count ];
+
+			if ( bucket->start != start || bucket->n == 0 ) continue;
+
+			GDateTime *dt = g_date_time_new_from_unix_local ( start / G_USEC_PER_SEC );
+			g_autofree char *str_time = g_date_time_format ( dt, sig_res_list_n[r].format );
+			g_date_time_unref ( dt );
+
+			g_string_append_printf ( gstring, "%-16s  %3u %3u %3u %%     %3u %3u %3u %%     %3u %%  %u%s \n", str_time,
+				(uint)bucket->sgl_min * 100 / 0xffff, (uint)( bucket->sgl_sum / bucket->n * 100 / 0xffff ), (uint)bucket->sgl_max * 100 / 0xffff,
+				(uint)bucket->snr_min * 100 / 0xffff, (uint)( bucket->snr_sum / bucket->n * 100 / 0xffff ), (uint)bucket->snr_max * 100 / 0xffff,
+				bucket->n_lock * 100 / bucket->n, bucket->ber_max, ( bucket->n_lock < bucket->n ) ? "  ◉" : "" );
+		}
+	}
+
+	return g_string_free ( gstring, FALSE );
+}
+
+SigHistory * sig_history_new ( void )
+{
+	SigHistory *hist = g_new0 ( SigHistory, 1 );
+
+	hist->channels = g_ptr_array_new_with_free_func ( (GDestroyNotify)sig_channel_free );
+
+	return hist;
+}
+
+void sig_history_free ( SigHistory *hist )
+{
+	g_ptr_array_unref ( hist->channels );
+
+	free ( hist );
+}
@@ -0,0 +1,35 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+/* Signal quality history: the frontend stats ( signal, SNR, lock, BER ) at full rate in a lock-free ring,
+ * filled from the bus sync handler without blocking ( the oldest samples are overwritten ).
+ * The main loop drains the ring into aggregates per channel: 1 s ( 2 min ), 1 min ( 3 h ), 1 h ( 1 week ) -
+ * min / avg / max, time locked, max BER - for dish alignment and outage diagnosis */
+
+typedef struct _SigHistory SigHistory;
+
+SigHistory * sig_history_new ( void );
+
+void sig_history_free ( SigHistory * );
+
+/* Any thread: signal, snr 0 - 0xffff ( dvbsrc ) */
+void sig_history_push ( int signal, int snr, gboolean lock, int ber, SigHistory * );
+
+/* Main loop: the following samples belong to the channel; NULL - stopped ( samples are not kept ) */
+void sig_history_set_channel ( const char *name, SigHistory * );
+
+/* Main loop: the new samples go to the aggregates. Returns TRUE with the latest sample of the current channel ( % ) if there is a new one */
+gboolean sig_history_update ( uint8_t *sgl, uint8_t *snr, gboolean *lock, SigHistory * );
+
+/* Main loop. Returns a newly-allocated string ( a table per resolution, newest first ), NULL - no history. Free with free() */
+char * sig_history_get_report ( const char *name, SigHistory * );
@@ -0,0 +1,354 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMER_EXTEND     60
+#define TIMER_EXTEND_MAX ( 3 * 3600 )
+#define TIMER_EPG_EXPIRE 60
+
+/* EIT running_status */
+#define RUNNING_STATUS_RUNNING 4
+
+struct _TimerList
+{
+	GList *timers;
+	char *file;
+	uint next_id;
+
+	Epg *epg;
+	TimerFunc func;
+	gpointer data;
+
+	time_t offset;
+	time_t epg_expire;
+	uint src_id;
+	gboolean debug;
+};
+
+static void timer_free ( Timer *timer )
+{
+	free ( timer->data );
+	free ( timer );
+}
+
+static void timer_list_save ( TimerList *list )
+{
+	GKeyFile *key_file = g_key_file_new ();
+
+	GList *l = NULL;
+	for ( l = list->timers; l != NULL; l = l->next )
+	{
+		Timer *timer = (Timer *)l->data;
+
+		if ( timer->state == TIMER_DONE || timer->state == TIMER_FAILED ) continue;
+
+		char group[32];
+		sprintf ( group, "Timer %u", timer->id );
+
+		g_key_file_set_string  ( key_file, group, "data",       timer->data );
+		g_key_file_set_integer ( key_file, group, "sid",        timer->sid  );
+		g_key_file_set_integer ( key_file, group, "event-id",   timer->event_id );
+		g_key_file_set_int64   ( key_file, group, "start",      (gint64)timer->start );
+		g_key_file_set_int64   ( key_file, group, "stop",       (gint64)timer->stop  );
+		g_key_file_set_integer ( key_file, group, "pad-before", (int)timer->pad_before );
+		g_key_file_set_integer ( key_file, group, "pad-after",  (int)timer->pad_after  );
+	}
+
+	GError *error = NULL;
+
+	if ( !g_key_file_save_to_file ( key_file, list->file, &error ) )
+	{
+		g_warning ( "%s: %s ", __func__, error->message );
+		g_error_free ( error );
+	}
+
+	g_key_file_free ( key_file );
+}
+
+/* data: the channel data, ":tsid=..:onid=.." */
+static uint16_t timer_data_get ( const char *data, const char *field )
+{
+	const char *str = ( data ) ? strstr ( data, field ) : NULL;
+
+	return ( str ) ? (uint16_t)atoi ( str + strlen ( field ) ) : 0;
+}
+
+static Timer * timer_new ( uint id, const char *data, uint16_t sid, uint16_t event_id, time_t start, time_t stop, uint pad_before, uint pad_after )
+{
+	Timer *timer = g_new0 ( Timer, 1 );
+
+	timer->id   = id;
+	timer->data = g_strdup ( data );
+	timer->sid  = sid;
+	timer->tsid = timer_data_get ( data, ":tsid=" );
+	timer->onid = timer_data_get ( data, ":onid=" );
+	timer->event_id = event_id;
+
+	timer->start = start;
+	timer->stop  = stop;
+
+	timer->pad_before = pad_before;
+	timer->pad_after  = pad_after;
+
+	timer->state = TIMER_WAIT;
+
+	return timer;
+}
+
+static void timer_list_load ( TimerList *list )
+{
+	GKeyFile *key_file = g_key_file_new ();
+
+	if ( !g_key_file_load_from_file ( key_file, list->file, G_KEY_FILE_NONE, NULL ) ) { g_key_file_free ( key_file ); return; }
+
+	char **groups = g_key_file_get_groups ( key_file, NULL );
+
+	uint i = 0; for ( i = 0; groups[i] != NULL; i++ )
+	{
+		g_autofree char *data = g_key_file_get_string ( key_file, groups[i], "data", NULL );
+
+		if ( !data ) continue;
+
+		Timer *timer = timer_new ( ++list->next_id, data,
+			(uint16_t)g_key_file_get_integer ( key_file, groups[i], "sid",      NULL ),
+			(uint16_t)g_key_file_get_integer ( key_file, groups[i], "event-id", NULL ),
+			(time_t)g_key_file_get_int64 ( key_file, groups[i], "start", NULL ),
+			(time_t)g_key_file_get_int64 ( key_file, groups[i], "stop",  NULL ),
+			(uint)g_key_file_get_integer ( key_file, groups[i], "pad-before", NULL ),
+			(uint)g_key_file_get_integer ( key_file, groups[i], "pad-after",  NULL ) );
+
+		list->timers = g_list_append ( list->timers, timer );
+	}
+
+	g_strfreev ( groups );
+	g_key_file_free ( key_file );
+}
+
+/* EIT event: start / stop follow the schedule; running - extended, the following event running - shortened */
+static void timer_update_event ( time_t now, Timer *timer, TimerList *list )
+{
+	const EpgEvent *event = epg_get_event ( timer->onid, timer->tsid, timer->sid, timer->event_id, list->epg );
+
+	if ( !event ) return;
+
+	time_t stop = event->start + (time_t)event->duration;
+
+	if ( timer->state == TIMER_WAIT ) timer->start = event->start;
+
+	if ( event->running_status == RUNNING_STATUS_RUNNING && now < stop + TIMER_EXTEND_MAX )
+	{
+		timer->running = TRUE;
+
+		if ( stop < now + TIMER_EXTEND ) stop = now + TIMER_EXTEND;
+	}
+	else
+		timer->running = FALSE;
+
+	const EpgEvent *next = epg_get_next ( timer->onid, timer->tsid, timer->sid, event->start, list->epg );
+
+	if ( timer->running && next && next->running_status == RUNNING_STATUS_RUNNING && now >= next->start - TIMER_EXTEND )
+	{
+		timer->running = FALSE;
+
+		if ( stop > now ) stop = now;
+	}
+
+	if ( stop != timer->stop && list->debug ) g_message ( "%s: timer %u | stop %+ld sec ", __func__, timer->id, (long)( stop - timer->stop ) );
+
+	timer->stop = stop;
+}
+
+static gboolean timer_list_check ( TimerList *list )
+{
+	time_t now = timer_list_now ( list );
+
+	/* Ended events: kept while a running event can still extend a timer */
+	if ( list->epg && now >= list->epg_expire )
+	{
+		epg_expire ( now - TIMER_EXTEND_MAX, list->epg );
+
+		list->epg_expire = now + TIMER_EPG_EXPIRE;
+	}
+
+	gboolean save = FALSE;
+
+	GList *l = list->timers;
+
+	while ( l != NULL )
+	{
+		Timer *timer = (Timer *)l->data;
+		GList *next = l->next;
+
+		if ( timer->event_id && list->epg ) timer_update_event ( now, timer, list );
+
+		time_t end = timer->stop + (time_t)timer->pad_after;
+
+		if ( timer->state == TIMER_WAIT && now >= end )
+		{
+			g_warning ( "%s: timer %u missed ", __func__, timer->id );
+
+			timer->state = TIMER_FAILED;
+		}
+		else if ( timer->state == TIMER_WAIT && ( timer->running || now >= timer->start - (time_t)timer->pad_before ) )
+		{
+			timer->state = ( list->func ( timer, TRUE, list->data ) ) ? TIMER_REC : TIMER_FAILED;
+
+			if ( timer->state == TIMER_FAILED ) g_warning ( "%s: timer %u not started ( no free tuner ) ", __func__, timer->id );
+
+			if ( list->debug ) g_message ( "%s: timer %u start | sid %u ", __func__, timer->id, timer->sid );
+		}
+		else if ( timer->state == TIMER_REC && now >= end && !timer->running )
+		{
+			list->func ( timer, FALSE, list->data );
+
+			timer->state = TIMER_DONE;
+
+			if ( list->debug ) g_message ( "%s: timer %u stop | sid %u ", __func__, timer->id, timer->sid );
+		}
+
+		if ( timer->state == TIMER_DONE || timer->state == TIMER_FAILED )
+		{
+			list->timers = g_list_delete_link ( list->timers, l );
+			timer_free ( timer );
+
+			save = TRUE;
+		}
+
+		l = next;
+	}
+
+	if ( save ) timer_list_save ( list );
+
+	return TRUE;
+}
+
+uint timer_list_add ( const char *data, uint16_t sid, uint16_t event_id, time_t start, time_t stop, uint pad_before, uint pad_after, TimerList *list )
+{
+	Timer *timer = timer_new ( ++list->next_id, data, sid, event_id, start, stop, pad_before, pad_after );
+
+	list->timers = g_list_append ( list->timers, timer );
+
+	timer_list_save ( list );
+
+	if ( list->debug ) g_message ( "%s: timer %u | sid %u | event %u | %ld - %ld ", __func__, timer->id, sid, event_id, (long)start, (long)stop );
+
+	return timer->id;
+}
+
+void timer_list_remove ( uint id, TimerList *list )
+{
+	GList *l = NULL;
+	for ( l = list->timers; l != NULL; l = l->next )
+	{
+		Timer *timer = (Timer *)l->data;
+
+		if ( timer->id != id ) continue;
+
+		if ( timer->state == TIMER_REC ) list->func ( timer, FALSE, list->data );
+
+		list->timers = g_list_delete_link ( list->timers, l );
+		timer_free ( timer );
+
+		timer_list_save ( list );
+
+		break;
+	}
+}
+
+void timer_list_set_failed ( uint16_t onid, uint16_t tsid, uint16_t sid, TimerList *list )
+{
+	GList *l = NULL;
+	for ( l = list->timers; l != NULL; l = l->next )
+	{
+		Timer *timer = (Timer *)l->data;
+
+		/* The same sid on another multiplex is another service */
+		if ( timer->sid != sid || timer->tsid != tsid || timer->onid != onid || timer->state != TIMER_REC ) continue;
+
+		g_warning ( "%s: timer %u failed | onid %u | tsid %u | sid %u ", __func__, timer->id, timer->onid, timer->tsid, timer->sid );
+
+		/* Removed and saved by the next check */
+		timer->state = TIMER_FAILED;
+	}
+}
+
+time_t timer_list_now ( TimerList *list )
+{
+	return time ( NULL ) + list->offset;
+}
+
+static time_t timer_clock_offset ( const char *clock )
+{
+	if ( !clock ) return 0;
+
+	time_t sim = 0;
+
+	GDateTime *dt = g_date_time_new_from_iso8601 ( clock, NULL );
+
+	if ( dt ) { sim = (time_t)g_date_time_to_unix ( dt ); g_date_time_unref ( dt ); } else sim = (time_t)atol ( clock );
+
+	return ( sim > 0 ) ? sim - time ( NULL ) : 0;
+}
+
+char * timer_list_get_info ( TimerList *list )
+{
+	const char *states[] = { "wait", "rec", "done", "failed" };
+
+	GString *gstring = g_string_new ( NULL );
+
+	GList *l = NULL;
+	for ( l = list->timers; l != NULL; l = l->next )
+	{
+		Timer *timer = (Timer *)l->data;
+
+		char **lines = g_strsplit ( timer->data, ":", 0 );
+
+		g_string_append_printf ( gstring, "%u  %s  sid %u  event %u  %ld - %ld  %s\n", timer->id, lines[0], timer->sid, timer->event_id,
+			(long)timer->start, (long)timer->stop, states[timer->state] );
+
+		g_strfreev ( lines );
+	}
+
+	return g_string_free ( gstring, FALSE );
+}
+
+TimerList * timer_list_new ( const char *file, Epg *epg, TimerFunc func, gpointer data )
+{
+	TimerList *list = g_new0 ( TimerList, 1 );
+
+	list->file = g_strdup ( file );
+	list->epg  = epg;
+	list->func = func;
+	list->data = data;
+
+	list->debug  = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
+	list->offset = timer_clock_offset ( g_getenv ( "DVB_CLOCK" ) );
+
+	timer_list_load ( list );
+
+	if ( list->debug && list->offset ) g_message ( "%s: simulated clock %+ld sec ", __func__, (long)list->offset );
+
+	list->src_id = g_timeout_add_seconds ( 1, (GSourceFunc)timer_list_check, list );
+
+	return list;
+}
+
+void timer_list_free ( TimerList *list )
+{
+	g_source_remove ( list->src_id );
+
+	g_list_free_full ( list->timers, (GDestroyNotify)timer_free );
+
+	free ( list->file );
+	free ( list );
+}
@@ -0,0 +1,72 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#include "epg.h"
+
+/* Timer recordings: by channel and time window or by EIT event ( start / stop follow the EPG and its running status ).
+ * Kept in a key file, checked every second. Simulated clock: DVB_CLOCK="2020-05-01T20:00:00Z" ( or unix time ) */
+
+typedef enum
+{
+	TIMER_WAIT,
+	TIMER_REC,
+	TIMER_DONE,
+	TIMER_FAILED
+} TimerState;
+
+typedef struct _Timer Timer;
+
+struct _Timer
+{
+	uint id;
+	char *data;
+
+	uint16_t sid;
+	uint16_t tsid, onid;  // of data, 0 - not in data
+	uint16_t event_id;
+
+	time_t start;
+	time_t stop;
+
+	uint pad_before;
+	uint pad_after;
+
+	TimerState state;
+	gboolean running;
+};
+
+/* start: TRUE - start the recording, FALSE - stop it. Returns FALSE if the recording can't be started ( no free tuner ) */
+typedef gboolean ( *TimerFunc ) ( const Timer *, gboolean start, gpointer data );
+
+typedef struct _TimerList TimerList;
+
+/* file: key file of the timers; epg: NULL - time windows only */
+TimerList * timer_list_new ( const char *file, Epg *epg, TimerFunc func, gpointer data );
+
+void timer_list_free ( TimerList * );
+
+/* data: channel string; event_id: 0 - time window only. Returns the timer id */
+uint timer_list_add ( const char *data, uint16_t sid, uint16_t event_id, time_t start, time_t stop, uint pad_before, uint pad_after, TimerList * );
+
+/* A running recording is stopped */
+void timer_list_remove ( uint id, TimerList * );
+
+/* The recording of the service ( onid, tsid, sid of the channel data ) was lost ( source error, no tuner to go on ):
+ * its running timers fail, the func is not called */
+void timer_list_set_failed ( uint16_t onid, uint16_t tsid, uint16_t sid, TimerList * );
+
+/* Clock of the timers ( real or simulated ) */
+time_t timer_list_now ( TimerList * );
+
+/* Returns a newly-allocated string ( one line per timer ). Free with free() */
+char * timer_list_get_info ( TimerList * );
@@ -0,0 +1,343 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+/* Timeshift ring file: positions are absolute byte counters, the file offset is position % size */
+
+#include "timeshift.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#define TS_ALIGN   188
+#define CHUNK_SIZE ( TS_ALIGN * 348 )
+
+struct _Timeshift
+{
+	GstElement *appsrc;
+	GMutex mutex;
+
+	char *path;
+	int fd;
+
+	guint64 size;
+	guint64 wr;
+	guint64 rd;
+	guint64 seek_pos;
+
+	guint64 rate;
+	guint64 rate_bytes;
+	gint64  rate_time;
+
+	gboolean need;
+	gboolean seek_pending;
+};
+
+static void timeshift_io ( gboolean write, uint8_t *data, gsize len, guint64 pos, Timeshift *ts )
+{
+	while ( len > 0 )
+	{
+		guint64 off = pos % ts->size;
+		gsize part = ( off + len > ts->size ) ? (gsize)( ts->size - off ) : len;
+
+		ssize_t ret = ( write ) ? pwrite ( ts->fd, data, part, (off_t)off ) : pread ( ts->fd, data, part, (off_t)off );
+
+		if ( ret <= 0 ) { g_warning ( "%s: %s ", __func__, g_strerror ( errno ) ); return; }
+
+		data += ret;
+		len  -= (gsize)ret;
+		pos  += (guint64)ret;
+	}
+}
+
+static guint64 timeshift_oldest ( Timeshift *ts )
+{
+	return ( ts->wr > ts->size ) ? ts->wr - ts->size : 0;
+}
+
+/* Mutex held. Returns the next chunk from the read cursor or NULL if the cursor is at the live position */
+static GstBuffer * timeshift_read ( Timeshift *ts )
+{
+	if ( ts->rd < timeshift_oldest ( ts ) ) ts->rd = timeshift_oldest ( ts );
+
+	guint64 avail = ts->wr - ts->rd;
+
+	if ( avail == 0 ) return NULL;
+
+	gsize len = ( avail > CHUNK_SIZE ) ? CHUNK_SIZE : (gsize)avail;
+
+	GstBuffer *buffer = gst_buffer_new_allocate ( NULL, len, NULL );
+
+	GstMapInfo map;
+	gst_buffer_map ( buffer, &map, GST_MAP_WRITE );
+		timeshift_io ( FALSE, map.data, len, ts->rd, ts );
+	gst_buffer_unmap ( buffer, &map );
+
+	GST_BUFFER_OFFSET ( buffer ) = ts->rd;
+	ts->rd += len;
+
+	return buffer;
+}
+
+static void timeshift_push ( GstElement *appsrc, GstBuffer *buffer )
+{
+	GstFlowReturn ret = GST_FLOW_OK;
+
+	g_signal_emit_by_name ( appsrc, "push-buffer", buffer, &ret );
+
+	gst_buffer_unref ( buffer );
+	gst_object_unref ( appsrc );
+}
+
+/* Mutex held */
+static void timeshift_write ( const uint8_t *data, gsize len, Timeshift *ts )
+{
+	if ( len > ts->size )
+	{
+		ts->wr += len - ts->size;
+		data   += len - ts->size;
+		len     = (gsize)ts->size;
+	}
+
+	timeshift_io ( TRUE, (uint8_t *)data, len, ts->wr, ts );
+
+	ts->wr += len;
+	ts->rate_bytes += len;
+
+	gint64 now = g_get_monotonic_time ();
+
+	if ( ts->rate_time == 0 ) ts->rate_time = now;
+
+	if ( now - ts->rate_time >= G_USEC_PER_SEC )
+	{
+		guint64 rate = ts->rate_bytes * G_USEC_PER_SEC / (guint64)( now - ts->rate_time );
+
+		ts->rate = ( ts->rate ) ? ( ts->rate * 3 + rate ) / 4 : rate;
+
+		ts->rate_bytes = 0;
+		ts->rate_time  = now;
+	}
+}
+
+GstPadProbeReturn timeshift_probe ( G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, Timeshift *ts )
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	GstMapInfo map;
+	if ( !gst_buffer_map ( buffer, &map, GST_MAP_READ ) ) return GST_PAD_PROBE_OK;
+
+	GstBuffer *out = NULL;
+	GstElement *appsrc = NULL;
+
+	g_mutex_lock ( &ts->mutex );
+
+		timeshift_write ( map.data, map.size, ts );
+
+		if ( ts->need && ts->appsrc && ( out = timeshift_read ( ts ) ) )
+		{
+			ts->need = FALSE;
+			appsrc = gst_object_ref ( ts->appsrc );
+		}
+
+	g_mutex_unlock ( &ts->mutex );
+
+	gst_buffer_unmap ( buffer, &map );
+
+	if ( out ) timeshift_push ( appsrc, out );
+
+	return GST_PAD_PROBE_OK;
+}
+
+/* Never blocks: at the live position the writer pushes the next chunk */
+static void timeshift_need_data ( GstElement *appsrc, G_GNUC_UNUSED uint length, Timeshift *ts )
+{
+	g_mutex_lock ( &ts->mutex );
+
+		GstBuffer *buffer = timeshift_read ( ts );
+
+		ts->need = ( buffer ) ? FALSE : TRUE;
+
+	g_mutex_unlock ( &ts->mutex );
+
+	if ( buffer ) timeshift_push ( gst_object_ref ( appsrc ), buffer );
+}
+
+/* The offset of appsrc is ignored: the start seek of basesrc keeps the cursor, timeshift_seek sets seek_pos */
+static gboolean timeshift_seek_data ( G_GNUC_UNUSED GstElement *appsrc, G_GNUC_UNUSED guint64 offset, Timeshift *ts )
+{
+	g_mutex_lock ( &ts->mutex );
+
+		if ( ts->seek_pending ) ts->rd = ts->seek_pos;
+
+		ts->need = FALSE;
+		ts->seek_pending = FALSE;
+
+	g_mutex_unlock ( &ts->mutex );
+
+	return TRUE;
+}
+
+void timeshift_set_src ( GstElement *appsrc, Timeshift *ts )
+{
+	g_object_set ( appsrc, "stream-type", 1 /* GST_APP_STREAM_TYPE_SEEKABLE */, "format", GST_FORMAT_BYTES, NULL );
+	g_object_set ( appsrc, "max-bytes", (guint64)( CHUNK_SIZE * 4 ), "size", (gint64)-1, NULL );
+
+	g_signal_connect ( appsrc, "need-data", G_CALLBACK ( timeshift_need_data ), ts );
+	g_signal_connect ( appsrc, "seek-data", G_CALLBACK ( timeshift_seek_data ), ts );
+
+	g_mutex_lock ( &ts->mutex );
+
+		if ( ts->appsrc ) gst_object_unref ( ts->appsrc );
+
+		ts->appsrc = gst_object_ref ( appsrc );
+		ts->need = FALSE;
+
+	g_mutex_unlock ( &ts->mutex );
+}
+
+GstElement * timeshift_create_src ( const char *name, Timeshift *ts )
+{
+	GstElement *appsrc = gst_element_factory_make ( "appsrc", name );
+
+	if ( !appsrc )
+	{
+		g_critical ( "%s:: element (factory make) - appsrc not created. \n", __func__ );
+		return NULL;
+	}
+
+	GstCaps *caps = gst_caps_from_string ( "video/mpegts, systemstream=(boolean)true, packetsize=(int)188" );
+	g_object_set ( appsrc, "caps", caps, NULL );
+	gst_caps_unref ( caps );
+
+	timeshift_set_src ( appsrc, ts );
+
+	return appsrc;
+}
+
+static void timeshift_seek_pos ( gboolean live, int sec, Timeshift *ts )
+{
+	GstElement *appsrc = NULL;
+	guint64 seek_pos = 0;
+
+	g_mutex_lock ( &ts->mutex );
+
+		gint64 pos = (gint64)ts->wr;
+
+		if ( !live ) pos = (gint64)ts->rd + (gint64)sec * (gint64)ts->rate;
+
+		if ( pos < (gint64)timeshift_oldest ( ts ) ) pos = (gint64)timeshift_oldest ( ts ) + CHUNK_SIZE;
+		if ( pos > (gint64)ts->wr ) pos = (gint64)ts->wr;
+
+		seek_pos = ts->seek_pos = (guint64)pos - (guint64)pos % TS_ALIGN;
+		ts->seek_pending = TRUE;
+
+		if ( ts->appsrc ) appsrc = gst_object_ref ( ts->appsrc );
+
+	g_mutex_unlock ( &ts->mutex );
+
+	if ( !appsrc ) return;
+
+	gst_element_seek ( appsrc, 1.0, GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, (gint64)seek_pos, GST_SEEK_TYPE_NONE, -1 );
+
+	gst_object_unref ( appsrc );
+}
+
+void timeshift_seek ( int sec, Timeshift *ts )
+{
+	if ( ts->rate == 0 ) return;
+
+	timeshift_seek_pos ( FALSE, sec, ts );
+}
+
+void timeshift_live ( Timeshift *ts )
+{
+	timeshift_seek_pos ( TRUE, 0, ts );
+}
+
+uint timeshift_get_delay ( Timeshift *ts )
+{
+	uint delay = 0;
+
+	g_mutex_lock ( &ts->mutex );
+
+		if ( ts->rate ) delay = (uint)( ( ts->wr - ts->rd ) / ts->rate );
+
+	g_mutex_unlock ( &ts->mutex );
+
+	return delay;
+}
+
+void timeshift_reset ( Timeshift *ts )
+{
+	g_mutex_lock ( &ts->mutex );
+
+		ts->wr = 0;
+		ts->rd = 0;
+		ts->rate = 0;
+		ts->rate_bytes = 0;
+		ts->rate_time  = 0;
+		ts->need = FALSE;
+		ts->seek_pending = FALSE;
+
+	g_mutex_unlock ( &ts->mutex );
+}
+
+char * timeshift_get_path ( const char *name )
+{
+	g_autofree char *dir = g_build_filename ( g_get_user_cache_dir (), "helia", NULL );
+
+	g_mkdir_with_parents ( dir, 0700 );
+
+	return g_build_filename ( dir, name, NULL );
+}
+
+Timeshift * timeshift_new ( const char *path, guint64 size )
+{
+	size -= size % TS_ALIGN;
+
+	if ( size < CHUNK_SIZE * 16 ) return NULL;
+
+	int fd = open ( path, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+
+	if ( fd == -1 ) { g_critical ( "%s: %s %s ", __func__, path, g_strerror ( errno ) ); return NULL; }
+
+	if ( posix_fallocate ( fd, 0, (off_t)size ) != 0 && ftruncate ( fd, (off_t)size ) == -1 )
+	{
+		g_critical ( "%s: %s %s ", __func__, path, g_strerror ( errno ) );
+
+		close ( fd );
+		g_unlink ( path );
+
+		return NULL;
+	}
+
+	Timeshift *ts = g_new0 ( Timeshift, 1 );
+
+	g_mutex_init ( &ts->mutex );
+
+	ts->fd   = fd;
+	ts->size = size;
+	ts->path = g_strdup ( path );
+
+	return ts;
+}
+
+void timeshift_free ( Timeshift *ts )
+{
+	if ( ts->appsrc ) gst_object_unref ( ts->appsrc );
+
+	close ( ts->fd );
+	g_unlink ( ts->path );
+
+	g_mutex_clear ( &ts->mutex );
+
+	free ( ts->path );
+	free ( ts );
+}
@@ -0,0 +1,47 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+/* Timeshift: the live TS is written to a preallocated ring file ( capture pipeline ),
+ * playback reads it from a cursor through an appsrc ( play pipeline ). Memory use does not depend on the window size. */
+
+typedef struct _Timeshift Timeshift;
+
+/* size: bytes of the ring file. Returns NULL if the file can't be created */
+Timeshift * timeshift_new ( const char *path, guint64 size );
+
+void timeshift_free ( Timeshift * );
+
+/* New stream: the ring is emptied */
+void timeshift_reset ( Timeshift * );
+
+/* Writer: buffer probe on the capture side */
+GstPadProbeReturn timeshift_probe ( GstPad *, GstPadProbeInfo *, Timeshift * );
+
+/* Reader: appsrc in the play pipeline */
+GstElement * timeshift_create_src ( const char *name, Timeshift * );
+
+/* Reader: an existing appsrc ( playbin "appsrc://", source-setup ) */
+void timeshift_set_src ( GstElement *appsrc, Timeshift * );
+
+/* sec: + forward / - back, limited by the window and the live position */
+void timeshift_seek ( int sec, Timeshift * );
+
+/* Catch-up to the live position */
+void timeshift_live ( Timeshift * );
+
+/* Seconds behind the live position */
+uint timeshift_get_delay ( Timeshift * );
+
+/* Returns a newly-allocated string holding the ring file path: user cache dir / helia / name. Free with free() */
+char * timeshift_get_path ( const char *name );
@@ -0,0 +1,131 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "tsbatch.h"
+
+#include <gst/base/gstadapter.h>
+
+#define TS_PACKET 188
+
+struct _TsBatch
+{
+	uint size;            // packets × 188
+	gint64 latency;       // us
+
+	GstAdapter *adapter;  // the reads, with their own timestamps, no copy
+
+	gint64 time_first;    // arrival of the oldest read in the batch
+};
+
+TsBatch * ts_batch_new ( uint packets, uint latency_ms )
+{
+	TsBatch *batch = g_new0 ( TsBatch, 1 );
+
+	batch->size    = packets * TS_PACKET;
+	batch->latency = (gint64)latency_ms * 1000;
+	batch->adapter = gst_adapter_new ();
+
+	return batch;
+}
+
+void ts_batch_free ( TsBatch *batch )
+{
+	g_object_unref ( batch->adapter );
+
+	free ( batch );
+}
+
+/* len bytes of the batch in a new buffer ( the memories of the reads appended ), the rest is kept.
+ * The timestamps are of the read the first byte came from */
+static GstBuffer * ts_batch_take ( gsize len, gint64 now, TsBatch *batch )
+{
+	GstClockTime pts = gst_adapter_prev_pts ( batch->adapter, NULL );
+	GstClockTime dts = gst_adapter_prev_dts ( batch->adapter, NULL );
+
+	GstBuffer *buffer = gst_adapter_take_buffer_fast ( batch->adapter, len );
+
+	buffer = gst_buffer_make_writable ( buffer );
+
+	GST_BUFFER_PTS ( buffer ) = pts;
+	GST_BUFFER_DTS ( buffer ) = dts;
+
+	/* A partial packet left: of the latest read */
+	batch->time_first = ( gst_adapter_available ( batch->adapter ) ) ? now : 0;
+
+	return buffer;
+}
+
+/* EOS: the rest goes straight to the peer ( the probes of the src pad have seen it ) */
+static void ts_batch_flush ( GstPad *pad, TsBatch *batch )
+{
+	gsize len = gst_adapter_available ( batch->adapter );
+
+	if ( len == 0 ) return;
+
+	GstBuffer *buffer = ts_batch_take ( len, 0, batch );
+
+	GstPad *peer = gst_pad_get_peer ( pad );
+
+	if ( peer ) { gst_pad_chain ( peer, buffer ); gst_object_unref ( peer ); } else gst_buffer_unref ( buffer );
+}
+
+static GstPadProbeReturn ts_batch_event ( GstPad *pad, GstEvent *event, TsBatch *batch )
+{
+	switch ( GST_EVENT_TYPE ( event ) )
+	{
+		case GST_EVENT_EOS:
+			ts_batch_flush ( pad, batch );
+			break;
+
+		case GST_EVENT_FLUSH_STOP:
+		case GST_EVENT_STREAM_START:
+			gst_adapter_clear ( batch->adapter );
+			batch->time_first = 0;
+			break;
+
+		default:
+			break;
+	}
+
+	return GST_PAD_PROBE_OK;
+}
+
+/* A read is dropped into the batch; a full batch ( or one older than the cap ) takes the place of the read that completed it,
+ * so the probes added later ( zap block probe ) still see the data flow */
+GstPadProbeReturn ts_batch_probe ( GstPad *pad, GstPadProbeInfo *info, TsBatch *batch )
+{
+	if ( info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM ) return ts_batch_event ( pad, GST_PAD_PROBE_INFO_EVENT ( info ), batch );
+
+	if ( batch->size == 0 ) return GST_PAD_PROBE_OK;
+
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER ( info );
+
+	gint64 now = g_get_monotonic_time ();
+
+	if ( batch->time_first == 0 ) batch->time_first = now;
+
+	/* A ref of the read: the pad unrefs the dropped one */
+	gst_adapter_push ( batch->adapter, gst_buffer_ref ( buffer ) );
+
+	gsize available = gst_adapter_available ( batch->adapter );
+
+	gboolean full = ( available >= batch->size ) ? TRUE : FALSE;
+	gboolean late = ( now - batch->time_first >= batch->latency ) ? TRUE : FALSE;
+
+	/* Whole packets go out, a partial packet stays */
+	gsize len = available / TS_PACKET * TS_PACKET;
+
+	if ( ( !full && !late ) || len == 0 ) return GST_PAD_PROBE_DROP;
+
+	gst_buffer_unref ( buffer );
+
+	GST_PAD_PROBE_INFO_DATA ( info ) = ts_batch_take ( len, now, batch );
+
+	return GST_PAD_PROBE_OK;
+}
@@ -0,0 +1,28 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+
+/* TS batching: the small reads of dvbsrc ( filesrc ) are gathered into buffers of N × 188 bytes, packet aligned,
+ * so the tee, tsdemux, the queues and the record branches handle one buffer instead of many ( the memories of the reads, no copy ).
+ * Latency cap: a batch older than the cap goes out with the whole packets it has */
+
+typedef struct _TsBatch TsBatch;
+
+/* packets: batch size, 0 - off; latency_ms: cap */
+TsBatch * ts_batch_new ( uint packets, uint latency_ms );
+
+void ts_batch_free ( TsBatch * );
+
+/* Buffer and event probe on the src pad of the source, added after the psi / analyzer probes of that pad ( they see the reads ).
+ * The cap is checked on every read ( dvbsrc reads continuously ); EOS pushes the rest */
+GstPadProbeReturn ts_batch_probe ( GstPad *, GstPadProbeInfo *, TsBatch * );
@@ -0,0 +1,327 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+/* Tuner pool: one owner per frontend, requests by multiplex, no second open of a busy device */
+
+#include "tuner.h"
+#include "scan.h"
+
+#include <string.h>
+#include <linux/dvb/frontend.h>
+
+#define MAX_ADAPTER  8
+#define MAX_FRONTEND 4
+#define MAX_TUNER    ( MAX_ADAPTER * MAX_FRONTEND )
+#define MAX_DELSYS   16
+
+typedef struct _TunerFe TunerFe;
+
+struct _TunerFe
+{
+	int adapter;
+	int frontend;
+
+	uint8_t delsys[MAX_DELSYS];
+	uint8_t n_delsys;
+
+	char *mux;
+	uint users;
+	gboolean exclusive;
+
+	char *locked;
+	gint64 time_lock;
+	gboolean used;
+
+	TunerReclaim reclaim;
+	gpointer reclaim_data;
+};
+
+struct _TunerPool
+{
+	TunerFe fe[MAX_TUNER];
+	uint8_t n_fe;
+
+	gboolean sim;
+	gboolean debug;
+};
+
+static void tuner_pool_add ( int adapter, int frontend, const uint8_t *delsys, uint8_t n_delsys, TunerPool *pool )
+{
+	if ( pool->n_fe >= MAX_TUNER ) return;
+
+	TunerFe *fe = &pool->fe[pool->n_fe++];
+
+	fe->adapter  = adapter;
+	fe->frontend = frontend;
+	fe->n_delsys = ( n_delsys > MAX_DELSYS ) ? MAX_DELSYS : n_delsys;
+
+	memcpy ( fe->delsys, delsys, fe->n_delsys );
+}
+
+static void tuner_pool_probe ( TunerPool *pool )
+{
+	int a = 0, f = 0;
+
+	for ( a = 0; a < MAX_ADAPTER; a++ )
+	for ( f = 0; f < MAX_FRONTEND; f++ )
+	{
+		char path[80];
+		sprintf ( path, "/dev/dvb/adapter%d/frontend%d", a, f );
+
+		if ( !g_file_test ( path, G_FILE_TEST_EXISTS ) ) continue;
+
+		uint8_t delsys[MAX_DELSYS];
+		uint8_t n_delsys = scan_get_dvb_delsys_all ( a, f, delsys, MAX_DELSYS );
+
+		tuner_pool_add ( a, f, delsys, n_delsys, pool );
+	}
+}
+
+/* DVB_TUNER_SIM="0:0:DVBT,DVBT2;1:0:DVBS,DVBS2" */
+static void tuner_pool_sim ( const char *sim, TunerPool *pool )
+{
+	char **tuners = g_strsplit ( sim, ";", 0 );
+
+	uint j = 0; for ( j = 0; tuners[j] != NULL; j++ )
+	{
+		char **fields = g_strsplit ( tuners[j], ":", 3 );
+
+		if ( g_strv_length ( fields ) == 3 )
+		{
+			char **names = g_strsplit ( fields[2], ",", 0 );
+
+			uint8_t delsys[MAX_DELSYS], n_delsys = 0;
+
+			uint i = 0; for ( i = 0; names[i] != NULL && n_delsys < MAX_DELSYS; i++ )
+				delsys[n_delsys++] = scan_get_dvb_delsys_num ( g_strstrip ( names[i] ) );
+
+			tuner_pool_add ( atoi ( fields[0] ), atoi ( fields[1] ), delsys, n_delsys, pool );
+
+			g_strfreev ( names );
+		}
+
+		g_strfreev ( fields );
+	}
+
+	g_strfreev ( tuners );
+}
+
+TunerPool * tuner_pool_get_default ( void )
+{
+	static TunerPool *pool = NULL;
+
+	if ( pool ) return pool;
+
+	pool = g_new0 ( TunerPool, 1 );
+
+	pool->debug = ( g_getenv ( "DVB_DEBUG" ) ) ? TRUE : FALSE;
+
+	const char *sim = g_getenv ( "DVB_TUNER_SIM" );
+
+	pool->sim = ( sim ) ? TRUE : FALSE;
+
+	if ( sim ) tuner_pool_sim ( sim, pool ); else tuner_pool_probe ( pool );
+
+	if ( pool->debug )
+	{
+		g_autofree char *info = tuner_pool_get_info ( pool );
+		g_message ( "%s: %u tuners %s\n%s", __func__, pool->n_fe, ( pool->sim ) ? "( simulated )" : "", info );
+	}
+
+	return pool;
+}
+
+static gboolean tuner_pool_fe_delsys ( uint8_t delsys, TunerFe *fe )
+{
+	if ( delsys == SYS_UNDEFINED || fe->n_delsys == 0 ) return TRUE;
+
+	uint8_t i = 0; for ( i = 0; i < fe->n_delsys; i++ )
+		if ( fe->delsys[i] == delsys ) return TRUE;
+
+	return FALSE;
+}
+
+void tuner_pool_set_locked ( int id, const char *mux, gboolean locked, TunerPool *pool )
+{
+	if ( id < 0 || id >= pool->n_fe ) return;
+
+	TunerFe *fe = &pool->fe[id];
+
+	free ( fe->locked );
+
+	fe->locked = ( locked ) ? g_strdup ( mux ) : NULL;
+	fe->time_lock = ( locked ) ? g_get_monotonic_time () : 0;
+}
+
+static int tuner_pool_take ( int id, const char *mux, gboolean exclusive, TunerPool *pool )
+{
+	TunerFe *fe = &pool->fe[id];
+
+	if ( fe->users == 0 )
+	{
+		free ( fe->mux );
+
+		fe->mux = g_strdup ( mux );
+		fe->exclusive = exclusive;
+
+		/* Another multiplex: the frontend will be retuned */
+		if ( fe->locked && !g_str_equal ( fe->locked, mux ) ) tuner_pool_set_locked ( id, NULL, FALSE, pool );
+	}
+
+	fe->users++;
+
+	if ( pool->debug ) g_message ( "%s: adapter%d/frontend%d | users %u | %s ", __func__, fe->adapter, fe->frontend, fe->users, mux );
+
+	return id;
+}
+
+/* Free frontend: 3 - locked to the mux, 2 - preferred device, 1 - without a lock ( another one stays warm ), 0 - any */
+static uint8_t tuner_pool_fe_rank ( const char *mux, int adapter, int frontend, TunerFe *fe )
+{
+	if ( fe->locked && g_str_equal ( fe->locked, mux ) ) return 3;
+
+	if ( fe->adapter == adapter && fe->frontend == frontend ) return 2;
+
+	return ( fe->locked ) ? 0 : 1;
+}
+
+/* A spare tuner of the delivery system is given up. Returns TRUE if its owner released it */
+static gboolean tuner_pool_reclaim ( uint8_t delsys, TunerPool *pool )
+{
+	int id = 0; for ( id = 0; id < pool->n_fe; id++ )
+	{
+		TunerFe *fe = &pool->fe[id];
+
+		if ( !fe->reclaim || !tuner_pool_fe_delsys ( delsys, fe ) ) continue;
+
+		if ( pool->debug ) g_message ( "%s: adapter%d/frontend%d ", __func__, fe->adapter, fe->frontend );
+
+		TunerReclaim func = fe->reclaim;
+
+		fe->reclaim = NULL;
+		func ( id, fe->reclaim_data );
+
+		return ( fe->users == 0 ) ? TRUE : FALSE;
+	}
+
+	return FALSE;
+}
+
+int tuner_pool_acquire ( const char *mux, uint8_t delsys, int adapter, int frontend, gboolean exclusive, TunerPool *pool )
+{
+	int id = 0, free_id = -1;
+	uint8_t free_rank = 0;
+
+	for ( id = 0; id < pool->n_fe; id++ )
+	{
+		TunerFe *fe = &pool->fe[id];
+
+		if ( !tuner_pool_fe_delsys ( delsys, fe ) ) continue;
+
+		if ( fe->users == 0 )
+		{
+			uint8_t rank = tuner_pool_fe_rank ( mux, adapter, frontend, fe );
+
+			if ( free_id == -1 || rank > free_rank ) { free_id = id; free_rank = rank; }
+
+			continue;
+		}
+
+		if ( !exclusive && !fe->exclusive && fe->mux && g_str_equal ( fe->mux, mux ) ) return tuner_pool_take ( id, mux, exclusive, pool );
+	}
+
+	if ( free_id == -1 && tuner_pool_reclaim ( delsys, pool ) ) return tuner_pool_acquire ( mux, delsys, adapter, frontend, exclusive, pool );
+
+	if ( free_id != -1 )
+	{
+		if ( pool->debug && free_rank == 3 ) g_message ( "%s: adapter%d/frontend%d still locked to the mux ", __func__, pool->fe[free_id].adapter, pool->fe[free_id].frontend );
+
+		return tuner_pool_take ( free_id, mux, exclusive, pool );
+	}
+
+	if ( pool->debug ) g_message ( "%s: no free tuner | delsys %u | %s ", __func__, delsys, mux );
+
+	return -1;
+}
+
+void tuner_pool_release ( int id, TunerPool *pool )
+{
+	if ( id < 0 || id >= pool->n_fe ) return;
+
+	TunerFe *fe = &pool->fe[id];
+
+	if ( fe->users ) fe->users--;
+
+	if ( fe->users == 0 ) { free ( fe->mux ); fe->mux = NULL; fe->exclusive = FALSE; fe->reclaim = NULL; fe->reclaim_data = NULL; }
+
+	if ( pool->debug ) g_message ( "%s: adapter%d/frontend%d | users %u ", __func__, fe->adapter, fe->frontend, fe->users );
+}
+
+int tuner_pool_get_adapter ( int id, TunerPool *pool )
+{
+	return ( id < 0 || id >= pool->n_fe ) ? 0 : pool->fe[id].adapter;
+}
+
+int tuner_pool_get_frontend ( int id, TunerPool *pool )
+{
+	return ( id < 0 || id >= pool->n_fe ) ? 0 : pool->fe[id].frontend;
+}
+
+uint8_t tuner_pool_count ( TunerPool *pool )
+{
+	return pool->n_fe;
+}
+
+gboolean tuner_pool_is_locked ( int id, const char *mux, TunerPool *pool )
+{
+	if ( id < 0 || id >= pool->n_fe ) return FALSE;
+
+	TunerFe *fe = &pool->fe[id];
+
+	return ( fe->locked && g_str_equal ( fe->locked, mux ) ) ? TRUE : FALSE;
+}
+
+void tuner_pool_set_spare ( int id, TunerReclaim func, gpointer data, TunerPool *pool )
+{
+	if ( id < 0 || id >= pool->n_fe ) return;
+
+	pool->fe[id].reclaim = func;
+	pool->fe[id].reclaim_data = ( func ) ? data : NULL;
+}
+
+gboolean tuner_pool_first_use ( int id, TunerPool *pool )
+{
+	if ( id < 0 || id >= pool->n_fe || pool->fe[id].used ) return FALSE;
+
+	pool->fe[id].used = TRUE;
+
+	return TRUE;
+}
+
+char * tuner_pool_get_info ( TunerPool *pool )
+{
+	GString *gstring = g_string_new ( NULL );
+
+	uint8_t id = 0; for ( id = 0; id < pool->n_fe; id++ )
+	{
+		TunerFe *fe = &pool->fe[id];
+
+		g_string_append_printf ( gstring, "adapter%d/frontend%d  delsys", fe->adapter, fe->frontend );
+
+		uint8_t i = 0; for ( i = 0; i < fe->n_delsys; i++ ) g_string_append_printf ( gstring, " %u", fe->delsys[i] );
+
+		g_string_append_printf ( gstring, "  users %u%s%s", fe->users, ( fe->exclusive ) ? " ( exclusive )" : "", ( fe->reclaim ) ? " ( spare )" : "" );
+
+		if ( fe->locked ) g_string_append_printf ( gstring, "  locked %ld s", (long)( ( g_get_monotonic_time () - fe->time_lock ) / G_USEC_PER_SEC ) );
+
+		g_string_append_c ( gstring, '\n' );
+	}
+
+	return g_string_free ( gstring, FALSE );
+}
@@ -0,0 +1,55 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+/* All adapters / frontends of the host ( /dev/dvb ) or simulated ones:
+ *   DVB_TUNER_SIM="0:0:DVBT,DVBT2;1:0:DVBS,DVBS2" - adapter:frontend:delsys,... */
+
+typedef struct _TunerPool TunerPool;
+
+/* Main loop: the spare tuner is wanted by a request; the owner stops its pipeline and releases the tuner at once */
+typedef void ( *TunerReclaim ) ( int id, gpointer data );
+
+/* Process-wide pool, created on first use */
+TunerPool * tuner_pool_get_default ( void );
+
+/* Shared request ( live view and its recordings ): a frontend tuned to the mux is reused, otherwise a free one is assigned.
+ * Exclusive request ( scan ): a free frontend only.
+ * Free frontends: the one still locked to the mux first, then the preferred device, then one without a lock.
+ * No free frontend: a spare one is reclaimed.
+ * adapter / frontend: preferred device or -1. Returns the tuner id or -1 if none can serve the request */
+int tuner_pool_acquire ( const char *mux, uint8_t delsys, int adapter, int frontend, gboolean exclusive, TunerPool * );
+
+void tuner_pool_release ( int id, TunerPool * );
+
+int tuner_pool_get_adapter  ( int id, TunerPool * );
+
+int tuner_pool_get_frontend ( int id, TunerPool * );
+
+uint8_t tuner_pool_count ( TunerPool * );
+
+/* Tuning state: the multiplex of the last lock of the frontend, kept after the release ( the driver holds the lock ).
+ * locked FALSE - tuning failed, the state is dropped */
+void tuner_pool_set_locked ( int id, const char *mux, gboolean locked, TunerPool * );
+
+/* TRUE - the frontend holds a lock on this multiplex */
+gboolean tuner_pool_is_locked ( int id, const char *mux, TunerPool * );
+
+/* TRUE on the first call only: the device info of the frontend ( FE_GET_INFO / FE_GET_PROPERTY ) is to be read once */
+gboolean tuner_pool_first_use ( int id, TunerPool * );
+
+/* Spare tuner ( speculative use ): given up to any request without a free frontend. func NULL - no longer spare.
+ * The release of the tuner ends the spare state */
+void tuner_pool_set_spare ( int id, TunerReclaim func, gpointer data, TunerPool * );
+
+/* Returns a newly-allocated string ( one line per frontend ). Free with free() */
+char * tuner_pool_get_info ( TunerPool * );
@@ -0,0 +1,398 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "mpegts.h"
+#include "epg.h"
+#include "psi.h"
+#include "tsbatch.h"
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TS_PACKET 188
+#define BENCH_BLOCKSIZE 8192
+
+/* Benchmarks without the GUI:
+ *   helia-bench psi <services>   PSI tables of a synthetic multiplex ( 1 - 2000 services )
+ *   helia-bench ts <file>        TS batching: filesrc → tee → queue → tsparse / fakesink for several batch sizes
+ *   helia-bench eit <services> <days>   EPG store: present / following and schedule EIT of a synthetic multiplex */
+
+/* Raw copy of the section: it is parsed again on get_pat / get_pmt / get_sdt, as the sections of tsdemux */
+static GstMpegtsSection * helia_bench_raw ( GstMpegtsSection *section )
+{
+	gsize size = 0;
+	guint8 *data = gst_mpegts_section_packetize ( section, &size );
+
+	GBytes *bytes = g_bytes_new ( data, size );
+	guint8 *copy = g_bytes_unref_to_data ( bytes, &size );
+
+	return gst_mpegts_section_new ( section->pid, copy, size );
+}
+
+static GPtrArray * helia_bench_mux ( uint n_services )
+{
+	GPtrArray *sections = g_ptr_array_new_with_free_func ( (GDestroyNotify)gst_mpegts_section_unref );
+
+	GPtrArray *programs = gst_mpegts_pat_new ();
+	GstMpegtsSDT *sdt = NULL;
+
+	uint16_t sid = 0;
+
+	for ( sid = 1; sid <= n_services; sid++ )
+	{
+		GstMpegtsPatProgram *program = gst_mpegts_pat_program_new ();
+		program->program_number = sid;
+		program->network_or_program_map_PID = (uint16_t)( 0x20 + sid );
+		g_ptr_array_add ( programs, program );
+
+		GstMpegtsPMT *pmt = gst_mpegts_pmt_new ();
+		pmt->program_number = sid;
+		pmt->pcr_pid = (uint16_t)( 0x1000 + sid * 2 );
+
+		GstMpegtsPMTStream *video = gst_mpegts_pmt_stream_new ();
+		video->stream_type = GST_MPEGTS_STREAM_TYPE_VIDEO_H264;
+		video->pid = (uint16_t)( 0x1000 + sid * 2 );
+		g_ptr_array_add ( pmt->streams, video );
+
+		GstMpegtsPMTStream *audio = gst_mpegts_pmt_stream_new ();
+		audio->stream_type = GST_MPEGTS_STREAM_TYPE_AUDIO_MPEG1;
+		audio->pid = (uint16_t)( 0x1000 + sid * 2 + 1 );
+		g_ptr_array_add ( pmt->streams, audio );
+
+		GstMpegtsSection *section = gst_mpegts_section_from_pmt ( pmt, (uint16_t)( 0x20 + sid ) );
+		g_ptr_array_add ( sections, helia_bench_raw ( section ) );
+		gst_mpegts_section_unref ( section );
+
+		if ( !sdt )
+		{
+			sdt = gst_mpegts_sdt_new ();
+			sdt->actual_ts = TRUE;
+			sdt->transport_stream_id = 1;
+			sdt->original_network_id = 1;
+		}
+
+		char name[32];
+		sprintf ( name, "Service %u", sid );
+
+		GstMpegtsSDTService *service = gst_mpegts_sdt_service_new ();
+		service->service_id = sid;
+		g_ptr_array_add ( service->descriptors, gst_mpegts_descriptor_from_dvb_service ( GST_DVB_SERVICE_DIGITAL_TELEVISION, name, "helia" ) );
+		g_ptr_array_add ( sdt->services, service );
+
+		if ( sdt->services->len == 32 || sid == n_services )
+		{
+			section = gst_mpegts_section_from_sdt ( sdt );
+			section->section_number = (uint8_t)( ( sid - 1 ) / 32 );
+			g_ptr_array_add ( sections, helia_bench_raw ( section ) );
+			gst_mpegts_section_unref ( section );
+
+			sdt = NULL;
+		}
+	}
+
+	GstMpegtsSection *section = gst_mpegts_section_from_pat ( programs, 1 );
+	g_ptr_array_insert ( sections, 0, helia_bench_raw ( section ) );
+	gst_mpegts_section_unref ( section );
+
+	return sections;
+}
+
+static gint64 helia_bench_pass ( GPtrArray *sections, MpegTs *mpegts )
+{
+	gint64 start = g_get_monotonic_time ();
+
+	uint i = 0; for ( i = 0; i < sections->len; i++ ) mpegts_add_section ( g_ptr_array_index ( sections, i ), mpegts );
+
+	return g_get_monotonic_time () - start;
+}
+
+/* Synthetic multiplex ( PAT, n PMT, SDT ): time of the first pass and of a repeated carousel pass */
+static int helia_bench_psi ( uint n_services )
+{
+	if ( n_services == 0 || n_services > 2000 ) { g_printerr ( "psi: 1 - 2000 services \n" ); return EXIT_FAILURE; }
+
+	mpegts_initialize ();
+
+	GPtrArray *first  = helia_bench_mux ( n_services );
+	GPtrArray *repeat = helia_bench_mux ( n_services );
+
+	MpegTs *mpegts = mpegts_new ();
+
+	gint64 time_first  = helia_bench_pass ( first,  mpegts );
+	gint64 time_repeat = helia_bench_pass ( repeat, mpegts );
+
+	MpegTsService *srv = mpegts_get_service ( (uint16_t)n_services, mpegts );
+
+	g_print ( "psi: %u services, %u sections | first pass %ld us | repeated pass %ld us | pmt %s, sdt %s | last: %s \n",
+		mpegts_get_n_services ( mpegts ), first->len, (long)time_first, (long)time_repeat,
+		( mpegts->pmt_done ) ? "done" : "not done", ( mpegts->sdt_done ) ? "done" : "not done", ( srv && srv->ch_name ) ? srv->ch_name : "-" );
+
+	gboolean ret = ( mpegts->pmt_done && mpegts->sdt_done );
+
+	mpegts_free ( mpegts );
+
+	g_ptr_array_unref ( first  );
+	g_ptr_array_unref ( repeat );
+
+	return ( ret ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#define EIT_EVENTS 3          // events of 1 hour per section: one 3 hour segment of the schedule
+
+static uint8_t helia_bench_bcd ( uint v )
+{
+	return (uint8_t)( ( ( v / 10 ) << 4 ) | ( v % 10 ) );
+}
+
+/* Raw EIT section ( EN 300 468 ): events of 1 hour from start, a short event descriptor each */
+static GstMpegtsSection * helia_bench_eit_section ( uint8_t table_id, uint16_t sid, uint8_t section_number, uint8_t last_section_number,
+	uint8_t last_table_id, time_t start, uint n_events )
+{
+	guint8 *data = g_malloc0 ( 4096 );
+	uint size = 14;
+
+	data[0] = table_id;
+	data[3] = (uint8_t)( sid >> 8 ); data[4] = (uint8_t)sid;
+	data[5] = 0xC1;                    // version 0, current
+	data[6] = section_number;
+	data[7] = last_section_number;
+	data[8] = 0; data[9] = 1;          // tsid
+	data[10] = 0; data[11] = 1;        // onid
+	data[12] = last_section_number;
+	data[13] = last_table_id;
+
+	uint i = 0; for ( i = 0; i < n_events; i++ )
+	{
+		time_t t = start + (time_t)i * 3600;
+		uint mjd = (uint)( t / 86400 ) + 40587;
+		uint sec = (uint)( t % 86400 );
+		uint16_t event_id = (uint16_t)( ( t / 3600 ) & 0xFFFF );
+
+		char title[64], text[128];
+		sprintf ( title, "Event %u of the service %u", event_id, sid );
+		sprintf ( text, "Synthetic event, %u:00 - %u:00", sec / 3600, sec / 3600 + 1 );
+
+		uint len_title = (uint)strlen ( title ), len_text = (uint)strlen ( text );
+		uint len_desc = 2 + 3 + 1 + len_title + 1 + len_text;
+
+		guint8 *ev = data + size;
+
+		ev[0] = (uint8_t)( event_id >> 8 ); ev[1] = (uint8_t)event_id;
+		ev[2] = (uint8_t)( mjd >> 8 ); ev[3] = (uint8_t)mjd;
+		ev[4] = helia_bench_bcd ( sec / 3600 ); ev[5] = helia_bench_bcd ( sec / 60 % 60 ); ev[6] = helia_bench_bcd ( sec % 60 );
+		ev[7] = helia_bench_bcd ( 1 ); ev[8] = 0; ev[9] = 0;      // duration 01:00:00
+		ev[10] = (uint8_t)( ( ( t == start && table_id == 0x4E && section_number == 0 ) ? 4 : 1 ) << 5 | ( len_desc >> 8 ) );
+		ev[11] = (uint8_t)len_desc;
+
+		guint8 *desc = ev + 12;
+
+		desc[0] = GST_MTS_DESC_DVB_SHORT_EVENT;
+		desc[1] = (uint8_t)( len_desc - 2 );
+		memcpy ( desc + 2, "eng", 3 );
+		desc[5] = (uint8_t)len_title; memcpy ( desc + 6, title, len_title );
+		desc[6 + len_title] = (uint8_t)len_text; memcpy ( desc + 7 + len_title, text, len_text );
+
+		size += 12 + len_desc;
+	}
+
+	uint section_length = size + 4 - 3;
+
+	data[1] = (uint8_t)( 0xF0 | ( section_length >> 8 ) );
+	data[2] = (uint8_t)section_length;
+
+	uint32_t crc = psi_crc32 ( data, size );
+
+	data[size] = (uint8_t)( crc >> 24 ); data[size + 1] = (uint8_t)( crc >> 16 ); data[size + 2] = (uint8_t)( crc >> 8 ); data[size + 3] = (uint8_t)crc;
+
+	return gst_mpegts_section_new ( 0x12, data, size + 4 );
+}
+
+/* Per service: present / following ( 0x4E ) and the schedule ( 0x50 - 0x5F: 4 days per table, a section per 3 hour segment ) */
+static GPtrArray * helia_bench_eit_mux ( uint n_services, uint days, time_t midnight )
+{
+	GPtrArray *sections = g_ptr_array_new_with_free_func ( (GDestroyNotify)gst_mpegts_section_unref );
+
+	time_t now = time ( NULL ) / 3600 * 3600;
+
+	uint8_t last_table_id = (uint8_t)( 0x50 + ( days - 1 ) / 4 );
+
+	uint16_t sid = 0; for ( sid = 1; sid <= n_services; sid++ )
+	{
+		g_ptr_array_add ( sections, helia_bench_eit_section ( 0x4E, sid, 0, 1, 0x4E, now, 1 ) );
+		g_ptr_array_add ( sections, helia_bench_eit_section ( 0x4E, sid, 1, 1, 0x4E, now + 3600, 1 ) );
+
+		uint d = 0; for ( d = 0; d < days; d++ )
+		{
+			uint8_t table_id = (uint8_t)( 0x50 + d / 4 );
+			uint8_t last_section_number = ( table_id == last_table_id ) ? (uint8_t)( ( ( days - 1 ) % 4 ) * 64 + 7 * 8 ) : 0xF8;
+
+			uint s = 0; for ( s = 0; s < 8; s++ )
+			{
+				uint8_t section_number = (uint8_t)( ( d % 4 ) * 64 + s * 8 );
+
+				g_ptr_array_add ( sections, helia_bench_eit_section ( table_id, sid, section_number, last_section_number, last_table_id,
+					midnight + (time_t)d * 86400 + (time_t)s * 3 * 3600, EIT_EVENTS ) );
+			}
+		}
+	}
+
+	return sections;
+}
+
+static gint64 helia_bench_eit_pass ( GPtrArray *sections, Epg *epg )
+{
+	gint64 start = g_get_monotonic_time ();
+
+	uint i = 0; for ( i = 0; i < sections->len; i++ ) mpegts_add_eit ( g_ptr_array_index ( sections, i ), epg );
+
+	return g_get_monotonic_time () - start;
+}
+
+/* Synthetic EIT ( n services, days of schedule ) through mpegts_add_eit: time of the first pass and of a repeated carousel pass */
+static int helia_bench_eit ( uint n_services, uint days )
+{
+	if ( n_services == 0 || n_services > 2000 ) { g_printerr ( "eit: 1 - 2000 services \n" ); return EXIT_FAILURE; }
+
+	if ( days == 0 || days > 64 ) { g_printerr ( "eit: 1 - 64 days \n" ); return EXIT_FAILURE; }
+
+	mpegts_initialize ();
+
+	time_t midnight = time ( NULL ) / 86400 * 86400;
+
+	GPtrArray *first  = helia_bench_eit_mux ( n_services, days, midnight );
+	GPtrArray *repeat = helia_bench_eit_mux ( n_services, days, midnight );
+
+	Epg *epg = epg_new ();
+
+	gint64 time_first  = helia_bench_eit_pass ( first,  epg );
+	gint64 time_repeat = helia_bench_eit_pass ( repeat, epg );
+
+	const EpgEvent *now = epg_get_now ( 1, 1, (uint16_t)n_services, time ( NULL ), epg );
+
+	g_print ( "eit: %u services, %u days, %u sections, %u events | first pass %ld us | repeated pass %ld us | now: %s \n",
+		n_services, days, first->len, epg_count ( epg ), (long)time_first, (long)time_repeat, ( now && now->title ) ? now->title : "-" );
+
+	gboolean ret = ( epg_count ( epg ) > 0 );
+
+	epg_free ( epg );
+
+	g_ptr_array_unref ( first  );
+	g_ptr_array_unref ( repeat );
+
+	return ( ret ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static gint64 helia_bench_cpu_time ( void )
+{
+	struct timespec ts;
+	clock_gettime ( CLOCK_PROCESS_CPUTIME_ID, &ts );
+
+	return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/* filesrc → tee → queue → tsparse → fakesink, tee → queue → fakesink ( live view and a record branch ). Returns the CPU time in us */
+static gint64 helia_bench_ts_pass ( const char *file, uint packets )
+{
+	GstElement *pipeline = gst_pipeline_new ( "pipeline-ts-bench" );
+
+	struct bench_list { const char *name; } bench_list_n[] =
+	{
+		{ "filesrc" }, { "tee" }, { "queue" }, { "tsparse" }, { "fakesink" }, { "queue" }, { "fakesink" }
+	};
+
+	GstElement *elements[ G_N_ELEMENTS ( bench_list_n ) ];
+
+	uint c = 0; for ( c = 0; c < G_N_ELEMENTS ( bench_list_n ); c++ )
+	{
+		elements[c] = gst_element_factory_make ( bench_list_n[c].name, NULL );
+
+		if ( !elements[c] ) { g_critical ( "%s:: element (factory make) - %s not created. \n", __func__, bench_list_n[c].name ); gst_object_unref ( pipeline ); return 0; }
+
+		gst_bin_add ( GST_BIN ( pipeline ), elements[c] );
+	}
+
+	gst_element_link_many ( elements[0], elements[1], elements[2], elements[3], elements[4], NULL );
+	gst_element_link_many ( elements[1], elements[5], elements[6], NULL );
+
+	g_object_set ( elements[0], "location", file, "blocksize", BENCH_BLOCKSIZE, NULL );
+	g_object_set ( elements[4], "sync", FALSE, NULL );
+	g_object_set ( elements[6], "sync", FALSE, NULL );
+
+	GstPad *pad = gst_element_get_static_pad ( elements[0], "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback)ts_batch_probe,
+		ts_batch_new ( packets, 50 ), (GDestroyNotify)ts_batch_free );
+	gst_object_unref ( pad );
+
+	gint64 time = helia_bench_cpu_time ();
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	GstMessage *msg = gst_bus_timed_pop_filtered ( bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR );
+
+	time = helia_bench_cpu_time () - time;
+
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ERROR ) { g_warning ( "%s: %s - error ", __func__, file ); time = 0; }
+
+	gst_message_unref ( msg );
+	gst_object_unref ( bus );
+
+	gst_element_set_state ( pipeline, GST_STATE_NULL );
+	gst_object_unref ( pipeline );
+
+	return time;
+}
+
+/* TS file read in small blocks ( as dvbsrc ), for several batch sizes: packets/s per core ( process CPU time ) and the CPU time per Mbit */
+static int helia_bench_ts ( const char *file )
+{
+	GStatBuf st;
+
+	if ( g_stat ( file, &st ) != 0 || st.st_size < TS_PACKET ) { g_printerr ( "ts: %s - no TS file \n", file ); return EXIT_FAILURE; }
+
+	double n_packets = (double)st.st_size / TS_PACKET;
+	double mbits = (double)st.st_size * 8 / 1000000;
+
+	uint sizes[] = { 0, 7, 64, 348, 1024 };
+
+	uint i = 0; for ( i = 0; i < G_N_ELEMENTS ( sizes ); i++ )
+	{
+		gint64 time = helia_bench_ts_pass ( file, sizes[i] );
+
+		if ( time <= 0 ) continue;
+
+		g_print ( "ts: batch %4u packets | %.0f packets/s per core | %.1f us CPU per Mbit \n", sizes[i],
+			n_packets * G_USEC_PER_SEC / (double)time, (double)time / mbits );
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int helia_bench_usage ( const char *name )
+{
+	g_printerr ( "Usage: %s psi <services> | ts <file> | eit <services> <days> \n", name );
+
+	return EXIT_FAILURE;
+}
+
+int main ( int argc, char *argv[] )
+{
+	gst_init ( NULL, NULL );
+
+	if ( argc >= 3 && g_str_equal ( argv[1], "psi" ) ) return helia_bench_psi ( (uint)atoi ( argv[2] ) );
+
+	if ( argc >= 3 && g_str_equal ( argv[1], "ts" ) ) return helia_bench_ts ( argv[2] );
+
+	if ( argc >= 4 && g_str_equal ( argv[1], "eit" ) ) return helia_bench_eit ( (uint)atoi ( argv[2] ), (uint)atoi ( argv[3] ) );
+
+	return helia_bench_usage ( argv[0] );
+}
@@ -0,0 +1,189 @@
+/*
+* Copyright 2020 Stepan Perun
+* This program is free software.
+*
+* License: Gnu General Public License GPL-3
+* file:///usr/share/common-licenses/GPL-3
+* http://www.gnu.org/licenses/gpl-3.0.html
+*/
+
+#include "scanjob.h"
+#include "mpegts.h"
+#include "psi.h"
+
+#include <gst/gst.h>
+#include <stdlib.h>
+
+/* Scan without the GUI: the channels found are printed ( one line each, as in gtv-channel.conf ).
+ *   helia-scan initial <file> [ adapter frontend ]   all transponders of an initial file, in parallel on the free tuners
+ *   helia-scan file <ts>                             a recorded multiplex, read at disk speed: the services and the PAT / PMT / SDT times
+ * Simulated tuners as in the GUI: DVB_TUNER_SIM, DVB_SCAN_SIM_DIR */
+
+typedef struct _HeliaScan HeliaScan;
+
+struct _HeliaScan
+{
+	GMainLoop *loop;
+	uint n_channels;
+
+	MpegTs *mpegts;
+	gint64 time_start, time_pat, time_pmt, time_sdt;
+};
+
+static void helia_scan_channel ( G_GNUC_UNUSED const char *ch_name, const char *ch_data, HeliaScan *hscan )
+{
+	g_print ( "%s\n", ch_data );
+
+	hscan->n_channels++;
+}
+
+static void helia_scan_progress ( uint done, uint total, uint tuners, HeliaScan *hscan )
+{
+	g_printerr ( "transponders %u / %u | tuners %u \n", done, total, tuners );
+
+	if ( done == total && tuners == 0 ) g_main_loop_quit ( hscan->loop );
+}
+
+static int helia_scan_initial ( const char *file, int adapter, int frontend )
+{
+	HeliaScan hscan = { NULL, 0, NULL, 0, 0, 0, 0 };
+
+	ScanJob *job = scan_job_new ( (ScanJobFunc)helia_scan_channel, (ScanJobProgress)helia_scan_progress, &hscan );
+
+	if ( !scan_job_add_file ( file, NULL, job ) ) { g_printerr ( "%s: no transponders \n", file ); scan_job_free ( job ); return EXIT_FAILURE; }
+
+	hscan.loop = g_main_loop_new ( NULL, FALSE );
+
+	gboolean ret = scan_job_start ( adapter, frontend, FALSE, job );
+
+	if ( ret ) g_main_loop_run ( hscan.loop ); else g_printerr ( "All tuners are busy. \n" );
+
+	scan_job_free ( job );
+	g_main_loop_unref ( hscan.loop );
+
+	return ( ret && hscan.n_channels ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void helia_scan_file_sections ( GPtrArray *sections, HeliaScan *hscan )
+{
+	uint i = 0; for ( i = 0; i < sections->len; i++ ) mpegts_add_section ( g_ptr_array_index ( sections, i ), hscan->mpegts );
+
+	gint64 now = g_get_monotonic_time ();
+
+	if ( !hscan->time_pat && hscan->mpegts->pat_done ) hscan->time_pat = now;
+	if ( !hscan->time_pmt && hscan->mpegts->pmt_done ) hscan->time_pmt = now;
+	if ( !hscan->time_sdt && hscan->mpegts->sdt_done ) hscan->time_sdt = now;
+
+	if ( hscan->mpegts->pat_done && hscan->mpegts->pmt_done && hscan->mpegts->sdt_done ) g_main_loop_quit ( hscan->loop );
+}
+
+static void helia_scan_file_msg ( G_GNUC_UNUSED GstBus *bus, GstMessage *msg, HeliaScan *hscan )
+{
+	if ( GST_MESSAGE_TYPE ( msg ) == GST_MESSAGE_ERROR )
+	{
+		GError *err = NULL;
+		gst_message_parse_error ( msg, &err, NULL );
+
+		g_printerr ( "%s \n", err->message );
+		g_error_free ( err );
+	}
+
+	g_main_loop_quit ( hscan->loop );
+}
+
+/* filesrc → fakesink without sync, as the Scanner page: ends when PAT, PMT and SDT are done ( or at EOS ) */
+static int helia_scan_file ( const char *file )
+{
+	HeliaScan hscan = { NULL, 0, NULL, 0, 0, 0, 0 };
+
+	GstElement *pipeline = gst_pipeline_new ( "pipeline-scan-file" );
+	GstElement *filesrc  = gst_element_factory_make ( "filesrc",  NULL );
+	GstElement *filesink = gst_element_factory_make ( "fakesink", NULL );
+
+	if ( !filesrc || !filesink ) { g_printerr ( "filesrc / fakesink not created. \n" ); gst_object_unref ( pipeline ); return EXIT_FAILURE; }
+
+	gst_bin_add_many ( GST_BIN ( pipeline ), filesrc, filesink, NULL );
+	gst_element_link_many ( filesrc, filesink, NULL );
+
+	g_object_set ( filesrc, "location", file, NULL );
+	g_object_set ( filesink, "sync", FALSE, NULL );
+
+	hscan.loop   = g_main_loop_new ( NULL, FALSE );
+	hscan.mpegts = mpegts_new ();
+
+	/* Immediate: the PAT / PMT / SDT times are not skewed by the batching */
+	Psi *psi = psi_new ( TRUE, TRUE, (PsiFunc)helia_scan_file_sections, &hscan );
+	psi_add_pid ( 0x11, psi );
+
+	GstPad *pad = gst_element_get_static_pad ( filesrc, "src" );
+	gst_pad_add_probe ( pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)psi_probe, psi, NULL );
+	gst_object_unref ( pad );
+
+	GstBus *bus = gst_element_get_bus ( pipeline );
+	gst_bus_add_signal_watch ( bus );
+
+	g_signal_connect ( bus, "message::eos",   G_CALLBACK ( helia_scan_file_msg ), &hscan );
+	g_signal_connect ( bus, "message::error", G_CALLBACK ( helia_scan_file_msg ), &hscan );
+
+	hscan.time_start = g_get_monotonic_time ();
+
+	gst_element_set_state ( pipeline, GST_STATE_PLAYING );
+
+	g_main_loop_run ( hscan.loop );
+
+	gint64 pos = 0;
+	gst_element_query_position ( filesrc, GST_FORMAT_BYTES, &pos );
+
+	gst_element_set_state ( pipeline, GST_STATE_NULL );
+
+	MpegTs *mpegts = hscan.mpegts;
+
+	uint i = 0, n = mpegts_get_n_services ( mpegts );
+
+	for ( i = 0; i < n; i++ )
+	{
+		const MpegTsService *srv = mpegts_get_service_nth ( i, mpegts );
+
+		g_print ( "%s:program-number=%u:video-pid=%u:audio-pid=%u:tsid=%u:onid=%u\n", ( srv->ch_name ) ? srv->ch_name : "-",
+			srv->sid, srv->pmt_vpid, srv->pmt_apid, mpegts->tsid, mpegts->onid );
+	}
+
+	g_printerr ( "PAT %ld ms | PMT %ld ms | SDT %ld ms | read %ld KB | services %u \n",
+		( hscan.time_pat ) ? (long)( hscan.time_pat - hscan.time_start ) / 1000 : -1L,
+		( hscan.time_pmt ) ? (long)( hscan.time_pmt - hscan.time_start ) / 1000 : -1L,
+		( hscan.time_sdt ) ? (long)( hscan.time_sdt - hscan.time_start ) / 1000 : -1L,
+		(long)pos / 1024, n );
+
+	gboolean ret = mpegts->pat_done;
+
+	gst_bus_remove_signal_watch ( bus );
+	gst_object_unref ( bus );
+	gst_object_unref ( pipeline );
+
+	psi_free ( psi );
+	mpegts_free ( mpegts );
+	g_main_loop_unref ( hscan.loop );
+
+	return ( ret ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int helia_scan_usage ( const char *name )
+{
+	g_printerr ( "Usage: %s initial <file> [ adapter frontend ] | file <ts> \n", name );
+
+	return EXIT_FAILURE;
+}
+
+int main ( int argc, char *argv[] )
+{
+	gst_init ( NULL, NULL );
+
+	mpegts_initialize ();
+
+	if ( argc >= 3 && g_str_equal ( argv[1], "initial" ) )
+		return helia_scan_initial ( argv[2], ( argc >= 5 ) ? atoi ( argv[3] ) : 0, ( argc >= 5 ) ? atoi ( argv[4] ) : 0 );
+
+	if ( argc >= 3 && g_str_equal ( argv[1], "file" ) ) return helia_scan_file ( argv[2] );
+
+	return helia_scan_usage ( argv[0] );
+}